@@ -4,6 +4,8 @@
 #if defined (WIN32)
     
     #include <windows.h>
+    #include <io.h>
+    #include <fcntl.h>
     
 #else
 
@@ -21,33 +23,15 @@
 #include <ctype.h>
 #include <time.h>
 
-#include "dpcdecl.h"
-#include "dmgr.h"
-#include "dspi.h"
+#include "dspi_dev.h"
+#include "dspi_script.h"
+#include "dspi_log.h"
+#include "dspi_cmd.h"
+#include "dspi_snap.h"
+#include "dspi_trace.h"
+#include "dspi_metrics.h"
 
 
-#ifndef strlwr
-/**
-* Converts a string to lower case
-*
-* @return pointer to input str in lower case
-*
-*/
-char* strlwr(char* str){
-	uint8_t *p = (uint8_t*) str;
-	while(*p){
-		*p = tolower((uint8_t)*p);
-		p++;
-	}
-	return str;
-}
-#endif
-
-#define op_write 0xAA
-#define op_read 0xBB
-
-#define BTNREG 0
-#define LEDREG 1
 
 #ifndef bool
 typedef enum { false, true } bool;
@@ -56,35 +40,101 @@ typedef enum { false, true } bool;
 //Function flags
 bool fWrite=false;
 bool fRead=false;
-bool fRunApplication=false;
+bool fAxi=false;
+bool fModify=false;
+bool fCas=false;
+bool fWait=false;
+bool fScript=false;
+bool fCapture=false;
+bool fSnapshot=false;
+bool fRestore=false;
+volatile bool fRunApplication=false;
 
 //DSPI Initialized Flag
 bool fDspiInit=false;
+//The fabric register file answers plain frames, see -fabric
+bool fFabric=false;
+//Deadline of every command in ms, 0 for none, see -timeout
+uint32_t deadlineMs=0;
 
 //Global Variables
-uint8_t reg = 0;
-uint8_t data = 0;
+uint16_t reg = 0;
+uint16_t regs[CMD_MAX_REGS];
+uint32_t regVals[CMD_MAX_REGS];
+int regCount = 0;
+uint32_t data = 0;
+uint32_t mask = 0;	//Bit mask, or the expected value of cas
+uint32_t timeoutMs = 0;
+uint8_t modifyOp = op_nop;
+AxiOp axiOps[BRIDGE_MAX_OPS];
+char scriptPath[256];
+char snapPath[256];
+int snapFlags = 0;
+DspiSnap snap;
+uint32_t capConfig[6];	//period, pre, post, trigger mask, trigger value, channels
+uint16_t capSrc[CAPTURE_MAX_CHANNELS];
+int axiCount = 0;
 char input[256];
-BYTE sendBuf[128];
-BYTE recvBuf[128];
 
+#if defined(WIN32)
 DWORD threadID;
-enum cmdState{
+#endif
+//Shared with the terminal thread, which spins on it
+volatile enum cmdState{
 GETINPUT, // Wait for console thread to enter command
 EXECUTE, // Command received, main thread to execute
 WAIT // Command received, both threads waiting for DSPI
 } cmdState = GETINPUT;
 
 //DSPI Device Variables
-HIF hif;
-int portNum=0;
-int failattempt=0;
+DspiDev dev;
+const DspiTransport* transport = NULL;
+const char* deviceName = NULL;
+
+//Operation log, see dspi_log.h. Console text moves to stderr while the log
+//goes to stdout.
+LogWriter opLog;
+LogFormat logFormat = LOG_OFF;
+const char* logPath = NULL;
+FILE* con;
+
+//Timeline trace, see dspi_trace.h. inputNs is set by the terminal thread
+//before it hands a command over.
+TraceWriter trace;
+const char* tracePath = NULL;
+volatile uint64_t inputNs;
+uint64_t commandNs;
+
+//Metrics endpoint, see dspi_metrics.h. metricsAddr is NULL while it is off.
+MetricsServer metrics;
+char metricsAddr[64];
+uint16_t metricsPort = METRICS_PORT;
 
 //Forward Declarations
 void closeDSPI();
+void dropDSPI(int status);
 int parseArgs(char* input);
-int parseParam(char* arg);
+int parseRegister(const char* arg, uint16_t* addr);
+int parseValue(const char* arg, const char* what, uint32_t* val);
+int parseAxiOps(CmdLine* cl, uint8_t kind);
+int parseModify(CmdLine* cl, uint8_t op);
+int parseCas(CmdLine* cl);
+int parseWait(CmdLine* cl);
+int parseScript(CmdLine* cl);
+int parseCapture(CmdLine* cl);
+int parseSnapshot(CmdLine* cl, int fRestoring);
+void runCapture();
+int parseCommandLine(int argc, char* argv[]);
 void printUsage();
+void reportRejected();
+void logOp(uint8_t op, uint32_t addr, uint32_t value, uint8_t status, int result, uint64_t t0);
+void closeLog();
+void openTrace();
+void endCommand();
+void closeTrace();
+int parseMetrics(const char* arg);
+int openMetrics();
+void closeMetrics();
 int initDSPI();
 
 #if defined(WIN32)
@@ -96,6 +146,8 @@ void* terminalThread();
 
 void
 SignalHandler(int sig) {
+    static const char msg[] = "INFO: received request to terminate!!!\n";
+
     if ( SIGINT == sig ) {
         fRunApplication = 0;
     }
@@ -108,28 +160,55 @@ SignalHandler(int sig) {
         fRunApplication = 0;
     }
 
-    DebugMsg(INFO, "INFO: received request to terminate!!!\n");
+    write(STDERR_FILENO, msg, sizeof(msg) - 1);
 }
 
 #endif
 
 int main(int argc, char* argv[]){
-	struct timespec ts = {.tv_sec = 0, .tv_nsec = 1000000};
-
 	int status;
 
+	con = stdout;
+	if(parseCommandLine(argc, argv) != 0){
+		return 1;
+	}
+	if(logFormat != LOG_OFF){
+		FILE* fp = stdout;
+
+		if(logPath != NULL && (fp = fopen(logPath, "wb")) == NULL){
+			fprintf(stderr, "Cannot open %s\n", logPath);
+			return 1;
+		}
+		if(fp == stdout){
+			con = stderr;
+#if defined(WIN32)
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		}
+		logOpen(&opLog, logFormat, fp);
+		atexit(closeLog);
+	}
+	if(openMetrics() != 0){
+		return 1;
+	}
 	printUsage();
 	atexit(closeDSPI);
 
 //Initialize the DSPI connection.
 
-	if(status = initDSPI()!=0){
-		printf("Is the USB104A7 connected and accessible? Adept runtime 2.20 or later is required.\n");
+	if((status = initDSPI())!=0){
+#if defined(DSPI_WITH_ADEPT)
+		if(transport == &transportAdept){
+			fprintf(con, "Is the USB104A7 connected and accessible? Adept runtime 2.20 or later is required.\n");
+		}
+#endif
 		return status;
 	}else{
 		fDspiInit=true;
 	}
-	
+	fRunApplication=true;
+	traceThreadName("main");
+	openTrace();
 
 #if defined (WIN32)
 	terminalHandle = CreateThread(0, 0, TerminalThread, NULL, 0, &threadID);
@@ -142,17 +221,17 @@ int main(int argc, char* argv[]){
     sa.sa_flags = SA_RESTART;
     sigfillset(&sa.sa_mask);
     if ( -1 == sigaction(SIGINT, &sa, NULL) ) {
-        DebugMsg(CRITICAL, "ERROR: failed to register signal handler for SIGINT\n");
+        fprintf(stderr, "ERROR: failed to register signal handler for SIGINT\n");
         return 1;
     }
 
     if ( -1 == sigaction(SIGHUP, &sa, NULL) ) {
-        DebugMsg(CRITICAL, "ERROR: failed to register signal handler for SIGHUP\n");
+        fprintf(stderr, "ERROR: failed to register signal handler for SIGHUP\n");
         return 1;
     }
 
     if ( -1 == sigaction(SIGTERM, &sa, NULL) ) {
-        DebugMsg(CRITICAL, "ERROR: failed to register signal handler for SIGHUP\n");
+        fprintf(stderr, "ERROR: failed to register signal handler for SIGTERM\n");
         return 1;
     }
 
@@ -160,202 +239,1048 @@ int main(int argc, char* argv[]){
 #endif
 
 	while(fRunApplication){
+		endCommand();
 		
 		//If the DSPI is not connected
 		if(fDspiInit==false){
 			//Initialize the DSPI connection.
-			if(status = initDSPI()!=0){
-			continue;//Retry
+			if(initDSPI()!=0){
+				osSleepUs(1000);
+				continue;//Retry
 			}else{
 				fDspiInit=true;
+				metricsReconnect();
 			}
 		}
 
 		//cmdState is set in the terminal thread when input is received.
 		if(cmdState == EXECUTE){
+			traceComplete("handoff", inputNs, NULL, 0);
+			commandNs = traceStart();
 			//Parse input
 
 			if(parseArgs(input)== -1){
 				cmdState= GETINPUT;
 			}
+			else if(deadlineMs != 0){
+				//Waits and scripts add their own timeout
+				devSetDeadline(osNowNs() + ((uint64_t)deadlineMs + (fWait || fScript ? timeoutMs : 0)) * 1000000);
+			}
 			
 		}
 
-		//Write LEDs operation
+		logPoll(&opLog);
+		if(trace.fp != NULL){
+			tracePoll(&trace);
+		}
+
+		//Write operation, one bulk write for a run of registers in one region,
+		//otherwise a posted frame per register. Statuses arrive with the next frame.
 		if (fWrite){
+			uint8_t devStatus = STATUS_NO_REPLY;
+			uint64_t t0 = osNowNs();
+			int i;
 			fWrite = false;
 
-			sendBuf[0] = op_write;
-			sendBuf[1] = reg;
-			sendBuf[2] = data;
-			if(!DspiPut(hif, 0, 1, sendBuf, recvBuf, 2, 0)){
-				status = DmgrGetLastError();
-				printf("Error %d sending write message.\n",status);
-				fDspiInit=fFalse;
+			if(regCount > 1 && cmdIsBlock(regs, regCount)){
+				for(i = 0; i < regCount; i++){
+					regVals[i] = data;
+				}
+				status = devBulkWrite(&dev, regs[0], regVals, regCount, ENC_DZV, &devStatus);
+				logOp(op_bulk_write, regs[0], regCount, devStatus, status, t0);
+			}else{
+				for(i = 0, status = 0; i < regCount && status <= 0; i++){
+					status = devWrite(&dev, regs[i], data);
+					logOp(op_write, regs[i], data, STATUS_NO_REPLY, status, t0);
+				}
+			}
+			if(status > 0){
+				fprintf(con, "Error %d sending write message.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			else if(status != 0 && devStatus != STATUS_NO_REPLY){
+				fprintf(con, "Device rejected write of registers 0x%04X-0x%04X with status 0x%02X\n", regs[0], regs[regCount-1], devStatus);
+			}
+			else if(status != 0){
+				fprintf(con, "Out of sequence response from the device.\n");
+			}
+			reportRejected();
+
+			cmdState=GETINPUT;
+		}
+		//Bit commands, a single frame except for masked writes
+		if (fModify){
+			uint64_t t0 = osNowNs();
+			fModify = false;
+
+			switch(modifyOp){
+				case op_set_bits: status = devSetBits(&dev, reg, mask); break;
+				case op_clear_bits: status = devClearBits(&dev, reg, mask); break;
+				case op_toggle_bits: status = devToggleBits(&dev, reg, mask); break;
+				default: status = devMaskWrite(&dev, reg, mask, data); break;
+			}
+			logOp(modifyOp, reg, modifyOp == op_mask_write ? data : mask, STATUS_NO_REPLY, status, t0);
+			if(status > 0){
+				fprintf(con, "Error %d sending bit command.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			else if(status != 0){
+				fprintf(con, "Out of sequence response from the device.\n");
+			}
+			reportRejected();
+
+			cmdState=GETINPUT;
+		}
+		//Compare-and-swap, done in one step on the device
+		if (fCas){
+			uint32_t val;
+			uint8_t devStatus;
+			uint64_t t0 = osNowNs();
+			fCas = false;
+
+			status = devCompareSwap(&dev, reg, mask, data, &val, &devStatus);
+			logOp(op_cas, reg, val, devStatus, status, t0);
+			if(status > 0){
+				fprintf(con, "Error %d sending compare-and-swap.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			if(status == 0){
+				fprintf(con, "Register 0x%04X = 0x%0*X\n", reg, 2*regWidth(reg), val);
+			}
+			else if(devStatus == STATUS_MISMATCH){
+				fprintf(con, "Register 0x%04X holds 0x%0*X, not swapped\n", reg, 2*regWidth(reg), val);
+			}
+			else{
+				fprintf(con, "Device rejected compare-and-swap of register 0x%04X with status 0x%02X\n", reg, devStatus);
+			}
+			cmdState=GETINPUT;
+		}
+		//Wait for a value, the device polls the register
+		if (fWait){
+			uint32_t val;
+			uint8_t devStatus;
+			uint64_t t;
+			fWait = false;
+
+			t = osNowNs();
+			status = devWait(&dev, reg, mask, data, timeoutMs * 1000, &val, &devStatus);
+			logOp(op_wait, reg, val, devStatus, status, t);
+			t = (osNowNs() - t) / 1000000;
+			if(status > 0){
+				fprintf(con, "Error %d waiting for register.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			if(status == 0){
+				fprintf(con, "Register 0x%04X = 0x%0*X after %u ms\n", reg, 2*regWidth(reg), val, (unsigned)t);
+			}
+			else if(devStatus == STATUS_TIMEOUT){
+				fprintf(con, "Timed out after %u ms, register 0x%04X = 0x%0*X\n", (unsigned)t, reg, 2*regWidth(reg), val);
+			}
+			else{
+				fprintf(con, "Device rejected wait on register 0x%04X with status 0x%02X\n", reg, devStatus);
+			}
+			cmdState=GETINPUT;
+		}
+		//Register script, assembled here and run on the device
+		if (fScript){
+			static uint8_t code[SCRIPT_SIZE];
+			uint32_t cb;
+			uint32_t state = 0;
+			uint8_t devStatus = STATUS_NO_REPLY;
+			uint64_t t = 0;
+			FILE* fp;
+			fScript = false;
+
+			if((fp = fopen(scriptPath, "r")) == NULL){
+				fprintf(con, "Cannot open %s\n", scriptPath);
 				cmdState=GETINPUT;
 				continue;
 			}
-			//A small delay is added to allow the USB104A7 to queue up another SPI transfer.
-			//This is a limitation of the software driver used in this demo.
-			nanosleep(&ts, NULL);
-			if(!DspiPut(hif, 0, 1, sendBuf+2, recvBuf, 1, 0)){
-				status = DmgrGetLastError();
-				printf("Error %d sending write message.\n",status);
-				fDspiInit=fFalse;
+			status = scriptAssemble(fp, scriptPath, code, sizeof(code), &cb);
+			fclose(fp);
+			if(status != 0){
 				cmdState=GETINPUT;
 				continue;
 			}
-			
+			t = osNowNs();
+			if((status = devScriptLoad(&dev, 0, code, cb, &devStatus)) == 0){
+				if((status = devWrite(&dev, REG_SCRIPT, 0)) == 0){
+					status = devWait(&dev, REG_SCRIPT, SCRIPT_STATE_RUNNING, 0, timeoutMs * 1000, &state, &devStatus);
+				}
+				if(status == 0){
+					devStatus = SCRIPT_STATE_STATUS(state);
+				}
+			}
+			logOp(op_script_load, SCRIPT_STATE_PC(state), cb, devStatus, status, t);
+			t = (osNowNs() - t) / 1000000;
+			if(status > 0){
+				fprintf(con, "Error %d running script.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			reportRejected();
+			if(status == 0 && SCRIPT_STATE_STATUS(state) == STATUS_OK){
+				fprintf(con, "Script of %u bytes done after %u ms\n", (unsigned)cb, (unsigned)t);
+			}
+			else if(status == 0){
+				fprintf(con, "Script failed at 0x%04X with status 0x%02X\n", SCRIPT_STATE_PC(state), SCRIPT_STATE_STATUS(state));
+			}
+			else if(devStatus == STATUS_TIMEOUT){
+				devWrite(&dev, REG_SCRIPT, SCRIPT_CTL_STOP);
+				fprintf(con, "Script still running at 0x%04X after %u ms, stopped\n", SCRIPT_STATE_PC(state), (unsigned)t);
+			}
+			else{
+				fprintf(con, "Device rejected script with status 0x%02X\n", devStatus);
+			}
 			cmdState=GETINPUT;
 		}
-		if (fRead){
-			fRead = false;
+		//Capture on the device, then one streamed read of the trace
+		if (fCapture){
+			fCapture = false;
+			runCapture();
+			cmdState=GETINPUT;
+		}
+		//Snapshot of the register file, a delta read per DELTA_MAX_REGS registers
+		if (fSnapshot){
+			uint8_t devStatus = STATUS_NO_REPLY;
+			uint64_t t0 = osNowNs();
+			fSnapshot = false;
 
-			sendBuf[0] = op_read;
-			sendBuf[1] = reg;
-			if(!DspiPut(hif, 0, 0, sendBuf, recvBuf, 2, 0)){
-				status = DmgrGetLastError();
-				printf("Error %d sending read command message.\n",status);
-				cmdState=GETINPUT;
+			status = snapTake(&dev, &snap, snapFlags, &devStatus);
+			logOp(op_delta_read, 0, snapRegisters(&snap), devStatus, status, t0);
+			t0 = osNowNs() - t0;
+			if(status > 0){
+				fprintf(con, "Error %d taking snapshot.\n",status);
+				dropDSPI(status);
 				continue;
 			}
-			//A small delay is added to allow the USB104A7 to queue up another SPI transfer.
-			//This is a limitation of the software driver used in this demo.
-			nanosleep(&ts, NULL);
-			if(!DspiGet(hif, 0, 1, 1, recvBuf, 1, fFalse)){
-				status = DmgrGetLastError();
-				printf("Error %d reading message.\n",status);
+			if(status != 0){
+				fprintf(con, "Device rejected the snapshot with status 0x%02X\n", devStatus);
+			}
+			else if(snapSave(&snap, snapPath) != 0){
+				fprintf(con, "Cannot write %s\n", snapPath);
+			}
+			else{
+				fprintf(con, "%u registers saved to %s after %.2f ms\n", (unsigned)snapRegisters(&snap), snapPath, t0 / 1e6);
+			}
+			cmdState=GETINPUT;
+		}
+		//Restore of a snapshot, a bulk write per run of registers and a read back
+		if (fRestore){
+			uint32_t written = 0;
+			uint32_t mismatch = 0;
+			uint16_t bad = 0;
+			uint8_t devStatus = STATUS_NO_REPLY;
+			uint64_t t0;
+			fRestore = false;
+
+			if(snapLoad(&snap, snapPath) != 0){
+				fprintf(con, "Cannot load %s: missing, damaged or of another register map\n", snapPath);
 				cmdState=GETINPUT;
 				continue;
 			}
+			t0 = osNowNs();
+			status = snapRestore(&dev, &snap, &written, &mismatch, &bad, &devStatus);
+			logOp(op_bulk_write, 0, written, devStatus, status, t0);
+			t0 = osNowNs() - t0;
+			if(status > 0){
+				fprintf(con, "Error %d restoring snapshot.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			reportRejected();
+			if(status == 0){
+				fprintf(con, "%u registers restored and verified after %.2f ms\n", (unsigned)written, t0 / 1e6);
+			}
+			else if(mismatch != 0){
+				fprintf(con, "%u registers read back different, the first is 0x%04X\n", (unsigned)mismatch, bad);
+			}
+			else{
+				fprintf(con, "Device rejected the restore with status 0x%02X\n", devStatus);
+			}
+			cmdState=GETINPUT;
+		}
+		//Read operation, the frames of a register list are pipelined
+		if (fRead){
+			uint64_t t0 = osNowNs();
+			int i;
+			fRead = false;
+
+			status = devRead(&dev, regs, regVals, regCount);
+			for(i = 0; i < regCount; i++){
+				logOp(op_read, regs[i], regVals[i], status == 0 ? STATUS_OK : STATUS_NO_REPLY, status, t0);
+			}
+			if(status > 0){
+				reportRejected();
+				fprintf(con, "Error %d reading message.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			reportRejected();
+			if(status < 0){
+				fprintf(con, "Device rejected a read of registers 0x%04X-0x%04X.\n", regs[0], regs[regCount-1]);
+			}
+
+			for(i = 0; i < regCount; i++){
+				fprintf(con, "Register 0x%04X = 0x%0*X\n", regs[i], 2*regWidth(regs[i]), regVals[i]);
+			}
+			cmdState=GETINPUT;
+		}
+		//Batched AXI peek/poke, one frame and two payload transfers
+		if (fAxi){
+			int i;
+			uint64_t t0 = osNowNs();
+			fAxi = false;
 
-			printf("Register %d = 0x%02X", reg, recvBuf[0]);
-			printf("\n");
+			status = devAxiBatch(&dev, axiOps, axiCount);
+			for(i = 0; i < axiCount; i++){
+				logOp(axiOps[i].kind == BRIDGE_READ ? LOG_OP_AXI_READ : LOG_OP_AXI_WRITE, axiOps[i].addr, axiOps[i].value,
+					axiOps[i].status, status > 0 ? status : (axiOps[i].status != STATUS_OK ? -1 : 0), t0);
+			}
+			if(status > 0){
+				fprintf(con, "Error %d sending AXI batch.\n",status);
+				dropDSPI(status);
+				continue;
+			}
+			reportRejected();
+			for(i = 0; i < axiCount; i++){
+				if(axiOps[i].status != STATUS_OK){
+					fprintf(con, "0x%08X: rejected with status 0x%02X\n", axiOps[i].addr, axiOps[i].status);
+				}
+				else if(axiOps[i].kind == BRIDGE_READ){
+					fprintf(con, "0x%08X = 0x%08X\n", axiOps[i].addr, axiOps[i].value);
+				}
+			}
 			cmdState=GETINPUT;
 		}
 
 		
-		nanosleep(&ts, NULL);
+		endCommand();
+		osSleepUs(1000);
 	}
+	closeTrace();
 	closeDSPI();
 	exit(0);
 	return 0;
 }
 
+/**
+* Prints a write the device rejected after it was sent.
+*/
+void reportRejected(){
+	uint8_t op;
+	uint16_t addr;
+	uint8_t status;
+
+	if(devTakeRejected(&dev, &op, &addr, &status)){
+		logOp(LOG_OP_REJECTED, addr, op, status, -1, osNowNs());
+		fprintf(con, "Device rejected command 0x%02X 0x%04X with status 0x%02X\n", op, addr, status);
+	}
+}
+
+/**
+* Logs an operation that started at t0 and ends now.
+*
+* @param op opcode, or LOG_OP_*
+* @param status device status, STATUS_NO_REPLY if the device gave none
+* @param result return value of the dspi_dev call
+*
+*/
+void logOp(uint8_t op, uint32_t addr, uint32_t value, uint8_t status, int result, uint64_t t0){
+	LogRecord rec;
+
+	if(logFormat == LOG_OFF){
+		return;
+	}
+	rec.tNs = t0;
+	rec.latencyNs = (uint32_t)(osNowNs() - t0);
+	rec.op = op;
+	rec.addr = addr;
+	rec.value = value;
+	rec.status = status;
+	rec.result = result;
+	logRecord(&opLog, &rec);
+}
+
+/**
+* Writes out the records still buffered in the operation log.
+*/
+void closeLog(){
+	logFlush(&opLog);
+}
+
+/**
+* Starts the -trace file, with the device events if the firmware traces.
+*/
+void openTrace(){
+	FILE* fp;
+
+	if(tracePath == NULL){
+		return;
+	}
+	if((fp = fopen(tracePath, "w")) == NULL){
+		fprintf(con, "Cannot open %s\n", tracePath);
+		return;
+	}
+	traceOpen(&trace, fp, &dev);
+	if(trace.dev == NULL){
+		fprintf(con, "Firmware does not trace, tracing the host only.\n");
+	}
+	atexit(closeTrace);
+}
+
+/**
+* Ends the trace span of a command once it is done.
+*/
+void endCommand(){
+	if(commandNs != 0 && cmdState == GETINPUT){
+		traceComplete("command", commandNs, NULL, 0);
+		commandNs = 0;
+	}
+}
+
+/**
+* Completes the -trace file.
+*/
+void closeTrace(){
+	if(trace.fp == NULL){
+		return;
+	}
+	traceClose(&trace);
+	fclose(trace.fp);
+	trace.fp = NULL;
+}
+
+/**
+* Starts the -metrics endpoint.
+*
+* @return 0 if passed or off, -1 if the port could not be opened
+*
+*/
+int openMetrics(){
+	if(metricsAddr[0] == '\0'){
+		return 0;
+	}
+	if(metricsServe(&metrics, metricsAddr, metricsPort) != 0){
+		fprintf(con, "Cannot serve metrics on %s:%u\n", metricsAddr, metricsPort);
+		return -1;
+	}
+	fprintf(con, "Metrics at http://%s:%u/metrics\n", metricsAddr, metrics.port);
+	atexit(closeMetrics);
+	return 0;
+}
+
+void closeMetrics(){
+	metricsStop(&metrics);
+}
+
+/**
+* Parses the argument of -metrics, [addr:]port.
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseMetrics(const char* arg){
+	const char* colon = strrchr(arg, ':');
+	const char* port = arg;
+	char* end;
+	unsigned long n;
+
+	strcpy(metricsAddr, "127.0.0.1");
+	if(colon != NULL){
+		if(colon == arg || (size_t)(colon - arg) >= sizeof(metricsAddr)){
+			return -1;
+		}
+		memcpy(metricsAddr, arg, colon - arg);
+		metricsAddr[colon - arg] = '\0';
+		port = colon + 1;
+	}
+	n = strtoul(port, &end, 0);
+	if(*port == '\0' || *end != '\0' || n > 0xFFFF){
+		return -1;
+	}
+	metricsPort = (uint16_t)n;
+	return 0;
+}
+
+/**
+* Handles a transport error. A missed deadline leaves the device open, the
+* next command skips the lost response. Other errors close the device and
+* the main loop opens it again.
+*/
+void dropDSPI(int status){
+	cmdState=GETINPUT;//Print prompt again.
+	if(status == LINK_ERR_TIMEOUT || status == LINK_ERR_CANCELED){
+		fprintf(con, "Deadline missed, the device stays open.\n");
+		return;
+	}
+	closeDSPI();
+}
+
 /**
 * Closes the connection to the DSPI device
 */
 void closeDSPI(){
 	cmdState=GETINPUT;//Print prompt again.
-	DmgrCancelTrans(hif);
-	DspiDisable(hif);
-	DmgrClose(hif);
+	trace.dev = NULL;//Device events end with the connection
+	if(fDspiInit){
+		devClose(&dev);
+	}
 	fDspiInit=false;
-	cmdState=false;
 }
 
 /**
-* Parses the input string into commands. Boolean flags are set and executed in the main loop.
+* Parses the program arguments.
 *
-* @param input the input string to parse
+* -sim [options]	use the simulated device, see link_sim.c for options
+* -rtl [options]	use the RTL co-simulation, see link_rtl.cpp for options
+* -d [device]		Adept device name
+* -log json|binary	log every operation, see dspi_log.h
+* -o [file]		write the log to file instead of stdout
+* -fabric		the device serves plain reads and writes from the fabric,
+*			skip the settle delay after them. Only needed with
+*			legacy firmware, newer firmware reports it
+* -timeout [ms]	deadline of every command, waits add their own timeout
+* -trace [file]	write a timeline of the host and the firmware, see
+*			dspi_trace.h
+* -metrics [addr:port]	serve Prometheus metrics, addr defaults to
+*			127.0.0.1, see dspi_metrics.h
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseCommandLine(int argc, char* argv[]){
+	int i;
+
+#if defined(DSPI_WITH_ADEPT)
+	transport = &transportAdept;
+#else
+	transport = &transportSim;
+#endif
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-sim") == 0){
+			transport = &transportSim;
+			if(i + 1 < argc && argv[i+1][0] != '-'){
+				deviceName = argv[++i];
+			}
+		}
+#if defined(DSPI_WITH_RTL)
+		else if(strcmp(argv[i], "-rtl") == 0){
+			transport = &transportRtl;
+			if(i + 1 < argc && argv[i+1][0] != '-'){
+				deviceName = argv[++i];
+			}
+		}
+#endif
+		else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc){
+			deviceName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-log") == 0 && i + 1 < argc && strcmp(argv[i+1], "json") == 0){
+			logFormat = LOG_JSON;
+			i++;
+		}
+		else if(strcmp(argv[i], "-log") == 0 && i + 1 < argc && strcmp(argv[i+1], "binary") == 0){
+			logFormat = LOG_BINARY;
+			i++;
+		}
+		else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+			logPath = argv[++i];
+		}
+		else if(strcmp(argv[i], "-fabric") == 0){
+			fFabric = true;
+		}
+		else if(strcmp(argv[i], "-timeout") == 0 && i + 1 < argc){
+			deadlineMs = (uint32_t)strtoul(argv[++i], NULL, 0);
+		}
+		else if(strcmp(argv[i], "-trace") == 0 && i + 1 < argc){
+			tracePath = argv[++i];
+		}
+		else if(strcmp(argv[i], "-metrics") == 0 && i + 1 < argc && parseMetrics(argv[i+1]) == 0){
+			i++;
+		}
+		else{
+			fprintf(con, "Usage: %s [-sim [sck=Hz,usb=us,btn=value,hang=n,hangms=ms,fabric=1,legacy=1,noop=op]] [-rtl [sck=Hz,usb=us,fw=ns,strict=1]] [-d device] [-log json|binary] [-o file] [-fabric] [-timeout ms] [-trace file] [-metrics [addr:]port]\n", argv[0]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+* Parses the input string into a command. Boolean flags are set and executed in the main loop.
+*
+* @param input the input string to parse, split in place
 *
 * @return 0 if passed, -1 if failed
 *
 */
 int parseArgs(char* input){
-	char* arg;
-	arg = strtok(input, " \n");
+	CmdLine cl;
+	const char* arg;
+	const char* extra;
+	uint32_t bad;
+	int status;
+
+	if(cmdSplit(input, &cl) == -1){
+		fprintf(con, "At most %d words fit on a line\n", CMD_MAX_TOKENS);
+		return -1;
+	}
+	arg = cmdNext(&cl);
 	if(arg==NULL){
-		printf("\nPlease enter a command\n");
+		fprintf(con, "\nPlease enter a command\n");
 		return -1;
 	}
-	while(arg!=NULL){
-		if(strcmp(strlwr(arg), "write")==0){
-			arg = strtok(NULL, " \n");
-			reg = parseParam(arg);
-			if(reg == -1){
-				printf("Unrecognize register %s. Please enter register number/signifier: IE: 1 0x1 led btn", arg);
-				return -1;
+	if(cmdIs(arg, "write") || cmdIs(arg, "read")){
+		bool fIsWrite = cmdIs(arg, "write");
+		int i;
+
+		arg = cmdNext(&cl);
+		if((status = cmdRegisters(arg, regs, CMD_MAX_REGS, &regCount, &bad)) != 0){
+			if(status == CMD_ERR_UNMAPPED){
+				fprintf(con, "Register 0x%X is not mapped, nothing was sent\n", (unsigned)bad);
+			}else if(status == CMD_ERR_TOO_MANY){
+				fprintf(con, "At most %d registers fit in one command\n", CMD_MAX_REGS);
+			}else{
+				fprintf(con, "Unrecognize register %s. Please enter register number/signifier, list or range: IE: 1 0x1 led btn 4,5 2..63\n", arg ? arg : "");
 			}
-			arg = strtok(NULL, " \n");
-			data = parseParam(arg);
-			if(data == -1){
-				printf("Unrecognized data: %s. Please enter a decimal or hex value. IE: 0xA or 10", arg);
+			return -1;
+		}
+		if(fIsWrite){
+			if(parseValue(cmdNext(&cl), "data", &data) != 0){
 				return -1;
 			}
-			fWrite=true;
-		}
-		else if(strcmp(strlwr(arg), "read")==0){
-			arg = strtok(NULL, " \n");
-			reg = parseParam(arg);
-			if(reg == -1){
-				printf("Unrecognize register %s. Please enter data to write in hex.", arg);
+			//The value has to fit every register it is written to
+			if((i = cmdTooWide(regs, regCount, data)) >= 0){
+				fprintf(con, "0x%X does not fit the %d-byte register 0x%04X, nothing was sent\n", (unsigned)data, regWidth(regs[i]), regs[i]);
 				return -1;
 			}
-
-			fRead=true;
 		}
-		else if(strcmp(strlwr(arg), "help")==0 || arg[0]=='?'){
-			printUsage();
+		if((extra = cmdNext(&cl)) != NULL){
+			fprintf(con, "Unexpected %s. Please enter one command per line\n", extra);
 			return -1;
 		}
-		else {
-			printf("Error: Invalid argument %s\n", arg);
-			printUsage();
-			return -1;
+		if(fIsWrite){
+			fWrite=true;
+		}else{
+			fRead=true;
 		}
-		arg = strtok(NULL, " \n");
+		return 0;
+	}
+	else if(cmdIs(arg, "set")){
+		status = parseModify(&cl, op_set_bits);
+	}
+	else if(cmdIs(arg, "clear")){
+		status = parseModify(&cl, op_clear_bits);
+	}
+	else if(cmdIs(arg, "toggle")){
+		status = parseModify(&cl, op_toggle_bits);
+	}
+	else if(cmdIs(arg, "mask")){
+		status = parseModify(&cl, op_mask_write);
+	}
+	else if(cmdIs(arg, "cas")){
+		status = parseCas(&cl);
+	}
+	else if(cmdIs(arg, "wait")){
+		status = parseWait(&cl);
+	}
+	else if(cmdIs(arg, "script")){
+		status = parseScript(&cl);
+	}
+	else if(cmdIs(arg, "capture")){
+		status = parseCapture(&cl);
+	}
+	else if(cmdIs(arg, "snapshot")){
+		status = parseSnapshot(&cl, 0);
+	}
+	else if(cmdIs(arg, "restore")){
+		status = parseSnapshot(&cl, 1);
+	}
+	else if(cmdIs(arg, "peek")){
+		status = parseAxiOps(&cl, BRIDGE_READ);
+	}
+	else if(cmdIs(arg, "poke")){
+		status = parseAxiOps(&cl, BRIDGE_WRITE);
+	}
+	else if(cmdIs(arg, "help") || arg[0]=='?'){
+		printUsage();
+		return -1;
+	}
+	else {
+		fprintf(con, "Error: Invalid argument %s\n", arg);
+		printUsage();
+		return -1;
+	}
+	if(status == 0 && (extra = cmdNext(&cl)) != NULL){
+		fprintf(con, "Unexpected %s. Please enter one command per line\n", extra);
+		fModify = fCas = fWait = fScript = fCapture = fSnapshot = fRestore = fAxi = false;
+		return -1;
+	}
+	return status;
+}
+
+/**
+* Parses a single mapped register and prints why it failed.
+*
+* @param arg the token to parse, may be NULL
+* @param addr receives the register address
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseRegister(const char* arg, uint16_t* addr){
+	uint32_t bad;
+	int status;
+
+	if((status = cmdRegister(arg, addr, &bad)) == CMD_ERR_UNMAPPED){
+		fprintf(con, "Register 0x%X is not mapped, nothing was sent\n", (unsigned)bad);
+		return -1;
 	}
+	if(status != 0){
+		fprintf(con, "Unrecognize register %s. Please enter register number/signifier: IE: 1 0x1 led btn\n", arg ? arg : "");
+		return -1;
+	}
+	return 0;
+}
 
+/**
+* Parses a 32-bit number and prints why it failed.
+*
+* @param arg the token to parse, may be NULL
+* @param what name of the parameter for the message
+* @param val receives the value
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseValue(const char* arg, const char* what, uint32_t* val){
+	if(cmdValue(arg, val) != 0){
+		fprintf(con, "Unrecognized %s: %s. Please enter a decimal or hex value. IE: 0xA or 10\n", what, arg ? arg : "");
+		return -1;
+	}
 	return 0;
 }
 
 /**
-* Parses the input string into a value.
+* Parses the rest of the input into a bit command: register and mask, plus the
+* value for a masked write.
 *
-* @param input the input string to parse
+* @param op op_set_bits, op_clear_bits, op_toggle_bits or op_mask_write
 *
-* @return integer value of a parameter
+* @return 0 if passed, -1 if failed
 *
 */
-int parseParam(char* arg){
-	uint8_t val;
-	if(arg==NULL){
+int parseModify(CmdLine* cl, uint8_t op){
+	if(parseRegister(cmdNext(cl), &reg) != 0 || parseValue(cmdNext(cl), "mask", &mask) != 0){
 		return -1;
 	}
-	//0xNN
-	if(arg[0]=='0' && (arg[1]=='x'||arg[1]=='X')){
-		sscanf(arg, "0x%X", &val);
+	if(op == op_mask_write && parseValue(cmdNext(cl), "data", &data) != 0){
+		return -1;
 	}
-	//led(s)
-	else if (strncmp(strlwr(arg), "led", 3)==0){
-		val = LEDREG;
+	modifyOp = op;
+	fModify=true;
+	return 0;
+}
+
+/**
+* Parses the rest of the input into a compare-and-swap: register, expected
+* value and new value.
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseCas(CmdLine* cl){
+	if(parseRegister(cmdNext(cl), &reg) != 0 || parseValue(cmdNext(cl), "expected value", &mask) != 0
+		|| parseValue(cmdNext(cl), "data", &data) != 0){
+		return -1;
+	}
+	fCas=true;
+	return 0;
+}
+
+/**
+* Parses the rest of the input into a wait: register, mask, value and
+* timeout in ms.
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseWait(CmdLine* cl){
+	if(parseRegister(cmdNext(cl), &reg) != 0 || parseValue(cmdNext(cl), "mask", &mask) != 0
+		|| parseValue(cmdNext(cl), "data", &data) != 0 || parseValue(cmdNext(cl), "timeout", &timeoutMs) != 0){
+		return -1;
 	}
-	else if(strncmp(strlwr(arg),"btn", 3)==0){
-		val = BTNREG;
+	if(timeoutMs > 3600000){
+		fprintf(con, "Timeout %u ms is over an hour\n", (unsigned)timeoutMs);
+		return -1;
 	}
-	//N
-	else{
-		val = strtol(arg, NULL, 10);
-		if (val==0 && arg[0]!='0'){//strtol returns 0 if no number is found. Check if the arg is actually 0
-			val=-1;//Arg was not a number
+	fWait=true;
+	return 0;
+}
+
+/**
+* Parses the rest of the input into a script run: file and optional timeout
+* in ms.
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseScript(CmdLine* cl){
+	const char* arg;
+
+	arg = cmdNext(cl);
+	if(arg == NULL || strlen(arg) >= sizeof(scriptPath)){
+		fprintf(con, "Please enter a script file. IE: script blink.txt\n");
+		return -1;
+	}
+	strcpy(scriptPath, arg);
+	timeoutMs = 10000;
+	arg = cmdNext(cl);
+	if(arg != NULL && (parseValue(arg, "timeout", &timeoutMs) != 0 || timeoutMs > 3600000)){
+		return -1;
+	}
+	fScript=true;
+	return 0;
+}
+
+/**
+* Parses the rest of the input into a snapshot, a file and "ddr" to include
+* the regions in DDR, or a restore, a file.
+*
+* @param fRestoring 1 for restore
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseSnapshot(CmdLine* cl, int fRestoring){
+	const char* arg;
+
+	arg = cmdNext(cl);
+	if(arg == NULL || strlen(arg) >= sizeof(snapPath)){
+		fprintf(con, "Please enter a snapshot file. IE: %s\n", fRestoring ? "restore state.snap" : "snapshot state.snap");
+		return -1;
+	}
+	strcpy(snapPath, arg);
+	snapFlags = 0;
+	if(!fRestoring && (arg = cmdNext(cl)) != NULL){
+		if(!cmdIs(arg, "ddr")){
+			fprintf(con, "Unexpected %s. Please enter ddr to include the DDR regions\n", arg);
+			return -1;
 		}
+		snapFlags = SNAP_DDR;
+	}
+	if(fRestoring){
+		fRestore=true;
+	}else{
+		fSnapshot=true;
 	}
-	return val;
+	return 0;
+}
+
+/**
+* Parses the rest of the input into a capture: period in us, samples before
+* and from the trigger, trigger mask and value, then up to
+* CAPTURE_MAX_CHANNELS registers as a list or range.
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseCapture(CmdLine* cl){
+	static const char* const names[] = {"period", "pre-trigger samples", "post-trigger samples", "trigger mask", "trigger value"};
+	const char* arg;
+	uint32_t bad;
+	int count = 0;
+	int n;
+	int status;
+	int i;
+
+	for(i = 0; i < 5; i++){
+		if(parseValue(cmdNext(cl), names[i], &capConfig[i]) != 0){
+			return -1;
+		}
+	}
+	while((arg = cmdNext(cl)) != NULL){
+		status = cmdRegisters(arg, capSrc + count, CAPTURE_MAX_CHANNELS - count, &n, &bad);
+		if(status == CMD_ERR_TOO_MANY){
+			fprintf(con, "At most %d registers can be captured\n", CAPTURE_MAX_CHANNELS);
+			return -1;
+		}
+		if(status == CMD_ERR_UNMAPPED){
+			fprintf(con, "Register 0x%X is not mapped, nothing was sent\n", (unsigned)bad);
+			return -1;
+		}
+		if(status != 0){
+			fprintf(con, "Unrecognize register %s. Please enter register number/signifier: IE: 1 0x1 led btn\n", arg);
+			return -1;
+		}
+		count += n;
+	}
+	if(count == 0){
+		fprintf(con, "Please enter at least one register\n");
+		return -1;
+	}
+	capConfig[5] = count;
+	fCapture=true;
+	return 0;
+}
+
+/**
+* Configures and arms a capture, waits for it to finish and prints the trace,
+* one sample per line with its time relative to the trigger.
+*/
+void runCapture(){
+	static uint32_t trace[CAPTURE_SIZE / 4];
+	static const uint16_t configRegs[6] = {REG_CAP_PERIOD, REG_CAP_PRE, REG_CAP_POST, REG_CAP_TRIG_MASK, REG_CAP_TRIG_VALUE, REG_CAP_CHANS};
+	uint16_t info[3] = {REG_CAP_LEN, REG_CAP_TRIG_AT, REG_CAP_ZLEN};
+	uint16_t ctl = REG_CAP_CTL;
+	uint32_t vals[3];
+	uint32_t state;
+	uint8_t op;
+	uint16_t addr;
+	uint32_t chans = capConfig[5];
+	uint32_t timeoutUs;
+	uint8_t devStatus = STATUS_NO_REPLY;
+	uint64_t t0 = osNowNs();
+	int status = 0;
+	uint32_t i, j;
+
+	for(i = 0; i < 6 && status == 0; i++){
+		status = devWrite(&dev, configRegs[i], capConfig[i]);
+	}
+	for(i = 0; i < chans && status == 0; i++){
+		status = devWrite(&dev, REG_CAP_SRC0 + i, capSrc[i]);
+	}
+	if(status == 0 && (status = devWrite(&dev, REG_CAP_CTL, CAPTURE_CTL_ARM)) == 0){
+		status = devRead(&dev, &ctl, &state, 1);//Collects the status of the arm
+	}
+	if(status > 0){
+		fprintf(con, "Error %d arming capture.\n",status);
+		dropDSPI(status);
+		return;
+	}
+	if(devTakeRejected(&dev, &op, &addr, &devStatus)){
+		fprintf(con, "Device rejected the capture setup at 0x%04X with status 0x%02X\n", addr, devStatus);
+		return;
+	}
+
+	//The post-trigger samples plus 10 s for the trigger
+	timeoutUs = 10000000 + (uint32_t)((uint64_t)capConfig[0] * capConfig[2] > 3600000000u ? 3600000000u : (uint64_t)capConfig[0] * capConfig[2]);
+	if(deadlineMs != 0){
+		devSetDeadline(osNowNs() + (uint64_t)timeoutUs * 1000 + (uint64_t)deadlineMs * 1000000);
+	}
+	status = devWait(&dev, REG_CAP_CTL, 0x3, CAPTURE_DONE, timeoutUs, &state, &devStatus);
+	if(status > 0){
+		fprintf(con, "Error %d waiting for capture.\n",status);
+		dropDSPI(status);
+		return;
+	}
+	if(status != 0){
+		devWrite(&dev, REG_CAP_CTL, CAPTURE_CTL_STOP);
+		fprintf(con, "Capture did not finish in time (state %u), stopped\n", (unsigned)state);
+		return;
+	}
+	//Packed if that is smaller, the device packs every finished trace
+	if(deadlineMs != 0){
+		devSetDeadline(osNowNs() + (uint64_t)deadlineMs * 1000000);
+	}
+	if((status = devRead(&dev, info, vals, 3)) == 0){
+		status = devCaptureTrace(&dev, trace, vals[0] * chans, chans, vals[2], &devStatus);
+		logOp(op_capture_read, vals[1], vals[0], devStatus, status, t0);
+	}
+	if(status > 0){
+		fprintf(con, "Error %d reading capture.\n",status);
+		dropDSPI(status);
+		return;
+	}
+	if(status != 0){
+		fprintf(con, "Device rejected the trace read with status 0x%02X\n", devStatus);
+		return;
+	}
+	fprintf(con, "%u samples every %u us, trigger at sample %u\n", (unsigned)vals[0], (unsigned)capConfig[0], (unsigned)vals[1]);
+	for(i = 0; i < vals[0]; i++){
+		fprintf(con, "%10lld", ((long long)i - vals[1]) * capConfig[0]);
+		for(j = 0; j < chans; j++){
+			fprintf(con, " 0x%08X", trace[i * chans + j]);
+		}
+		fprintf(con, "\n");
+	}
+}
+
+/**
+* Parses the rest of the input into a batch of AXI requests: addresses for
+* peek, address and value pairs for poke.
+*
+* @param kind BRIDGE_READ or BRIDGE_WRITE
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+int parseAxiOps(CmdLine* cl, uint8_t kind){
+	const char* arg;
+	axiCount = 0;
+	while((arg = cmdNext(cl)) != NULL){
+		if(axiCount == BRIDGE_MAX_OPS){
+			fprintf(con, "At most %d AXI requests fit in one batch\n", BRIDGE_MAX_OPS);
+			return -1;
+		}
+		if(parseValue(arg, "address", &axiOps[axiCount].addr) != 0){
+			return -1;
+		}
+		if(axiOps[axiCount].addr & 3){
+			fprintf(con, "Address 0x%08X is not word aligned\n", axiOps[axiCount].addr);
+			return -1;
+		}
+		axiOps[axiCount].kind = kind;
+		axiOps[axiCount].value = 0;
+		if(kind == BRIDGE_WRITE && parseValue(cmdNext(cl), "data", &axiOps[axiCount].value) != 0){
+			return -1;
+		}
+		axiCount++;
+	}
+	if(axiCount == 0){
+		fprintf(con, "Please enter at least one address\n");
+		return -1;
+	}
+	fAxi=true;
+	return 0;
 }
 
 /**
 * Prints the usage of the program
 */
 void printUsage(){
-	printf("USB104A7 DSPI demo\n------------------------------\n");
-	printf("This demo implements 64 makeshift registers on the USB104A7 that this application can read and write to.\n");
-	printf("Registers:\n");
-	printf("0 \"btn\" - Buttons\n1 \"led\" - LEDs\n2 - 63 General Purpose\n");
-	printf("Commands\n");
-	printf("write [register] [byte]\t-\twrite byte to \"register\" on board. IE: \"write led 5\" will turn on LD2 and LD0\n");
-	printf("read [register]\t-\treads a \"register\" from the device. IE: \"read btn\" will read the value of the buttons\n");
-	printf("help ?\t-\tPrints this usage menu\n");
+	int i;
+
+	fprintf(con, "USB104A7 DSPI demo\n------------------------------\n");
+	fprintf(con, "This demo implements makeshift registers on the USB104A7 that this application can read and write to.\n");
+	fprintf(con, "Registers:\n");
+	for(i = 0; i < REGMAP_N_NAMED; i++){
+		fprintf(con, "0x%04X \"%s\" - %s\n", regNamed[i].addr, regNamed[i].name, regNamed[i].help);
+	}
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		fprintf(con, "0x%04X - 0x%04X %s\n", regRegions[i].base, regRegions[i].base + regRegions[i].count - 1, regRegions[i].help);
+	}
+	fprintf(con, "Commands\n");
+	fprintf(con, "write [registers] [value]\t-\twrite value to \"registers\" on board. IE: \"write led 5\" will turn on LD2 and LD0\n");
+	fprintf(con, "read [registers]\t-\treads \"registers\" from the device. IE: \"read btn\" will read the value of the buttons\n");
+	fprintf(con, "\t[registers] is a register, a comma separated list or a range. IE: \"read 0x200..0x20F\" \"write 0x200,0x202 1\"\n");
+	fprintf(con, "set [register] [mask]\t-\tsets the bits of mask in \"register\" in one step. IE: \"set led 1\" will turn on LD0\n");
+	fprintf(con, "clear [register] [mask]\t-\tclears the bits of mask in \"register\" in one step. IE: \"clear led 1\" will turn off LD0\n");
+	fprintf(con, "toggle [register] [mask]\t-\tinverts the bits of mask in \"register\" in one step. IE: \"toggle led 0xF\"\n");
+	fprintf(con, "mask [register] [mask] [value]\t-\twrites only the bits of mask in \"register\". IE: \"mask led 0xC 4\" will turn on LD2 and off LD3\n");
+	fprintf(con, "cas [register] [expected] [value]\t-\twrites value if \"register\" holds expected, in one step. IE: \"cas 0x200 0 1\"\n");
+	fprintf(con, "wait [register] [mask] [value] [ms]\t-\twaits on the device until the bits of mask match value. IE: \"wait btn 1 1 5000\" waits for BTN0\n");
+	fprintf(con, "script [file] [ms]\t-\tassembles a register script and runs it on the device, 10 s timeout by default. IE: \"script blink.txt\"\n");
+	fprintf(con, "capture [us] [pre] [post] [mask] [value] [register]...\t-\tsamples registers on the device every us, from pre samples before the first sample whose bits of mask match value, and prints the trace. IE: \"capture 10 100 1000 1 1 btn led\"\n");
+	fprintf(con, "snapshot [file] [ddr]\t-\tsaves the registers of the fabric regions, and with ddr also those in DDR, to file. IE: \"snapshot state.snap\"\n");
+	fprintf(con, "restore [file]\t-\twrites a snapshot back to the device and verifies it. Read only registers and led, cap_ctl and script are left as they are. IE: \"restore state.snap\"\n");
+	fprintf(con, "peek [addr]...\t-\treads 32-bit words from the device AXI bus in one batch. IE: \"peek 0x40000000 0x40000008\"\n");
+	fprintf(con, "poke [addr] [value]...\t-\twrites 32-bit words to the device AXI bus in one batch. IE: \"poke 0x40000008 0xF\"\n");
+	fprintf(con, "help ?\t-\tPrints this usage menu\n");
 
 }
 
@@ -367,44 +1292,19 @@ void printUsage(){
 */
 int initDSPI(){
 	int status;
-	int cprtPti;
-	DWORD spd;
-
 
-	//Open device
-	if((status = DmgrOpen(&hif, "Usb104A7_DPTI"))==false){
-		status = DmgrGetLastError();
-		printf("Error %d opening Usb104A7_DSPI\n", status);
-		return status;	
-	}
-	//Get DSPI port count on device
-	if((status = DspiGetPortCount(hif, &cprtPti))==false){
-		status = DmgrGetLastError();
-		printf("Error %d getting DSPI port count\n", status);
-		DmgrClose(hif);
+	if((status = devOpen(&dev, transport, deviceName)) != 0){
 		return status;
 	}
-	if(cprtPti == 0){
-		printf("No DSPI ports found\n");
-		return status;
-	}
-	//Enable DSPI bus
-	if((status = DspiEnableEx(hif, portNum))==false){
-		status = DmgrGetLastError();
-		printf("Error %d enabling DSPI bus\n", status);
-		DmgrClose(hif);
-		return status;
+	if(fFabric){
+		dev.fabric = 1;//Firmware from before op_identify does not say
 	}
-	//Attempt to set speed slower (actual speed is stored in spd)
-	DspiSetSpeed(hif, 125000, &spd);
-	if(status =DspiSetSpiMode(hif, 0, fFalse)==false){ // Set to SPI Mode 0
-		status = DmgrGetLastError();
-		printf("Error %d setting SPI mode\n", status);
-		DmgrClose(hif);
-		return status;
+	if(dev.caps.protocol == PROTOCOL_LEGACY){
+		fprintf(con, "DSPI Device Opened (%s, legacy firmware)\n", transport->name);
+	}else{
+		fprintf(con, "DSPI Device Opened (%s, firmware %u, protocol %u%s)\n", transport->name,
+			dev.caps.firmware, dev.caps.protocol, dev.fabric ? ", fabric" : "");
 	}
-	DmgrSetTransTimeout(hif, 3000);//3 second timeout
-	printf("DSPI Device Opened\n");
 	return 0;
 }
 
@@ -417,12 +1317,24 @@ DWORD WINAPI TerminalThread(){
 void* terminalThread(){
 #endif
 	
+		uint64_t t;
+
+		traceThreadName("terminal");
 		//Print command prompt
 		while(fRunApplication){
-			printf("Enter command:");
-			fgets(input, sizeof(input), stdin);
+			fprintf(con, "Enter command:");
+			fflush(con);
+			if(fgets(input, sizeof(input), stdin) == NULL){
+				fRunApplication = false;//End of input
+				break;
+			}
+			inputNs = traceStart();
+			t = inputNs;
 			cmdState=EXECUTE;
-			while(cmdState != GETINPUT);
+			while(cmdState != GETINPUT && fRunApplication){
+				osSleepUs(1000);
+			}
+			traceComplete("wait", t, NULL, 0);
 		}
 		return 0;
-}
\ No newline at end of file
+}
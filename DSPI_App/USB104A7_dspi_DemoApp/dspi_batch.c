@@ -0,0 +1,195 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_batch.c  --  Coalescing of register accesses from threads    */
+/*                                                                      */
+/************************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+
+#include "dspi_batch.h"
+
+/**
+* Sets up batching for an open device.
+*
+* @param batch state to initialize
+* @param dev device the batches run on
+* @param budgetUs longest a request is held for others to join it
+* @param maxOps requests per batch, at most BATCH_MAX_OPS
+*
+*/
+void batchInit(DspiBatch* batch, DspiDev* dev, uint32_t budgetUs, int maxOps){
+	memset(batch, 0, sizeof(DspiBatch));
+	batch->dev = dev;
+	batch->budgetUs = budgetUs;
+	batch->maxOps = maxOps < 1 ? 1 : maxOps > BATCH_MAX_OPS ? BATCH_MAX_OPS : maxOps;
+	batch->gapNs = (uint64_t)budgetUs * 1000;//Start out as lightly loaded
+	osMutexInit(&batch->lock);
+	osCondInit(&batch->cond);
+}
+
+/**
+* Releases the state set up by batchInit(). No thread may use it.
+*/
+void batchDestroy(DspiBatch* batch){
+	osCondDestroy(&batch->cond);
+	osMutexDestroy(&batch->lock);
+}
+
+/**
+* Holds the open batch for the window, then runs it and hands the results
+* out. Called and returns with the batch lock held.
+*/
+static void batchLead(DspiBatch* batch){
+	BatchEntry* run[BATCH_MAX_OPS];
+	RegOp ops[BATCH_MAX_OPS];
+	uint64_t budgetNs = (uint64_t)batch->budgetUs * 1000;
+	uint64_t start, now, deadline;
+	uint64_t latest = 0;
+	uint64_t callerDeadline = devDeadline();
+	int fUnbounded = 0;	//a request without a deadline
+	int result;
+	int n, i, j;
+
+	batch->fLeader = 1;
+	start = osNowNs();
+	if(2 * batch->gapNs < budgetNs){
+		//Open until requests stop coming or the budget is used up
+		while(batch->count < batch->maxOps){
+			now = osNowNs();
+			deadline = batch->lastNs + 2 * batch->gapNs;
+			if(deadline > start + budgetNs){
+				deadline = start + budgetNs;
+			}
+			if(now >= deadline){
+				break;
+			}
+			osCondWaitUs(&batch->cond, &batch->lock, (uint32_t)((deadline - now + 999) / 1000));
+		}
+	}
+	batch->windowNs = osNowNs() - start;
+
+	//Requests that arrive from here on go into the next batch. Those past
+	//their deadline are dropped before they reach the device.
+	now = osNowNs();
+	for(i = 0, n = 0; i < batch->count; i++){
+		if(batch->queue[i]->deadlineNs != 0 && batch->queue[i]->deadlineNs <= now){
+			batch->queue[i]->result = LINK_ERR_TIMEOUT;
+			batch->queue[i]->fDone = 1;
+			batch->expired++;
+			continue;
+		}
+		if(batch->queue[i]->deadlineNs == 0){
+			fUnbounded = 1;
+		}else if(batch->queue[i]->deadlineNs > latest){
+			latest = batch->queue[i]->deadlineNs;
+		}
+		run[n++] = batch->queue[i];
+	}
+	batch->count = 0;
+	if(n == 0){
+		batch->fLeader = 0;
+		osCondBroadcast(&batch->cond);
+		return;
+	}
+	osCondBroadcast(&batch->cond);
+	osMutexUnlock(&batch->lock);
+
+	for(j = 0; j < n; j++){
+		ops[j] = run[j]->op;
+	}
+	devSetDeadline(fUnbounded ? 0 : latest);
+	result = devRegBatch(batch->dev, ops, n);
+	devSetDeadline(callerDeadline);
+
+	osMutexLock(&batch->lock);
+	for(j = 0; j < n; j++){
+		run[j]->op = ops[j];
+		run[j]->result = result > 0 ? result : ops[j].status != STATUS_OK ? -1 : 0;
+		run[j]->fDone = 1;
+	}
+	batch->batches++;
+	batch->ops += n;
+	batch->fLeader = 0;
+	osCondBroadcast(&batch->cond);
+}
+
+/**
+* Adds a request to the open batch and waits for its result, leading the
+* batch if no one else does.
+*/
+static int batchSubmit(DspiBatch* batch, BatchEntry* entry){
+	uint64_t now, gap;
+
+	entry->fDone = 0;
+	entry->deadlineNs = devDeadline();
+	osMutexLock(&batch->lock);
+	while(batch->count == batch->maxOps){
+		if(entry->deadlineNs == 0){
+			osCondWait(&batch->cond, &batch->lock);
+		}else if((now = osNowNs()) < entry->deadlineNs){
+			osCondWaitUs(&batch->cond, &batch->lock, (uint32_t)((entry->deadlineNs - now + 999) / 1000));
+		}else{
+			batch->expired++;
+			osMutexUnlock(&batch->lock);
+			return LINK_ERR_TIMEOUT;
+		}
+	}
+	now = osNowNs();
+	if(batch->lastNs != 0){
+		gap = now - batch->lastNs;
+		if(gap > (uint64_t)batch->budgetUs * 1000){
+			gap = (uint64_t)batch->budgetUs * 1000;//Idle time says nothing about bursts
+		}
+		batch->gapNs = batch->gapNs - batch->gapNs / 8 + gap / 8;
+	}
+	batch->lastNs = now;
+	batch->queue[batch->count++] = entry;
+	osCondBroadcast(&batch->cond);
+
+	while(!entry->fDone){
+		if(batch->fLeader){
+			osCondWait(&batch->cond, &batch->lock);
+		}else{
+			batchLead(batch);
+		}
+	}
+	osMutexUnlock(&batch->lock);
+	return entry->result;
+}
+
+/**
+* Reads a register as part of a batch.
+*
+* @param addr register address
+* @param value receives the value, 0 if the read was rejected
+*
+*/
+int batchRead(DspiBatch* batch, uint16_t addr, uint32_t* value){
+	BatchEntry entry;
+	int result;
+
+	entry.op.op = op_read;
+	entry.op.addr = addr;
+	entry.op.value = 0;
+	result = batchSubmit(batch, &entry);
+	*value = entry.op.status == STATUS_OK ? entry.op.value : 0;
+	return result;
+}
+
+/**
+* Writes a register as part of a batch. Unlike devWrite() the call returns
+* the write's own status.
+*
+* @param addr register address
+* @param value value to write
+*
+*/
+int batchWrite(DspiBatch* batch, uint16_t addr, uint32_t value){
+	BatchEntry entry;
+
+	entry.op.op = op_write;
+	entry.op.addr = addr;
+	entry.op.value = value;
+	return batchSubmit(batch, &entry);
+}
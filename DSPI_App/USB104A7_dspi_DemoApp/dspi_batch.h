@@ -0,0 +1,77 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_batch.h  --  Coalescing of register accesses from threads    */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Single register reads and writes from many threads each take the  */
+/*    device on their own. DspiBatch collects them instead and runs     */
+/*    them together with devRegBatch(): pipelined back to back under    */
+/*    one lock, consecutive writes as a bulk write, and reads of a      */
+/*    cacheable register once until it is written. Each caller blocks  */
+/*    until its own result is in.                                       */
+/*                                                                      */
+/*    The first caller to find no batch open leads the next one: it     */
+/*    holds the batch open while requests keep arriving, then runs it.  */
+/*    Requests that arrive while a batch runs wait for the next one.    */
+/*                                                                      */
+/*    The window follows the load. The mean time between requests is    */
+/*    tracked, counting idle stretches as budgetUs. A batch closes when */
+/*    no request arrived for twice that time, after budgetUs, or at     */
+/*    maxOps requests. If the mean is above half the budget the batch   */
+/*    runs at once, so a lightly loaded device adds no latency while a  */
+/*    busy one trades up to budgetUs for fewer transfers per request.   */
+/*                                                                      */
+/*    Requests carry the calling thread's devSetDeadline() deadline. A  */
+/*    request whose deadline passes before its batch runs is dropped    */
+/*    with LINK_ERR_TIMEOUT, and a batch runs under the latest deadline */
+/*    of its requests.                                                  */
+/*                                                                      */
+/*    Functions return 0 on success, -1 if the device rejected the      */
+/*    request or answered out of sequence, or a positive transport      */
+/*    error code.                                                       */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_BATCH_INCLUDED)
+#define      DSPI_BATCH_INCLUDED
+
+#include <stdint.h>
+
+#include "host_os.h"
+#include "dspi_dev.h"
+
+#define BATCH_MAX_OPS 64
+#define BATCH_BUDGET_US 200	//default latency budget
+
+typedef struct {
+	RegOp op;
+	uint64_t deadlineNs;	//0 if none
+	int result;
+	int fDone;
+} BatchEntry;
+
+typedef struct {
+	DspiDev* dev;
+	uint32_t budgetUs;	//longest a request is held for others
+	int maxOps;	//a batch closes at this many requests
+	OsMutex lock;
+	OsCond cond;
+	BatchEntry* queue[BATCH_MAX_OPS];	//the open batch
+	int count;
+	int fLeader;	//a caller is collecting or running a batch
+	uint64_t lastNs;	//arrival of the last request
+	uint64_t gapNs;	//mean time between requests
+	uint64_t windowNs;	//window of the last batch
+	uint64_t batches;
+	uint64_t ops;
+	uint64_t expired;	//requests dropped at their deadline
+} DspiBatch;
+
+void batchInit(DspiBatch* batch, DspiDev* dev, uint32_t budgetUs, int maxOps);
+void batchDestroy(DspiBatch* batch);
+int batchRead(DspiBatch* batch, uint16_t addr, uint32_t* value);
+int batchWrite(DspiBatch* batch, uint16_t addr, uint32_t value);
+
+#endif
@@ -0,0 +1,942 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_bench.c  --  Throughput and latency benchmark for DSPI       */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Measures the whole host to device path through dspi_dev:          */
+/*        write_latency   single register writes                       */
+/*        read_latency    single register reads                        */
+/*        rmw_host        bit update as a host read, modify and write   */
+/*        set_bits        bit update as one atomic device command       */
+/*        axi_burst       AXI bridge batches across batch sizes         */
+/*        read_depth      pipelined register reads across depths        */
+/*        contention      several threads sharing one device            */
+/*        batched         the same reads coalesced by dspi_batch        */
+/*        bulk_raw        register block writes across the share of     */
+/*                        repeated words in the data                    */
+/*        bulk_dzv        the same blocks packed with ENC_DZV           */
+/*        preempt         register writes while another thread streams  */
+/*                        bulk writes, with and without dspi_sched      */
+/*        sync_full       keeping a copy of 64 registers current by     */
+/*                        reading them all, across registers changed    */
+/*        sync_delta      the same with devDeltaRead()                  */
+/*        restore_replay  putting the fabric registers back with a      */
+/*                        write per register                            */
+/*        restore_snap    the same with snapRestore(), verified         */
+/*                                                                      */
+/*    Results are written as JSON so that runs from different commits   */
+/*    can be compared. Progress goes to stderr. With -rtl the times are */
+/*    simulated time of the RTL co-simulation, cycle accurate and the   */
+/*    same on every machine.                                            */
+/*                                                                      */
+/*    Usage: dspi_bench [-sim [options] | -rtl [options] | -d device]   */
+/*                      [-n iterations] [-o file] [-label text]         */
+/*                      [-only benchmark] [-deadline us]                */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dspi_dev.h"
+#include "dspi_sched.h"
+#include "dspi_batch.h"
+#include "dspi_snap.h"
+
+#define BENCH_REG 0x0200	//32-bit application state, LMB
+#define BENCH_TABLE 0x1000	//32-bit tables, DDR
+#define BENCH_AXI_ADDR 0x40000000	//Button GPIO data, readable on every build
+#define MAX_CLIENTS 8
+#define BENCH_BULK_WORDS 1024	//Registers per bulk write, in the DDR tables
+#define BENCH_PREEMPT_GAP_US 500	//Between the writes of the preempt benchmark
+#define BENCH_SYNC_REGS 64	//Registers kept current by the sync benchmarks
+#define BENCH_RESTORE_CALLS 20	//Restores timed, each is hundreds of registers
+
+typedef struct {
+	const char* name;
+	const char* param;	//Name of the swept parameter, NULL if none
+	int paramValue;
+	int calls;
+	int ops;	//Register or AXI operations across all calls
+	int errors;
+	uint64_t bytes;	//Bytes clocked over the link
+	uint64_t dataBytes;	//Register data moved, if it differs from bytes
+	uint64_t elapsedNs;
+	uint32_t* samplesNs;	//Latency of each call
+	const SchedStats* queue;	//Per class waits for the device, NULL if not scheduled
+	double batchOps;	//Mean requests per batch, 0 if not batched
+} BenchResult;
+
+typedef struct {
+	int index;
+	DspiBatch* batch;	//NULL to read through the device lock
+	int calls;
+	int errors;
+	uint32_t* samplesNs;
+} BenchClient;
+
+DspiDev dev;
+DspiSched sched;
+volatile int fStreaming;	//the preempt benchmark's bulk thread runs while set
+DspiSnap snap;	//of the restore benchmarks
+FILE* out;
+int iterations = 200;
+uint32_t deadlineUs = 0;	//deadline of every call, 0 for none
+int cResults = 0;
+const char* only = NULL;
+
+//Forward Declarations
+int benchWriteLatency();
+int benchReadLatency();
+int benchBitUpdate(int fAtomic);
+int benchAxiBurst(int count);
+int benchReadDepth(int depth);
+int benchContention(int clients, int fBatch);
+int benchBulkWrite(uint8_t encoding, int zeroPct);
+int benchPreempt(int fSched);
+int benchSync(int fDelta, int changed);
+int benchRestore(int fSnap);
+void* contentionClient(void* arg);
+void* preemptStreamer(void* arg);
+int beginResult(BenchResult* res, const char* name, const char* param, int paramValue);
+void endResult(BenchResult* res);
+int compareSamples(const void* a, const void* b);
+void writeString(const char* str);
+
+/**
+* Reads the clock the benchmarks are timed with: the device's simulated
+* time if the transport has one, else the host clock.
+*/
+static uint64_t benchNow(){
+	if(dev.transport->clockNs != NULL){
+		return dev.transport->clockNs(dev.link);
+	}
+	return osNowNs();
+}
+
+/**
+* Starts a timed call: sets the calling thread's deadline if -deadline was
+* given, then reads the benchmark clock.
+*/
+static uint64_t benchStart(){
+	if(deadlineUs != 0){
+		devSetDeadline(osNowNs() + (uint64_t)deadlineUs * 1000);
+	}
+	return benchNow();
+}
+
+/**
+* Tells whether a call failed for good. A missed deadline only fails the
+* call, the device stays usable.
+*/
+static int benchFatal(int status){
+	return status > 0 && status != LINK_ERR_TIMEOUT && status != LINK_ERR_CANCELED;
+}
+
+int main(int argc, char* argv[]){
+	const DspiTransport* transport;
+	const char* deviceName = NULL;
+	const char* outName = NULL;
+	const char* label = "";
+	static const int axiCounts[] = {1, 4, 16, BRIDGE_MAX_OPS};
+	static const int depths[] = {1, 2, 4, 8, 16, 32, 64};
+	static const int clients[] = {1, 2, 4, MAX_CLIENTS};
+	static const int zeroPcts[] = {0, 50, 90, 100};
+	static const int changes[] = {0, 1, 4, 16, BENCH_SYNC_REGS};
+	int status;
+	int i;
+
+#if defined(DSPI_WITH_ADEPT)
+	transport = &transportAdept;
+#else
+	transport = &transportSim;
+#endif
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-sim") == 0){
+			transport = &transportSim;
+			if(i + 1 < argc && argv[i+1][0] != '-'){
+				deviceName = argv[++i];
+			}
+		}
+#if defined(DSPI_WITH_RTL)
+		else if(strcmp(argv[i], "-rtl") == 0){
+			transport = &transportRtl;
+			if(i + 1 < argc && argv[i+1][0] != '-'){
+				deviceName = argv[++i];
+			}
+		}
+#endif
+		else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc){
+			deviceName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+			iterations = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+			outName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-label") == 0 && i + 1 < argc){
+			label = argv[++i];
+		}
+		else if(strcmp(argv[i], "-only") == 0 && i + 1 < argc){
+			only = argv[++i];
+		}
+		else if(strcmp(argv[i], "-deadline") == 0 && i + 1 < argc){
+			deadlineUs = (uint32_t)strtoul(argv[++i], NULL, 0);
+		}
+		else{
+			fprintf(stderr, "Usage: %s [-sim [sck=Hz,usb=us,btn=value,hang=n,hangms=ms,fabric=1,legacy=1,noop=op] | -rtl [sck=Hz,usb=us,fw=ns,strict=1] | -d device] [-n iterations] [-o file] [-label text] [-only benchmark] [-deadline us]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(iterations <= 0){
+		fprintf(stderr, "Iterations must be positive.\n");
+		return 1;
+	}
+
+	if((status = devOpen(&dev, transport, deviceName)) != 0){
+		fprintf(stderr, "Error %d opening the %s device.\n", status, transport->name);
+		return 1;
+	}
+	if(outName == NULL){
+		out = stdout;
+	}else if((out = fopen(outName, "w")) == NULL){
+		fprintf(stderr, "Cannot open %s.\n", outName);
+		devClose(&dev);
+		return 1;
+	}
+	schedInit(&sched, &dev);
+
+	fprintf(out, "{\n\t\"label\": ");
+	writeString(label);
+	fprintf(out, ",\n\t\"transport\": \"%s\",\n\t\"device\": ", transport->name);
+	writeString(deviceName != NULL ? deviceName : "");
+	fprintf(out, ",\n");
+	fprintf(out, "\t\"clock\": \"%s\",\n", transport->clockNs != NULL ? "simulated" : "host");
+	fprintf(out, "\t\"protocol\": %u,\n\t\"firmware\": %u,\n", dev.caps.protocol, dev.caps.firmware);
+	fprintf(out, "\t\"iterations\": %d,\n\t\"results\": [", iterations);
+
+	status = benchWriteLatency();
+	if(status == 0){
+		status = benchReadLatency();
+	}
+	if(status == 0){
+		status = benchBitUpdate(0);
+	}
+	if(status == 0){
+		status = benchBitUpdate(1);
+	}
+	for(i = 0; status == 0 && i < (int)(sizeof(axiCounts)/sizeof(axiCounts[0])); i++){
+		status = benchAxiBurst(axiCounts[i]);
+	}
+	for(i = 0; status == 0 && i < (int)(sizeof(depths)/sizeof(depths[0])); i++){
+		status = benchReadDepth(depths[i]);
+	}
+	for(i = 0; status == 0 && i < (int)(sizeof(clients)/sizeof(clients[0])); i++){
+		status = benchContention(clients[i], 0);
+	}
+	for(i = 0; status == 0 && i < (int)(sizeof(clients)/sizeof(clients[0])); i++){
+		status = benchContention(clients[i], 1);
+	}
+	for(i = 0; status == 0 && i < (int)(sizeof(zeroPcts)/sizeof(zeroPcts[0])); i++){
+		if((status = benchBulkWrite(ENC_RAW, zeroPcts[i])) == 0){
+			status = benchBulkWrite(ENC_DZV, zeroPcts[i]);
+		}
+	}
+	if(status == 0){
+		status = benchPreempt(0);
+	}
+	if(status == 0){
+		status = benchPreempt(1);
+	}
+	for(i = 0; status == 0 && i < (int)(sizeof(changes)/sizeof(changes[0])); i++){
+		if((status = benchSync(0, changes[i])) == 0){
+			status = benchSync(1, changes[i]);
+		}
+	}
+	if(status == 0){
+		status = benchRestore(0);
+	}
+	if(status == 0){
+		status = benchRestore(1);
+	}
+
+	fprintf(out, "\n\t]\n}\n");
+	if(out != stdout){
+		fclose(out);
+	}
+	schedDestroy(&sched);
+	devClose(&dev);
+	if(status != 0){
+		fprintf(stderr, "Benchmark aborted, transport error %d.\n", status);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Times single register writes. A write costs one frame.
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchWriteLatency(){
+	BenchResult res;
+	uint64_t t;
+	int status;
+	int i;
+
+	if(!beginResult(&res, "write_latency", NULL, 0)){
+		return 0;
+	}
+	for(i = 0; i < iterations; i++){
+		t = benchStart();
+		status = devWrite(&dev, BENCH_REG + (i % 16), i);
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0;
+	}
+	res.calls = iterations;
+	res.ops = iterations;
+	res.bytes = (uint64_t)iterations * FRAME_SIZE;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Times single register reads. A read costs a frame and the flush that
+* collects its response.
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchReadLatency(){
+	BenchResult res;
+	uint16_t addr = BENCH_REG;
+	uint32_t val;
+	uint64_t t;
+	int status;
+	int i;
+
+	if(!beginResult(&res, "read_latency", NULL, 0)){
+		return 0;
+	}
+	for(i = 0; i < iterations; i++){
+		t = benchStart();
+		status = devRead(&dev, &addr, &val, 1);
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0;
+	}
+	res.calls = iterations;
+	res.ops = iterations;
+	res.bytes = (uint64_t)iterations * 2 * FRAME_SIZE;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Times setting a bit of a register, either read-modify-write from the host
+* (a read and its flush, then a write) or with a single set-bits frame.
+*
+* @param fAtomic 1 for the device command, 0 for the host sequence
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchBitUpdate(int fAtomic){
+	BenchResult res;
+	uint16_t addr = BENCH_REG;
+	uint32_t val;
+	uint64_t t;
+	int status;
+	int i;
+
+	if(!beginResult(&res, fAtomic ? "set_bits" : "rmw_host", NULL, 0)){
+		return 0;
+	}
+	for(i = 0; i < iterations; i++){
+		t = benchStart();
+		if(fAtomic){
+			status = devSetBits(&dev, addr, 1u << (i % 32));
+		}
+		else if((status = devRead(&dev, &addr, &val, 1)) == 0){
+			status = devWrite(&dev, addr, val | (1u << (i % 32)));
+		}
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0;
+	}
+	res.calls = iterations;
+	res.ops = iterations;
+	res.bytes = (uint64_t)iterations * (fAtomic ? 1 : 3) * FRAME_SIZE;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Times AXI bridge batches of count reads.
+*
+* @param count requests per batch
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchAxiBurst(int count){
+	BenchResult res;
+	AxiOp ops[BRIDGE_MAX_OPS];
+	uint64_t t;
+	int status;
+	int i, j;
+
+	if(!beginResult(&res, "axi_burst", "batch", count)){
+		return 0;
+	}
+	for(i = 0; i < iterations; i++){
+		for(j = 0; j < count; j++){
+			ops[j].kind = BRIDGE_READ;
+			ops[j].addr = BENCH_AXI_ADDR;
+			ops[j].value = 0;
+		}
+		t = benchStart();
+		status = devAxiBatch(&dev, ops, count);
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0;
+	}
+	res.calls = iterations;
+	res.ops = iterations * count;
+	res.bytes = (uint64_t)iterations * (FRAME_SIZE + count * (BRIDGE_REQ_SIZE + BRIDGE_RSP_SIZE));
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Times pipelined reads of depth registers in one call. The device answers
+* each frame with the next, so depth reads cost depth+1 frames.
+*
+* @param depth registers per call
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchReadDepth(int depth){
+	BenchResult res;
+	uint16_t addrs[64];
+	uint32_t vals[64];
+	uint64_t t;
+	int status;
+	int i;
+
+	if(!beginResult(&res, "read_depth", "depth", depth)){
+		return 0;
+	}
+	for(i = 0; i < depth; i++){
+		addrs[i] = BENCH_TABLE + i;
+	}
+	for(i = 0; i < iterations; i++){
+		t = benchStart();
+		status = devRead(&dev, addrs, vals, depth);
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0;
+	}
+	res.calls = iterations;
+	res.ops = iterations * depth;
+	res.bytes = (uint64_t)iterations * (depth + 1) * FRAME_SIZE;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Reads from several threads sharing the device. Each client does
+* iterations single register reads, the latency includes waiting for the
+* device lock, or for the batch when the reads are coalesced.
+*
+* @param clients number of threads
+* @param fBatch 1 to read through dspi_batch, 0 for the device lock
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchContention(int clients, int fBatch){
+	BenchResult res;
+	BenchClient client[MAX_CLIENTS];
+	OsThread thread[MAX_CLIENTS];
+	DspiBatch batch;
+	int i;
+
+	if(!beginResult(&res, fBatch ? "batched" : "contention", "clients", clients)){
+		return 0;
+	}
+	batchInit(&batch, &dev, BATCH_BUDGET_US, BATCH_MAX_OPS);
+	free(res.samplesNs);
+	if((res.samplesNs = malloc((size_t)clients * iterations * sizeof(uint32_t))) == NULL){
+		return 0;
+	}
+	res.elapsedNs = benchNow();
+	for(i = 0; i < clients; i++){
+		client[i].index = i;
+		client[i].batch = fBatch ? &batch : NULL;
+		client[i].calls = 0;
+		client[i].errors = 0;
+		client[i].samplesNs = res.samplesNs + i * iterations;
+		if(osThreadStart(&thread[i], contentionClient, &client[i]) != 0){
+			fprintf(stderr, "Cannot start client thread %d.\n", i);
+			clients = i;
+			break;
+		}
+	}
+	for(i = 0; i < clients; i++){
+		osThreadJoin(thread[i]);
+		res.calls += client[i].calls;
+		res.errors += client[i].errors;
+	}
+	res.elapsedNs = benchNow() - res.elapsedNs;
+	res.ops = res.calls;
+	res.bytes = (uint64_t)res.calls * 2 * FRAME_SIZE;
+	if(fBatch){
+		//A batch of n reads costs n+1 frames
+		res.bytes = (batch.ops + batch.batches) * FRAME_SIZE;
+		res.batchOps = batch.batches != 0 ? (double)batch.ops / batch.batches : 0;
+	}
+	batchDestroy(&batch);
+	endResult(&res);
+	return 0;
+}
+
+void* contentionClient(void* arg){
+	BenchClient* client = arg;
+	uint16_t addr = BENCH_REG + client->index;
+	uint32_t val;
+	uint64_t t;
+	int status;
+	int i;
+
+	for(i = 0; i < iterations; i++){
+		t = benchStart();
+		if(client->batch != NULL){
+			status = batchRead(client->batch, addr, &val);
+		}else{
+			status = devRead(&dev, &addr, &val, 1);
+		}
+		client->samplesNs[i] = (uint32_t)(benchNow() - t);
+		client->calls++;
+		if(benchFatal(status)){
+			client->errors++;
+			break;//Transport failure, the other clients will see it too
+		}
+		client->errors += status != 0;
+	}
+	return 0;
+}
+
+/**
+* Times writes of BENCH_BULK_WORDS registers in one call. The data changes
+* at random from word to word, except for zeroPct percent of the words that
+* repeat the one before, the case delta coding packs best.
+*
+* @param encoding ENC_RAW or ENC_DZV
+* @param zeroPct share of repeated words, 0 to 100
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchBulkWrite(uint8_t encoding, int zeroPct){
+	BenchResult res;
+	uint32_t values[BENCH_BULK_WORDS];
+	uint8_t payload[PAYLOAD_SIZE];
+	uint32_t seed = 2463534242u;	//xorshift32, the same data on every run
+	uint32_t n, cb;
+	uint64_t bytes = 0;
+	uint8_t enc;
+	uint64_t t;
+	int status;
+	int i;
+
+	if(!beginResult(&res, encoding == ENC_DZV ? "bulk_dzv" : "bulk_raw", "zero_pct", zeroPct)){
+		return 0;
+	}
+	for(i = 0; i < BENCH_BULK_WORDS; i++){
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		values[i] = i > 0 && (int)(seed % 100) < zeroPct ? values[i - 1] : seed;
+	}
+	//Link bytes of one call, packed the way devBulkWrite() packs them
+	for(i = 0; i < BENCH_BULK_WORDS; i += n){
+		n = devBulkPack(values + i, BENCH_BULK_WORDS - i, encoding, dev.caps.payloadSize, payload, &enc, &cb);
+		bytes += 2 * FRAME_SIZE + cb;
+	}
+	for(i = 0; i < iterations; i++){
+		t = benchStart();
+		status = devBulkWrite(&dev, BENCH_TABLE, values, BENCH_BULK_WORDS, encoding, NULL);
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0;
+	}
+	res.calls = iterations;
+	res.ops = iterations * BENCH_BULK_WORDS;
+	res.bytes = (uint64_t)iterations * (bytes + FRAME_SIZE);
+	res.dataBytes = (uint64_t)iterations * BENCH_BULK_WORDS * 4;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Times bringing a host copy of BENCH_SYNC_REGS registers up to date after
+* changed of them were written, by reading them all or with
+* devDeltaRead(). The writes are not timed. A copy that does not match what
+* was written counts as an error.
+*
+* @param fDelta 1 for devDeltaRead(), 0 for pipelined reads
+* @param changed registers written before each sync
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchSync(int fDelta, int changed){
+	BenchResult res;
+	uint16_t addrs[BENCH_SYNC_REGS];
+	uint32_t expect[BENCH_SYNC_REGS];
+	uint32_t copy[BENCH_SYNC_REGS];
+	uint32_t gen = 0;
+	uint32_t cChanged;
+	uint64_t t;
+	int status;
+	int i, k;
+
+	if(!beginResult(&res, fDelta ? "sync_delta" : "sync_full", "changed", changed)){
+		return 0;
+	}
+	for(k = 0; k < BENCH_SYNC_REGS; k++){
+		addrs[k] = (uint16_t)(BENCH_REG + k);
+	}
+	//Start from a copy that is current
+	if((status = devRead(&dev, addrs, expect, BENCH_SYNC_REGS)) == 0){
+		memcpy(copy, expect, sizeof(copy));
+		status = fDelta ? devDeltaRead(&dev, BENCH_REG, BENCH_SYNC_REGS, &gen, copy, NULL, NULL) : 0;
+	}
+	if(benchFatal(status)){
+		free(res.samplesNs);
+		return status;
+	}
+	for(i = 0; i < iterations; i++){
+		for(k = 0; k < changed; k++){
+			expect[(i * 7 + k) % BENCH_SYNC_REGS] = 0x5A000000u + (uint32_t)(i * BENCH_SYNC_REGS + k);
+			if(benchFatal(status = devWrite(&dev, addrs[(i * 7 + k) % BENCH_SYNC_REGS], expect[(i * 7 + k) % BENCH_SYNC_REGS]))){
+				free(res.samplesNs);
+				return status;
+			}
+		}
+		t = benchStart();
+		if(fDelta){
+			status = devDeltaRead(&dev, BENCH_REG, BENCH_SYNC_REGS, &gen, copy, &cChanged, NULL);
+		}else{
+			status = devRead(&dev, addrs, copy, BENCH_SYNC_REGS);
+			cChanged = BENCH_SYNC_REGS;
+		}
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0 || memcmp(copy, expect, sizeof(copy)) != 0;
+		res.ops += (int)cChanged;
+		if(fDelta && gen != 0){
+			//Operand, scan, flush, read and flush frames around the delta
+			res.bytes += 5 * FRAME_SIZE + 4 + (BENCH_SYNC_REGS + 7) / 8 + 4 * cChanged;
+		}else{
+			res.bytes += (BENCH_SYNC_REGS + 1) * FRAME_SIZE;
+		}
+	}
+	res.calls = iterations;
+	res.dataBytes = (uint64_t)iterations * BENCH_SYNC_REGS * 4;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Times putting the fabric regions back after a reset, from a snapshot of
+* them. The replay writes every register snapRestore() would with a frame
+* of its own, the way a tool replaying its writes does. Before each call a
+* few registers are cleared, untimed. Payload sizes depend on the packing,
+* so only the time is compared.
+*
+* @param fSnap 1 for snapRestore(), 0 for a write per register
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchRestore(int fSnap){
+	BenchResult res;
+	uint32_t written = 0;
+	uint32_t off, k;
+	uint64_t t;
+	int status = 0;
+	int i, r;
+
+	if(!beginResult(&res, fSnap ? "restore_snap" : "restore_replay", NULL, 0)){
+		return 0;
+	}
+	for(k = 0; k < 16 && status <= 0; k++){
+		status = devWrite(&dev, (uint16_t)(BENCH_REG + k), 0xC0DE0000u + k);
+	}
+	if(status <= 0){
+		status = snapTake(&dev, &snap, 0, NULL);
+	}
+	if(benchFatal(status)){
+		free(res.samplesNs);
+		return status;
+	}
+	for(i = 0; i < iterations && i < BENCH_RESTORE_CALLS; i++){
+		for(k = 0; k < 16; k++){
+			if(benchFatal(status = devWrite(&dev, (uint16_t)(BENCH_REG + k), 0))){
+				free(res.samplesNs);
+				return status;
+			}
+		}
+		t = benchStart();
+		if(fSnap){
+			status = snapRestore(&dev, &snap, &written, NULL, NULL, NULL);
+		}else{
+			written = 0;
+			for(r = 0, off = 0, status = 0; r < REGMAP_N_REGIONS; off += regRegions[r++].count){
+				for(k = 0; snap.fRegion[r] && k < regRegions[r].count && status <= 0; k++){
+					if(snapWritable((uint16_t)(regRegions[r].base + k))){
+						status = devWrite(&dev, (uint16_t)(regRegions[r].base + k), snap.vals[off + k]);
+						written++;
+					}
+				}
+			}
+		}
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			free(res.samplesNs);
+			return status;
+		}
+		res.errors += status != 0;
+		res.ops += (int)written;
+		res.calls++;
+	}
+	res.dataBytes = (uint64_t)res.ops * 4;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Times single register writes while another thread streams bulk writes of
+* BENCH_BULK_WORDS registers. Without the scheduler a write waits for the
+* device lock, up to a whole block. With it the writes are SCHED_CONTROL
+* and the blocks SCHED_BULK, so a write waits for at most a segment. The
+* result reports the waits of both classes.
+*
+* @param fSched 1 to go through dspi_sched, 0 for the device lock
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int benchPreempt(int fSched){
+	BenchResult res;
+	SchedStats queue[SCHED_N_CLASSES];
+	OsThread thread;
+	uint64_t t;
+	int status = 0;
+	int i;
+
+	if(!beginResult(&res, "preempt", "sched", fSched)){
+		return 0;
+	}
+	schedDestroy(&sched);
+	schedInit(&sched, &dev);
+	fStreaming = 1;
+	if(osThreadStart(&thread, preemptStreamer, fSched ? &sched : NULL) != 0){
+		fprintf(stderr, "Cannot start the bulk thread.\n");
+		free(res.samplesNs);
+		return 0;
+	}
+	for(i = 0; i < iterations; i++){
+		osSleepUs(BENCH_PREEMPT_GAP_US);
+		t = benchStart();
+		if(fSched){
+			status = schedWrite(&sched, SCHED_CONTROL, BENCH_REG + (i % 16), i);
+		}else{
+			status = devWrite(&dev, BENCH_REG + (i % 16), i);
+		}
+		res.samplesNs[i] = (uint32_t)(benchNow() - t);
+		if(benchFatal(status)){
+			break;
+		}
+		res.errors += status != 0;
+	}
+	fStreaming = 0;
+	osThreadJoin(thread);
+	if(benchFatal(status)){
+		free(res.samplesNs);
+		return status;
+	}
+	if(fSched){
+		schedStats(&sched, queue);
+		res.queue = queue;
+	}
+	res.calls = iterations;
+	res.ops = iterations;
+	res.bytes = (uint64_t)iterations * FRAME_SIZE;
+	endResult(&res);
+	return 0;
+}
+
+/**
+* Bulk thread of benchPreempt(): writes blocks of the DDR tables until
+* fStreaming is cleared.
+*
+* @param arg the scheduler, or NULL to use the device lock
+*
+*/
+void* preemptStreamer(void* arg){
+	DspiSched* s = arg;
+	static uint32_t values[BENCH_BULK_WORDS];
+	int i;
+
+	for(i = 0; i < BENCH_BULK_WORDS; i++){
+		values[i] = i;
+	}
+	while(fStreaming){
+		if(s != NULL){
+			schedBulkWrite(s, SCHED_BULK, BENCH_TABLE, values, BENCH_BULK_WORDS, ENC_RAW, NULL);
+		}else{
+			devBulkWrite(&dev, BENCH_TABLE, values, BENCH_BULK_WORDS, ENC_RAW, NULL);
+		}
+	}
+	return 0;
+}
+
+/**
+* Starts a result unless -only excludes the benchmark.
+*
+* @return 1 if the benchmark should run, 0 if not
+*
+*/
+int beginResult(BenchResult* res, const char* name, const char* param, int paramValue){
+	if(only != NULL && strcmp(only, name) != 0){
+		return 0;
+	}
+	memset(res, 0, sizeof(BenchResult));
+	res->name = name;
+	res->param = param;
+	res->paramValue = paramValue;
+	if((res->samplesNs = malloc((size_t)iterations * sizeof(uint32_t))) == NULL){
+		fprintf(stderr, "Out of memory.\n");
+		return 0;
+	}
+	if(param != NULL){
+		fprintf(stderr, "%s %s=%d\n", name, param, paramValue);
+	}else{
+		fprintf(stderr, "%s\n", name);
+	}
+	return 1;
+}
+
+/**
+* Summarizes the samples of a result and writes it out. For benchmarks that
+* do not time the whole run themselves, the elapsed time is the sum of the
+* samples.
+*/
+void endResult(BenchResult* res){
+	uint64_t sum = 0;
+	double seconds;
+	int i;
+
+	for(i = 0; i < res->calls; i++){
+		sum += res->samplesNs[i];
+	}
+	if(res->elapsedNs == 0){
+		res->elapsedNs = sum;
+	}
+	seconds = res->elapsedNs > 0 ? res->elapsedNs / 1e9 : 1e-9;
+	qsort(res->samplesNs, res->calls, sizeof(uint32_t), compareSamples);
+
+	fprintf(out, "%s\n\t\t{\"name\": \"%s\"", cResults++ == 0 ? "" : ",", res->name);
+	if(res->param != NULL){
+		fprintf(out, ", \"%s\": %d", res->param, res->paramValue);
+	}
+	fprintf(out, ", \"calls\": %d, \"ops\": %d, \"errors\": %d, \"bytes\": %llu, \"elapsed_us\": %.1f,",
+		res->calls, res->ops, res->errors, (unsigned long long)res->bytes, res->elapsedNs / 1e3);
+	fprintf(out, " \"ops_per_s\": %.1f, \"bytes_per_s\": %.1f,", res->ops / seconds, res->bytes / seconds);
+	if(res->dataBytes != 0 && res->bytes != 0){
+		fprintf(out, " \"data_bytes_per_s\": %.1f, \"ratio\": %.3f,", res->dataBytes / seconds, (double)res->dataBytes / res->bytes);
+	}
+	if(res->batchOps != 0){
+		fprintf(out, " \"batch_ops\": %.2f,", res->batchOps);
+	}
+	if(res->queue != NULL){
+		fprintf(out, " \"queue_us\": {");
+		for(i = 0; i < SCHED_N_CLASSES; i++){
+			fprintf(out, "%s\"%s\": {\"grants\": %llu, \"yields\": %llu, \"expired\": %llu, \"mean\": %.1f, \"max\": %.1f}",
+				i == 0 ? "" : ", ", schedClassName((SchedClass)i),
+				(unsigned long long)res->queue[i].grants, (unsigned long long)res->queue[i].yields,
+				(unsigned long long)res->queue[i].expired,
+				res->queue[i].grants != 0 ? (double)res->queue[i].waitNs / res->queue[i].grants / 1e3 : 0.0,
+				res->queue[i].maxWaitNs / 1e3);
+		}
+		fprintf(out, "},");
+	}
+	if(res->calls > 0){
+		fprintf(out, " \"latency_us\": {\"min\": %.1f, \"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}}",
+			res->samplesNs[0] / 1e3,
+			(double)sum / res->calls / 1e3,
+			res->samplesNs[res->calls / 2] / 1e3,
+			res->samplesNs[(int)((res->calls - 1) * 0.99)] / 1e3,
+			res->samplesNs[res->calls - 1] / 1e3);
+	}else{
+		fprintf(out, " \"latency_us\": null}");
+	}
+	fflush(out);
+	free(res->samplesNs);
+}
+
+int compareSamples(const void* a, const void* b){
+	uint32_t x = *(const uint32_t*)a;
+	uint32_t y = *(const uint32_t*)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+* Writes str as a JSON string.
+*/
+void writeString(const char* str){
+	fputc('"', out);
+	for(; *str != '\0'; str++){
+		if(*str == '"' || *str == '\\'){
+			fprintf(out, "\\%c", *str);
+		}else if((unsigned char)*str < 0x20){
+			fprintf(out, "\\u%04x", *str);
+		}else{
+			fputc(*str, out);
+		}
+	}
+	fputc('"', out);
+}
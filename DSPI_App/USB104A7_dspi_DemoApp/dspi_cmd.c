@@ -0,0 +1,231 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_cmd.c  --  Console command tokenizer and operand parsers     */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "dspi_cmd.h"
+#include "dspi_dev.h"
+
+#define CMD_NAME_LEN 32
+
+/**
+* Splits a line into blank separated tokens. The blanks after tokens are
+* overwritten with NUL, the tokens point into the line.
+*
+* @param line line to split, modified
+* @param cl receives the tokens, its cursor is reset
+*
+* @return number of tokens, -1 if there are more than CMD_MAX_TOKENS
+*
+*/
+int cmdSplit(char* line, CmdLine* cl){
+	char* p = line;
+
+	cl->count = 0;
+	cl->next = 0;
+	while(*p != '\0'){
+		if(isspace((unsigned char)*p)){
+			*p++ = '\0';
+			continue;
+		}
+		if(cl->count == CMD_MAX_TOKENS){
+			return -1;
+		}
+		cl->tok[cl->count++] = p;
+		while(*p != '\0' && !isspace((unsigned char)*p)){
+			p++;
+		}
+	}
+	return cl->count;
+}
+
+/**
+* @return the next token, NULL after the last one
+*/
+const char* cmdNext(CmdLine* cl){
+	return cl->next < cl->count ? cl->tok[cl->next++] : NULL;
+}
+
+/**
+* Compares a token with a lower case word, ignoring the case of the token.
+*
+* @return 1 if they match, 0 if not or tok is NULL
+*
+*/
+int cmdIs(const char* tok, const char* word){
+	if(tok == NULL){
+		return 0;
+	}
+	for(; *tok != '\0' && tolower((unsigned char)*tok) == *word; tok++, word++);
+	return *tok == '\0' && *word == '\0';
+}
+
+/**
+* Parses a decimal, 0x hex or 0 octal number that fits 32 bits.
+*
+* @return 0 if passed, CMD_ERR_SYNTAX if failed or tok is NULL
+*
+*/
+int cmdValue(const char* tok, uint32_t* val){
+	unsigned long long v;
+	char* end;
+
+	if(tok == NULL || *tok == '\0' || *tok == '-' || *tok == '+'){
+		return CMD_ERR_SYNTAX;
+	}
+	v = strtoull(tok, &end, 0);
+	if(*end != '\0' || v > 0xFFFFFFFFull){
+		return CMD_ERR_SYNTAX;
+	}
+	*val = (uint32_t)v;
+	return 0;
+}
+
+/**
+* Parses a register number or a name from regmap.def, mapped or not.
+*/
+static int cmdAddress(const char* tok, uint32_t* val){
+	const RegNamed* named;
+
+	if((named = regFind(tok)) != NULL){
+		*val = named->addr;
+		return 0;
+	}
+	return cmdValue(tok, val);
+}
+
+/**
+* Parses a single mapped register.
+*
+* @param tok token, may be NULL
+* @param addr receives the register address
+* @param bad receives the value of an unmapped register
+*
+* @return 0 if passed, CMD_ERR_SYNTAX or CMD_ERR_UNMAPPED
+*
+*/
+int cmdRegister(const char* tok, uint16_t* addr, uint32_t* bad){
+	uint32_t val;
+
+	if(tok == NULL || cmdAddress(tok, &val) != 0){
+		return CMD_ERR_SYNTAX;
+	}
+	if(val > 0xFFFF || regWidth((uint16_t)val) == 0){
+		*bad = val;
+		return CMD_ERR_UNMAPPED;
+	}
+	*addr = (uint16_t)val;
+	return 0;
+}
+
+/**
+* Parses a register list, see dspi_cmd.h.
+*
+* @param tok token, may be NULL
+* @param addrs receives the registers in list order
+* @param max size of addrs
+* @param count receives the number of registers
+* @param bad receives the first unmapped register
+*
+* @return 0 if passed, CMD_ERR_SYNTAX, CMD_ERR_UNMAPPED or CMD_ERR_TOO_MANY
+*
+*/
+int cmdRegisters(const char* tok, uint16_t* addrs, int max, int* count, uint32_t* bad){
+	char part[2][CMD_NAME_LEN];
+	const char* end;
+	const char* dots;
+	uint32_t lo, hi, a;
+	size_t cb;
+	int i;
+
+	*count = 0;
+	if(tok == NULL || *tok == '\0'){
+		return CMD_ERR_SYNTAX;
+	}
+	for(;;){
+		if((end = strchr(tok, ',')) == NULL){
+			end = tok + strlen(tok);
+		}
+		//Split the element at "..", a single register is a range of one
+		for(dots = tok; dots + 1 < end && !(dots[0] == '.' && dots[1] == '.'); dots++);
+		if(dots + 1 >= end){
+			dots = end;
+		}
+		for(i = 0; i < 2; i++){
+			cb = i == 0 ? (size_t)(dots - tok) : (size_t)(end - dots - 2);
+			if(cb == 0 || cb >= CMD_NAME_LEN){
+				return CMD_ERR_SYNTAX;
+			}
+			memcpy(part[i], i == 0 ? tok : dots + 2, cb);
+			part[i][cb] = '\0';
+			if(dots == end){
+				strcpy(part[1], part[0]);
+				break;
+			}
+		}
+		if(cmdAddress(part[0], &lo) != 0 || cmdAddress(part[1], &hi) != 0 || lo > hi){
+			return CMD_ERR_SYNTAX;
+		}
+		for(a = lo; a <= hi; a++){
+			if(a > 0xFFFF || regWidth((uint16_t)a) == 0){
+				*bad = a;
+				return CMD_ERR_UNMAPPED;
+			}
+			if(*count == max){
+				return CMD_ERR_TOO_MANY;
+			}
+			addrs[(*count)++] = (uint16_t)a;
+		}
+		if(*end == '\0'){
+			return 0;
+		}
+		tok = end + 1;
+	}
+}
+
+/**
+* Finds the first register a value does not fit, so a write to a list is
+* refused before any of it is sent.
+*
+* @return index of that register, -1 if the value fits them all
+*
+*/
+int cmdTooWide(const uint16_t* addrs, int count, uint32_t value){
+	int i;
+
+	for(i = 0; i < count; i++){
+		if(regWidth(addrs[i]) < 4 && value >> (8 * regWidth(addrs[i])) != 0){
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+* Tells whether registers are consecutive and in one region, so a single
+* bulk write covers them.
+*/
+int cmdIsBlock(const uint16_t* addrs, int count){
+	int i;
+
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		if(addrs[0] >= regRegions[i].base && addrs[0] - regRegions[i].base < regRegions[i].count){
+			break;
+		}
+	}
+	if(i == REGMAP_N_REGIONS || addrs[0] - regRegions[i].base + count > regRegions[i].count){
+		return 0;
+	}
+	for(i = 1; i < count; i++){
+		if(addrs[i] != addrs[0] + i){
+			return 0;
+		}
+	}
+	return 1;
+}
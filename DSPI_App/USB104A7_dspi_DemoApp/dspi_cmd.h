@@ -0,0 +1,47 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_cmd.h  --  Console command tokenizer and operand parsers     */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    cmdSplit() cuts a caller's line into tokens in place, in one      */
+/*    pass and without allocating; the parsers only read tokens, so     */
+/*    several lines can be parsed at once from different threads.      */
+/*                                                                      */
+/*    Register operands are numbers or names from regmap.def. A         */
+/*    register list is a comma separated list of registers and          */
+/*    inclusive ranges, e.g. "led", "2..63" or "4,5,0x200..0x20F".      */
+/*    Every register of a list is checked against the register map, so  */
+/*    unmapped addresses never reach the device.                        */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_CMD_INCLUDED)
+#define      DSPI_CMD_INCLUDED
+
+#include <stdint.h>
+
+#define CMD_MAX_TOKENS 64
+#define CMD_MAX_REGS 0x4000	//registers in one list, the largest region
+
+#define CMD_ERR_SYNTAX -1	//not a number, name or range
+#define CMD_ERR_UNMAPPED -2	//a register is not in the register map
+#define CMD_ERR_TOO_MANY -3	//list longer than the caller's array
+
+typedef struct {
+	int count;
+	int next;	//cursor of cmdNext()
+	char* tok[CMD_MAX_TOKENS];
+} CmdLine;
+
+int cmdSplit(char* line, CmdLine* cl);
+const char* cmdNext(CmdLine* cl);
+int cmdIs(const char* tok, const char* word);
+int cmdValue(const char* tok, uint32_t* val);
+int cmdRegister(const char* tok, uint16_t* addr, uint32_t* bad);
+int cmdRegisters(const char* tok, uint16_t* addrs, int max, int* count, uint32_t* bad);
+int cmdIsBlock(const uint16_t* addrs, int count);
+int cmdTooWide(const uint16_t* addrs, int count, uint32_t value);
+
+#endif
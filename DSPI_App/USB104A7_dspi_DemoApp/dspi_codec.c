@@ -0,0 +1,142 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_codec.c  --  Payload encodings of the DSPI link              */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdint.h>
+
+#include "dspi_codec.h"
+
+static uint32_t varintSize(uint32_t v){
+	uint32_t n = 1;
+
+	while(v >= 0x80){
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+static uint8_t* putVarint(uint8_t* p, uint32_t v){
+	while(v >= 0x80){
+		*p++ = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+/**
+* Reads an LEB128 varint of at most 5 bytes.
+*
+* @return 0 if the varint runs past end or is too long
+*
+*/
+static int getVarint(const uint8_t** p, const uint8_t* end, uint32_t* v){
+	const uint8_t* q = *p;
+	uint32_t shift;
+	uint8_t b;
+
+	*v = 0;
+	for(shift = 0; shift < 35; shift += 7){
+		if(q == end){
+			return 0;
+		}
+		b = *q++;
+		*v |= (uint32_t)(b & 0x7F) << shift;
+		if(!(b & 0x80)){
+			*p = q;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+* Packs words with ENC_DZV until the output is full.
+*
+* @param words words to pack
+* @param count number of words
+* @param stride distance of the word each word is diffed against
+* @param out receives the encoded bytes
+* @param cbMax size of out, DZV_MAX_SIZE(count) always holds all words
+* @param cb receives the number of bytes written
+*
+* @return number of words packed, decoding cb bytes yields exactly these
+*
+*/
+uint32_t dzvEncode(const uint32_t* words, uint32_t count, uint32_t stride, uint8_t* out, uint32_t cbMax, uint32_t* cb){
+	uint8_t* p = out;
+	uint8_t* end = out + cbMax;
+	uint32_t i, d, z;
+	uint32_t run = 0;
+
+	for(i = 0; i < count; i++){
+		d = words[i] - (i < stride ? 0 : words[i - stride]);
+		z = (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+		if(z == 0){
+			run++;
+			continue;
+		}
+		if((uint32_t)(end - p) < (run != 0 ? 1 + varintSize(run) : 0) + varintSize(z)){
+			break;
+		}
+		if(run != 0){
+			*p++ = 0;
+			p = putVarint(p, run);
+			run = 0;
+		}
+		p = putVarint(p, z);
+	}
+	if(run != 0){
+		//A run that does not fit is left for the next payload
+		if((uint32_t)(end - p) < 1 + varintSize(run)){
+			i -= run;
+		}else{
+			*p++ = 0;
+			p = putVarint(p, run);
+		}
+	}
+	*cb = (uint32_t)(p - out);
+	return i;
+}
+
+/**
+* Unpacks ENC_DZV data into exactly count words.
+*
+* @param in encoded bytes
+* @param cb number of encoded bytes
+* @param words receives count words
+* @param count number of words expected
+* @param stride distance of the word each word is diffed against
+*
+* @return 0 if passed, -1 if the data is malformed or does not hold exactly count words
+*
+*/
+int dzvDecode(const uint8_t* in, uint32_t cb, uint32_t* words, uint32_t count, uint32_t stride){
+	const uint8_t* end = in + cb;
+	uint32_t i = 0;
+	uint32_t z, run;
+
+	while(in != end){
+		if(!getVarint(&in, end, &z)){
+			return -1;
+		}
+		if(z == 0){
+			if(!getVarint(&in, end, &run) || run == 0 || run > count - i){
+				return -1;
+			}
+			for(; run != 0; run--, i++){
+				words[i] = i < stride ? 0 : words[i - stride];
+			}
+			continue;
+		}
+		if(i == count){
+			return -1;
+		}
+		words[i] = (i < stride ? 0 : words[i - stride]) + ((z >> 1) ^ (0u - (z & 1)));
+		i++;
+	}
+	return i == count ? 0 : -1;
+}
@@ -0,0 +1,26 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_codec.h  --  Payload encodings of the DSPI link              */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    ENC_DZV, the delta, zero-run and varint code of 32-bit words      */
+/*    described in dspi_protocol.h. The encoder fills a payload of a    */
+/*    given size and reports how many words went in, so callers can     */
+/*    split a block into payloads and compare against ENC_RAW per       */
+/*    payload.                                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_CODEC_INCLUDED)
+#define      DSPI_CODEC_INCLUDED
+
+#include <stdint.h>
+
+#define DZV_MAX_SIZE(count) (5 * (count))	//worst case encoded bytes
+
+uint32_t dzvEncode(const uint32_t* words, uint32_t count, uint32_t stride, uint8_t* out, uint32_t cbMax, uint32_t* cb);
+int dzvDecode(const uint8_t* in, uint32_t cb, uint32_t* words, uint32_t count, uint32_t stride);
+
+#endif
@@ -0,0 +1,1532 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_dev.c  --  Register access to the USB104A7 DSPI demo device  */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "dspi_dev.h"
+#include "dspi_codec.h"
+#include "dspi_trace.h"
+#include "dspi_metrics.h"
+
+const RegRegion regRegions[REGMAP_N_REGIONS] = {
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	{base, count, width, attrs, REGMAP_IN_FABRIC_##backing, help},
+#include "regmap.def"
+};
+
+const RegNamed regNamed[REGMAP_N_NAMED] = {
+#define REGMAP_REG(id, name, addr, attrs, help) \
+	{name, addr, attrs, help},
+#include "regmap.def"
+};
+
+//Deadline of the calling thread's operations, see devSetDeadline()
+static OS_THREAD_LOCAL uint64_t threadDeadlineNs;
+
+/**
+* Opens a device.
+*
+* @param dev device to initialize
+* @param transport transport that reaches the device
+* @param device transport specific device name or options, may be NULL
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int devOpen(DspiDev* dev, const DspiTransport* transport, const char* device){
+	int status;
+
+	memset(dev, 0, sizeof(DspiDev));
+	if((status = transport->open(&dev->link, device)) != 0){
+		metricsOpen(status);
+		return status;
+	}
+	metricsOpen(0);
+	dev->transport = transport;
+	dev->settleUs = transport->settleUs;
+	dev->timeoutMs = DEV_TIMEOUT_MS;
+	dev->pendingOp = op_nop;//The device may still hold a response from a previous session
+	osMutexInit(&dev->lock);
+	if((status = devIdentify(dev)) != 0){
+		devClose(dev);
+		return status;
+	}
+	return 0;
+}
+
+/**
+* Asks the firmware what it serves and fills in dev->caps. The identify
+* words are read back to back, ID_COUNT+1 frames; firmware that rejects the
+* first gets the PROTOCOL_LEGACY set after two. Sets dev->fabric if the
+* fabric answers plain frames. Called by devOpen().
+*
+* @return 0 if passed, -1 if out of sequence, transport error code if failed
+*
+*/
+int devIdentify(DspiDev* dev){
+	static const uint8_t legacyOps[] = {
+		op_nop, op_write, op_read, op_axi_batch, op_operand, op_set_bits,
+		op_clear_bits, op_toggle_bits, op_mask_write, op_cas, op_wait,
+		op_script_load, op_capture_read, op_bulk_write
+	};
+	uint8_t rsp[FRAME_SIZE];
+	uint32_t id[ID_COUNT];
+	DevCaps* caps = &dev->caps;
+	int fIdentified = 1;
+	int status = 0;
+	uint32_t i;
+
+	devLock(dev);
+	for(i = 0; i <= ID_COUNT; i++){
+		if(i < ID_COUNT){
+			status = devTransferFrame(dev, op_identify, (uint16_t)i, 0, rsp);
+		}else{
+			status = devFlush(dev, rsp);//Collect the last word
+		}
+		if(status != 0){
+			break;
+		}
+		if(i > 0){
+			id[i-1] = rsp[FRAME_STATUS] == STATUS_OK ? getBE32(rsp + FRAME_DATA) : 0;
+			if(i == 1 && rsp[FRAME_STATUS] != STATUS_OK){
+				fIdentified = 0;//Legacy firmware, its last answer is collected later
+				break;
+			}
+		}
+	}
+	devUnlock(dev);
+	if(status != 0){
+		return status;
+	}
+
+	memset(caps, 0, sizeof(DevCaps));
+	if(!fIdentified){
+		caps->protocol = PROTOCOL_LEGACY;
+		caps->registers = REGMAP_N_REGS;
+		caps->payloadSize = PAYLOAD_SIZE;
+		caps->bulkWords = BULK_MAX_WORDS;
+		caps->bridgeOps = BRIDGE_MAX_OPS;
+		caps->features = FEATURE_DZV;
+		for(i = 0; i < sizeof(legacyOps); i++){
+			caps->ops[legacyOps[i] / 32] |= 1u << (legacyOps[i] % 32);
+		}
+		return 0;
+	}
+	caps->protocol = (uint16_t)(id[ID_VERSION] >> 16);
+	caps->firmware = (uint16_t)id[ID_VERSION];
+	caps->registers = id[ID_REGISTERS];
+	caps->payloadSize = id[ID_PAYLOAD] < PAYLOAD_SIZE ? id[ID_PAYLOAD] : PAYLOAD_SIZE;
+	caps->bulkWords = (id[ID_BURST] >> 16) < BULK_MAX_WORDS ? id[ID_BURST] >> 16 : BULK_MAX_WORDS;
+	caps->bridgeOps = (id[ID_BURST] & 0xFFFF) < BRIDGE_MAX_OPS ? id[ID_BURST] & 0xFFFF : BRIDGE_MAX_OPS;
+	caps->fifoBytes = id[ID_FIFO];
+	caps->features = id[ID_FEATURES];
+	for(i = 0; i < 8; i++){
+		caps->ops[i] = id[ID_OPS + i];
+	}
+	if(caps->features & FEATURE_FABRIC){
+		dev->fabric = 1;
+	}
+	return 0;
+}
+
+/**
+* Tells whether the firmware serves an opcode. Payload commands the
+* firmware does not serve must never be sent: it would take their payload
+* for frames.
+*/
+int devServes(const DspiDev* dev, uint8_t op){
+	return (dev->caps.ops[op / 32] >> (op % 32)) & 1;
+}
+
+/**
+* Closes a device opened by devOpen().
+*/
+void devClose(DspiDev* dev){
+	if(dev->transport == NULL){
+		return;
+	}
+	dev->transport->close(dev->link);
+	dev->transport = NULL;
+	osMutexDestroy(&dev->lock);
+	metricsClose();
+}
+
+/**
+* Takes the device for a sequence of raw transfers. The response to a frame
+* arrives with the next one, so a sequence must not be interleaved with
+* another thread's. The sequence runs under the calling thread's deadline.
+*/
+void devLock(DspiDev* dev){
+	uint64_t t = traceStart();
+
+	metricsLockEnter();
+	osMutexLock(&dev->lock);
+	metricsLockAcquired();
+	traceComplete("lock", t, NULL, 0);
+	dev->deadlineNs = threadDeadlineNs;
+}
+
+void devUnlock(DspiDev* dev){
+	osMutexUnlock(&dev->lock);
+	metricsUnlock();
+}
+
+/**
+* Sets the deadline of the calling thread's following operations, on any
+* device. It covers the wait for the device lock: an operation that only
+* gets the device after its deadline fails without sending anything.
+*
+* @param deadlineNs osNowNs() time, 0 for none
+*
+*/
+void devSetDeadline(uint64_t deadlineNs){
+	threadDeadlineNs = deadlineNs;
+}
+
+/**
+* Returns the deadline of the calling thread, 0 if it has none.
+*/
+uint64_t devDeadline(){
+	return threadDeadlineNs;
+}
+
+/**
+* Cancels the transfer in flight from another thread. Its operation fails
+* with LINK_ERR_CANCELED and the device stays open; operations waiting for
+* the device are not affected.
+*/
+void devCancel(DspiDev* dev){
+	dev->transport->cancel(dev->link);
+}
+
+/**
+* Limits the next transfer to the time left until the deadline. The caller
+* must hold the device lock.
+*
+* @param fFrame 1 before a frame, which is not sent once the deadline has
+*        passed. 0 before a payload: the device has taken its frame, so the
+*        payload runs to completion under DEV_TIMEOUT_MS.
+*
+* @return 0 if passed, LINK_ERR_TIMEOUT if the deadline has passed
+*
+*/
+static int devArm(DspiDev* dev, int fFrame){
+	uint32_t ms = DEV_TIMEOUT_MS;
+	uint64_t now;
+
+	if(dev->deadlineNs != 0 && fFrame){
+		now = osNowNs();
+		if(now >= dev->deadlineNs){
+			return LINK_ERR_TIMEOUT;
+		}else if(dev->deadlineNs - now < (uint64_t)DEV_TIMEOUT_MS * 1000000){
+			ms = (uint32_t)((dev->deadlineNs - now + 999999) / 1000000);
+		}
+	}
+	if(ms != dev->timeoutMs && dev->transport->setTimeout != NULL){
+		dev->transport->setTimeout(dev->link, ms);
+		dev->timeoutMs = ms;
+	}
+	return 0;
+}
+
+/**
+* Brings the device back to frames after a payload transfer failed. The
+* device may still wait for that payload, have taken it and gone on to a
+* reply payload, or be at frames already. A transfer of another length
+* ends a payload phase and a short frame is dropped, so one transfer of 1
+* byte, 2 if the payload was 1 byte, brings it back to frames in every case.
+* The response that follows is not checked. The caller must hold the device
+* lock.
+*
+* @return 0 if passed, transport error code if failed. The resync is tried
+*         again before the next frame.
+*
+*/
+static int devResync(DspiDev* dev){
+	static const uint8_t fill[2];
+	uint8_t rcv[2];
+	int status;
+
+	status = dev->transport->put(dev->link, fill, rcv, dev->resyncLen == 1 ? 2 : 1);
+	if(status != 0 && status != LINK_ERR_LENGTH){//The simulated device reports the length
+		return status;
+	}
+	traceInstant("resync", "bytes", dev->resyncLen);
+	dev->resyncLen = 0;
+	dev->pendingOp = op_nop;
+	return 0;
+}
+
+/**
+* Tells whether the result of a command is left to devTakeRejected(). These
+* commands return as soon as their frame is out.
+*/
+static int opIsPosted(uint8_t op){
+	switch(op){
+		case op_write:
+		case op_set_bits:
+		case op_clear_bits:
+		case op_toggle_bits:
+		case op_mask_write:
+			return 1;
+	}
+	return 0;
+}
+
+/**
+* Tells whether the fabric register file answers a frame without the
+* firmware: NOPs, and reads and writes at the native width of registers in
+* a fabric region that have no hooks. Its response is ready at once.
+*/
+static int frameInFabric(uint8_t op, uint8_t width, uint16_t addr){
+	int i;
+	int attrs;
+
+	if(op == op_nop){
+		return 1;
+	}
+	if(op != op_read && op != op_write){
+		return 0;
+	}
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		if(addr >= regRegions[i].base && addr - regRegions[i].base < regRegions[i].count){
+			break;
+		}
+	}
+	if(i == REGMAP_N_REGIONS || !regRegions[i].fabric || (width != 0 && width != regRegions[i].width)){
+		return 0;
+	}
+	attrs = regAttrs(addr);
+	if(op == op_read){
+		return !(attrs & REG_ATTR_READ_EFFECT);
+	}
+	return !(attrs & (REG_ATTR_WRITE_EFFECT | REG_ATTR_READONLY));
+}
+
+/**
+* Clocks one command frame out to the device. Frames are pipelined, the
+* device answers each frame while the next one is clocked in, so rsp receives
+* the response to the previously sent frame. The response is checked against
+* that frame. A rejected write or bit command is recorded for
+* devTakeRejected(), other
+* statuses are left to the caller. The caller must hold the device lock.
+*
+* @param op opcode of the frame
+* @param addr register the frame addresses
+* @param data data for write frames
+* @param rsp receives FRAME_SIZE bytes, the response to the previous frame
+*
+* @return 0 if passed, -1 if the response is out of sequence, transport error code if failed
+*
+*/
+int devTransferFrame(DspiDev* dev, uint8_t op, uint16_t addr, uint32_t data, uint8_t* rsp){
+	return devTransferFrameWidth(dev, op, 0, addr, data, rsp);//Width 0, native
+}
+
+/**
+* Clocks one command frame with an explicit width byte: the access width of
+* register commands, the payload encoding of payload commands. Otherwise the
+* same as devTransferFrame(). A frame that arrives before the device staged
+* the last response is dropped and answered with STATUS_DROPPED; it is sent
+* again, up to DEV_DROP_RETRIES times, and the response still due comes with
+* the frame that gets through.
+*
+* @return also -1 if the device kept dropping the frame
+*
+*/
+int devTransferFrameWidth(DspiDev* dev, uint8_t op, uint8_t width, uint16_t addr, uint32_t data, uint8_t* rsp){
+	uint8_t frame[FRAME_SIZE] = {op, width, 0, 0};
+	uint8_t expectOp = dev->pendingOp;
+	uint16_t expectAddr = dev->pendingAddr;
+	uint64_t t;
+	int fSequence;
+	int status;
+	int i;
+
+	if((status = devArm(dev, 1)) != 0){
+		return status;
+	}
+	if(dev->resyncLen != 0){
+		if((status = devResync(dev)) != 0){
+			metricsError(status);
+			return status;
+		}
+	}
+	putBE16(frame + FRAME_ADDR, addr);
+	putBE32(frame + FRAME_DATA, data);
+	dev->pendingOp = op_nop;
+	for(i = 0; ; i++){
+		t = traceStart();
+		if((status = dev->transport->put(dev->link, frame, rsp, FRAME_SIZE)) != 0){
+			metricsError(status);
+			return status;
+		}
+		if(t != 0){
+			dev->frameDoneNs = osNowNs();
+			traceRecord("frame", t, dev->frameDoneNs - t, "op", op);
+		}
+		if(rsp[FRAME_STATUS] != STATUS_DROPPED){
+			break;
+		}
+		metricsFrame(op, STATUS_DROPPED, 0, FRAME_SIZE);
+		if(i == DEV_DROP_RETRIES){
+			return -1;
+		}
+		osSleepUs(DEV_DROP_WAIT_US);
+	}
+	t = traceStart();
+	//A small delay is added to allow the USB104A7 to re-arm for the next frame.
+	//This is a limitation of the software driver used in this demo. A wait
+	//frame keeps the device busy for up to a slice before it re-arms. Frames
+	//the fabric answers need no delay when dev->fabric is set.
+	if(dev->settleUs != 0 && !(dev->fabric && frameInFabric(op, width, addr))){
+		if(op == op_wait && dev->settleUs < WAIT_SLICE_US + WAIT_MARGIN_US){
+			osSleepUs(WAIT_SLICE_US + WAIT_MARGIN_US);
+		}else{
+			osSleepUs(dev->settleUs);
+		}
+		traceComplete("settle", t, NULL, 0);
+	}
+	dev->pendingOp = op;
+	dev->pendingAddr = addr;
+
+	fSequence = expectOp != op_nop && (rsp[FRAME_OP] != expectOp || getBE16(rsp + FRAME_ADDR) != expectAddr);
+	metricsFrame(op, expectOp != op_nop && !fSequence ? rsp[FRAME_STATUS] : STATUS_OK, fSequence, FRAME_SIZE);
+	if(expectOp == op_nop){
+		return 0;
+	}
+	if(fSequence){
+		return -1;
+	}
+	if(rsp[FRAME_STATUS] != STATUS_OK && opIsPosted(expectOp)){
+		dev->rejectedOp = expectOp;
+		dev->rejectedAddr = expectAddr;
+		dev->rejectedStatus = rsp[FRAME_STATUS];
+	}
+	return 0;
+}
+
+/**
+* Clocks a payload phase of a command that moves more than a frame. The
+* caller must hold the device lock.
+*
+* @param snd bytes to send, or NULL to send zeros
+* @param rcv receives cb bytes, or NULL to discard them
+* @param cb payload size
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+int devTransferPayload(DspiDev* dev, const uint8_t* snd, uint8_t* rcv, uint32_t cb){
+	uint64_t t = traceStart();
+	int status;
+
+	devArm(dev, 0);
+	if(snd != NULL){
+		status = dev->transport->put(dev->link, snd, rcv, cb);
+	}else{
+		status = dev->transport->get(dev->link, rcv, cb);
+	}
+	if(status != 0){
+		dev->pendingOp = op_nop;
+		dev->resyncLen = cb;
+		devResync(dev);
+		metricsError(status);
+		return status;
+	}
+	metricsPayload(cb);
+	traceComplete("payload", t, "bytes", cb);
+	if(dev->settleUs != 0){
+		t = traceStart();
+		osSleepUs(dev->settleUs);
+		traceComplete("settle", t, NULL, 0);
+	}
+	return 0;
+}
+
+/**
+* Clocks a NOP to collect the response to the last frame. The caller must
+* hold the device lock.
+*
+* @param rsp receives the response
+*
+* @return see devTransferFrame()
+*
+*/
+int devFlush(DspiDev* dev, uint8_t* rsp){
+	return devTransferFrame(dev, op_nop, 0, 0, rsp);
+}
+
+/**
+* Sends a single frame command that modifies a register.
+*/
+static int devPost(DspiDev* dev, uint8_t op, uint16_t addr, uint32_t data){
+	uint8_t rsp[FRAME_SIZE];
+	int status;
+
+	devLock(dev);
+	status = devTransferFrame(dev, op, addr, data, rsp);
+	devUnlock(dev);
+	return status;
+}
+
+/**
+* Updates a register with a read and a write under the device lock, for
+* firmware without the bit commands. That is only atomic against other
+* host threads, and the read costs a flush.
+*/
+static int devUpdateFrames(DspiDev* dev, uint16_t addr, uint32_t clear, uint32_t set, uint32_t toggle){
+	uint8_t rsp[FRAME_SIZE];
+	int status;
+
+	devLock(dev);
+	if((status = devTransferFrame(dev, op_read, addr, 0, rsp)) == 0
+		&& (status = devFlush(dev, rsp)) == 0){
+		if(rsp[FRAME_STATUS] != STATUS_OK){
+			status = -1;
+		}else{
+			status = devTransferFrame(dev, op_write, addr, ((getBE32(rsp + FRAME_DATA) & ~clear) | set) ^ toggle, rsp);
+		}
+	}
+	devUnlock(dev);
+	return status;
+}
+
+/**
+* Writes a register. The write costs a single frame, its status arrives with
+* the next frame and a rejection is reported by devTakeRejected().
+*
+* @param addr register address
+* @param value value to write
+*
+* @return 0 if passed, -1 if out of sequence, transport error code if failed
+*
+*/
+int devWrite(DspiDev* dev, uint16_t addr, uint32_t value){
+	return devPost(dev, op_write, addr, value);
+}
+
+/**
+* Sets, clears or inverts the bits of mask in a register. The device does the
+* read-modify-write in one step, so it cannot race with other clients and
+* costs a single frame. Like devWrite(), a rejection is reported by
+* devTakeRejected(). Firmware without the command gets a read and a write.
+*
+* @param addr register address
+* @param mask bits to change
+*
+* @return 0 if passed, -1 if out of sequence, transport error code if failed
+*
+*/
+int devSetBits(DspiDev* dev, uint16_t addr, uint32_t mask){
+	if(!devServes(dev, op_set_bits)){
+		return devUpdateFrames(dev, addr, 0, mask, 0);
+	}
+	return devPost(dev, op_set_bits, addr, mask);
+}
+
+int devClearBits(DspiDev* dev, uint16_t addr, uint32_t mask){
+	if(!devServes(dev, op_clear_bits)){
+		return devUpdateFrames(dev, addr, mask, 0, 0);
+	}
+	return devPost(dev, op_clear_bits, addr, mask);
+}
+
+int devToggleBits(DspiDev* dev, uint16_t addr, uint32_t mask){
+	if(!devServes(dev, op_toggle_bits)){
+		return devUpdateFrames(dev, addr, 0, 0, mask);
+	}
+	return devPost(dev, op_toggle_bits, addr, mask);
+}
+
+/**
+* Writes the bits of mask in a register and leaves the others. Costs two
+* frames, the mask is latched as the operand of the write.
+*
+* @param addr register address
+* @param mask bits to write
+* @param value new value of those bits
+*
+* @return 0 if passed, -1 if out of sequence, transport error code if failed
+*
+*/
+int devMaskWrite(DspiDev* dev, uint16_t addr, uint32_t mask, uint32_t value){
+	uint8_t rsp[FRAME_SIZE];
+	int status;
+
+	if(!devServes(dev, op_mask_write)){
+		return devUpdateFrames(dev, addr, mask, value & mask, 0);
+	}
+	devLock(dev);
+	if((status = devTransferFrame(dev, op_operand, addr, mask, rsp)) == 0){
+		status = devTransferFrame(dev, op_mask_write, addr, value, rsp);
+	}
+	devUnlock(dev);
+	return status;
+}
+
+/**
+* Writes a register only if it holds an expected value. The device compares
+* and writes in one step.
+*
+* @param addr register address
+* @param expect value the register must hold
+* @param value value to write
+* @param current receives the register value after the call
+* @param status receives the device status, STATUS_MISMATCH if the register
+*        did not hold expect. May be NULL.
+*
+* @return 0 if swapped, -1 if not swapped or out of sequence, transport error code if failed
+*
+*/
+int devCompareSwap(DspiDev* dev, uint16_t addr, uint32_t expect, uint32_t value, uint32_t* current, uint8_t* status){
+	uint8_t rsp[FRAME_SIZE];
+	int result;
+
+	devLock(dev);
+	if((result = devTransferFrame(dev, op_operand, addr, expect, rsp)) == 0
+		&& (result = devTransferFrame(dev, op_cas, addr, value, rsp)) == 0){
+		result = devFlush(dev, rsp);
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = result == 0 ? rsp[FRAME_STATUS] : STATUS_NO_REPLY;
+	}
+	*current = result == 0 ? getBE32(rsp + FRAME_DATA) : 0;
+	if(result == 0 && rsp[FRAME_STATUS] != STATUS_OK){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Waits until (reg & mask) == (value & mask). The device polls the register
+* itself, a wait frame at a time: each covers up to WAIT_SLICE_US of polling
+* and frames are sent back to back until one matches or timeoutUs pass.
+* Every frame carries the answer to the one before, so a match costs one
+* extra frame, which only repeats the check.
+*
+* @param addr register address
+* @param mask bits to compare
+* @param value value of those bits to wait for
+* @param timeoutUs how long to wait, rounded up to whole slices
+* @param current receives the last sample of the register
+* @param status receives the device status, STATUS_TIMEOUT if the bits did
+*        not match in time. May be NULL.
+*
+* @return 0 if the bits matched, -1 if not or out of sequence, transport error code if failed
+*
+*/
+int devWait(DspiDev* dev, uint16_t addr, uint32_t mask, uint32_t value, uint32_t timeoutUs, uint32_t* current, uint8_t* status){
+	uint8_t rsp[FRAME_SIZE];
+	uint64_t deadline = osNowNs() + (uint64_t)timeoutUs * 1000;
+	uint8_t devStatus = STATUS_NO_REPLY;
+	int fLast;
+	int result;
+
+	*current = 0;
+	devLock(dev);
+	if((result = devTransferFrame(dev, op_operand, addr, mask, rsp)) == 0){
+		result = devTransferFrame(dev, op_wait, addr, value, rsp);
+	}
+	while(result == 0){
+		fLast = osNowNs() >= deadline;
+		if(fLast){
+			result = devFlush(dev, rsp);//Collect the last slice
+		}else{
+			result = devTransferFrame(dev, op_wait, addr, value, rsp);
+		}
+		if(result != 0){
+			break;
+		}
+		devStatus = rsp[FRAME_STATUS];
+		*current = getBE32(rsp + FRAME_DATA);
+		if(fLast){
+			break;
+		}
+		if(devStatus != STATUS_TIMEOUT){
+			result = devFlush(dev, rsp);//Drain the extra wait frame
+			break;
+		}
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = devStatus;
+	}
+	if(result == 0 && devStatus != STATUS_OK){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Reads several registers back to back. Every frame carries the response to
+* the one before it, so count registers cost count+1 transfers.
+*
+* @param addrs registers to read
+* @param vals receives one value per register, 0 for a rejected read
+* @param count number of registers
+*
+* @return 0 if passed, -1 if a read was rejected or out of sequence, transport error code if failed
+*
+*/
+int devRead(DspiDev* dev, const uint16_t* addrs, uint32_t* vals, int count){
+	uint8_t rsp[FRAME_SIZE];
+	int result = 0;
+	int status;
+	int i;
+
+	devLock(dev);
+	for(i = 0; i <= count; i++){
+		if(i < count){
+			status = devTransferFrame(dev, op_read, addrs[i], 0, rsp);
+		}else{
+			status = devFlush(dev, rsp);//Collect the last response
+		}
+		if(status != 0){
+			result = status;
+			break;
+		}
+		if(i > 0){
+			if(rsp[FRAME_STATUS] != STATUS_OK){
+				vals[i-1] = 0;
+				result = -1;
+			}else{
+				vals[i-1] = getBE32(rsp + FRAME_DATA);
+			}
+		}
+	}
+	devUnlock(dev);
+	return result;
+}
+
+/**
+* Reads a run of registers frame by frame and compares it with the copy,
+* for firmware without op_delta_scan.
+*/
+static int devDeltaFrames(DspiDev* dev, uint16_t addr, uint32_t count, uint32_t* vals, uint32_t* cChanged){
+	uint16_t addrs[DELTA_MAX_REGS];
+	uint32_t fresh[DELTA_MAX_REGS];
+	uint32_t i;
+	int result;
+
+	for(i = 0; i < count; i++){
+		addrs[i] = (uint16_t)(addr + i);
+	}
+	result = devRead(dev, addrs, fresh, (int)count);
+	for(i = 0; result == 0 && i < count; i++){
+		if(fresh[i] != vals[i]){
+			vals[i] = fresh[i];
+			(*cChanged)++;
+		}
+	}
+	return result;
+}
+
+/**
+* Brings a host copy of a run of registers up to date. op_delta_scan stages
+* the registers written since the copy's generation and op_delta_read
+* fetches them, five transfers however long the run. Firmware without them
+* gets the whole run read and compared; the generation then stays 0.
+*
+* @param addr first register
+* @param count number of registers, at most DELTA_MAX_REGS of one region
+* @param gen generation the copy is up to date with, 0 if it holds nothing
+*        yet. Receives the new generation.
+* @param vals the copy, count values. Changed registers are updated.
+* @param cChanged receives the number of registers updated. May be NULL.
+* @param status receives the device status, STATUS_BAD_ADDR if the run
+*        leaves its region. May be NULL.
+*
+* @return 0 if passed, -1 if rejected, out of sequence or malformed, transport error code if failed
+*
+*/
+int devDeltaRead(DspiDev* dev, uint16_t addr, uint32_t count, uint32_t* gen, uint32_t* vals, uint32_t* cChanged, uint8_t* status){
+	uint8_t buf[DELTA_MAX_SIZE(DELTA_MAX_REGS)];
+	uint8_t rsp[FRAME_SIZE];
+	const uint8_t* p;
+	uint32_t changed = 0;
+	uint32_t cb = 0;
+	uint32_t i;
+	int result;
+
+	if(cChanged != NULL){
+		*cChanged = 0;
+	}
+	if(count == 0 || count > DELTA_MAX_REGS){
+		return -1;
+	}
+	if(!devServes(dev, op_delta_scan) || !devServes(dev, op_delta_read)){
+		*gen = 0;
+		result = devDeltaFrames(dev, addr, count, vals, &changed);
+		if(status != NULL){
+			*status = result == 0 ? STATUS_OK : result > 0 ? STATUS_NO_REPLY : STATUS_BAD_ADDR;
+		}
+		if(cChanged != NULL){
+			*cChanged = changed;
+		}
+		return result;
+	}
+	devLock(dev);
+	if((result = devTransferFrame(dev, op_operand, 0, count, rsp)) == 0
+		&& (result = devTransferFrame(dev, op_delta_scan, addr, *gen, rsp)) == 0
+		&& (result = devFlush(dev, rsp)) == 0 && rsp[FRAME_STATUS] == STATUS_OK){
+		//The length is all the device decides, the rest is fixed by count
+		cb = getBE32(rsp + FRAME_DATA);
+		if(cb < 4 + (count + 7) / 8 || cb > DELTA_MAX_SIZE(count)){
+			result = -1;
+		}
+		else if((result = devTransferFrame(dev, op_delta_read, 0, cb, rsp)) == 0
+			&& (result = devTransferPayload(dev, NULL, buf, cb)) == 0){
+			result = devFlush(dev, rsp);
+		}
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = result == 0 ? rsp[FRAME_STATUS] : STATUS_NO_REPLY;
+	}
+	if(result != 0 || rsp[FRAME_STATUS] != STATUS_OK){
+		return result != 0 ? result : -1;
+	}
+
+	//A generation behind the copy's means the device restarted
+	if(*gen != 0 && getBE32(buf) < *gen){
+		*gen = 0;
+		return devDeltaRead(dev, addr, count, gen, vals, cChanged, status);
+	}
+	p = buf + 4 + (count + 7) / 8;
+	for(i = 0; i < count; i++){
+		if(buf[4 + i / 8] & (1 << (i % 8))){
+			if(p + 4 > buf + cb){
+				return -1;
+			}
+			vals[i] = getBE32(p);
+			p += 4;
+			changed++;
+		}
+	}
+	if(p != buf + cb){
+		return -1;
+	}
+	*gen = getBE32(buf);
+	if(cChanged != NULL){
+		*cChanged = changed;
+	}
+	return 0;
+}
+
+/**
+* Counts the writes at the start of ops that can go out as one bulk write:
+* consecutive registers of one region, at most a raw payload. Registers the
+* fabric answers are left to single frames, which need no settle, and so
+* is everything if the firmware has no op_bulk_write.
+*
+* @return length of the run, 0 if ops does not start with a write
+*
+*/
+static int devWriteRun(DspiDev* dev, const RegOp* ops, int count){
+	int i, n;
+
+	if(ops[0].op != op_write || !devServes(dev, op_bulk_write)
+		|| (dev->fabric && frameInFabric(op_write, 0, ops[0].addr))){
+		return 0;
+	}
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		if(ops[0].addr >= regRegions[i].base && ops[0].addr - regRegions[i].base < regRegions[i].count){
+			break;
+		}
+	}
+	if(i == REGMAP_N_REGIONS){
+		return 1;
+	}
+	for(n = 1; n < count && n < (int)(dev->caps.payloadSize / 4) && n < (int)dev->caps.bulkWords; n++){
+		if(ops[n].op != op_write || ops[n].addr != ops[0].addr + n
+			|| ops[n].addr - regRegions[i].base >= regRegions[i].count){
+			break;
+		}
+	}
+	return n;
+}
+
+/**
+* Fills in the requests a response answers: a single frame's, or all writes
+* of a bulk write, which keep the values written.
+*/
+static void devRegAnswer(RegOp* ops, int count, const uint8_t* rsp){
+	int i;
+
+	for(i = 0; i < count; i++){
+		ops[i].status = rsp[FRAME_STATUS];
+		if(count == 1){
+			ops[i].value = getBE32(rsp + FRAME_DATA);
+		}
+	}
+}
+
+/**
+* Finds an earlier read in a batch that answers a read of a
+* REG_ATTR_CACHEABLE register: one of the same register with no write to
+* it in between. Such a register only changes when written over DSPI, and
+* the batch holds the device lock throughout.
+*
+* @return index of the earlier read, -1 if the read has to go to the device
+*
+*/
+static int devSameRead(const RegOp* ops, int i){
+	int attrs;
+	int j;
+
+	if(ops[i].op != op_read || (attrs = regAttrs(ops[i].addr)) < 0 || !(attrs & REG_ATTR_CACHEABLE)){
+		return -1;
+	}
+	for(j = i - 1; j >= 0; j--){
+		if(ops[j].addr == ops[i].addr){
+			return ops[j].op == op_read ? j : -1;
+		}
+	}
+	return -1;
+}
+
+/**
+* Runs a mix of register reads and writes back to back under one lock. Each
+* frame carries the response to the one before, so count requests cost
+* count+1 frames, and runs of at least DEV_BULK_RUN writes to consecutive
+* registers go out as one bulk write. A read of a cacheable register that
+* an earlier read in the batch already covers costs no frame. Unlike
+* devWrite(), every write gets its own status.
+*
+* @param ops op_read or op_write requests, status and value are filled in
+*        on return: the value read, or read back after a single write
+* @param count number of requests
+*
+* @return 0 if passed, -1 if a request was rejected or out of sequence, transport error code if failed
+*
+*/
+int devRegBatch(DspiDev* dev, RegOp* ops, int count){
+	uint8_t payload[PAYLOAD_SIZE];
+	uint8_t rsp[FRAME_SIZE];
+	RegOp* prev = ops;
+	int cPrev = 0;	//requests the next response answers
+	int status = 0;
+	int i, j, n;
+
+	if(count <= 0){
+		return -1;
+	}
+	for(i = 0; i < count; i++){
+		ops[i].status = STATUS_NO_REPLY;
+	}
+	devLock(dev);
+	for(i = 0; i < count && status == 0; i += n){
+		if((n = devWriteRun(dev, ops + i, count - i)) >= DEV_BULK_RUN){
+			for(j = 0; j < n; j++){
+				putBE32(payload + 4 * j, ops[i+j].value);
+			}
+			if((status = devTransferFrame(dev, op_operand, ops[i].addr, n, rsp)) != 0){
+				break;
+			}
+			devRegAnswer(prev, cPrev, rsp);
+			if((status = devTransferFrameWidth(dev, op_bulk_write, ENC_RAW, ops[i].addr, 4 * n, rsp)) == 0){
+				status = devTransferPayload(dev, payload, NULL, 4 * n);
+			}
+		}
+		else if(devSameRead(ops, i) >= 0){
+			n = 1;//Answered below
+			continue;
+		}
+		else{
+			n = 1;
+			if((status = devTransferFrame(dev, ops[i].op, ops[i].addr, ops[i].value, rsp)) == 0){
+				devRegAnswer(prev, cPrev, rsp);
+			}
+		}
+		prev = ops + i;
+		cPrev = n;
+	}
+	if(status == 0 && (status = devFlush(dev, rsp)) == 0){//Collect the last response
+		devRegAnswer(prev, cPrev, rsp);
+	}
+	devUnlock(dev);
+
+	if(status != 0){
+		return status;
+	}
+	for(i = 0; i < count; i++){
+		if((j = devSameRead(ops, i)) >= 0){
+			ops[i].status = ops[j].status;
+			ops[i].value = ops[j].value;
+		}
+	}
+	for(i = 0; i < count; i++){
+		if(ops[i].status != STATUS_OK){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+* Executes a batch of 32-bit AXI reads and writes on the device bus. The
+* whole batch costs one frame and two payload transfers.
+*
+* @param ops requests, status and value are filled in on return
+* @param count number of requests, at most caps.bridgeOps
+*
+* @return 0 if passed, -1 if a request was rejected or out of sequence, transport error code if failed
+*
+*/
+int devAxiBatch(DspiDev* dev, AxiOp* ops, int count){
+	uint8_t req[BRIDGE_MAX_OPS*BRIDGE_REQ_SIZE];
+	uint8_t rsp[BRIDGE_MAX_OPS*BRIDGE_RSP_SIZE];
+	uint8_t frame[FRAME_SIZE];
+	uint8_t* p;
+	int status;
+	int result = 0;
+	int i;
+
+	if(count <= 0 || count > (int)dev->caps.bridgeOps){
+		return -1;
+	}
+	if(!devServes(dev, op_axi_batch)){
+		for(i = 0; i < count; i++){
+			ops[i].status = STATUS_BAD_OP;
+		}
+		return -1;
+	}
+	for(i = 0, p = req; i < count; i++, p += BRIDGE_REQ_SIZE){
+		p[0] = ops[i].kind;
+		putBE32(p + 1, ops[i].addr);
+		putBE32(p + 5, ops[i].value);
+		ops[i].status = STATUS_NO_REPLY;
+	}
+
+	devLock(dev);
+	if((status = devTransferFrame(dev, op_axi_batch, 0, count, frame)) != 0
+		|| (status = devTransferPayload(dev, req, NULL, count*BRIDGE_REQ_SIZE)) != 0
+		|| (status = devTransferPayload(dev, NULL, rsp, count*BRIDGE_RSP_SIZE)) != 0){
+		devUnlock(dev);
+		return status;
+	}
+	devUnlock(dev);
+
+	for(i = 0, p = rsp; i < count; i++, p += BRIDGE_RSP_SIZE){
+		ops[i].status = p[0];
+		ops[i].value = getBE32(p + 1);
+		if(ops[i].status != STATUS_OK){
+			result = -1;
+		}
+	}
+	return result;
+}
+
+/**
+* Reads part of a finished capture trace. The whole range arrives in one
+* payload transfer streamed from the device's trace memory. Captures are
+* armed and watched through the cap_* registers.
+*
+* @param encoding ENC_RAW for the trace, ENC_DZV for the packed trace of
+*        cap_zlen bytes
+* @param offset byte offset in the trace
+* @param buf receives cb bytes, the trace words are big endian
+* @param cb number of bytes, at most CAPTURE_SIZE, DZV_MAX_SIZE(CAPTURE_SIZE / 4) packed
+* @param status receives the device status, STATUS_BUSY if no trace is
+*        finished, STATUS_BAD_OP or STATUS_BAD_WIDTH if the firmware lacks
+*        the command or the encoding. May be NULL.
+*
+* @return 0 if passed, -1 if rejected or out of sequence, transport error code if failed
+*
+*/
+int devCaptureRead(DspiDev* dev, uint8_t encoding, uint32_t offset, uint8_t* buf, uint32_t cb, uint8_t* status){
+	uint8_t rsp[FRAME_SIZE];
+	int result;
+
+	if(cb == 0 || cb > (encoding == ENC_DZV ? DZV_MAX_SIZE(CAPTURE_SIZE / 4) : CAPTURE_SIZE)){
+		return -1;
+	}
+	if(!devServes(dev, op_capture_read) || (encoding == ENC_DZV && !(dev->caps.features & FEATURE_DZV))){
+		if(status != NULL){
+			*status = devServes(dev, op_capture_read) ? STATUS_BAD_WIDTH : STATUS_BAD_OP;
+		}
+		return -1;
+	}
+	devLock(dev);
+	if((result = devTransferFrame(dev, op_operand, 0, offset, rsp)) == 0
+		&& (result = devTransferFrameWidth(dev, op_capture_read, encoding, 0, cb, rsp)) == 0
+		&& (result = devTransferPayload(dev, NULL, buf, cb)) == 0){
+		result = devFlush(dev, rsp);
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = result == 0 ? rsp[FRAME_STATUS] : STATUS_NO_REPLY;
+	}
+	if(result == 0 && rsp[FRAME_STATUS] != STATUS_OK){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Reads a whole finished capture trace, packed if cap_zlen is smaller than
+* the trace and the firmware packs payloads. The payload goes through a
+* buffer of the call's own, so threads can read traces at the same time.
+*
+* @param words receives count words, sample by sample
+* @param count number of words, cap_len * cap_chans
+* @param chans cap_chans, the stride of the packed trace
+* @param cbPacked cap_zlen
+* @param status receives the device status, see devCaptureRead(). May be NULL.
+*
+* @return 0 if passed, -1 if rejected, out of sequence, malformed or out of memory, transport error code if failed
+*
+*/
+int devCaptureTrace(DspiDev* dev, uint32_t* words, uint32_t count, uint32_t chans, uint32_t cbPacked, uint8_t* status){
+	int fPacked = cbPacked != 0 && cbPacked < 4 * count && (dev->caps.features & FEATURE_DZV);
+	uint32_t cb = fPacked ? cbPacked : 4 * count;
+	uint8_t* buf;
+	uint32_t i;
+	int result;
+
+	if(count == 0 || count > CAPTURE_SIZE / 4){
+		return -1;
+	}
+	if((buf = malloc(cb)) == NULL){
+		return -1;
+	}
+	if((result = devCaptureRead(dev, fPacked ? ENC_DZV : ENC_RAW, 0, buf, cb, status)) == 0){
+		if(fPacked){
+			result = dzvDecode(buf, cbPacked, words, count, chans);
+		}else{
+			for(i = 0; i < count; i++){
+				words[i] = getBE32(buf + 4 * i);
+			}
+		}
+	}
+	free(buf);
+	return result;
+}
+
+/**
+* Fills the next op_bulk_write payload. With ENC_DZV the payload is packed
+* as far as it fits and falls back to ENC_RAW when that carries more words,
+* so incompressible data never costs more than raw.
+*
+* @param values words still to write
+* @param count number of words
+* @param encoding ENC_RAW or ENC_DZV
+* @param cbMax payload limit, caps.payloadSize
+* @param payload receives up to cbMax bytes
+* @param enc receives the encoding of the payload
+* @param cb receives the payload size
+*
+* @return number of words in the payload
+*
+*/
+uint32_t devBulkPack(const uint32_t* values, uint32_t count, uint8_t encoding, uint32_t cbMax, uint8_t* payload, uint8_t* enc, uint32_t* cb){
+	uint32_t n = count < cbMax / 4 ? count : cbMax / 4;
+	uint32_t m, i;
+
+	if(encoding == ENC_DZV){
+		m = dzvEncode(values, count < BULK_MAX_WORDS ? count : BULK_MAX_WORDS, 1, payload, cbMax, cb);
+		if(m > n || (m == n && *cb < 4 * n)){
+			*enc = ENC_DZV;
+			return m;
+		}
+	}
+	for(i = 0; i < n; i++){
+		putBE32(payload + 4 * i, values[i]);
+	}
+	*enc = ENC_RAW;
+	*cb = 4 * n;
+	return n;
+}
+
+/**
+* Writes consecutive registers a frame each, for firmware without
+* op_bulk_write. See devBulkWrite().
+*/
+static int devWriteFrames(DspiDev* dev, uint16_t addr, const uint32_t* values, uint32_t count, uint8_t* status){
+	uint8_t rsp[FRAME_SIZE];
+	uint8_t devStatus = STATUS_OK;
+	uint32_t i;
+	int result = 0;
+
+	devLock(dev);
+	for(i = 0; i <= count && result == 0; i++){
+		if(i < count){
+			result = devTransferFrame(dev, op_write, (uint16_t)(addr + i), values[i], rsp);
+		}else{
+			result = devFlush(dev, rsp);//Collect the last status
+		}
+		if(result == 0 && i > 0 && devStatus == STATUS_OK){
+			devStatus = rsp[FRAME_STATUS];
+		}
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = result == 0 ? devStatus : STATUS_NO_REPLY;
+	}
+	if(result == 0 && devStatus != STATUS_OK){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Writes a block of consecutive registers, each payload packed by
+* devBulkPack(). A payload costs an operand frame, the op_bulk_write frame
+* and the payload itself. Firmware without packed payloads gets raw ones,
+* firmware without op_bulk_write a write frame per register.
+*
+* @param addr first register
+* @param values values to write
+* @param count number of registers, all in one region
+* @param encoding ENC_RAW or ENC_DZV
+* @param status receives the device status of the first rejected payload.
+*        May be NULL.
+*
+* @return 0 if passed, -1 if rejected or out of sequence, transport error code if failed
+*
+*/
+int devBulkWrite(DspiDev* dev, uint16_t addr, const uint32_t* values, uint32_t count, uint8_t encoding, uint8_t* status){
+	uint8_t payload[PAYLOAD_SIZE];
+	uint8_t rsp[FRAME_SIZE];
+	uint8_t devStatus = STATUS_OK;
+	uint8_t enc;
+	uint32_t n, cb;
+	int fFirst = 1;
+	int result = 0;
+
+	if(count == 0 || encoding > ENC_DZV){
+		return -1;
+	}
+	if(!devServes(dev, op_bulk_write)){
+		return devWriteFrames(dev, addr, values, count, status);
+	}
+	if(!(dev->caps.features & FEATURE_DZV)){
+		encoding = ENC_RAW;
+	}
+	devLock(dev);
+	//The status of each payload arrives with the frame after it
+	while(result == 0 && count != 0){
+		n = devBulkPack(values, count < dev->caps.bulkWords ? count : dev->caps.bulkWords, encoding, dev->caps.payloadSize, payload, &enc, &cb);
+		if((result = devTransferFrame(dev, op_operand, addr, n, rsp)) != 0){
+			break;
+		}
+		if(!fFirst && (devStatus = rsp[FRAME_STATUS]) != STATUS_OK){
+			break;
+		}
+		if((result = devTransferFrameWidth(dev, op_bulk_write, enc, addr, cb, rsp)) != 0
+			|| (result = devTransferPayload(dev, payload, NULL, cb)) != 0){
+			break;
+		}
+		fFirst = 0;
+		addr += n;
+		values += n;
+		count -= n;
+	}
+	if(result == 0 && devStatus == STATUS_OK){
+		if((result = devFlush(dev, rsp)) == 0){
+			devStatus = rsp[FRAME_STATUS];
+		}
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = result == 0 ? devStatus : STATUS_NO_REPLY;
+	}
+	if(result == 0 && devStatus != STATUS_OK){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Copies a script into device script memory, a payload of up to PAYLOAD_SIZE
+* bytes per frame. Scripts are started by writing their offset to REG_SCRIPT
+* and stopped by writing SCRIPT_CTL_STOP, reading it returns the script state.
+*
+* @param offset destination in script memory
+* @param code bytecode, see SC_* in dspi_protocol.h
+* @param cb number of bytes
+* @param status receives the device status, STATUS_BUSY while a script runs,
+*        STATUS_BAD_OP if the firmware has no scripts. May be NULL.
+*
+* @return 0 if passed, -1 if rejected or out of sequence, transport error code if failed
+*
+*/
+int devScriptLoad(DspiDev* dev, uint16_t offset, const uint8_t* code, uint32_t cb, uint8_t* status){
+	uint8_t rsp[FRAME_SIZE];
+	uint8_t devStatus = STATUS_OK;
+	uint32_t n;
+	int fFirst = 1;
+	int result = 0;
+
+	if(cb == 0 || cb > SCRIPT_SIZE || offset > SCRIPT_SIZE - cb){
+		return -1;
+	}
+	if(!devServes(dev, op_script_load)){
+		if(status != NULL){
+			*status = STATUS_BAD_OP;
+		}
+		return -1;
+	}
+	devLock(dev);
+	//The status of each chunk arrives with the frame of the next one
+	while(result == 0 && cb != 0){
+		n = cb < dev->caps.payloadSize ? cb : dev->caps.payloadSize;
+		if((result = devTransferFrame(dev, op_script_load, offset, n, rsp)) != 0
+			|| (result = devTransferPayload(dev, code, NULL, n)) != 0){
+			break;
+		}
+		if(!fFirst && (devStatus = rsp[FRAME_STATUS]) != STATUS_OK){
+			break;
+		}
+		fFirst = 0;
+		offset += n;
+		code += n;
+		cb -= n;
+	}
+	if(result == 0 && devStatus == STATUS_OK){
+		if((result = devFlush(dev, rsp)) == 0){
+			devStatus = rsp[FRAME_STATUS];
+		}
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = result == 0 ? devStatus : STATUS_NO_REPLY;
+	}
+	if(result == 0 && devStatus != STATUS_OK){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Sends op_trace: reads the trace clock or the event count, or starts or
+* stops the device trace.
+*
+* @param word TRACE_CLOCK, TRACE_COUNT or TRACE_START
+* @param value for TRACE_START, 1 to start a new trace or 0 to stop it
+* @param result receives the clock, or the events recorded since the start
+* @param status receives the device status, STATUS_BAD_OP if the firmware
+*        does not trace. May be NULL.
+*
+* @return 0 if passed, -1 if rejected or out of sequence, transport error code if failed
+*
+*/
+int devTraceControl(DspiDev* dev, uint16_t word, uint32_t value, uint32_t* result, uint8_t* status){
+	uint8_t rsp[FRAME_SIZE];
+	int r;
+
+	*result = 0;
+	if(!devServes(dev, op_trace)){
+		if(status != NULL){
+			*status = STATUS_BAD_OP;
+		}
+		return -1;
+	}
+	devLock(dev);
+	if((r = devTransferFrame(dev, op_trace, word, value, rsp)) == 0){
+		r = devFlush(dev, rsp);
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = r == 0 ? rsp[FRAME_STATUS] : STATUS_NO_REPLY;
+	}
+	if(r == 0 && rsp[FRAME_STATUS] != STATUS_OK){
+		r = -1;
+	}
+	if(r == 0){
+		*result = getBE32(rsp + FRAME_DATA);
+	}
+	return r;
+}
+
+/**
+* Samples the device trace clock against osNowNs(). The firmware reads its
+* clock once the op_trace frame is in, somewhere between the start of the
+* transfer and its return.
+*
+* @param ticks receives the trace clock
+* @param hostNs receives the middle of that window
+* @param windowNs receives the length of the window, the uncertainty
+*
+* @return see devTraceControl()
+*
+*/
+int devTraceClock(DspiDev* dev, uint32_t* ticks, uint64_t* hostNs, uint64_t* windowNs){
+	uint8_t rsp[FRAME_SIZE];
+	uint64_t t0 = 0, t1 = 0;
+	int r;
+
+	*ticks = 0;
+	if(!devServes(dev, op_trace)){
+		return -1;
+	}
+	devLock(dev);
+	t0 = osNowNs();
+	if((r = devTransferFrame(dev, op_trace, TRACE_CLOCK, 0, rsp)) == 0){
+		//Only kept while tracing, otherwise the settle is in the window
+		t1 = dev->frameDoneNs > t0 ? dev->frameDoneNs : osNowNs();
+		r = devFlush(dev, rsp);
+	}
+	devUnlock(dev);
+
+	if(r == 0 && rsp[FRAME_STATUS] != STATUS_OK){
+		r = -1;
+	}
+	if(r == 0){
+		*ticks = getBE32(rsp + FRAME_DATA);
+		*hostNs = t0 + (t1 - t0) / 2;
+		*windowNs = t1 - t0;
+	}
+	return r;
+}
+
+/**
+* Reads device trace events with op_trace_read.
+*
+* @param first index of the first event since the start
+* @param buf receives count events of TRACE_EVENT_SIZE bytes, see
+*        dspi_protocol.h
+* @param count number of events, at most TRACE_DEPTH
+* @param status receives the device status, STATUS_BAD_ADDR if the events
+*        were not recorded yet or already overwritten. May be NULL.
+*
+* @return 0 if passed, -1 if rejected or out of sequence, transport error code if failed
+*
+*/
+int devTraceRead(DspiDev* dev, uint32_t first, uint8_t* buf, uint32_t count, uint8_t* status){
+	uint8_t rsp[FRAME_SIZE];
+	int result;
+
+	if(count == 0 || count > TRACE_DEPTH){
+		return -1;
+	}
+	if(!devServes(dev, op_trace_read)){
+		if(status != NULL){
+			*status = STATUS_BAD_OP;
+		}
+		return -1;
+	}
+	devLock(dev);
+	if((result = devTransferFrame(dev, op_operand, 0, first, rsp)) == 0
+		&& (result = devTransferFrame(dev, op_trace_read, 0, count * TRACE_EVENT_SIZE, rsp)) == 0
+		&& (result = devTransferPayload(dev, NULL, buf, count * TRACE_EVENT_SIZE)) == 0){
+		result = devFlush(dev, rsp);
+	}
+	devUnlock(dev);
+
+	if(status != NULL){
+		*status = result == 0 ? rsp[FRAME_STATUS] : STATUS_NO_REPLY;
+	}
+	if(result == 0 && rsp[FRAME_STATUS] != STATUS_OK){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Reports a write the device rejected after devWrite() returned.
+*
+* @param op receives the opcode of the rejected command
+* @param addr receives its address
+* @param status receives the device status
+*
+* @return 1 if a rejection was pending, 0 if not
+*
+*/
+int devTakeRejected(DspiDev* dev, uint8_t* op, uint16_t* addr, uint8_t* status){
+	int fRejected;
+
+	devLock(dev);
+	fRejected = dev->rejectedStatus != STATUS_OK;
+	if(fRejected){
+		*op = dev->rejectedOp;
+		*addr = dev->rejectedAddr;
+		*status = dev->rejectedStatus;
+		dev->rejectedStatus = STATUS_OK;
+	}
+	devUnlock(dev);
+	return fRejected;
+}
+
+/**
+* Looks up the native width of a register.
+*
+* @param addr register address
+*
+* @return width in bytes, 0 if the address is not mapped
+*
+*/
+int regWidth(uint16_t addr){
+	int i;
+
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		if(addr >= regRegions[i].base && addr - regRegions[i].base < regRegions[i].count){
+			return regRegions[i].width;
+		}
+	}
+	return 0;
+}
+
+/**
+* Looks up the attributes of a register, those of a named register or else
+* those of its region.
+*
+* @param addr register address
+*
+* @return REG_ATTR_* flags, -1 if the address is not mapped
+*
+*/
+int regAttrs(uint16_t addr){
+	int i;
+
+	for(i = 0; i < REGMAP_N_NAMED; i++){
+		if(regNamed[i].addr == addr){
+			return regNamed[i].attrs;
+		}
+	}
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		if(addr >= regRegions[i].base && addr - regRegions[i].base < regRegions[i].count){
+			return regRegions[i].attrs;
+		}
+	}
+	return -1;
+}
+
+/**
+* Looks up a named register, ignoring case.
+*
+* @param name register name, e.g. "led"
+*
+* @return the register, or NULL if there is none by that name
+*
+*/
+const RegNamed* regFind(const char* name){
+	const char* a;
+	const char* b;
+	int i;
+
+	for(i = 0; i < REGMAP_N_NAMED; i++){
+		for(a = name, b = regNamed[i].name; *a != '\0' && tolower((unsigned char)*a) == *b; a++, b++);
+		if(*a == '\0' && *b == '\0'){
+			return &regNamed[i];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,160 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_dev.h  --  Register access to the USB104A7 DSPI demo device  */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Host side of the DSPI protocol on top of a DspiTransport. The     */
+/*    device answers every frame while the next one is clocked in, so   */
+/*    DspiDev remembers which frame the next response belongs to. The   */
+/*    public operations take the device lock, so several threads can    */
+/*    share one device.                                                 */
+/*                                                                      */
+/*    Unless noted, functions return 0 on success, -1 if the device    */
+/*    rejected the command or answered out of sequence, or a positive   */
+/*    transport error code.                                             */
+/*                                                                      */
+/*    devOpen() asks the firmware what it serves with op_identify and   */
+/*    keeps the answer in caps. Operations take the fastest path the    */
+/*    firmware has and fall back to plain frames where one is missing.  */
+/*    Firmware from before op_identify is taken as PROTOCOL_LEGACY.     */
+/*                                                                      */
+/*    devDeltaRead() keeps a host copy of a run of registers current:   */
+/*    the firmware counts a generation per write and sends only the     */
+/*    registers written since the copy's generation, so a sync costs    */
+/*    what changed rather than the size of the run.                     */
+/*                                                                      */
+/*    A thread can give its operations a deadline with                  */
+/*    devSetDeadline(). A frame due after it is not sent and the        */
+/*    operation fails with LINK_ERR_TIMEOUT, and no transfer is allowed */
+/*    to run past it. The device stays open; the response of the lost   */
+/*    frame is skipped.                                                 */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_DEV_INCLUDED)
+#define      DSPI_DEV_INCLUDED
+
+#include <stdint.h>
+
+#include "host_os.h"
+#include "dspi_link.h"
+#include "dspi_protocol.h"
+#include "regmap.h"
+
+typedef struct {
+	uint8_t kind;	//BRIDGE_READ or BRIDGE_WRITE
+	uint32_t addr;
+	uint32_t value;
+	uint8_t status;
+} AxiOp;
+
+typedef struct {
+	uint8_t op;	//op_read or op_write
+	uint16_t addr;
+	uint32_t value;
+	uint8_t status;
+} RegOp;
+
+#define DEV_BULK_RUN 4	//consecutive writes that devRegBatch() sends as a bulk write
+#define DEV_TIMEOUT_MS 3000	//longest transfer without a deadline
+#define DEV_DROP_RETRIES 50	//resends of a frame the device dropped with STATUS_DROPPED
+#define DEV_DROP_WAIT_US 20	//before each resend
+
+//Register regions and named registers of the device, from regmap.def
+typedef struct {
+	uint16_t base;
+	uint16_t count;
+	uint8_t width;
+	uint8_t attrs;	//REG_ATTR_*
+	uint8_t fabric;	//1 if the fabric register file serves the region
+	const char* help;
+} RegRegion;
+
+typedef struct {
+	const char* name;
+	uint16_t addr;
+	uint8_t attrs;	//REG_ATTR_*, replace the region's
+	const char* help;
+} RegNamed;
+
+//What the firmware serves, from op_identify
+typedef struct {
+	uint16_t protocol;	//PROTOCOL_VERSION of the firmware
+	uint16_t firmware;	//firmware version, 0 if not reported
+	uint32_t registers;	//registers in the register map
+	uint32_t payloadSize;	//largest payload phase, at most PAYLOAD_SIZE
+	uint32_t bulkWords;	//registers per op_bulk_write
+	uint32_t bridgeOps;	//requests per op_axi_batch
+	uint32_t fifoBytes;	//reply payload FIFO, 0 if not reported
+	uint32_t features;	//FEATURE_*
+	uint32_t ops[8];	//bit op % 32 of ops[op / 32] for every opcode served
+} DevCaps;
+
+extern const RegRegion regRegions[REGMAP_N_REGIONS];
+extern const RegNamed regNamed[REGMAP_N_NAMED];
+
+typedef struct {
+	const DspiTransport* transport;
+	void* link;
+	uint32_t settleUs;
+	int fabric;	//the fabric answers plain frames, no settle after them
+	DevCaps caps;
+	OsMutex lock;
+	uint64_t deadlineNs;	//of the lock holder's operation, 0 if none
+	uint32_t timeoutMs;	//transfer timeout the transport is set to
+	uint64_t frameDoneNs;	//when the last traced frame was clocked, before its settle
+
+	//Frame whose response arrives with the next transfer
+	uint8_t pendingOp;
+	uint16_t pendingAddr;
+	uint32_t resyncLen;	//length of a failed payload the device may still wait for, see devResync()
+
+	//Last write or bit command the device rejected after the call returned
+	uint8_t rejectedOp;
+	uint16_t rejectedAddr;
+	uint8_t rejectedStatus;
+} DspiDev;
+
+int devOpen(DspiDev* dev, const DspiTransport* transport, const char* device);
+void devClose(DspiDev* dev);
+void devLock(DspiDev* dev);
+void devUnlock(DspiDev* dev);
+void devSetDeadline(uint64_t deadlineNs);
+uint64_t devDeadline();
+void devCancel(DspiDev* dev);
+int devIdentify(DspiDev* dev);
+int devServes(const DspiDev* dev, uint8_t op);
+
+int devTransferFrame(DspiDev* dev, uint8_t op, uint16_t addr, uint32_t data, uint8_t* rsp);
+int devTransferFrameWidth(DspiDev* dev, uint8_t op, uint8_t width, uint16_t addr, uint32_t data, uint8_t* rsp);
+int devTransferPayload(DspiDev* dev, const uint8_t* snd, uint8_t* rcv, uint32_t cb);
+int devFlush(DspiDev* dev, uint8_t* rsp);
+
+int devWrite(DspiDev* dev, uint16_t addr, uint32_t value);
+int devSetBits(DspiDev* dev, uint16_t addr, uint32_t mask);
+int devClearBits(DspiDev* dev, uint16_t addr, uint32_t mask);
+int devToggleBits(DspiDev* dev, uint16_t addr, uint32_t mask);
+int devMaskWrite(DspiDev* dev, uint16_t addr, uint32_t mask, uint32_t value);
+int devCompareSwap(DspiDev* dev, uint16_t addr, uint32_t expect, uint32_t value, uint32_t* current, uint8_t* status);
+int devWait(DspiDev* dev, uint16_t addr, uint32_t mask, uint32_t value, uint32_t timeoutUs, uint32_t* current, uint8_t* status);
+int devRead(DspiDev* dev, const uint16_t* addrs, uint32_t* vals, int count);
+int devDeltaRead(DspiDev* dev, uint16_t addr, uint32_t count, uint32_t* gen, uint32_t* vals, uint32_t* cChanged, uint8_t* status);
+int devRegBatch(DspiDev* dev, RegOp* ops, int count);
+int devAxiBatch(DspiDev* dev, AxiOp* ops, int count);
+int devCaptureRead(DspiDev* dev, uint8_t encoding, uint32_t offset, uint8_t* buf, uint32_t cb, uint8_t* status);
+int devCaptureTrace(DspiDev* dev, uint32_t* words, uint32_t count, uint32_t chans, uint32_t cbPacked, uint8_t* status);
+uint32_t devBulkPack(const uint32_t* values, uint32_t count, uint8_t encoding, uint32_t cbMax, uint8_t* payload, uint8_t* enc, uint32_t* cb);
+int devBulkWrite(DspiDev* dev, uint16_t addr, const uint32_t* values, uint32_t count, uint8_t encoding, uint8_t* status);
+int devScriptLoad(DspiDev* dev, uint16_t offset, const uint8_t* code, uint32_t cb, uint8_t* status);
+int devTraceControl(DspiDev* dev, uint16_t word, uint32_t value, uint32_t* result, uint8_t* status);
+int devTraceClock(DspiDev* dev, uint32_t* ticks, uint64_t* hostNs, uint64_t* windowNs);
+int devTraceRead(DspiDev* dev, uint32_t first, uint8_t* buf, uint32_t count, uint8_t* status);
+int devTakeRejected(DspiDev* dev, uint8_t* op, uint16_t* addr, uint8_t* status);
+
+int regWidth(uint16_t addr);
+int regAttrs(uint16_t addr);
+const RegNamed* regFind(const char* name);
+
+#endif
@@ -0,0 +1,62 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_link.h  --  Transports that carry DSPI transfers             */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    A transport moves raw SPI transfers to a device. Every transfer   */
+/*    asserts slave select for its whole length. transportAdept talks   */
+/*    to a real USB104A7 through the Adept runtime, transportSim runs   */
+/*    a model of the firmware in process so the host can be built,      */
+/*    benchmarked and tested on a machine without a board. transportRtl */
+/*    clocks the Verilated RTL of the fabric SPI slave with that model  */
+/*    as its firmware, for cycle accurate timing of the protocol.       */
+/*                                                                      */
+/*    Transport calls return 0 on success or an error code: the Adept   */
+/*    ERC from DmgrGetLastError(), or one of the LINK_ERR codes. A      */
+/*    transfer that times out or is canceled fails with                 */
+/*    LINK_ERR_TIMEOUT or LINK_ERR_CANCELED and leaves the link open.   */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_LINK_INCLUDED)
+#define      DSPI_LINK_INCLUDED
+
+#include <stdint.h>
+
+#define LINK_ERR_OPEN       3001	//device could not be opened
+#define LINK_ERR_LENGTH     3002	//transfer does not fit what the device expects
+#define LINK_ERR_CANCELED   3003	//transfer was canceled
+#define LINK_ERR_TIMEOUT    3004	//transfer did not complete in time
+
+typedef struct {
+	const char* name;
+	uint32_t settleUs;	//time the device needs to re-arm between transfers
+	int (*open)(void** link, const char* device);
+	void (*close)(void* link);
+	int (*put)(void* link, const uint8_t* snd, uint8_t* rcv, uint32_t cb);	//rcv may be NULL
+	int (*get)(void* link, uint8_t* rcv, uint32_t cb);
+	void (*cancel)(void* link);	//cancels the transfer in flight, from another thread
+	void (*setTimeout)(void* link, uint32_t ms);	//limit of the following transfers, NULL if they cannot stall
+	uint64_t (*clockNs)(void* link);	//simulated time, NULL if the device runs in real time
+} DspiTransport;
+
+#if defined(DSPI_WITH_ADEPT)
+extern const DspiTransport transportAdept;
+#endif
+extern const DspiTransport transportSim;
+#if defined(DSPI_WITH_RTL)
+extern const DspiTransport transportRtl;
+#endif
+
+//Firmware model of transportSim as used by transportRtl
+#define SIM_NEXT_FRAME 0	//the response goes out with the next frame
+#define SIM_NEXT_RECV 1	//a request payload is due
+#define SIM_NEXT_SEND 2	//a reply payload is due, then the response
+
+int simNext(void* link, uint8_t* rsp, const uint8_t** tx, uint32_t* cb);
+void* simRegionStore(void* link, int index);
+void simRegionTouch(void* link, int index, uint32_t reg);
+
+#endif
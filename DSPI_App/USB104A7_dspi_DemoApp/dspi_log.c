@@ -0,0 +1,152 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_log.c  --  Machine-readable operation log                    */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "host_os.h"
+#include "dspi_log.h"
+#include "dspi_protocol.h"
+
+static void putLE32(uint8_t* p, uint32_t v){
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static void putLE64(uint8_t* p, uint64_t v){
+	putLE32(p, (uint32_t)v);
+	putLE32(p + 4, (uint32_t)(v >> 32));
+}
+
+/**
+* Starts a log and buffers its header.
+*
+* @param format LOG_JSON or LOG_BINARY
+* @param fp stream to write to, opened in binary mode for LOG_BINARY
+*
+* @return 0 if passed, -1 if the format is not known
+*
+*/
+int logOpen(LogWriter* log, LogFormat format, FILE* fp){
+	uint64_t now = (uint64_t)time(NULL);
+
+	if(format != LOG_JSON && format != LOG_BINARY){
+		return -1;
+	}
+	log->fp = fp;
+	log->format = format;
+	log->startNs = osNowNs();
+	log->oldestNs = log->startNs;
+	if(format == LOG_JSON){
+		log->cb = (uint32_t)snprintf((char*)log->buf, LOG_RECORD_MAX,
+			"{\"log\": \"dspi\", \"version\": 1, \"start_unix_s\": %llu}\n", (unsigned long long)now);
+	}else{
+		memcpy(log->buf, "DSPILOG\x01", 8);
+		putLE64(log->buf + 8, now);
+		log->cb = 16;
+	}
+	return 0;
+}
+
+/**
+* Adds a record to the buffer, writing the buffer out first if the record
+* might not fit.
+*/
+void logRecord(LogWriter* log, const LogRecord* rec){
+	uint8_t* p;
+	const char* name;
+	int cb;
+
+	if(log->format == LOG_OFF){
+		return;
+	}
+	if(LOG_BUFFER_SIZE - log->cb < LOG_RECORD_MAX){
+		logFlush(log);
+	}
+	if(log->oldestNs == 0){
+		log->oldestNs = osNowNs();
+	}
+	p = log->buf + log->cb;
+	if(log->format == LOG_BINARY){
+		putLE64(p, rec->tNs - log->startNs);
+		putLE32(p + 8, rec->latencyNs);
+		putLE32(p + 12, rec->addr);
+		putLE32(p + 16, rec->value);
+		putLE32(p + 20, (uint32_t)rec->result);
+		p[24] = rec->op;
+		p[25] = rec->status;
+		p[26] = 0;
+		p[27] = 0;
+		log->cb += LOG_BINARY_SIZE;
+		return;
+	}
+	name = logOpName(rec->op);
+	cb = snprintf((char*)p, LOG_RECORD_MAX,
+		"{\"t_us\": %.1f, \"op\": \"%s\", \"addr\": %lu, \"value\": %lu, \"status\": %u, \"result\": %ld, \"latency_us\": %.1f}\n",
+		(rec->tNs - log->startNs) / 1e3, name, (unsigned long)rec->addr, (unsigned long)rec->value,
+		rec->status, (long)rec->result, rec->latencyNs / 1e3);
+	if(cb > 0 && cb < LOG_RECORD_MAX){
+		log->cb += (uint32_t)cb;
+	}
+}
+
+/**
+* Writes the buffer out if its oldest record has waited LOG_FLUSH_MS. Call
+* it regularly, so records reach the reader while the device is idle.
+*/
+void logPoll(LogWriter* log){
+	if(log->oldestNs != 0 && osNowNs() - log->oldestNs >= (uint64_t)LOG_FLUSH_MS * 1000000){
+		logFlush(log);
+	}
+}
+
+/**
+* Writes the buffered records out.
+*/
+void logFlush(LogWriter* log){
+	if(log->format == LOG_OFF || log->cb == 0){
+		return;
+	}
+	fwrite(log->buf, 1, log->cb, log->fp);
+	fflush(log->fp);
+	log->cb = 0;
+	log->oldestNs = 0;
+}
+
+/**
+* @return name of an operation in LOG_JSON records
+*/
+const char* logOpName(uint8_t op){
+	switch(op){
+		case op_write: return "write";
+		case op_read: return "read";
+		case op_set_bits: return "set";
+		case op_clear_bits: return "clear";
+		case op_toggle_bits: return "toggle";
+		case op_mask_write: return "mask";
+		case op_cas: return "cas";
+		case op_wait: return "wait";
+		case op_script_load: return "script";
+		case op_capture_read: return "capture";
+		case op_bulk_write: return "bulk_write";
+		case op_nop: return "nop";
+		case op_operand: return "operand";
+		case op_axi_batch: return "axi_batch";
+		case op_identify: return "identify";
+		case op_delta_scan: return "delta_scan";
+		case op_delta_read: return "delta_read";
+		case op_trace: return "trace";
+		case op_trace_read: return "trace_read";
+		case LOG_OP_AXI_READ: return "peek";
+		case LOG_OP_AXI_WRITE: return "poke";
+		case LOG_OP_REJECTED: return "rejected";
+	}
+	return "unknown";
+}
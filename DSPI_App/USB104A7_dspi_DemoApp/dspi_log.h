@@ -0,0 +1,80 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_log.h  --  Machine-readable operation log                    */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    One record per device operation: start time, latency, opcode,     */
+/*    address, value, device status and host result. Records are        */
+/*    formatted into a buffer that is written out when it fills up,     */
+/*    when its oldest record is LOG_FLUSH_MS old, or on logFlush(), so  */
+/*    a high operation rate costs no write per record.                  */
+/*                                                                      */
+/*    LOG_JSON writes a header line, then one JSON object per line:     */
+/*        {"log": "dspi", "version": 1, "start_unix_s": 1790000000}     */
+/*        {"t_us": 10.5, "op": "read", "addr": 1, "value": 5,           */
+/*         "status": 0, "result": 0, "latency_us": 120.0}               */
+/*                                                                      */
+/*    LOG_BINARY writes the 8 bytes "DSPILOG" 0x01 and the start time   */
+/*    as a 64-bit Unix time, then LOG_BINARY_SIZE byte records, all     */
+/*    little endian:                                                    */
+/*        u64 t_ns, u32 latency_ns, u32 addr, u32 value, i32 result,    */
+/*        u8 op, u8 status, u16 reserved                                */
+/*                                                                      */
+/*    op is the protocol opcode, or a LOG_OP_* code for operations      */
+/*    that have none. status is STATUS_NO_REPLY when the device gave    */
+/*    none, as for posted writes: their late rejections follow as       */
+/*    LOG_OP_REJECTED records. result is 0, -1 if rejected or out of    */
+/*    sequence, or a transport error code. A log is used by one thread. */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_LOG_INCLUDED)
+#define      DSPI_LOG_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOG_BUFFER_SIZE 65536
+#define LOG_RECORD_MAX 256	//longest formatted record
+#define LOG_BINARY_SIZE 28
+#define LOG_FLUSH_MS 200
+
+//Operations without an opcode of their own
+#define LOG_OP_AXI_READ 0xF0	//one AXI bridge read, addr is 32-bit
+#define LOG_OP_AXI_WRITE 0xF1	//one AXI bridge write
+#define LOG_OP_REJECTED 0xF2	//late rejection of a posted write, value = its opcode
+
+typedef enum {
+	LOG_OFF,
+	LOG_JSON,
+	LOG_BINARY
+} LogFormat;
+
+typedef struct {
+	uint64_t tNs;	//osNowNs() at the start of the operation
+	uint32_t latencyNs;
+	uint32_t addr;
+	uint32_t value;
+	int32_t result;
+	uint8_t op;
+	uint8_t status;
+} LogRecord;
+
+typedef struct {
+	FILE* fp;
+	LogFormat format;
+	uint64_t startNs;	//record times are relative to this
+	uint64_t oldestNs;	//time the oldest buffered record was added, 0 if none
+	uint32_t cb;
+	uint8_t buf[LOG_BUFFER_SIZE];
+} LogWriter;
+
+int logOpen(LogWriter* log, LogFormat format, FILE* fp);
+void logRecord(LogWriter* log, const LogRecord* rec);
+void logPoll(LogWriter* log);
+void logFlush(LogWriter* log);
+const char* logOpName(uint8_t op);
+
+#endif
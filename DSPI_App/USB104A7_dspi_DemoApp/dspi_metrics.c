@@ -0,0 +1,477 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_metrics.c  --  Counters of the DSPI stack for Prometheus     */
+/*                                                                      */
+/************************************************************************/
+
+#if defined(WIN32)
+	#include <winsock2.h>
+	typedef SOCKET MetricsSocket;
+	#define metricsCloseSocket closesocket
+	#define METRICS_NO_SOCKET INVALID_SOCKET
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <sys/select.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <unistd.h>
+	typedef int MetricsSocket;
+	#define metricsCloseSocket close
+	#define METRICS_NO_SOCKET (-1)
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dspi_metrics.h"
+#include "dspi_protocol.h"
+#include "dspi_log.h"
+
+#if defined(MSG_NOSIGNAL)
+	#define METRICS_SEND_FLAGS MSG_NOSIGNAL	//a scraper that hangs up raises no SIGPIPE
+#else
+	#define METRICS_SEND_FLAGS 0
+#endif
+
+#define METRICS_REQUEST_SIZE 1024
+#define METRICS_POLL_MS 200	//the server checks for metricsStop() this often
+#define METRICS_READ_MS 1000	//longest wait for a request
+
+volatile int metricsEnabled;
+OS_THREAD_LOCAL MetricsShard* metricsThreadShard;
+
+static MetricsShard shards[METRICS_MAX_THREADS];
+static volatile uint32_t cShards;	//shards claimed, more than there are once they ran out
+static OS_THREAD_LOCAL int fNoShard;
+
+//Upper bounds of the latency buckets
+static const uint64_t bucketNs[METRICS_BUCKETS] = {
+	100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+	25000000, 50000000, 100000000, 250000000, 500000000, 1000000000, 2500000000u
+};
+
+/**
+* Claims a shard for the calling thread. Called by metricsShard() on the
+* thread's first count.
+*
+* @return shard, NULL once all are taken
+*/
+MetricsShard* metricsClaim(){
+	uint32_t slot;
+
+	if(metricsThreadShard == NULL && !fNoShard){
+		slot = osAtomicAdd(&cShards, 1);
+		if(slot < METRICS_MAX_THREADS){
+			metricsThreadShard = &shards[slot];
+		}else{
+			fNoShard = 1;
+		}
+	}
+	return metricsThreadShard;
+}
+
+static uint32_t metricsShards(){
+	uint32_t n = osAtomicLoad(&cShards);
+
+	return n < METRICS_MAX_THREADS ? n : METRICS_MAX_THREADS;
+}
+
+/**
+* Counts a transport error.
+*
+* @param code DmgrGetLastError() ERC or LINK_ERR code, not 0
+*
+*/
+void metricsError(int code){
+	MetricsShard* s;
+	int i;
+
+	if(!metricsEnabled || (s = metricsShard()) == NULL){
+		return;
+	}
+	for(i = 0; i < METRICS_ERROR_CODES; i++){
+		if(s->errors[i].code == 0){
+			s->errors[i].code = i == METRICS_ERROR_CODES - 1 ? -1 : code;//Last slot takes the rest
+		}
+		if(s->errors[i].code == code || s->errors[i].code == -1){
+			s->errors[i].count++;
+			return;
+		}
+	}
+}
+
+/**
+* Counts a device open, or a failed one by its error.
+*
+* @param status what devOpen() returns
+*
+*/
+void metricsOpen(int status){
+	MetricsShard* s;
+
+	if(status != 0){
+		metricsError(status);
+	}else if(metricsEnabled && (s = metricsShard()) != NULL){
+		s->opens++;
+	}
+}
+
+void metricsClose(){
+	MetricsShard* s;
+
+	if(metricsEnabled && (s = metricsShard()) != NULL){
+		s->closes++;
+	}
+}
+
+/**
+* Counts a device opened again after its connection was lost.
+*/
+void metricsReconnect(){
+	MetricsShard* s;
+
+	if(metricsEnabled && (s = metricsShard()) != NULL){
+		s->reconnects++;
+	}
+}
+
+/**
+* Adds a transaction to the latency histogram.
+*/
+void metricsDuration(MetricsShard* s, uint64_t ns){
+	int i;
+
+	for(i = 0; i < METRICS_BUCKETS && ns > bucketNs[i]; i++);
+	s->buckets[i]++;
+	s->durationNs += ns;
+	s->transactions++;
+}
+
+/**
+* Appends to the scrape text, dropping what does not fit.
+*/
+static void metricsAppend(char* buf, size_t cb, size_t* n, const char* fmt, ...){
+	va_list args;
+	int r;
+
+	if(*n + 1 >= cb){
+		return;
+	}
+	va_start(args, fmt);
+	r = vsnprintf(buf + *n, cb - *n, fmt, args);
+	va_end(args);
+	if(r > 0){
+		*n = *n + r < cb ? *n + r : cb - 1;
+	}
+}
+
+/**
+* Sums a counter over all shards.
+*
+* @param offset offset of the counter in MetricsShard
+*
+*/
+static uint64_t metricsSum(size_t offset){
+	uint64_t sum = 0;
+	uint32_t i;
+
+	for(i = 0; i < metricsShards(); i++){
+		sum += *(volatile uint64_t*)((uint8_t*)&shards[i] + offset);
+	}
+	return sum;
+}
+
+#define METRICS_SUM(field) metricsSum(offsetof(MetricsShard, field))
+
+static void metricsHeader(char* buf, size_t cb, size_t* n, const char* name, const char* type, const char* help){
+	metricsAppend(buf, cb, n, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+* Estimates a latency quantile from the histogram, interpolating within
+* the bucket it falls in.
+*
+* @param counts transactions per bucket
+* @param total sum of counts
+* @param q quantile, 0 to 1
+*
+* @return seconds, or a negative value without transactions
+*/
+static double metricsQuantile(const uint64_t* counts, uint64_t total, double q){
+	double rank = q * total;
+	double below = 0;
+	double lower;
+	int i;
+
+	if(total == 0){
+		return -1;
+	}
+	for(i = 0; i < METRICS_BUCKETS; i++){
+		if(below + counts[i] >= rank && counts[i] != 0){
+			lower = i == 0 ? 0 : (double)bucketNs[i - 1];
+			return (lower + ((double)bucketNs[i] - lower) * (rank - below) / counts[i]) / 1e9;
+		}
+		below += counts[i];
+	}
+	return bucketNs[METRICS_BUCKETS - 1] / 1e9;//Beyond the last bound
+}
+
+/**
+* Formats every metric in the Prometheus text format.
+*
+* @param buf receives the text, NUL terminated
+* @param cb size of buf
+*
+* @return length of the text
+*
+*/
+size_t metricsFormat(char* buf, size_t cb){
+	static const double quantiles[] = {0.5, 0.9, 0.99};
+	uint64_t counts[METRICS_BUCKETS + 1];
+	uint64_t total, sum, v;
+	size_t n = 0;
+	uint32_t i, j;
+	int32_t code;
+	double q;
+
+	buf[0] = '\0';
+	for(i = 0; i <= METRICS_BUCKETS; i++){
+		counts[i] = METRICS_SUM(buckets[i]);
+	}
+	total = METRICS_SUM(transactions);
+
+	metricsHeader(buf, cb, &n, "dspi_transactions_total", "counter", "Device operations, each one devLock() to devUnlock() sequence.");
+	metricsAppend(buf, cb, &n, "dspi_transactions_total %llu\n", (unsigned long long)total);
+
+	metricsHeader(buf, cb, &n, "dspi_transaction_duration_seconds", "histogram", "Latency of device operations, including the wait for the device lock.");
+	for(i = 0, sum = 0; i < METRICS_BUCKETS; i++){
+		sum += counts[i];
+		metricsAppend(buf, cb, &n, "dspi_transaction_duration_seconds_bucket{le=\"%g\"} %llu\n", bucketNs[i] / 1e9, (unsigned long long)sum);
+	}
+	metricsAppend(buf, cb, &n, "dspi_transaction_duration_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)(sum + counts[METRICS_BUCKETS]));
+	metricsAppend(buf, cb, &n, "dspi_transaction_duration_seconds_sum %.9f\n", METRICS_SUM(durationNs) / 1e9);
+	metricsAppend(buf, cb, &n, "dspi_transaction_duration_seconds_count %llu\n", (unsigned long long)(sum + counts[METRICS_BUCKETS]));
+
+	metricsHeader(buf, cb, &n, "dspi_transaction_duration_quantile_seconds", "gauge", "Latency quantiles since the start, estimated from the histogram.");
+	for(i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++){
+		q = metricsQuantile(counts, sum + counts[METRICS_BUCKETS], quantiles[i]);
+		if(q < 0){
+			metricsAppend(buf, cb, &n, "dspi_transaction_duration_quantile_seconds{quantile=\"%g\"} NaN\n", quantiles[i]);
+		}else{
+			metricsAppend(buf, cb, &n, "dspi_transaction_duration_quantile_seconds{quantile=\"%g\"} %.6f\n", quantiles[i], q);
+		}
+	}
+
+	metricsHeader(buf, cb, &n, "dspi_lock_wait_seconds_total", "counter", "Time operations waited for the device lock.");
+	metricsAppend(buf, cb, &n, "dspi_lock_wait_seconds_total %.9f\n", METRICS_SUM(lockWaitNs) / 1e9);
+	metricsHeader(buf, cb, &n, "dspi_lock_queue_depth", "gauge", "Threads waiting for the device lock.");
+	metricsAppend(buf, cb, &n, "dspi_lock_queue_depth %llu\n", (unsigned long long)(METRICS_SUM(lockEntered) - METRICS_SUM(lockAcquired)));
+
+	metricsHeader(buf, cb, &n, "dspi_frames_total", "counter", "Command frames sent, by opcode.");
+	for(j = 0; j < 256; j++){
+		if((v = METRICS_SUM(frames[j])) != 0){
+			if(strcmp(logOpName((uint8_t)j), "unknown") == 0){
+				metricsAppend(buf, cb, &n, "dspi_frames_total{op=\"0x%02X\"} %llu\n", j, (unsigned long long)v);
+			}else{
+				metricsAppend(buf, cb, &n, "dspi_frames_total{op=\"%s\"} %llu\n", logOpName((uint8_t)j), (unsigned long long)v);
+			}
+		}
+	}
+	metricsHeader(buf, cb, &n, "dspi_payloads_total", "counter", "Payload phases clocked.");
+	metricsAppend(buf, cb, &n, "dspi_payloads_total %llu\n", (unsigned long long)METRICS_SUM(payloads));
+	metricsHeader(buf, cb, &n, "dspi_link_bytes_total", "counter", "Bytes clocked over the SPI link.");
+	metricsAppend(buf, cb, &n, "dspi_link_bytes_total %llu\n", (unsigned long long)METRICS_SUM(bytes));
+
+	metricsHeader(buf, cb, &n, "dspi_device_status_total", "counter", "Responses the device rejected, by status.");
+	for(j = 1; j < 256; j++){
+		if((v = METRICS_SUM(statuses[j])) != 0){
+			metricsAppend(buf, cb, &n, "dspi_device_status_total{status=\"%u\"} %llu\n", j, (unsigned long long)v);
+		}
+	}
+	metricsHeader(buf, cb, &n, "dspi_sequence_errors_total", "counter", "Responses that did not belong to the frame before.");
+	metricsAppend(buf, cb, &n, "dspi_sequence_errors_total %llu\n", (unsigned long long)METRICS_SUM(sequence));
+
+	//Codes are summed over the shards that saw them
+	metricsHeader(buf, cb, &n, "dspi_transport_errors_total", "counter", "Failed transfers and opens, by Adept ERC or LINK_ERR code.");
+	for(i = 0; i < metricsShards(); i++){
+		for(j = 0; j < METRICS_ERROR_CODES && (code = shards[i].errors[j].code) != 0; j++){
+			uint32_t k, l;
+			int fSeen = 0;
+
+			for(k = 0; k < i && !fSeen; k++){
+				for(l = 0; l < METRICS_ERROR_CODES && shards[k].errors[l].code != 0; l++){
+					fSeen |= shards[k].errors[l].code == code;
+				}
+			}
+			if(fSeen){
+				continue;
+			}
+			for(k = i, v = 0; k < metricsShards(); k++){
+				for(l = 0; l < METRICS_ERROR_CODES; l++){
+					if(shards[k].errors[l].code == code){
+						v += shards[k].errors[l].count;
+					}
+				}
+			}
+			metricsAppend(buf, cb, &n, "dspi_transport_errors_total{code=\"%ld\"} %llu\n", (long)code, (unsigned long long)v);
+		}
+	}
+
+	metricsHeader(buf, cb, &n, "dspi_device_opens_total", "counter", "Devices opened.");
+	metricsAppend(buf, cb, &n, "dspi_device_opens_total %llu\n", (unsigned long long)METRICS_SUM(opens));
+	metricsHeader(buf, cb, &n, "dspi_reconnects_total", "counter", "Devices opened again after the connection was lost.");
+	metricsAppend(buf, cb, &n, "dspi_reconnects_total %llu\n", (unsigned long long)METRICS_SUM(reconnects));
+	metricsHeader(buf, cb, &n, "dspi_device_up", "gauge", "Devices open.");
+	metricsAppend(buf, cb, &n, "dspi_device_up %llu\n", (unsigned long long)(METRICS_SUM(opens) - METRICS_SUM(closes)));
+	return n;
+}
+
+/**
+* Sends all of a buffer.
+*/
+static int metricsSend(MetricsSocket s, const char* p, size_t cb){
+	int r;
+
+	while(cb != 0){
+		if((r = send(s, p, (int)cb, METRICS_SEND_FLAGS)) <= 0){
+			return -1;
+		}
+		p += r;
+		cb -= r;
+	}
+	return 0;
+}
+
+/**
+* Waits for a socket to become readable.
+*
+* @return 1 if readable, 0 on timeout or error
+*/
+static int metricsReadable(MetricsSocket s, uint32_t ms){
+	struct timeval tv;
+	fd_set set;
+
+	FD_ZERO(&set);
+	FD_SET(s, &set);
+	tv.tv_sec = ms / 1000;
+	tv.tv_usec = (ms % 1000) * 1000;
+	return select((int)s + 1, &set, NULL, NULL, &tv) > 0;
+}
+
+/**
+* Reads one request from a scraper and answers it.
+*/
+static void metricsAnswer(MetricsServer* ms, MetricsSocket s){
+	char req[METRICS_REQUEST_SIZE];
+	char head[160];
+	size_t n = 0;
+	size_t cb;
+	int r;
+
+	while(n < sizeof(req) - 1 && metricsReadable(s, METRICS_READ_MS)){
+		if((r = recv(s, req + n, (int)(sizeof(req) - 1 - n), 0)) <= 0){
+			break;
+		}
+		n += r;
+		req[n] = '\0';
+		if(strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL){
+			break;
+		}
+	}
+	req[n] = '\0';
+
+	if(strncmp(req, "GET /metrics ", 13) == 0 || strncmp(req, "GET /metrics?", 13) == 0){
+		cb = metricsFormat(ms->text, sizeof(ms->text));
+		snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+			(unsigned long)cb);
+		if(metricsSend(s, head, strlen(head)) == 0){
+			metricsSend(s, ms->text, cb);
+		}
+	}else{
+		snprintf(head, sizeof(head), "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 22\r\nConnection: close\r\n\r\nOnly /metrics is here\n");
+		metricsSend(s, head, strlen(head));
+	}
+}
+
+/**
+* Server thread, answers one scraper at a time until metricsStop().
+*/
+static void* metricsThread(void* arg){
+	MetricsServer* ms = arg;
+	MetricsSocket listener = (MetricsSocket)ms->fd;
+	MetricsSocket s;
+
+	while(!ms->fStop){
+		if(!metricsReadable(listener, METRICS_POLL_MS)){
+			continue;
+		}
+		if((s = accept(listener, NULL, NULL)) == METRICS_NO_SOCKET){
+			continue;
+		}
+		metricsAnswer(ms, s);
+		metricsCloseSocket(s);
+	}
+	return NULL;
+}
+
+/**
+* Turns counting on and serves the metrics over HTTP.
+*
+* @param addr IPv4 address to listen on, NULL for 127.0.0.1
+* @param port TCP port, 0 for any free one, see ms->port
+*
+* @return 0 if passed, -1 if the port could not be opened
+*
+*/
+int metricsServe(MetricsServer* ms, const char* addr, uint16_t port){
+	struct sockaddr_in sa;
+	socklen_t cbSa = sizeof(sa);
+	MetricsSocket listener;
+	int on = 1;
+
+#if defined(WIN32)
+	WSADATA wsa;
+
+	if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0){
+		return -1;
+	}
+#endif
+	memset(ms, 0, sizeof(MetricsServer));
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(port);
+	sa.sin_addr.s_addr = inet_addr(addr != NULL ? addr : "127.0.0.1");
+	if((listener = socket(AF_INET, SOCK_STREAM, 0)) == METRICS_NO_SOCKET){
+		return -1;
+	}
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+	if(bind(listener, (struct sockaddr*)&sa, sizeof(sa)) != 0
+		|| listen(listener, 4) != 0
+		|| getsockname(listener, (struct sockaddr*)&sa, &cbSa) != 0){
+		metricsCloseSocket(listener);
+		return -1;
+	}
+	ms->fd = (intptr_t)listener;
+	ms->port = ntohs(sa.sin_port);
+	metricsEnabled = 1;
+	if(osThreadStart(&ms->thread, metricsThread, ms) != 0){
+		metricsCloseSocket(listener);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+* Stops the server started by metricsServe(). Counting goes on.
+*/
+void metricsStop(MetricsServer* ms){
+	ms->fStop = 1;
+	osThreadJoin(ms->thread);
+	metricsCloseSocket((MetricsSocket)ms->fd);
+#if defined(WIN32)
+	WSACleanup();
+#endif
+}
@@ -0,0 +1,163 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_metrics.h  --  Counters of the DSPI stack for Prometheus     */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    dspi_dev records what it does into counters: transactions (one    */
+/*    per devLock() to devUnlock() sequence) and their latency, frames  */
+/*    by opcode, payload transfers, link bytes, rejections by device    */
+/*    status, responses out of sequence, transport errors by code (the  */
+/*    DmgrGetLastError() ERC or a LINK_ERR code), opens and closes, and */
+/*    the threads waiting for the device lock.                          */
+/*                                                                      */
+/*    Counters are sharded per thread: every thread claims a shard on   */
+/*    first use and is its only writer, so recording takes no lock and  */
+/*    no shared cache line. A scrape sums the shards. Nothing is        */
+/*    recorded before metricsEnabled is set, after that a count costs   */
+/*    a thread-local load, and a transaction two clock reads. At most   */
+/*    METRICS_MAX_THREADS threads are counted, later ones are not.      */
+/*                                                                      */
+/*    metricsServe() answers GET /metrics on a local port in the        */
+/*    Prometheus text format from a thread of its own. Latency is a     */
+/*    histogram, so rates and quantiles over any window come from       */
+/*    histogram_quantile(); the quantile gauges estimate them from the  */
+/*    buckets since the start, for readers without Prometheus.          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_METRICS_INCLUDED)
+#define      DSPI_METRICS_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "host_os.h"
+
+#define METRICS_MAX_THREADS 32
+#define METRICS_ERROR_CODES 16	//distinct error codes per shard, the rest count as code -1
+#define METRICS_BUCKETS 14	//latency buckets below +Inf
+#define METRICS_PORT 9464	//default port
+#define METRICS_TEXT_SIZE 65536	//largest scrape
+#define METRICS_CACHE_LINE 64	//shards start on a line of their own
+
+typedef struct {
+	volatile int32_t code;	//0 for a free slot
+	volatile uint64_t count;
+} MetricsError;
+
+typedef struct {
+	OS_ALIGN(METRICS_CACHE_LINE) volatile uint64_t transactions;	//aligns and pads the shard to whole cache lines
+	volatile uint64_t durationNs;	//sum over transactions
+	volatile uint64_t buckets[METRICS_BUCKETS + 1];	//by latency, not cumulative
+	volatile uint64_t lockWaitNs;
+	volatile uint64_t lockEntered;
+	volatile uint64_t lockAcquired;
+	volatile uint64_t frames[256];	//by opcode
+	volatile uint64_t payloads;
+	volatile uint64_t bytes;	//clocked over the link
+	volatile uint64_t statuses[256];	//responses by device status, STATUS_OK not counted
+	volatile uint64_t sequence;	//responses out of sequence
+	volatile uint64_t opens;
+	volatile uint64_t closes;
+	volatile uint64_t reconnects;
+	MetricsError errors[METRICS_ERROR_CODES];
+	uint64_t lockNs;	//when the thread asked for the device lock
+} MetricsShard;
+
+typedef struct {
+	OsThread thread;
+	intptr_t fd;	//listening socket
+	volatile int fStop;
+	uint16_t port;
+	char text[METRICS_TEXT_SIZE];	//scrape being answered
+} MetricsServer;
+
+extern volatile int metricsEnabled;
+extern OS_THREAD_LOCAL MetricsShard* metricsThreadShard;
+
+MetricsShard* metricsClaim();
+void metricsError(int code);
+void metricsOpen(int status);
+void metricsClose();
+void metricsReconnect();
+void metricsDuration(MetricsShard* shard, uint64_t ns);
+size_t metricsFormat(char* buf, size_t cb);
+int metricsServe(MetricsServer* ms, const char* addr, uint16_t port);
+void metricsStop(MetricsServer* ms);
+
+/**
+* @return the calling thread's shard, NULL once all are taken
+*/
+static inline MetricsShard* metricsShard(){
+	return metricsThreadShard != NULL ? metricsThreadShard : metricsClaim();
+}
+
+/**
+* Counts a frame, its response status and its bytes.
+*
+* @param op opcode of the frame
+* @param status device status of the previous frame's response, STATUS_OK
+*        if none arrived
+* @param fSequence 1 if that response was out of sequence
+*
+*/
+static inline void metricsFrame(uint8_t op, uint8_t status, int fSequence, uint32_t cb){
+	MetricsShard* s;
+
+	if(metricsEnabled && (s = metricsShard()) != NULL){
+		s->frames[op]++;
+		s->bytes += cb;
+		if(status != 0){
+			s->statuses[status]++;
+		}
+		if(fSequence){
+			s->sequence++;
+		}
+	}
+}
+
+static inline void metricsPayload(uint32_t cb){
+	MetricsShard* s;
+
+	if(metricsEnabled && (s = metricsShard()) != NULL){
+		s->payloads++;
+		s->bytes += cb;
+	}
+}
+
+/**
+* Marks the start of a transaction, before the device lock is taken.
+*/
+static inline void metricsLockEnter(){
+	MetricsShard* s;
+
+	if(metricsEnabled && (s = metricsShard()) != NULL){
+		s->lockNs = osNowNs();
+		s->lockEntered++;
+	}
+}
+
+static inline void metricsLockAcquired(){
+	MetricsShard* s;
+
+	if(metricsEnabled && (s = metricsShard()) != NULL && s->lockEntered != s->lockAcquired){
+		s->lockWaitNs += osNowNs() - s->lockNs;
+		s->lockAcquired++;
+	}
+}
+
+/**
+* Ends the transaction once the device lock is released.
+*/
+static inline void metricsUnlock(){
+	MetricsShard* s;
+
+	if(metricsEnabled && (s = metricsShard()) != NULL && s->lockNs != 0){
+		metricsDuration(s, osNowNs() - s->lockNs);
+		s->lockNs = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,219 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_protocol.h  --  DSPI frame layout of the USB104A7 firmware   */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Host copy of the firmware's dspi_protocol.h. Every command is a   */
+/*    fixed FRAME_SIZE frame:                                           */
+/*        [op, width, addrHi, addrLo, d3, d2, d1, d0]                   */
+/*    answered while the next frame is clocked in with:                 */
+/*        [op, status, addrHi, addrLo, v3, v2, v1, v0]                  */
+/*    Commands that move more than a frame continue with a request      */
+/*    payload and then a reply payload right after their frame. A       */
+/*    payload transfer of another length ends the payload phases, the   */
+/*    command is answered with STATUS_BAD_LENGTH and the next transfer  */
+/*    is a frame again. A frame of another length is dropped.           */
+/*                                                                      */
+/*    Must be kept in step with the firmware.                           */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_PROTOCOL_INCLUDED)
+#define      DSPI_PROTOCOL_INCLUDED
+
+#include <stdint.h>
+
+#define op_nop 0x00
+#define op_write 0xAA
+#define op_read 0xBB
+#define op_axi_batch 0xC0
+//Atomic bit commands answer with the new value. op_operand latches the
+//second operand of the next command: op_mask_write writes
+//(reg & ~operand) | (data & operand).
+#define op_operand 0xA0
+#define op_set_bits 0xA1
+#define op_clear_bits 0xA2
+#define op_toggle_bits 0xA3
+#define op_mask_write 0xA4
+//op_cas writes data if the register holds the operand. op_wait polls on the
+//device until (reg & operand) == (data & operand) or WAIT_SLICE_US pass and
+//only then re-arms, so the next transfer must wait WAIT_SLICE_US + WAIT_MARGIN_US.
+#define op_cas 0xA5
+#define op_wait 0xA6
+//op_script_load copies a request payload of data bytes to script memory at
+//offset addr, there is no reply payload.
+#define op_script_load 0xC1
+//op_capture_read streams data bytes of the finished capture trace from byte
+//offset operand as its reply payload, there is no request payload. The
+//payload is sent even if the read is rejected, its status comes with the
+//next frame.
+#define op_capture_read 0xC2
+//op_bulk_write writes operand consecutive registers from addr out of a
+//request payload of data bytes and answers with the count. On payload
+//commands the width byte selects the payload encoding: ENC_DZV on
+//op_capture_read addresses the packed trace of cap_zlen bytes.
+#define op_bulk_write 0xC3
+//op_identify answers identify word addr, ID_*, so the host can pick the
+//paths the firmware supports. Firmware without it answers STATUS_BAD_OP
+//and speaks PROTOCOL_LEGACY.
+#define op_identify 0xA7
+//op_delta_scan stages the operand registers from addr, at most
+//DELTA_MAX_REGS of one region, that were written after generation data and
+//answers with the length of that delta. op_delta_read streams data bytes of
+//the staged delta as its reply payload, sent even if rejected like
+//op_capture_read. The delta is the current generation (BE32), a bitmap of
+//(operand + 7) / 8 bytes with bit i % 8 of byte i / 8 set for every changed
+//register i, then a BE32 value per changed register. Generation 0 selects
+//every register.
+#define op_delta_scan 0xA8
+#define op_delta_read 0xC4
+//op_trace controls the firmware event trace, addr selects TRACE_CLOCK,
+//TRACE_COUNT or TRACE_START. op_trace_read streams data bytes of events
+//from event operand as its reply payload, sent even if rejected like
+//op_capture_read. An event is TRACE_EVENT_SIZE bytes: the trace clock
+//(BE32), the event, and the opcode and address (BE16) of the frame it
+//belongs to. Only the last TRACE_DEPTH events are kept.
+#define op_trace 0xA9
+#define op_trace_read 0xC5
+
+#define PROTOCOL_VERSION 2
+#define PROTOCOL_LEGACY 1	//op_nop to op_bulk_write, no op_identify
+
+#define ID_VERSION 0	//PROTOCOL_VERSION << 16 | firmware version
+#define ID_REGISTERS 1	//registers in the register map
+#define ID_PAYLOAD 2	//largest payload phase, bytes
+#define ID_BURST 3	//BULK_MAX_WORDS << 16 | BRIDGE_MAX_OPS
+#define ID_FIFO 4	//reply payload FIFO of the SPI slave, bytes
+#define ID_FEATURES 5	//FEATURE_*
+#define ID_OPS 8	//8 words, bit op % 32 of word ID_OPS + op / 32 is set for every opcode served
+#define ID_COUNT 16
+
+#define FEATURE_FABRIC 0x01	//the fabric answers plain frames
+#define FEATURE_DZV 0x02	//ENC_DZV payloads
+
+#define WAIT_SLICE_US 500
+#define WAIT_MARGIN_US 250
+
+#define FRAME_SIZE 8
+#define FRAME_OP 0
+#define FRAME_WIDTH 1
+#define FRAME_STATUS 1
+#define FRAME_ADDR 2
+#define FRAME_DATA 4
+
+#define PAYLOAD_SIZE 512
+
+#define STATUS_OK 0x00
+#define STATUS_BAD_OP 0x01
+#define STATUS_BAD_ADDR 0x02
+#define STATUS_BAD_WIDTH 0x03
+#define STATUS_DENIED 0x04
+#define STATUS_BAD_LENGTH 0x05
+#define STATUS_MISMATCH 0x06
+#define STATUS_TIMEOUT 0x07
+#define STATUS_BUSY 0x08
+#define STATUS_DROPPED 0x09	//Answers a frame clocked in before the last response was staged, the frame was dropped and that response is still due
+#define STATUS_NO_REPLY 0xFF	//Host side only, the device never answered
+
+//AXI bridge. op_axi_batch carries the request count in its data field and is
+//followed by a request payload of [kind, a3..a0, v3..v0] records, then a
+//reply payload of [status, v3..v0] records.
+#define BRIDGE_READ 0x01
+#define BRIDGE_WRITE 0x02
+#define BRIDGE_REQ_SIZE 9
+#define BRIDGE_RSP_SIZE 5
+#define BRIDGE_MAX_OPS 48
+
+//Script bytecode, an opcode byte followed by big endian operands:
+//a = 16-bit register, m/v = 32-bit mask/value, us = 32-bit microseconds,
+//t = 16-bit script offset. acc is the value of the last sc_load.
+#define SC_END 0x00	//stop, success
+#define SC_WRITE 0x01	//a v
+#define SC_SET 0x02	//a m
+#define SC_CLEAR 0x03	//a m
+#define SC_TOGGLE 0x04	//a m
+#define SC_DELAY 0x05	//us
+#define SC_WAIT 0x06	//a m v us, fails with STATUS_TIMEOUT
+#define SC_LOAD 0x07	//a
+#define SC_BEQ 0x08	//m v t, branch if (acc & m) == v
+#define SC_BNE 0x09	//m v t, branch if (acc & m) != v
+#define SC_JUMP 0x0A	//t
+
+#define SCRIPT_SIZE 4096
+
+//Script register: write an offset to start there, SCRIPT_CTL_STOP to stop.
+//Reads return the state: pc, last status and SCRIPT_STATE_RUNNING.
+#define SCRIPT_CTL_STOP 0x80000000
+#define SCRIPT_STATE_RUNNING 0x01000000
+#define SCRIPT_STATE_STATUS(s) (((s) >> 16) & 0xFF)
+#define SCRIPT_STATE_PC(s) ((s) & 0xFFFF)
+
+//Capture engine, configured by the cap_* registers. A trace holds samples
+//of cap_chans 32-bit words each, oldest first, the trigger sample at
+//cap_trig_at.
+#define CAPTURE_SIZE 0x40000	//bytes of trace memory
+#define CAPTURE_MAX_CHANNELS 4
+#define CAPTURE_MIN_PERIOD_US 5
+
+#define CAPTURE_CTL_STOP 0	//writes to cap_ctl
+#define CAPTURE_CTL_ARM 1
+#define CAPTURE_CTL_TRIGGER 2	//trigger now
+
+#define CAPTURE_IDLE 0		//reads of cap_ctl
+#define CAPTURE_ARMED 1
+#define CAPTURE_TRIGGERED 2
+#define CAPTURE_DONE 3
+
+//Payload encodings. ENC_DZV packs 32-bit words: each word becomes its
+//difference to the word stride places back (0 for the first stride words),
+//zigzag mapped and written as an LEB128 varint; a varint 0 is followed by a
+//varint count of zero differences. The stride is 1 for bulk writes and
+//cap_chans for traces.
+#define ENC_RAW 0
+#define ENC_DZV 1
+
+#define BULK_MAX_WORDS 4096	//registers per op_bulk_write
+
+#define DELTA_MAX_REGS 1024	//registers per op_delta_scan
+#define DELTA_MAX_SIZE(n) (4 + ((n) + 7) / 8 + 4 * (n))	//delta of n registers, all changed
+
+#define TRACE_CLOCK 0	//op_trace answers the trace clock
+#define TRACE_COUNT 1	//op_trace answers the events recorded since the start
+#define TRACE_START 2	//op_trace starts a new trace if data is 1, stops it if 0
+#define TRACE_TICK_HZ 100000000	//32-bit trace clock, the AXI clock
+#define TRACE_DEPTH 1024	//events the device keeps
+#define TRACE_EVENT_SIZE 8
+
+//Trace events, with TRACE_EV_BEGIN or TRACE_EV_END for spans
+#define TRACE_EV_IRQ 0x01	//link interrupt, the frame is the one it raised
+#define TRACE_EV_FRAME 0x02	//a forwarded frame, from decode to response
+#define TRACE_EV_PAYLOAD 0x03	//a request payload, from arrival to response
+#define TRACE_EV_PRINT 0x04	//UART output after a frame
+#define TRACE_EV_CAPTURE 0x05	//finishing a capture
+#define TRACE_EV_BEGIN 0x40
+#define TRACE_EV_END 0x80
+#define TRACE_EV_KIND(e) ((e) & 0x3F)
+
+static inline uint16_t getBE16(const uint8_t* p){
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static inline uint32_t getBE32(const uint8_t* p){
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void putBE16(uint8_t* p, uint16_t v){
+	p[0] = v >> 8;
+	p[1] = (uint8_t)v;
+}
+
+static inline void putBE32(uint8_t* p, uint32_t v){
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = (uint8_t)v;
+}
+
+#endif
@@ -0,0 +1,277 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_sched.c  --  Priority classes for threads sharing a device   */
+/*                                                                      */
+/************************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+
+#include "dspi_sched.h"
+
+/**
+* Reads the clock waits are measured with: the device's simulated time if
+* the transport has one, else the host clock.
+*/
+static uint64_t schedNow(DspiSched* sched){
+	if(sched->dev->transport->clockNs != NULL){
+		return sched->dev->transport->clockNs(sched->dev->link);
+	}
+	return osNowNs();
+}
+
+/**
+* Tells whether a class above cls is waiting for the device. The caller
+* must hold the scheduler lock.
+*/
+static int schedHigherWaiting(DspiSched* sched, SchedClass cls){
+	int i;
+
+	for(i = 0; i < (int)cls; i++){
+		if(sched->waiting[i] != 0){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+* Sets up a scheduler for an open device, with the default segment sizes.
+*
+* @param sched scheduler to initialize
+* @param dev device the scheduler hands out
+*
+*/
+void schedInit(DspiSched* sched, DspiDev* dev){
+	memset(sched, 0, sizeof(DspiSched));
+	sched->dev = dev;
+	sched->segWords = SCHED_SEG_WORDS;
+	sched->segBytes = SCHED_SEG_BYTES;
+	osMutexInit(&sched->lock);
+	osCondInit(&sched->cond);
+}
+
+/**
+* Releases a scheduler set up by schedInit(). No thread may use it.
+*/
+void schedDestroy(DspiSched* sched){
+	osCondDestroy(&sched->cond);
+	osMutexDestroy(&sched->lock);
+}
+
+/**
+* Waits until the device is free and no higher class is waiting, then takes
+* it. The wait is added to the statistics of the class.
+*
+* @param cls priority class of the caller
+*
+* @return 0 if passed, LINK_ERR_TIMEOUT if the caller's deadline passed first
+*
+*/
+int schedAcquire(DspiSched* sched, SchedClass cls){
+	SchedStats* stats = &sched->stats[cls];
+	uint64_t t = schedNow(sched);
+	uint64_t deadline = devDeadline();
+	uint64_t now;
+
+	osMutexLock(&sched->lock);
+	sched->waiting[cls]++;
+	while(sched->fBusy || schedHigherWaiting(sched, cls)){
+		if(deadline == 0){
+			osCondWait(&sched->cond, &sched->lock);
+		}else if((now = osNowNs()) < deadline){
+			osCondWaitUs(&sched->cond, &sched->lock, (uint32_t)((deadline - now + 999) / 1000));
+		}else{
+			//Dropped before it reached the device
+			sched->waiting[cls]--;
+			stats->expired++;
+			osCondBroadcast(&sched->cond);
+			osMutexUnlock(&sched->lock);
+			return LINK_ERR_TIMEOUT;
+		}
+	}
+	sched->waiting[cls]--;
+	sched->fBusy = 1;
+	osMutexUnlock(&sched->lock);
+
+	//Only the holder updates the statistics, but schedStats() reads them
+	t = schedNow(sched) - t;
+	osMutexLock(&sched->lock);
+	stats->grants++;
+	stats->waitNs += t;
+	if(t > stats->maxWaitNs){
+		stats->maxWaitNs = t;
+	}
+	osMutexUnlock(&sched->lock);
+	return 0;
+}
+
+/**
+* Gives the device up after schedAcquire().
+*/
+void schedRelease(DspiSched* sched){
+	osMutexLock(&sched->lock);
+	sched->fBusy = 0;
+	osCondBroadcast(&sched->cond);
+	osMutexUnlock(&sched->lock);
+}
+
+/**
+* Steps aside if a higher class is waiting: releases the device and takes
+* it back once the higher classes are done. Called by the holder between
+* two segments of an operation, where no response is outstanding.
+*
+* @param cls priority class the device was acquired with
+*
+* @return 0 if the caller holds the device, LINK_ERR_TIMEOUT if its deadline
+*         passed while it stepped aside and it does not
+*
+*/
+int schedYield(DspiSched* sched, SchedClass cls){
+	int fYield;
+
+	osMutexLock(&sched->lock);
+	if((fYield = schedHigherWaiting(sched, cls)) != 0){
+		sched->stats[cls].yields++;
+	}
+	osMutexUnlock(&sched->lock);
+	if(fYield){
+		schedRelease(sched);
+		return schedAcquire(sched, cls);
+	}
+	return 0;
+}
+
+/**
+* Writes a register, see devWrite().
+*
+* @param cls priority class of the write
+*
+*/
+int schedWrite(DspiSched* sched, SchedClass cls, uint16_t addr, uint32_t value){
+	int result;
+
+	if((result = schedAcquire(sched, cls)) != 0){
+		return result;
+	}
+	result = devWrite(sched->dev, addr, value);
+	schedRelease(sched);
+	return result;
+}
+
+/**
+* Reads registers back to back, see devRead().
+*
+* @param cls priority class of the reads
+*
+*/
+int schedRead(DspiSched* sched, SchedClass cls, const uint16_t* addrs, uint32_t* vals, int count){
+	int result;
+
+	if((result = schedAcquire(sched, cls)) != 0){
+		return result;
+	}
+	result = devRead(sched->dev, addrs, vals, count);
+	schedRelease(sched);
+	return result;
+}
+
+/**
+* Writes a block of consecutive registers segWords at a time, stepping
+* aside for higher classes between segments. See devBulkWrite().
+*
+* @param cls priority class of the transfer, usually SCHED_BULK
+* @param status receives the device status of the first rejected segment.
+*        May be NULL.
+*
+*/
+int schedBulkWrite(DspiSched* sched, SchedClass cls, uint16_t addr, const uint32_t* values, uint32_t count, uint8_t encoding, uint8_t* status){
+	uint32_t n;
+	int result = -1;
+
+	if(status != NULL){
+		*status = STATUS_NO_REPLY;
+	}
+	if(count == 0){
+		return -1;
+	}
+	if((result = schedAcquire(sched, cls)) != 0){
+		return result;
+	}
+	while(count != 0){
+		n = count < sched->segWords ? count : sched->segWords;
+		if((result = devBulkWrite(sched->dev, addr, values, n, encoding, status)) != 0){
+			break;
+		}
+		addr += n;
+		values += n;
+		count -= n;
+		if(count != 0 && (result = schedYield(sched, cls)) != 0){
+			return result;
+		}
+	}
+	schedRelease(sched);
+	return result;
+}
+
+/**
+* Reads part of a finished capture trace segBytes at a time, stepping aside
+* for higher classes between segments. See devCaptureRead(); cb may exceed
+* a single read.
+*
+* @param cls priority class of the transfer, usually SCHED_BULK
+*
+*/
+int schedCaptureRead(DspiSched* sched, SchedClass cls, uint8_t encoding, uint32_t offset, uint8_t* buf, uint32_t cb, uint8_t* status){
+	uint32_t n;
+	int result = -1;
+
+	if(status != NULL){
+		*status = STATUS_NO_REPLY;
+	}
+	if(cb == 0){
+		return -1;
+	}
+	if((result = schedAcquire(sched, cls)) != 0){
+		return result;
+	}
+	while(cb != 0){
+		n = cb < sched->segBytes ? cb : sched->segBytes;
+		if((result = devCaptureRead(sched->dev, encoding, offset, buf, n, status)) != 0){
+			break;
+		}
+		offset += n;
+		buf += n;
+		cb -= n;
+		if(cb != 0 && (result = schedYield(sched, cls)) != 0){
+			return result;
+		}
+	}
+	schedRelease(sched);
+	return result;
+}
+
+/**
+* Copies the statistics of every class.
+*
+* @param stats receives SCHED_N_CLASSES entries, indexed by class
+*
+*/
+void schedStats(DspiSched* sched, SchedStats* stats){
+	osMutexLock(&sched->lock);
+	memcpy(stats, sched->stats, sizeof(sched->stats));
+	osMutexUnlock(&sched->lock);
+}
+
+const char* schedClassName(SchedClass cls){
+	switch(cls){
+		case SCHED_CONTROL:
+			return "control";
+		case SCHED_NORMAL:
+			return "normal";
+		case SCHED_BULK:
+			return "bulk";
+		default:
+			return "?";
+	}
+}
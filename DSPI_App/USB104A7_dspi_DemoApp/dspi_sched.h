@@ -0,0 +1,83 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_sched.h  --  Priority classes for threads sharing a device   */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    The device lock is granted in no particular order, so a thread    */
+/*    streaming a large block holds up a register write for the whole   */
+/*    block. DspiSched hands the device out by priority class instead:  */
+/*    a waiting SCHED_CONTROL operation goes before any waiting         */
+/*    SCHED_NORMAL one, and those before SCHED_BULK.                    */
+/*                                                                      */
+/*    Bulk writes and capture reads are split into segments of          */
+/*    segWords registers or segBytes bytes. Between segments the        */
+/*    operation gives the device up if a higher class is waiting, so    */
+/*    that one waits for at most a segment. Every segment collects its  */
+/*    own status, which costs a flush frame per segment.                */
+/*                                                                      */
+/*    Other commands are run between schedAcquire() and                 */
+/*    schedRelease(). Every class records how long its operations       */
+/*    waited for the device. A class that always has work waiting       */
+/*    starves the classes below it.                                     */
+/*                                                                      */
+/*    A request still waiting for the device at the calling thread's    */
+/*    devSetDeadline() deadline is dropped with LINK_ERR_TIMEOUT.       */
+/*    Functions return that, or what the dspi_dev.h call they wrap      */
+/*    returns.                                                          */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_SCHED_INCLUDED)
+#define      DSPI_SCHED_INCLUDED
+
+#include <stdint.h>
+
+#include "host_os.h"
+#include "dspi_dev.h"
+
+#define SCHED_SEG_WORDS 256	//two raw payloads
+#define SCHED_SEG_BYTES 1024
+
+typedef enum {
+	SCHED_CONTROL,	//interactive register commands
+	SCHED_NORMAL,
+	SCHED_BULK,	//block transfers
+	SCHED_N_CLASSES
+} SchedClass;
+
+typedef struct {
+	uint64_t grants;	//operations and segments that got the device
+	uint64_t waitNs;	//time they waited for it
+	uint64_t maxWaitNs;
+	uint64_t yields;	//times a segmented operation stepped aside
+	uint64_t expired;	//requests dropped at their deadline
+} SchedStats;
+
+typedef struct {
+	DspiDev* dev;
+	uint32_t segWords;	//registers per bulk write segment
+	uint32_t segBytes;	//bytes per capture read segment
+	OsMutex lock;
+	OsCond cond;
+	int fBusy;
+	int waiting[SCHED_N_CLASSES];
+	SchedStats stats[SCHED_N_CLASSES];
+} DspiSched;
+
+void schedInit(DspiSched* sched, DspiDev* dev);
+void schedDestroy(DspiSched* sched);
+int schedAcquire(DspiSched* sched, SchedClass cls);
+void schedRelease(DspiSched* sched);
+int schedYield(DspiSched* sched, SchedClass cls);
+
+int schedWrite(DspiSched* sched, SchedClass cls, uint16_t addr, uint32_t value);
+int schedRead(DspiSched* sched, SchedClass cls, const uint16_t* addrs, uint32_t* vals, int count);
+int schedBulkWrite(DspiSched* sched, SchedClass cls, uint16_t addr, const uint32_t* values, uint32_t count, uint8_t encoding, uint8_t* status);
+int schedCaptureRead(DspiSched* sched, SchedClass cls, uint8_t encoding, uint32_t offset, uint8_t* buf, uint32_t cb, uint8_t* status);
+
+void schedStats(DspiSched* sched, SchedStats* stats);
+const char* schedClassName(SchedClass cls);
+
+#endif
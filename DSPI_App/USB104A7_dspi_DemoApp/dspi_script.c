@@ -0,0 +1,240 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_script.c  --  Assembler for device register scripts          */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Single pass, branch targets to labels not yet seen are patched    */
+/*    once the whole text is read.                                      */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "dspi_script.h"
+#include "dspi_dev.h"
+
+#define SCRIPT_MAX_LABELS 64
+#define SCRIPT_MAX_FIXUPS 128
+#define SCRIPT_LABEL_LEN 32
+
+typedef struct {
+	char name[SCRIPT_LABEL_LEN];
+	uint16_t offset;
+} ScriptLabel;
+
+typedef struct {
+	char name[SCRIPT_LABEL_LEN];
+	uint32_t at;	//offset of the 16-bit target in the code
+	int line;
+} ScriptFixup;
+
+typedef struct {
+	const char* mnemonic;
+	uint8_t op;
+	const char* operands;	//r = register, v = 32-bit value, l = label
+} ScriptInsn;
+
+static const ScriptInsn scriptInsns[] = {
+	{"end", SC_END, ""},
+	{"write", SC_WRITE, "rv"},
+	{"set", SC_SET, "rv"},
+	{"clear", SC_CLEAR, "rv"},
+	{"toggle", SC_TOGGLE, "rv"},
+	{"delay", SC_DELAY, "v"},
+	{"wait", SC_WAIT, "rvvv"},
+	{"load", SC_LOAD, "r"},
+	{"beq", SC_BEQ, "vvl"},
+	{"bne", SC_BNE, "vvl"},
+	{"jump", SC_JUMP, "l"}
+};
+
+#define SCRIPT_N_INSNS (int)(sizeof(scriptInsns) / sizeof(scriptInsns[0]))
+
+/**
+* Parses a register name or number.
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+static int scriptParseReg(const char* arg, uint16_t* addr){
+	const RegNamed* named;
+	unsigned long val;
+	char* end;
+
+	if((named = regFind(arg)) != NULL){
+		*addr = named->addr;
+		return 0;
+	}
+	val = strtoul(arg, &end, 0);
+	if(end == arg || *end != '\0' || val > 0xFFFF){
+		return -1;
+	}
+	*addr = (uint16_t)val;
+	return 0;
+}
+
+/**
+* Parses a decimal or hex value.
+*
+* @return 0 if passed, -1 if failed
+*
+*/
+static int scriptParseValue(const char* arg, uint32_t* val){
+	unsigned long long v;
+	char* end;
+
+	v = strtoull(arg, &end, 0);
+	if(end == arg || *end != '\0' || v > 0xFFFFFFFF){
+		return -1;
+	}
+	*val = (uint32_t)v;
+	return 0;
+}
+
+/**
+* Assembles a script.
+*
+* @param fp script text
+* @param name file name for error messages
+* @param code receives the bytecode
+* @param cbMax size of code, at most SCRIPT_SIZE is used
+* @param cb receives the size of the bytecode
+*
+* @return 0 if passed, -1 if the script has errors. Errors are printed.
+*
+*/
+int scriptAssemble(FILE* fp, const char* name, uint8_t* code, uint32_t cbMax, uint32_t* cb){
+	static ScriptLabel labels[SCRIPT_MAX_LABELS];
+	static ScriptFixup fixups[SCRIPT_MAX_FIXUPS];
+	const ScriptInsn* insn;
+	char text[256];
+	char* tok[8];
+	char* p;
+	int nLabels = 0;
+	int nFixups = 0;
+	int nTok;
+	int line = 0;
+	int errors = 0;
+	uint32_t at = 0;
+	uint32_t size;
+	uint32_t val = 0;
+	uint16_t addr = 0;
+	const char* o;
+	int i, j;
+
+	if(cbMax > SCRIPT_SIZE){
+		cbMax = SCRIPT_SIZE;
+	}
+	while(fgets(text, sizeof(text), fp) != NULL){
+		line++;
+		if((p = strchr(text, ';')) != NULL){
+			*p = '\0';
+		}
+		for(nTok = 0, p = strtok(text, " \t\r\n,"); p != NULL && nTok < 8; p = strtok(NULL, " \t\r\n,")){
+			tok[nTok++] = p;
+		}
+		if(nTok == 0){
+			continue;
+		}
+
+		//label:
+		p = tok[0] + strlen(tok[0]) - 1;
+		if(*p == ':'){
+			*p = '\0';
+			for(i = 0; i < nLabels && strcmp(labels[i].name, tok[0]) != 0; i++);
+			if(i < nLabels){
+				fprintf(stderr, "%s:%d: label %s defined twice\n", name, line, tok[0]);
+				errors++;
+			}else if(nLabels == SCRIPT_MAX_LABELS || strlen(tok[0]) >= SCRIPT_LABEL_LEN || tok[0][0] == '\0'){
+				fprintf(stderr, "%s:%d: bad or too many labels\n", name, line);
+				errors++;
+			}else{
+				strcpy(labels[nLabels].name, tok[0]);
+				labels[nLabels++].offset = (uint16_t)at;
+			}
+			if(nTok == 1){
+				continue;
+			}
+			memmove(tok, tok + 1, --nTok * sizeof(tok[0]));
+		}
+
+		for(p = tok[0]; *p != '\0'; p++){
+			*p = (char)tolower((unsigned char)*p);
+		}
+		for(i = 0; i < SCRIPT_N_INSNS && strcmp(tok[0], scriptInsns[i].mnemonic) != 0; i++);
+		if(i == SCRIPT_N_INSNS){
+			fprintf(stderr, "%s:%d: unknown instruction %s\n", name, line, tok[0]);
+			errors++;
+			continue;
+		}
+		insn = &scriptInsns[i];
+		if(nTok - 1 != (int)strlen(insn->operands)){
+			fprintf(stderr, "%s:%d: %s takes %d operands\n", name, line, insn->mnemonic, (int)strlen(insn->operands));
+			errors++;
+			continue;
+		}
+		size = 1;
+		for(o = insn->operands; *o != '\0'; o++){
+			size += *o == 'v' ? 4 : 2;
+		}
+		if(at + size > cbMax){
+			fprintf(stderr, "%s:%d: script is larger than %u bytes\n", name, line, (unsigned)cbMax);
+			return -1;
+		}
+
+		code[at] = insn->op;
+		for(j = 1, o = insn->operands, size = 1; *o != '\0'; j++, o++){
+			if(*o == 'r'){
+				if(scriptParseReg(tok[j], &addr) != 0){
+					fprintf(stderr, "%s:%d: unknown register %s\n", name, line, tok[j]);
+					errors++;
+				}
+				putBE16(code + at + size, addr);
+				size += 2;
+			}
+			else if(*o == 'v'){
+				if(scriptParseValue(tok[j], &val) != 0){
+					fprintf(stderr, "%s:%d: bad value %s\n", name, line, tok[j]);
+					errors++;
+				}
+				putBE32(code + at + size, val);
+				size += 4;
+			}
+			else{
+				if(nFixups == SCRIPT_MAX_FIXUPS || strlen(tok[j]) >= SCRIPT_LABEL_LEN){
+					fprintf(stderr, "%s:%d: bad or too many branches\n", name, line);
+					errors++;
+				}else{
+					strcpy(fixups[nFixups].name, tok[j]);
+					fixups[nFixups].at = at + size;
+					fixups[nFixups++].line = line;
+				}
+				size += 2;
+			}
+		}
+		at += size;
+	}
+
+	for(i = 0; i < nFixups; i++){
+		for(j = 0; j < nLabels && strcmp(labels[j].name, fixups[i].name) != 0; j++);
+		if(j == nLabels){
+			fprintf(stderr, "%s:%d: undefined label %s\n", name, fixups[i].line, fixups[i].name);
+			errors++;
+			continue;
+		}
+		putBE16(code + fixups[i].at, labels[j].offset);
+	}
+	//Running off the end, or branching to a label after the last line, ends the script
+	if(at + 1 > cbMax){
+		fprintf(stderr, "%s: script is larger than %u bytes\n", name, (unsigned)cbMax);
+		return -1;
+	}
+	code[at++] = SC_END;
+	*cb = at;
+	return errors == 0 ? 0 : -1;
+}
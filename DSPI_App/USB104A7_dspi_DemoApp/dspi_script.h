@@ -0,0 +1,32 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_script.h  --  Assembler for device register scripts          */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Translates script text into the SC_* bytecode the firmware runs.  */
+/*    One instruction per line, ';' starts a comment:                   */
+/*        label:                                                        */
+/*        write <reg> <value>                                           */
+/*        set|clear|toggle <reg> <mask>                                 */
+/*        delay <us>                                                    */
+/*        wait <reg> <mask> <value> <timeout us>                        */
+/*        load <reg>                                                    */
+/*        beq|bne <mask> <value> <label>                                */
+/*        jump <label>                                                  */
+/*        end                                                           */
+/*    Registers are numbers or names from regmap.def, values are       */
+/*    decimal or 0x hex. A script that falls off its last line ends.    */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_SCRIPT_INCLUDED)
+#define      DSPI_SCRIPT_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+
+int scriptAssemble(FILE* fp, const char* name, uint8_t* code, uint32_t cbMax, uint32_t* cb);
+
+#endif
@@ -0,0 +1,393 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_snap.c  --  Snapshot and restore of the device registers     */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dspi_snap.h"
+#include "dspi_codec.h"
+
+#define SNAP_HEADER_SIZE 12	//magic, version, regions, generation
+#define SNAP_REGION_SIZE 5	//base, count, width
+#define SNAP_BLOCK_HEADER 4	//words, packed bytes
+#define SNAP_HOOK_OPS 16	//registers with hooks restored per devRegBatch()
+
+/**
+* Finds where the values of a region start in DspiSnap.vals.
+*/
+static uint32_t snapOffset(int region){
+	uint32_t off = 0;
+	int i;
+
+	for(i = 0; i < region; i++){
+		off += regRegions[i].count;
+	}
+	return off;
+}
+
+/**
+* Adds bytes to a CRC-32, the reflected 0xEDB88320 one of zip and
+* Ethernet. Start with 0.
+*/
+static uint32_t snapCrc(uint32_t crc, const uint8_t* p, uint32_t cb){
+	int i;
+
+	crc = ~crc;
+	while(cb-- != 0){
+		crc ^= *p++;
+		for(i = 0; i < 8; i++){
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+static int snapPut(FILE* fp, const uint8_t* p, uint32_t cb, uint32_t* crc){
+	*crc = snapCrc(*crc, p, cb);
+	return fwrite(p, 1, cb, fp) == cb ? 0 : -1;
+}
+
+static int snapGet(FILE* fp, uint8_t* p, uint32_t cb, uint32_t* crc){
+	if(fread(p, 1, cb, fp) != cb){
+		return -1;
+	}
+	*crc = snapCrc(*crc, p, cb);
+	return 0;
+}
+
+/**
+* Tells whether restoring a register puts back state: it is mapped, takes
+* writes, and a write does not start an action like cap_ctl and script do.
+*/
+int snapWritable(uint16_t addr){
+	int attrs = regAttrs(addr);
+
+	return attrs >= 0 && !(attrs & (REG_ATTR_READONLY | REG_ATTR_COMMAND));
+}
+
+/**
+* Tells whether a register goes back with the bulk writes. One whose writes
+* drive hardware, like led, is written through its hook on its own.
+*/
+static int snapPlain(uint16_t addr){
+	return snapWritable(addr) && !(regAttrs(addr) & REG_ATTR_WRITE_EFFECT);
+}
+
+/**
+* Writes registers with hooks, one frame each.
+*
+* @param status receives the status of the first rejected write. May be NULL.
+*
+* @return see devRegBatch()
+*
+*/
+static int snapWriteHooked(DspiDev* dev, RegOp* ops, int count, uint8_t* status){
+	int result;
+	int i;
+
+	if(count == 0){
+		return 0;
+	}
+	if((result = devRegBatch(dev, ops, count)) < 0 && status != NULL){
+		for(i = 0; i < count && ops[i].status == STATUS_OK; i++);
+		*status = i < count ? ops[i].status : STATUS_NO_REPLY;
+	}
+	return result;
+}
+
+/**
+* Counts the registers a snapshot holds.
+*/
+uint32_t snapRegisters(const DspiSnap* snap){
+	uint32_t n = 0;
+	int i;
+
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		if(snap->fRegion[i]){
+			n += regRegions[i].count;
+		}
+	}
+	return n;
+}
+
+/**
+* Reads the register file of the device into a snapshot, a delta read of
+* DELTA_MAX_REGS registers at a time.
+*
+* @param snap receives the snapshot
+* @param flags SNAP_DDR to include the regions in DDR
+* @param status receives the device status of a rejected read. May be NULL.
+*
+* @return 0 if passed, -1 if rejected or out of sequence, transport error code if failed
+*
+*/
+int snapTake(DspiDev* dev, DspiSnap* snap, int flags, uint8_t* status){
+	uint32_t off, i, n, gen;
+	int result = 0;
+	int r;
+
+	memset(snap, 0, sizeof(DspiSnap));
+	if(status != NULL){
+		*status = STATUS_OK;
+	}
+	for(r = 0; r < REGMAP_N_REGIONS && result == 0; r++){
+		if(!regRegions[r].fabric && !(flags & SNAP_DDR)){
+			continue;
+		}
+		off = snapOffset(r);
+		for(i = 0; i < regRegions[r].count && result == 0; i += n){
+			n = regRegions[r].count - i < DELTA_MAX_REGS ? regRegions[r].count - i : DELTA_MAX_REGS;
+			gen = 0;//Everything, not what changed
+			result = devDeltaRead(dev, regRegions[r].base + i, n, &gen, snap->vals + off + i, NULL, status);
+			if(gen > snap->gen){
+				snap->gen = gen;
+			}
+		}
+		snap->fRegion[r] = result == 0;
+	}
+	return result;
+}
+
+/**
+* Writes a snapshot back to the device, a bulk write for every run of
+* plain registers, then the registers whose writes drive hardware one at a
+* time through their hooks, then reads the regions back and compares every
+* register snapWritable() passes.
+*
+* @param snap snapshot to restore
+* @param cWritten receives the number of registers written. May be NULL.
+* @param cMismatch receives the number of registers that read back
+*        different. May be NULL.
+* @param firstBad receives the first of them. May be NULL.
+* @param status receives the device status of the first rejected write or
+*        read. May be NULL.
+*
+* @return 0 if passed, -1 if rejected, out of sequence or a register read
+*         back different, transport error code if failed
+*
+*/
+int snapRestore(DspiDev* dev, const DspiSnap* snap, uint32_t* cWritten, uint32_t* cMismatch, uint16_t* firstBad, uint8_t* status){
+	uint32_t fresh[DELTA_MAX_REGS];
+	RegOp ops[SNAP_HOOK_OPS];
+	int cOps = 0;
+	uint32_t off, i, j, n, gen;
+	uint32_t written = 0;
+	uint32_t mismatch = 0;
+	uint16_t base;
+	int result = 0;
+	int r;
+
+	if(status != NULL){
+		*status = STATUS_OK;
+	}
+	for(r = 0; r < REGMAP_N_REGIONS && result == 0; r++){
+		if(!snap->fRegion[r]){
+			continue;
+		}
+		base = regRegions[r].base;
+		off = snapOffset(r);
+		for(i = 0; i < regRegions[r].count && result == 0; i += n){
+			for(n = 0; i + n < regRegions[r].count && snapPlain(base + i + n); n++);
+			if(n == 0){
+				n = 1;//Left as it is
+				continue;
+			}
+			result = devBulkWrite(dev, base + i, snap->vals + off + i, n, ENC_DZV, status);
+			written += n;
+		}
+	}
+
+	//Then the hardware, once the state it may depend on is back
+	for(r = 0; r < REGMAP_N_REGIONS && result == 0; r++){
+		if(!snap->fRegion[r]){
+			continue;
+		}
+		base = regRegions[r].base;
+		off = snapOffset(r);
+		for(i = 0; i < regRegions[r].count && result == 0; i++){
+			if(!snapWritable(base + i) || snapPlain(base + i)){
+				continue;
+			}
+			ops[cOps].op = op_write;
+			ops[cOps].addr = base + i;
+			ops[cOps].value = snap->vals[off + i];
+			if(++cOps == SNAP_HOOK_OPS){
+				result = snapWriteHooked(dev, ops, cOps, status);
+				written += cOps;
+				cOps = 0;
+			}
+		}
+	}
+	if(result == 0){
+		result = snapWriteHooked(dev, ops, cOps, status);
+		written += cOps;
+	}
+
+	//Verify what was written
+	for(r = 0; r < REGMAP_N_REGIONS && result == 0; r++){
+		if(!snap->fRegion[r]){
+			continue;
+		}
+		base = regRegions[r].base;
+		off = snapOffset(r);
+		for(i = 0; i < regRegions[r].count && result == 0; i += n){
+			n = regRegions[r].count - i < DELTA_MAX_REGS ? regRegions[r].count - i : DELTA_MAX_REGS;
+			gen = 0;
+			if((result = devDeltaRead(dev, base + i, n, &gen, fresh, NULL, status)) != 0){
+				break;
+			}
+			for(j = 0; j < n; j++){
+				if(fresh[j] != snap->vals[off + i + j] && snapWritable(base + i + j)){
+					if(mismatch++ == 0 && firstBad != NULL){
+						*firstBad = base + i + j;
+					}
+				}
+			}
+		}
+	}
+
+	if(cWritten != NULL){
+		*cWritten = written;
+	}
+	if(cMismatch != NULL){
+		*cMismatch = mismatch;
+	}
+	if(result == 0 && mismatch != 0){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Writes a snapshot to a file, see dspi_snap.h.
+*
+* @param path file to create or replace
+*
+*/
+int snapSave(const DspiSnap* snap, const char* path){
+	uint8_t buf[SNAP_BLOCK_SIZE];
+	uint32_t crc = 0;
+	uint32_t off, i, n, cb;
+	int regions = 0;
+	int result = 0;
+	int r;
+	FILE* fp;
+
+	if((fp = fopen(path, "wb")) == NULL){
+		return -1;
+	}
+	for(r = 0; r < REGMAP_N_REGIONS; r++){
+		regions += snap->fRegion[r] != 0;
+	}
+	putBE32(buf, SNAP_MAGIC);
+	putBE16(buf + 4, SNAP_VERSION);
+	putBE16(buf + 6, (uint16_t)regions);
+	putBE32(buf + 8, snap->gen);
+	result = snapPut(fp, buf, SNAP_HEADER_SIZE, &crc);
+
+	for(r = 0; r < REGMAP_N_REGIONS && result == 0; r++){
+		if(!snap->fRegion[r]){
+			continue;
+		}
+		putBE16(buf, regRegions[r].base);
+		putBE16(buf + 2, regRegions[r].count);
+		buf[4] = regRegions[r].width;
+		result = snapPut(fp, buf, SNAP_REGION_SIZE, &crc);
+		off = snapOffset(r);
+		for(i = 0; i < regRegions[r].count && result == 0; i += n){
+			n = dzvEncode(snap->vals + off + i, regRegions[r].count - i, 1,
+				buf + SNAP_BLOCK_HEADER, SNAP_BLOCK_SIZE - SNAP_BLOCK_HEADER, &cb);
+			putBE16(buf, (uint16_t)n);
+			putBE16(buf + 2, (uint16_t)cb);
+			result = snapPut(fp, buf, SNAP_BLOCK_HEADER + cb, &crc);
+		}
+	}
+	if(result == 0){
+		putBE32(buf, crc);
+		result = fwrite(buf, 1, 4, fp) == 4 ? 0 : -1;
+	}
+	if(fclose(fp) != 0){
+		result = -1;
+	}
+	return result;
+}
+
+/**
+* Reads a snapshot from a file written by snapSave(). It is rejected if it
+* is damaged or its regions do not match regmap.def.
+*
+* @param snap receives the snapshot, empty if the file is rejected
+* @param path file to read
+*
+*/
+int snapLoad(DspiSnap* snap, const char* path){
+	uint8_t buf[SNAP_BLOCK_SIZE];
+	uint32_t crc = 0;
+	uint32_t off, i, j, n, cb;
+	uint16_t base, count;
+	int regions;
+	int result;
+	int r;
+	FILE* fp;
+
+	memset(snap, 0, sizeof(DspiSnap));
+	if((fp = fopen(path, "rb")) == NULL){
+		return -1;
+	}
+	result = snapGet(fp, buf, SNAP_HEADER_SIZE, &crc);
+	if(result == 0 && (getBE32(buf) != SNAP_MAGIC || getBE16(buf + 4) != SNAP_VERSION)){
+		result = -1;
+	}
+	regions = getBE16(buf + 6);
+	snap->gen = getBE32(buf + 8);
+
+	while(result == 0 && regions-- > 0){
+		if((result = snapGet(fp, buf, SNAP_REGION_SIZE, &crc)) != 0){
+			break;
+		}
+		base = getBE16(buf);
+		count = getBE16(buf + 2);
+		for(r = 0; r < REGMAP_N_REGIONS; r++){
+			if(regRegions[r].base == base && regRegions[r].count == count && regRegions[r].width == buf[4]){
+				break;
+			}
+		}
+		if(r == REGMAP_N_REGIONS || snap->fRegion[r]){
+			result = -1;
+			break;
+		}
+		snap->fRegion[r] = 1;
+		off = snapOffset(r);
+		for(i = 0; i < count && result == 0; i += n){
+			if((result = snapGet(fp, buf, SNAP_BLOCK_HEADER, &crc)) != 0){
+				break;
+			}
+			n = getBE16(buf);
+			cb = getBE16(buf + 2);
+			if(n == 0 || n > count - i || cb > SNAP_BLOCK_SIZE
+				|| snapGet(fp, buf, cb, &crc) != 0
+				|| dzvDecode(buf, cb, snap->vals + off + i, n, 1) != 0){
+				result = -1;
+				break;
+			}
+			//Values have to fit the registers they go back to
+			for(j = i; j < i + n && regRegions[r].width < 4; j++){
+				if(snap->vals[off + j] >> (8 * regRegions[r].width) != 0){
+					result = -1;
+				}
+			}
+		}
+	}
+	if(result == 0 && (fread(buf, 1, 4, fp) != 4 || getBE32(buf) != crc || fgetc(fp) != EOF)){
+		result = -1;
+	}
+	fclose(fp);
+	if(result != 0){
+		memset(snap, 0, sizeof(DspiSnap));
+	}
+	return result;
+}
@@ -0,0 +1,57 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_snap.h  --  Snapshot and restore of the device registers     */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    After a reconnect or a firmware reset the device state has to be  */
+/*    put back. Replaying every write as a frame of its own costs a     */
+/*    settle per register; a DspiSnap holds the register file instead   */
+/*    and puts it back with a bulk write per run of registers.          */
+/*                                                                      */
+/*    snapTake() reads the fabric regions, and the DDR regions with     */
+/*    SNAP_DDR, DELTA_MAX_REGS registers per op_delta_read.             */
+/*    snapRestore() writes back every register that holds state and     */
+/*    reads the regions again to verify them: plain runs with bulk      */
+/*    writes, then registers that drive hardware, like led, one frame   */
+/*    each through their hooks. Read only registers and commands, like  */
+/*    cap_ctl and script, are neither written nor verified. Registers   */
+/*    written while a snapshot is taken may be caught either way.       */
+/*                                                                      */
+/*    snapSave() and snapLoad() keep a snapshot in a file: a header,    */
+/*    each region as DZV packed blocks and a CRC-32 of all of it, all   */
+/*    big endian. A file only loads if its regions match regmap.def.    */
+/*                                                                      */
+/*    Device functions return what the dspi_dev.h calls return, file    */
+/*    functions 0 on success or -1.                                     */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_SNAP_INCLUDED)
+#define      DSPI_SNAP_INCLUDED
+
+#include <stdint.h>
+
+#include "dspi_dev.h"
+
+#define SNAP_MAGIC 0x44534E50	//"DSNP"
+#define SNAP_VERSION 1
+#define SNAP_BLOCK_SIZE 4096	//largest packed block in a file
+
+#define SNAP_DDR 0x01	//snapTake() also reads the regions in DDR
+
+typedef struct {
+	uint8_t fRegion[REGMAP_N_REGIONS];	//1 for each region the snapshot holds
+	uint32_t gen;	//device generation when taken, 0 if not reported
+	uint32_t vals[REGMAP_N_REGS];	//registers of all regions, in regmap.def order
+} DspiSnap;
+
+int snapTake(DspiDev* dev, DspiSnap* snap, int flags, uint8_t* status);
+int snapRestore(DspiDev* dev, const DspiSnap* snap, uint32_t* cWritten, uint32_t* cMismatch, uint16_t* firstBad, uint8_t* status);
+int snapSave(const DspiSnap* snap, const char* path);
+int snapLoad(DspiSnap* snap, const char* path);
+int snapWritable(uint16_t addr);
+uint32_t snapRegisters(const DspiSnap* snap);
+
+#endif
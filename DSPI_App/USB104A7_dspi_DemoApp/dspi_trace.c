@@ -0,0 +1,367 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_trace.c  --  Timeline trace of the host and the firmware     */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dspi_trace.h"
+#include "dspi_log.h"
+
+#define TRACE_PID_HOST 1
+#define TRACE_PID_DEVICE 2
+#define TRACE_SLACK 16	//device events the frames of a read add before the copy
+
+typedef struct {
+	volatile uint32_t head;	//written by the thread
+	volatile uint32_t tail;	//written by the exporter
+	volatile uint32_t dropped;	//events that found the ring full
+	const char* name;
+	TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+volatile int traceEnabled;
+
+static TraceRing rings[TRACE_MAX_THREADS];
+static volatile uint32_t cRings;	//rings claimed, more than there are once they ran out
+static volatile uint32_t cUnringed;	//events of threads that got no ring
+static OS_THREAD_LOCAL TraceRing* threadRing;
+static OS_THREAD_LOCAL int fNoRing;
+
+//Device events by TRACE_EV_KIND()
+static const char* const deviceEvents[] = {
+	"event", "irq", "frame", "payload", "print", "capture"
+};
+
+/**
+* Finds the calling thread's ring, claiming one on first use.
+*
+* @return ring, NULL once all are taken
+*/
+static TraceRing* traceRing(){
+	uint32_t slot;
+
+	if(threadRing == NULL && !fNoRing){
+		slot = osAtomicAdd(&cRings, 1);
+		if(slot < TRACE_MAX_THREADS){
+			threadRing = &rings[slot];
+		}else{
+			fNoRing = 1;
+		}
+	}
+	return threadRing;
+}
+
+static uint32_t traceRings(){
+	uint32_t n = osAtomicLoad(&cRings);
+
+	return n < TRACE_MAX_THREADS ? n : TRACE_MAX_THREADS;
+}
+
+/**
+* Adds an event to the calling thread's ring. Called through the trace
+* points in dspi_trace.h.
+*
+* @param name event name, a string that outlives the trace
+* @param startNs osNowNs() at the start
+* @param durNs length of a span, 0 for an instant
+* @param argName argument name, NULL for none
+* @param arg argument value
+*
+*/
+void traceRecord(const char* name, uint64_t startNs, uint64_t durNs, const char* argName, uint32_t arg){
+	TraceRing* ring = traceRing();
+	TraceEvent* e;
+	uint32_t head;
+
+	if(ring == NULL){
+		osAtomicAdd(&cUnringed, 1);
+		return;
+	}
+	head = ring->head;
+	if(head - osAtomicLoad(&ring->tail) >= TRACE_RING_EVENTS){
+		osAtomicStore(&ring->dropped, ring->dropped + 1);
+		return;
+	}
+	e = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+	e->ns = startNs;
+	e->durNs = durNs;
+	e->name = name;
+	e->argName = argName;
+	e->arg = arg;
+	osAtomicStore(&ring->head, head + 1);
+}
+
+/**
+* Names the calling thread's track in the trace.
+*
+* @param name a string that outlives the trace
+*
+*/
+void traceThreadName(const char* name){
+	TraceRing* ring = traceRing();
+
+	if(ring != NULL){
+		ring->name = name;
+	}
+}
+
+/**
+* Writes one trace event object.
+*/
+static void traceJson(TraceWriter* tw, const char* fmt, ...){
+	va_list args;
+
+	fputs(tw->fFirst ? "\n" : ",\n", tw->fp);
+	tw->fFirst = 0;
+	va_start(args, fmt);
+	vfprintf(tw->fp, fmt, args);
+	va_end(args);
+}
+
+/**
+* Formats the args object of an event.
+*/
+static const char* traceArgs(char* buf, size_t cb, const char* argName, uint32_t arg){
+	if(argName == NULL){
+		return "{}";
+	}
+	if(strcmp(argName, "op") == 0){
+		snprintf(buf, cb, "{\"op\":\"%s\"}", logOpName((uint8_t)arg));
+	}else{
+		snprintf(buf, cb, "{\"%s\":%lu}", argName, (unsigned long)arg);
+	}
+	return buf;
+}
+
+/**
+* Moves the events of every thread ring to the file.
+*/
+static void traceDrainHost(TraceWriter* tw){
+	char args[64];
+	const TraceEvent* e;
+	TraceRing* ring;
+	uint32_t head, tail, dropped;
+	uint32_t i;
+
+	dropped = osAtomicLoad(&cUnringed);
+	for(i = 0; i < traceRings(); i++){
+		ring = &rings[i];
+		head = osAtomicLoad(&ring->head);
+		for(tail = ring->tail; tail != head; tail++){
+			e = &ring->events[tail & (TRACE_RING_EVENTS - 1)];
+			if(e->durNs != 0){
+				traceJson(tw, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"args\":%s}",
+					e->name, TRACE_PID_HOST, (unsigned long)i + 1, (int64_t)(e->ns - tw->startNs) / 1e3, e->durNs / 1e3,
+					traceArgs(args, sizeof(args), e->argName, e->arg));
+			}else{
+				traceJson(tw, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%lu,\"ts\":%.3f,\"args\":%s}",
+					e->name, TRACE_PID_HOST, (unsigned long)i + 1, (int64_t)(e->ns - tw->startNs) / 1e3,
+					traceArgs(args, sizeof(args), e->argName, e->arg));
+			}
+		}
+		osAtomicStore(&ring->tail, tail);
+		dropped += osAtomicLoad(&ring->dropped);
+	}
+	if(dropped != tw->dropped){
+		traceJson(tw, "{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"args\":{\"events\":%lu}}",
+			TRACE_PID_HOST, (osNowNs() - tw->startNs) / 1e3, (unsigned long)(dropped - tw->dropped));
+		tw->dropped = dropped;
+	}
+}
+
+/**
+* Samples the device clock TRACE_SYNC_SAMPLES times and keeps the sample
+* with the shortest window.
+*
+* @param sync receives the sample
+*
+* @return see devTraceClock()
+*
+*/
+static int traceSync(TraceWriter* tw, TraceSync* sync){
+	uint64_t hostNs, windowNs;
+	uint64_t best = UINT64_MAX;
+	uint32_t ticks;
+	int result;
+	int i;
+
+	for(i = 0; i < TRACE_SYNC_SAMPLES; i++){
+		if((result = devTraceClock(tw->dev, &ticks, &hostNs, &windowNs)) != 0){
+			return result;
+		}
+		if(windowNs < best){
+			best = windowNs;
+			sync->hostNs = hostNs;
+			sync->ticks = ticks;
+		}
+	}
+	traceJson(tw, "{\"name\":\"clock_sync\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":1,\"ts\":%.3f,\"args\":{\"ticks\":%lu,\"window_ns\":%llu}}",
+		TRACE_PID_DEVICE, (int64_t)(sync->hostNs - tw->startNs) / 1e3, (unsigned long)sync->ticks, (unsigned long long)best);
+	return 0;
+}
+
+/**
+* Places a device clock reading on the host timeline, interpolated between
+* the last two samples. Readings within 21 s of the older one map right.
+*
+* @return osNowNs() time relative to startNs
+*/
+static double traceDeviceTime(const TraceWriter* tw, uint32_t ticks){
+	double nsPerTick = 1e9 / TRACE_TICK_HZ;
+	int32_t span = (int32_t)(tw->cur.ticks - tw->prev.ticks);
+
+	if(span > 0 && tw->cur.hostNs > tw->prev.hostNs){
+		nsPerTick = (double)(tw->cur.hostNs - tw->prev.hostNs) / span;
+	}
+	return (double)(int64_t)(tw->prev.hostNs - tw->startNs) + (int32_t)(ticks - tw->prev.ticks) * nsPerTick;
+}
+
+/**
+* Aligns the clocks again and moves the events the device recorded since
+* the last read to the file.
+*
+* @return see devTraceRead()
+*/
+static int traceDrainDevice(TraceWriter* tw){
+	uint8_t buf[TRACE_DEPTH * TRACE_EVENT_SIZE];
+	const uint8_t* p;
+	const char* name;
+	char ph;
+	uint64_t t = traceStart();
+	uint32_t count, n, i;
+	uint8_t event;
+	int result;
+
+	tw->prev = tw->cur;
+	if((result = traceSync(tw, &tw->cur)) != 0
+		|| (result = devTraceControl(tw->dev, TRACE_COUNT, 0, &count, NULL)) != 0){
+		return result;
+	}
+	if(count - tw->consumed > TRACE_DEPTH - TRACE_SLACK){
+		//Overwritten before they can be read, spans open across the gap stay open
+		n = count - tw->consumed - (TRACE_DEPTH - TRACE_SLACK);
+		tw->lost += n;
+		tw->consumed += n;
+		tw->depth = 0;
+		traceJson(tw, "{\"name\":\"lost\",\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,\"tid\":1,\"ts\":%.3f,\"args\":{\"events\":%lu}}",
+			TRACE_PID_DEVICE, (int64_t)(tw->cur.hostNs - tw->startNs) / 1e3, (unsigned long)n);
+	}
+	n = count - tw->consumed;
+	if(n == 0){
+		return 0;
+	}
+	if((result = devTraceRead(tw->dev, tw->consumed, buf, n, NULL)) != 0){
+		return result;
+	}
+	tw->consumed += n;
+
+	for(i = 0, p = buf; i < n; i++, p += TRACE_EVENT_SIZE){
+		event = p[4];
+		name = TRACE_EV_KIND(event) < sizeof(deviceEvents) / sizeof(deviceEvents[0]) ? deviceEvents[TRACE_EV_KIND(event)] : "event";
+		if(event & TRACE_EV_BEGIN){
+			ph = 'B';
+			tw->depth++;
+		}else if(event & TRACE_EV_END){
+			if(tw->depth == 0){
+				continue;//Began before the trace did
+			}
+			ph = 'E';
+			tw->depth--;
+		}else{
+			ph = 'i';
+		}
+		traceJson(tw, "{\"name\":\"%s\",\"ph\":\"%c\",%s\"pid\":%d,\"tid\":1,\"ts\":%.3f,\"args\":{\"op\":\"%s\",\"addr\":%u}}",
+			name, ph, ph == 'i' ? "\"s\":\"t\"," : "", TRACE_PID_DEVICE, traceDeviceTime(tw, getBE32(p)) / 1e3,
+			logOpName(p[5]), getBE16(p + 6));
+	}
+	traceComplete("trace_read", t, "events", n);
+	return 0;
+}
+
+/**
+* Starts a trace file and turns the trace points on.
+*
+* @param fp file to write, left open by traceClose()
+* @param dev device whose firmware events are merged in, NULL for none.
+*        Firmware without op_trace leaves the host events only.
+*
+* @return 0 if passed, -1 if the file could not be written
+*
+*/
+int traceOpen(TraceWriter* tw, FILE* fp, DspiDev* dev){
+	uint32_t count;
+	uint32_t i;
+
+	memset(tw, 0, sizeof(TraceWriter));
+	tw->fp = fp;
+	tw->fFirst = 1;
+	tw->startNs = osNowNs();
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", fp);
+	traceJson(tw, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"host\"}}", TRACE_PID_HOST);
+
+	//Left over from an earlier trace
+	for(i = 0; i < traceRings(); i++){
+		osAtomicStore(&rings[i].tail, osAtomicLoad(&rings[i].head));
+		tw->dropped += osAtomicLoad(&rings[i].dropped);
+	}
+	tw->dropped += osAtomicLoad(&cUnringed);
+	traceEnabled = 1;
+
+	if(dev != NULL && devServes(dev, op_trace) && devServes(dev, op_trace_read)){
+		tw->dev = dev;
+		if(devTraceControl(dev, TRACE_START, 1, &count, NULL) != 0 || traceSync(tw, &tw->cur) != 0){
+			tw->dev = NULL;
+		}else{
+			traceJson(tw, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"device\"}}", TRACE_PID_DEVICE);
+			traceJson(tw, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,\"args\":{\"name\":\"firmware\"}}", TRACE_PID_DEVICE);
+			tw->lastPollNs = osNowNs();
+		}
+	}
+	return ferror(fp) ? -1 : 0;
+}
+
+/**
+* Moves the recorded events to the file. Call it regularly from the thread
+* that opened the trace; device events are read every TRACE_POLL_MS.
+*/
+void tracePoll(TraceWriter* tw){
+	uint64_t now;
+
+	traceDrainHost(tw);
+	if(tw->dev != NULL && (now = osNowNs()) - tw->lastPollNs >= (uint64_t)TRACE_POLL_MS * 1000000){
+		tw->lastPollNs = now;
+		if(traceDrainDevice(tw) != 0){
+			tw->dev = NULL;//Keep the host side going
+		}
+	}
+	fflush(tw->fp);
+}
+
+/**
+* Reads the last events, stops the device trace, turns the trace points off
+* and completes the file.
+*/
+void traceClose(TraceWriter* tw){
+	uint32_t count;
+	uint32_t i;
+
+	if(tw->dev != NULL){
+		traceDrainDevice(tw);
+		devTraceControl(tw->dev, TRACE_START, 0, &count, NULL);
+	}
+	traceEnabled = 0;
+	traceDrainHost(tw);
+	for(i = 0; i < traceRings(); i++){
+		if(rings[i].name != NULL){
+			traceJson(tw, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+				TRACE_PID_HOST, (unsigned long)i + 1, rings[i].name);
+		}
+	}
+	fputs("\n]}\n", tw->fp);
+	fflush(tw->fp);
+}
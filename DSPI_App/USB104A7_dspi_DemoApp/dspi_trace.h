@@ -0,0 +1,123 @@
+/************************************************************************/
+/*                                                                      */
+/*    dspi_trace.h  --  Timeline trace of the host and the firmware     */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Trace points mark where time goes on the host: the wait for the   */
+/*    device lock, each frame and payload transfer and the settle       */
+/*    after it, the Adept calls, and the hand-off of a command from     */
+/*    the terminal thread. The firmware marks its side with op_trace:   */
+/*    the link interrupt, each forwarded frame and payload, UART output */
+/*    and finishing a capture, on its own clock.                        */
+/*                                                                      */
+/*    Every thread records into a ring of its own, so a trace point     */
+/*    takes no lock: the thread is the only writer of its ring's head,  */
+/*    the exporter the only writer of its tail. A full ring drops the   */
+/*    event and counts it. Rings are claimed on first use and never     */
+/*    released, at most TRACE_MAX_THREADS threads are traced. While     */
+/*    tracing is off a trace point is a load and a branch.              */
+/*                                                                      */
+/*    traceOpen() starts a Chrome trace event file, which Perfetto and  */
+/*    chrome://tracing load. tracePoll() moves the host events to it    */
+/*    and every TRACE_POLL_MS reads the device events too. Each device  */
+/*    read first aligns the clocks: the trace clock is sampled a few    */
+/*    times and the sample with the shortest round trip is taken to be  */
+/*    from the middle of it. Device events are placed on the host       */
+/*    timeline by interpolating between consecutive samples, which      */
+/*    also follows the drift of the two clocks. The trace clock wraps   */
+/*    every 42 s, so tracePoll() has to be called more often than that  */
+/*    while the device is traced.                                       */
+/*                                                                      */
+/*    Host events are on process 1 with a track per thread, device      */
+/*    events on process 2. Times are in microseconds since traceOpen(). */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_TRACE_INCLUDED)
+#define      DSPI_TRACE_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "host_os.h"
+#include "dspi_dev.h"
+
+#define TRACE_MAX_THREADS 32
+#define TRACE_RING_EVENTS 4096	//per thread, a power of 2
+#define TRACE_POLL_MS 500	//device events are read this often
+#define TRACE_SYNC_SAMPLES 3	//clock samples per alignment
+
+typedef struct {
+	uint64_t ns;	//osNowNs() at the start
+	uint64_t durNs;	//0 for an instant
+	const char* name;	//static string
+	const char* argName;	//static string, NULL for no argument
+	uint32_t arg;
+} TraceEvent;
+
+//Device clock sample, see traceSync()
+typedef struct {
+	uint64_t hostNs;
+	uint32_t ticks;
+} TraceSync;
+
+typedef struct {
+	FILE* fp;
+	DspiDev* dev;	//traced device, NULL for the host only
+	uint64_t startNs;	//event times are relative to this
+	int fFirst;	//no event written yet
+	uint32_t dropped;	//host events dropped, as last reported
+
+	//Device events
+	uint32_t consumed;	//events read since the start
+	uint32_t lost;	//events overwritten before they were read
+	int depth;	//open device spans
+	uint64_t lastPollNs;
+	TraceSync prev;
+	TraceSync cur;
+} TraceWriter;
+
+extern volatile int traceEnabled;
+
+void traceRecord(const char* name, uint64_t startNs, uint64_t durNs, const char* argName, uint32_t arg);
+void traceThreadName(const char* name);
+int traceOpen(TraceWriter* tw, FILE* fp, DspiDev* dev);
+void tracePoll(TraceWriter* tw);
+void traceClose(TraceWriter* tw);
+
+/**
+* Starts a span, see traceComplete().
+*
+* @return start time, 0 while tracing is off
+*/
+static inline uint64_t traceStart(){
+	return traceEnabled ? osNowNs() : 0;
+}
+
+/**
+* Records a span from traceStart() to now.
+*
+* @param name span name, a string that outlives the trace
+* @param startNs what traceStart() returned
+* @param argName argument name, NULL for none. "op" is shown by name.
+* @param arg argument value
+*
+*/
+static inline void traceComplete(const char* name, uint64_t startNs, const char* argName, uint32_t arg){
+	if(startNs != 0){
+		traceRecord(name, startNs, osNowNs() - startNs, argName, arg);
+	}
+}
+
+/**
+* Records an instant event now.
+*/
+static inline void traceInstant(const char* name, const char* argName, uint32_t arg){
+	if(traceEnabled){
+		traceRecord(name, osNowNs(), 0, argName, arg);
+	}
+}
+
+#endif
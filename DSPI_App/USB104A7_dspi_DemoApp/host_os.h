@@ -0,0 +1,129 @@
+/************************************************************************/
+/*                                                                      */
+/*    host_os.h  --  Threads, locks and clocks for Windows and Linux    */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(HOST_OS_INCLUDED)
+#define      HOST_OS_INCLUDED
+
+#include <stdint.h>
+
+#if defined(WIN32)
+
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+
+	typedef CRITICAL_SECTION OsMutex;
+	typedef HANDLE OsThread;
+
+	#define OS_THREAD_LOCAL __declspec(thread)
+	#define OS_ALIGN(n) __declspec(align(n))
+
+	static inline void osMutexInit(OsMutex* m){ InitializeCriticalSection(m); }
+	static inline void osMutexDestroy(OsMutex* m){ DeleteCriticalSection(m); }
+	static inline void osMutexLock(OsMutex* m){ EnterCriticalSection(m); }
+	static inline void osMutexUnlock(OsMutex* m){ LeaveCriticalSection(m); }
+
+	typedef CONDITION_VARIABLE OsCond;
+
+	static inline void osCondInit(OsCond* c){ InitializeConditionVariable(c); }
+	static inline void osCondDestroy(OsCond* c){ (void)c; }
+	static inline void osCondWait(OsCond* c, OsMutex* m){ SleepConditionVariableCS(c, m, INFINITE); }
+	static inline void osCondWaitUs(OsCond* c, OsMutex* m, uint32_t us){ SleepConditionVariableCS(c, m, (us + 999) / 1000); }
+	static inline void osCondBroadcast(OsCond* c){ WakeAllConditionVariable(c); }
+
+	static inline int osThreadStart(OsThread* t, void* (*fn)(void*), void* arg){
+		*t = CreateThread(0, 0, (LPTHREAD_START_ROUTINE)fn, arg, 0, NULL);
+		return *t == NULL ? -1 : 0;
+	}
+	static inline void osThreadJoin(OsThread t){
+		WaitForSingleObject(t, INFINITE);
+		CloseHandle(t);
+	}
+
+	static inline uint32_t osAtomicLoad(volatile uint32_t* p){ return InterlockedCompareExchange((volatile LONG*)p, 0, 0); }
+	static inline void osAtomicStore(volatile uint32_t* p, uint32_t v){ InterlockedExchange((volatile LONG*)p, (LONG)v); }
+	static inline uint32_t osAtomicAdd(volatile uint32_t* p, uint32_t v){ return (uint32_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v); }
+
+	static inline uint64_t osNowNs(){
+		LARGE_INTEGER f, c;
+		QueryPerformanceFrequency(&f);
+		QueryPerformanceCounter(&c);
+		return (uint64_t)((double)c.QuadPart * 1e9 / (double)f.QuadPart);
+	}
+
+#else
+
+	#include <pthread.h>
+	#include <time.h>
+
+	typedef pthread_mutex_t OsMutex;
+	typedef pthread_t OsThread;
+
+	#define OS_THREAD_LOCAL __thread
+	#define OS_ALIGN(n) __attribute__((aligned(n)))
+
+	static inline void osMutexInit(OsMutex* m){ pthread_mutex_init(m, NULL); }
+	static inline void osMutexDestroy(OsMutex* m){ pthread_mutex_destroy(m); }
+	static inline void osMutexLock(OsMutex* m){ pthread_mutex_lock(m); }
+	static inline void osMutexUnlock(OsMutex* m){ pthread_mutex_unlock(m); }
+
+	typedef pthread_cond_t OsCond;
+
+	//Timed waits run on CLOCK_MONOTONIC, so a step of the wall clock does
+	//not stretch or cut short a batch window or a deadline
+	static inline void osCondInit(OsCond* c){
+		pthread_condattr_t attr;
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(c, &attr);
+		pthread_condattr_destroy(&attr);
+	}
+	static inline void osCondDestroy(OsCond* c){ pthread_cond_destroy(c); }
+	static inline void osCondWait(OsCond* c, OsMutex* m){ pthread_cond_wait(c, m); }
+	static inline void osCondWaitUs(OsCond* c, OsMutex* m, uint32_t us){
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		ts.tv_sec += us / 1000000;
+		ts.tv_nsec += (long)(us % 1000000) * 1000;
+		if(ts.tv_nsec >= 1000000000){
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(c, m, &ts);
+	}
+	static inline void osCondBroadcast(OsCond* c){ pthread_cond_broadcast(c); }
+
+	static inline int osThreadStart(OsThread* t, void* (*fn)(void*), void* arg){
+		return pthread_create(t, NULL, fn, arg) == 0 ? 0 : -1;
+	}
+	static inline void osThreadJoin(OsThread t){ pthread_join(t, NULL); }
+
+	static inline uint32_t osAtomicLoad(volatile uint32_t* p){ return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+	static inline void osAtomicStore(volatile uint32_t* p, uint32_t v){ __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+	static inline uint32_t osAtomicAdd(volatile uint32_t* p, uint32_t v){ return __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL); }
+
+	static inline uint64_t osNowNs(){
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
+
+#endif
+
+/**
+* Sleeps for at least us microseconds.
+*/
+static inline void osSleepUs(uint32_t us){
+#if defined(WIN32)
+	Sleep((us + 999) / 1000);
+#else
+	struct timespec ts;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (long)(us % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+#endif
@@ -0,0 +1,164 @@
+/************************************************************************/
+/*                                                                      */
+/*    link_adept.c  --  DSPI transport over the Adept runtime           */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    The only file that includes the Adept headers. They define       */
+/*    constants, so including them in a second file breaks the link.   */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dpcdecl.h"
+#include "dmgr.h"
+#include "dspi.h"
+
+#include "dspi_link.h"
+#include "dspi_trace.h"
+
+#define DEFAULT_DEVICE "Usb104A7_DPTI"
+
+typedef struct {
+	HIF hif;
+	int portNum;
+	volatile int fCanceled;	//set by adeptCancel() for the transfer in flight
+} AdeptLink;
+
+/**
+* Translates the error of a failed transfer. Adept reports a timeout and a
+* cancel the same way.
+*/
+static int adeptError(AdeptLink* al){
+	int erc = DmgrGetLastError();
+
+	if(erc == ercTransferCancelled){
+		return al->fCanceled ? LINK_ERR_CANCELED : LINK_ERR_TIMEOUT;
+	}
+	return erc;
+}
+
+/**
+* Opens the DSPI port of a device.
+*
+* @param link receives the link state
+* @param device Adept device name, NULL for the USB104A7 default
+*
+* @return 0 if passed, DmgrGetLastError() code if failed
+*
+*/
+static int adeptOpen(void** link, const char* device){
+	AdeptLink* al;
+	int status;
+	INT32 cprtPti;
+	DWORD spd;
+
+	if((al = calloc(1, sizeof(AdeptLink))) == NULL){
+		return LINK_ERR_OPEN;
+	}
+	if(device == NULL){
+		device = DEFAULT_DEVICE;
+	}
+	//Open device
+	if(!DmgrOpen(&al->hif, (char*)device)){
+		status = DmgrGetLastError();
+		printf("Error %d opening %s\n", status, device);
+		free(al);
+		return status;
+	}
+	//Get DSPI port count on device
+	if(!DspiGetPortCount(al->hif, &cprtPti)){
+		status = DmgrGetLastError();
+		printf("Error %d getting DSPI port count\n", status);
+		goto fail;
+	}
+	if(cprtPti == 0){
+		printf("No DSPI ports found\n");
+		status = LINK_ERR_OPEN;
+		goto fail;
+	}
+	//Enable DSPI bus
+	if(!DspiEnableEx(al->hif, al->portNum)){
+		status = DmgrGetLastError();
+		printf("Error %d enabling DSPI bus\n", status);
+		goto fail;
+	}
+	//Attempt to set speed slower (actual speed is stored in spd)
+	DspiSetSpeed(al->hif, 125000, &spd);
+	if(!DspiSetSpiMode(al->hif, 0, fFalse)){ // Set to SPI Mode 0
+		status = DmgrGetLastError();
+		printf("Error %d setting SPI mode\n", status);
+		DspiDisable(al->hif);
+		goto fail;
+	}
+	DmgrSetTransTimeout(al->hif, 3000);//3 second timeout unless a deadline is nearer
+	*link = al;
+	return 0;
+
+fail:
+	DmgrClose(al->hif);
+	free(al);
+	return status;
+}
+
+static void adeptClose(void* link){
+	AdeptLink* al = link;
+
+	DmgrCancelTrans(al->hif);
+	DspiDisable(al->hif);
+	DmgrClose(al->hif);
+	free(al);
+}
+
+static int adeptPut(void* link, const uint8_t* snd, uint8_t* rcv, uint32_t cb){
+	AdeptLink* al = link;
+	uint64_t t = traceStart();
+
+	al->fCanceled = 0;
+	if(!DspiPut(al->hif, fTrue, fTrue, (BYTE*)snd, rcv, cb, fFalse)){
+		return adeptError(al);
+	}
+	traceComplete("DspiPut", t, "bytes", cb);
+	return 0;
+}
+
+static int adeptGet(void* link, uint8_t* rcv, uint32_t cb){
+	AdeptLink* al = link;
+	uint64_t t = traceStart();
+
+	al->fCanceled = 0;
+	if(!DspiGet(al->hif, fTrue, fTrue, 0, rcv, cb, fFalse)){
+		return adeptError(al);
+	}
+	traceComplete("DspiGet", t, "bytes", cb);
+	return 0;
+}
+
+static void adeptCancel(void* link){
+	AdeptLink* al = link;
+
+	al->fCanceled = 1;
+	DmgrCancelTrans(al->hif);
+}
+
+static void adeptSetTimeout(void* link, uint32_t ms){
+	AdeptLink* al = link;
+
+	DmgrSetTransTimeout(al->hif, ms);
+}
+
+const DspiTransport transportAdept = {
+	"adept",
+	1000,//The firmware needs time to re-arm between transfers
+	adeptOpen,
+	adeptClose,
+	adeptPut,
+	adeptGet,
+	adeptCancel,
+	adeptSetTimeout,
+	NULL
+};
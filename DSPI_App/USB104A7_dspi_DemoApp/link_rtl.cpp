@@ -0,0 +1,653 @@
+/************************************************************************/
+/*                                                                      */
+/*    link_rtl.cpp  --  Co-simulation with the RTL of the SPI slave     */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Runs transfers through a Verilated model of dspi_regfile.v, the   */
+/*    fabric SPI slave and register RAM, clocked at 100 MHz like the    */
+/*    MicroBlaze bus. SCK, MOSI and slave select are driven bit by bit  */
+/*    and MISO is sampled on the rising edge, so every frame the fabric */
+/*    answers is timed to the clock cycle.                              */
+/*                                                                      */
+/*    The MicroBlaze is played by the firmware model of link_sim.c. It  */
+/*    reacts to the interrupt line after a fixed latency and talks to   */
+/*    the RTL through AXI-Lite transactions, also cycle by cycle: ISR,  */
+/*    the forwarded frame, the response, payload phases and the TX      */
+/*    FIFO, as fabric.c does. The model's registers are kept in step    */
+/*    with the RTL register RAM through the Verilated state, which     */
+/*    costs no simulated time. Scripts and captures of the model only   */
+/*    run when a frame is forwarded.                                    */
+/*                                                                      */
+/*    Time only passes in the simulation. The transport waits, in       */
+/*    simulated time, until the firmware has staged its response before */
+/*    it starts a transfer. With strict=1 frames go out at once, and    */
+/*    those that come too early are dropped as on the board; payloads   */
+/*    still wait. clockNs returns the simulated time for the benchmark. */
+/*                                                                      */
+/*    The device string is a comma separated list of options:           */
+/*        sck=<Hz>     SPI clock, at most 12500000, default 4000000     */
+/*        usb=<us>     idle time before every transfer, default 0       */
+/*        fw=<ns>      firmware interrupt latency, default 2000         */
+/*        strict=1     send frames without waiting for the firmware     */
+/*    and those of the simulated device, e.g. btn=<value>.              */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <array>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Vdspi_regfile.h"
+#include "Vdspi_regfile___024root.h"
+#include "verilated.h"
+
+extern "C" {
+#include "host_os.h"
+#include "dspi_link.h"
+#include "dspi_protocol.h"
+#include "regmap.h"
+}
+
+#define RTL_CLK_NS 10
+#define RTL_RESET_CYCLES 16
+#define RTL_GAP_CYCLES 16	//slave select high between transfers, lets the decoder finish
+#define RTL_WAIT_CYCLES 100000000ull	//1 s of simulated time without a response
+#define RTL_FIFO_SIZE 512
+
+//AXI-Lite window of dspi_regfile, see the module header
+#define RTL_REGS 0x0000
+#define RTL_RXBUF 0x0800
+#define RTL_CTRL 0x1000
+#define RTL_ISR 0x1004
+#define RTL_IER 0x1008
+#define RTL_REQ_HDR 0x100C
+#define RTL_REQ_DATA 0x1010
+#define RTL_RSP_HDR 0x1014
+#define RTL_RSP_DATA 0x1018
+#define RTL_PHASE 0x101C
+#define RTL_TXFIFO 0x1020
+#define RTL_TXFREE 0x1024
+#define RTL_FLAGS 0x1028
+#define RTL_WIN(n) (0x1040 + 8 * (n))
+
+#define RTL_INT_FRAME 0x01
+#define RTL_INT_RECV 0x02
+#define RTL_INT_TX_LOW 0x04
+#define RTL_INT_LATE 0x08
+#define RTL_INT_ABORT 0x10
+
+#define RTL_PHASE_RECV (1u << 24)
+#define RTL_PHASE_SEND (2u << 24)
+
+//One step of the firmware: an AXI access or a delay, then a continuation
+typedef struct {
+	enum { STEP_DELAY, STEP_READ, STEP_WRITE } kind;
+	uint32_t addr;
+	uint32_t data;	//value to write, or cycles to wait
+	std::function<void(uint32_t)> done;	//gets the value read, may be empty
+} FwStep;
+
+typedef struct {
+	uint16_t base;
+	uint16_t count;
+	uint8_t width;
+	uint8_t attrs;
+	uint8_t fabric;
+	uint16_t offset;	//in the register RAM
+} RtlRegion;
+
+typedef struct {
+	uint16_t addr;
+	uint8_t attrs;
+} RtlNamed;
+
+typedef struct {
+	OsMutex lock;
+	Vdspi_regfile* top;
+	void* fw;	//firmware model, a transportSim link
+	uint64_t cycle;
+	uint32_t halfCycles;	//of SCK
+	uint32_t usbUs;
+	uint32_t fwCycles;
+	int fStrict;
+	RtlRegion regions[REGMAP_N_REGIONS];
+
+	//Firmware
+	std::deque<FwStep> steps;
+	int fStepBusy;	//address phase of the front step is done
+	uint64_t delayEnd;
+	uint32_t recvLen;
+	uint8_t payload[PAYLOAD_SIZE];
+	uint8_t* txCopy;	//reply payload still to push
+	uint32_t txLen;
+	uint32_t txPos;
+	uint32_t late;	//frames the RTL answered with STATUS_DROPPED
+} RtlDevice;
+
+static const RtlRegion rtlRegionMap[] = {
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	{base, count, width, attrs, REGMAP_IN_FABRIC_##backing, 0},
+#include "regmap.def"
+};
+
+static const RtlNamed rtlNamed[] = {
+#define REGMAP_REG(id, name, addr, attrs, help) \
+	{addr, attrs},
+#include "regmap.def"
+};
+
+static void rtlFwFeed(RtlDevice* rd, uint32_t room);
+
+/**
+* Looks up the attributes of a register in a region, see regAttrs().
+*/
+static int rtlAttrs(const RtlRegion* r, uint16_t addr){
+	int i;
+
+	for(i = 0; i < REGMAP_N_NAMED; i++){
+		if(rtlNamed[i].addr == addr){
+			return rtlNamed[i].attrs;
+		}
+	}
+	return r->attrs;
+}
+
+/**
+* Advances the model by one clock cycle. The firmware drives the AXI-Lite
+* inputs before the rising edge and sees the handshakes of that edge.
+*/
+static void rtlTick(RtlDevice* rd){
+	Vdspi_regfile* top = rd->top;
+	FwStep* step = rd->steps.empty() ? NULL : &rd->steps.front();
+	int fDone = 0;
+	uint32_t rdata = 0;
+
+	top->s_axi_awvalid = 0;
+	top->s_axi_wvalid = 0;
+	top->s_axi_arvalid = 0;
+	top->s_axi_bready = 1;
+	top->s_axi_rready = 1;
+	if(step != NULL && step->kind == FwStep::STEP_WRITE && !rd->fStepBusy){
+		top->s_axi_awaddr = step->addr;
+		top->s_axi_wdata = step->data;
+		top->s_axi_wstrb = 0xF;
+		top->s_axi_awvalid = 1;
+		top->s_axi_wvalid = 1;
+	}else if(step != NULL && step->kind == FwStep::STEP_READ && !rd->fStepBusy){
+		top->s_axi_araddr = step->addr;
+		top->s_axi_arvalid = 1;
+	}
+	top->s_axi_aclk = 0;
+	top->eval();
+
+	if(step != NULL){
+		switch(step->kind){
+		case FwStep::STEP_DELAY:
+			if(!rd->fStepBusy){
+				rd->delayEnd = rd->cycle + step->data;
+				rd->fStepBusy = 1;
+			}
+			fDone = rd->cycle >= rd->delayEnd;
+			break;
+		case FwStep::STEP_WRITE:
+			if(!rd->fStepBusy){
+				rd->fStepBusy = top->s_axi_awready;
+			}else{
+				fDone = top->s_axi_bvalid;
+			}
+			break;
+		case FwStep::STEP_READ:
+			if(!rd->fStepBusy){
+				rd->fStepBusy = top->s_axi_arready;
+			}else if(top->s_axi_rvalid){
+				rdata = top->s_axi_rdata;
+				fDone = 1;
+			}
+			break;
+		}
+	}
+
+	top->s_axi_aclk = 1;
+	top->eval();
+	rd->cycle++;
+
+	if(fDone){
+		std::function<void(uint32_t)> done = step->done;
+
+		rd->steps.pop_front();
+		rd->fStepBusy = 0;
+		if(done){
+			done(rdata);
+		}
+	}
+}
+
+/**
+* Copies the register RAM into the firmware model or back. Copying it into
+* the model also takes the dirty bitmap, as FabricDirty() does, and gives
+* the registers in the words the RTL wrote a new generation.
+*/
+static void rtlSyncRegisters(RtlDevice* rd, int fToRtl){
+	auto& ram = rd->top->rootp->dspi_regfile__DOT__regs;
+	auto& dirty = rd->top->rootp->dspi_regfile__DOT__dirty;
+	const RtlRegion* r;
+	uint8_t* store;
+	uint32_t cb;
+	uint32_t i;
+	int n;
+
+	for(n = 0; n < REGMAP_N_REGIONS; n++){
+		r = &rd->regions[n];
+		if(!r->fabric){
+			continue;
+		}
+		store = (uint8_t*)simRegionStore(rd->fw, n);
+		for(i = 0; !fToRtl && i < r->count; i++){
+			uint32_t word = (r->offset + i * r->width) / 4;
+
+			if(dirty[word / 32] & (1u << (word % 32))){
+				simRegionTouch(rd->fw, n, i);
+			}
+		}
+		cb = (uint32_t)r->count * r->width;
+		for(i = 0; i < cb; i++){
+			uint32_t word = (r->offset + i) / 4;
+			uint32_t shift = 8 * ((r->offset + i) % 4);
+
+			if(fToRtl){
+				ram[word] = (ram[word] & ~(0xFFu << shift)) | ((uint32_t)store[i] << shift);
+			}else{
+				store[i] = (uint8_t)(ram[word] >> shift);
+			}
+		}
+	}
+	for(i = 0; !fToRtl && i < 16; i++){
+		dirty[i] = 0;
+	}
+}
+
+static void rtlFwWrite(RtlDevice* rd, uint32_t addr, uint32_t data){
+	FwStep step = {FwStep::STEP_WRITE, addr, data, nullptr};
+
+	rd->steps.push_back(step);
+}
+
+static void rtlFwRead(RtlDevice* rd, uint32_t addr, std::function<void(uint32_t)> done){
+	FwStep step = {FwStep::STEP_READ, addr, 0, done};
+
+	rd->steps.push_back(step);
+}
+
+static void rtlFwDelay(RtlDevice* rd, uint32_t cycles, std::function<void(uint32_t)> done){
+	FwStep step = {FwStep::STEP_DELAY, 0, cycles, done};
+
+	rd->steps.push_back(step);
+}
+
+/**
+* Stages what the firmware model decided after a frame or a request
+* payload, like the end of the main loop in main.c.
+*/
+static void rtlFwAnswer(RtlDevice* rd){
+	uint8_t rsp[FRAME_SIZE];
+	const uint8_t* tx;
+	uint32_t cb;
+	int next;
+
+	next = simNext(rd->fw, rsp, &tx, &cb);
+	if(next == SIM_NEXT_RECV){
+		rd->recvLen = cb;
+		rtlFwWrite(rd, RTL_PHASE, RTL_PHASE_RECV | cb);
+		return;
+	}
+	rtlFwWrite(rd, RTL_RSP_HDR, getBE32(rsp));
+	rtlFwWrite(rd, RTL_RSP_DATA, getBE32(rsp + FRAME_DATA));
+	if(next == SIM_NEXT_FRAME){
+		rtlFwWrite(rd, RTL_PHASE, 0);
+		return;
+	}
+	//The model sends the payload at once, the RTL takes it as the FIFO drains
+	free(rd->txCopy);
+	rd->txCopy = (uint8_t*)malloc(cb);
+	memcpy(rd->txCopy, tx, cb);
+	rd->txLen = cb;
+	rd->txPos = 0;
+	transportSim.get(rd->fw, NULL, cb);
+	rtlSyncRegisters(rd, 1);
+	rtlFwFeed(rd, RTL_FIFO_SIZE);
+	rtlFwWrite(rd, RTL_PHASE, RTL_PHASE_SEND | cb);
+}
+
+/**
+* Pushes reply payload words while the TX FIFO has room, byte 0 first.
+*/
+static void rtlFwFeed(RtlDevice* rd, uint32_t room){
+	uint32_t word;
+	uint32_t i;
+
+	while(rd->txPos < rd->txLen && room >= 4){
+		word = 0;
+		for(i = 0; i < 4 && rd->txPos + i < rd->txLen; i++){
+			word |= (uint32_t)rd->txCopy[rd->txPos + i] << (8 * i);
+		}
+		rtlFwWrite(rd, RTL_TXFIFO, word);
+		rd->txPos += i;
+		room -= 4;
+	}
+}
+
+/**
+* Runs a forwarded frame through the firmware model.
+*/
+static void rtlFwFrame(RtlDevice* rd, const uint8_t* frame){
+	uint8_t rsp[FRAME_SIZE];
+	const uint8_t* tx;
+	uint32_t cb;
+	uint32_t extra = 0;
+
+	rtlSyncRegisters(rd, 0);
+	transportSim.put(rd->fw, frame, rsp, FRAME_SIZE);
+	rtlSyncRegisters(rd, 1);
+	if(frame[FRAME_OP] == op_wait && simNext(rd->fw, rsp, &tx, &cb) == SIM_NEXT_FRAME
+		&& rsp[FRAME_STATUS] == STATUS_TIMEOUT){
+		extra = WAIT_SLICE_US * (1000 / RTL_CLK_NS);//The firmware polls the whole slice
+	}
+	if(extra != 0){
+		rtlFwDelay(rd, extra, [rd](uint32_t){ rtlFwAnswer(rd); });
+	}else{
+		rtlFwAnswer(rd);
+	}
+}
+
+/**
+* Handles the interrupt, like FabricInterruptHandler() and the main loop.
+*/
+static void rtlFwInterrupt(RtlDevice* rd){
+	rtlFwDelay(rd, rd->fwCycles, nullptr);
+	rtlFwRead(rd, RTL_ISR, [rd](uint32_t isr){
+		if(isr & RTL_INT_LATE){
+			rd->late++;
+			rtlFwWrite(rd, RTL_ISR, RTL_INT_LATE);
+		}
+		if(isr & RTL_INT_ABORT){
+			uint8_t rsp[FRAME_SIZE];
+			const uint8_t* tx;
+			uint32_t cb;
+
+			//The RTL answered the command, end the payload phase of the
+			//model too with a transfer of another length
+			rtlFwWrite(rd, RTL_ISR, RTL_INT_ABORT);
+			rd->txPos = rd->txLen;
+			if(simNext(rd->fw, rsp, &tx, &cb) == SIM_NEXT_RECV){
+				transportSim.put(rd->fw, NULL, NULL, cb == 1 ? 2 : 1);
+			}
+			isr &= ~RTL_INT_TX_LOW;
+		}
+		if(isr & RTL_INT_TX_LOW){
+			rtlFwRead(rd, RTL_TXFREE, [rd](uint32_t room){ rtlFwFeed(rd, room); });
+		}
+		if(isr & RTL_INT_FRAME){
+			auto frame = std::make_shared<std::array<uint8_t, FRAME_SIZE>>();
+
+			rtlFwWrite(rd, RTL_ISR, RTL_INT_FRAME);
+			rtlFwRead(rd, RTL_REQ_HDR, [frame](uint32_t v){ putBE32(frame->data(), v); });
+			rtlFwRead(rd, RTL_REQ_DATA, [rd, frame](uint32_t v){
+				putBE32(frame->data() + FRAME_DATA, v);
+				rtlFwFrame(rd, frame->data());
+			});
+		}
+		if(isr & RTL_INT_RECV){
+			uint32_t i;
+
+			rtlFwWrite(rd, RTL_ISR, RTL_INT_RECV);
+			for(i = 0; i < rd->recvLen; i += 4){
+				rtlFwRead(rd, RTL_RXBUF + i, [rd, i](uint32_t v){
+					uint32_t k;
+
+					for(k = 0; k < 4 && i + k < rd->recvLen; k++){
+						rd->payload[i + k] = (uint8_t)(v >> (8 * k));
+					}
+					if(i + 4 >= rd->recvLen){
+						rtlSyncRegisters(rd, 0);
+						transportSim.put(rd->fw, rd->payload, NULL, rd->recvLen);
+						rtlSyncRegisters(rd, 1);
+						rtlFwAnswer(rd);
+					}
+				});
+			}
+		}
+	});
+}
+
+/**
+* Advances the model, with the firmware reacting to the interrupt.
+*/
+static void rtlRun(RtlDevice* rd, uint64_t cycles){
+	uint64_t end = rd->cycle + cycles;
+
+	while(rd->cycle < end){
+		if(rd->steps.empty() && rd->top->irq){
+			rtlFwInterrupt(rd);
+		}
+		rtlTick(rd);
+	}
+}
+
+/**
+* Advances the model until the firmware has nothing left to do.
+*
+* @return 0 if passed, LINK_ERR_LENGTH if the firmware never settles
+*
+*/
+static int rtlSettle(RtlDevice* rd){
+	uint64_t end = rd->cycle + RTL_WAIT_CYCLES;
+
+	while(!rd->steps.empty() || rd->top->irq){
+		if(rd->cycle >= end){
+			return LINK_ERR_LENGTH;
+		}
+		rtlRun(rd, 1);
+	}
+	return 0;
+}
+
+/**
+* Clocks one transfer with slave select held low, MSB first in SPI mode 0.
+*
+* @param snd bytes from the host, NULL for zeros
+* @param rcv receives the bytes from the device, may be NULL
+* @param cb transfer length
+*
+* @return 0 if passed, LINK_ERR_LENGTH if the firmware never settles
+*
+*/
+static int rtlTransfer(RtlDevice* rd, const uint8_t* snd, uint8_t* rcv, uint32_t cb){
+	Vdspi_regfile* top = rd->top;
+	uint8_t in;
+	uint32_t i;
+	int bit;
+	int status = 0;
+
+	osMutexLock(&rd->lock);
+	rtlRun(rd, (uint64_t)rd->usbUs * (1000 / RTL_CLK_NS));
+	if((!rd->fStrict || cb != FRAME_SIZE) && (status = rtlSettle(rd)) != 0){
+		osMutexUnlock(&rd->lock);
+		return status;
+	}
+
+	top->dspi_spisel = 0;
+	rtlRun(rd, rd->halfCycles);
+	for(i = 0; i < cb; i++){
+		in = 0;
+		for(bit = 7; bit >= 0; bit--){
+			top->dspi_io0_io = snd != NULL ? (snd[i] >> bit) & 1 : 0;
+			rtlRun(rd, rd->halfCycles);
+			in = (uint8_t)(in << 1) | top->dspi_io1_io;
+			top->dspi_sck_io = 1;
+			rtlRun(rd, rd->halfCycles);
+			top->dspi_sck_io = 0;
+		}
+		if(rcv != NULL){
+			rcv[i] = in;
+		}
+	}
+	rtlRun(rd, rd->halfCycles);
+	top->dspi_spisel = 1;
+	rtlRun(rd, RTL_GAP_CYCLES);
+	osMutexUnlock(&rd->lock);
+	return 0;
+}
+
+/**
+* Creates the model, resets it and runs the firmware initialization:
+* windows over the register regions, forwarding of the registers with side
+* effects, interrupt enables and the fast path.
+*
+* @param link receives the device
+* @param device option string, see the file description. May be NULL.
+*
+* @return 0 if passed, LINK_ERR_OPEN if an option is not accepted
+*
+*/
+static int rtlOpen(void** link, const char* device){
+	RtlDevice* rd;
+	std::string simOptions;
+	const char* p = device;
+	char key[16];
+	long val;
+	uint32_t sckHz = 4000000;
+	uint16_t offset = 0;
+	uint32_t flags;
+	int attrs;
+	int window = 0;
+	int n;
+	int i;
+
+	rd = new RtlDevice();
+	rd->fwCycles = 2000 / RTL_CLK_NS;
+	while(p != NULL && *p != '\0'){
+		if(sscanf(p, "%15[^=]=%li%n", key, &val, &n) != 2){
+			printf("Unrecognized co-simulation option %s\n", p);
+			delete rd;
+			return LINK_ERR_OPEN;
+		}
+		if(strcmp(key, "sck") == 0){
+			sckHz = (uint32_t)val;
+		}else if(strcmp(key, "usb") == 0){
+			rd->usbUs = (uint32_t)val;
+		}else if(strcmp(key, "fw") == 0){
+			rd->fwCycles = (uint32_t)val / RTL_CLK_NS;
+		}else if(strcmp(key, "strict") == 0){
+			rd->fStrict = val != 0;
+		}else{
+			simOptions.append(simOptions.empty() ? "" : ",").append(p, n);
+		}
+		p += n;
+		if(*p == ','){
+			p++;
+		}
+	}
+	//The RTL oversamples SCK, a half period needs at least four clocks
+	if(sckHz == 0 || sckHz > 1000000000 / RTL_CLK_NS / 8){
+		printf("SCK must be between 1 and %d Hz\n", 1000000000 / RTL_CLK_NS / 8);
+		delete rd;
+		return LINK_ERR_OPEN;
+	}
+	rd->halfCycles = 1000000000 / RTL_CLK_NS / 2 / sckHz;
+	simOptions.insert(0, simOptions.empty() ? "fabric=1" : "fabric=1,");
+	if(transportSim.open(&rd->fw, simOptions.c_str()) != 0){
+		delete rd;
+		return LINK_ERR_OPEN;
+	}
+
+	rd->top = new Vdspi_regfile();
+	rd->top->dspi_spisel = 1;
+	rd->top->s_axi_aresetn = 0;
+	rtlRun(rd, RTL_RESET_CYCLES);
+	rd->top->s_axi_aresetn = 1;
+
+	//Registers are laid out in the RAM in regmap.def order, like .fab_bss
+	for(n = 0; n < REGMAP_N_REGIONS; n++){
+		rd->regions[n] = rtlRegionMap[n];
+		if(!rd->regions[n].fabric){
+			continue;
+		}
+		rd->regions[n].offset = offset;
+		offset += (rd->regions[n].count * rd->regions[n].width + 3) & ~3;
+		rtlFwWrite(rd, RTL_WIN(window), ((uint32_t)rd->regions[n].count << 16) | rd->regions[n].base);
+		rtlFwWrite(rd, RTL_WIN(window) + 4, 0x80000000 | ((uint32_t)rd->regions[n].width << 16) | rd->regions[n].offset);
+		window++;
+		for(i = 0; i < rd->regions[n].count; i++){
+			attrs = rtlAttrs(&rd->regions[n], rd->regions[n].base + i);
+			flags = (attrs & REG_ATTR_READ_EFFECT ? 1 << 16 : 0)
+				| (attrs & (REG_ATTR_WRITE_EFFECT | REG_ATTR_READONLY) ? 1 << 17 : 0);
+			if(flags != 0){
+				rtlFwWrite(rd, RTL_FLAGS, flags | (rd->regions[n].offset + i * rd->regions[n].width));
+			}
+		}
+	}
+	rtlSyncRegisters(rd, 1);
+	rtlFwWrite(rd, RTL_IER, RTL_INT_FRAME | RTL_INT_RECV | RTL_INT_TX_LOW | RTL_INT_LATE | RTL_INT_ABORT);
+	rtlFwWrite(rd, RTL_CTRL, 1);
+	rtlSettle(rd);
+
+	osMutexInit(&rd->lock);
+	*link = rd;
+	return 0;
+}
+
+static void rtlClose(void* link){
+	RtlDevice* rd = (RtlDevice*)link;
+
+	if(rd->late != 0){
+		printf("Co-simulation: %u frames arrived before their response was staged\n", rd->late);
+	}
+	rd->top->final();
+	delete rd->top;
+	transportSim.close(rd->fw);
+	free(rd->txCopy);
+	osMutexDestroy(&rd->lock);
+	delete rd;
+}
+
+static int rtlPut(void* link, const uint8_t* snd, uint8_t* rcv, uint32_t cb){
+	return rtlTransfer((RtlDevice*)link, snd, rcv, cb);
+}
+
+static int rtlGet(void* link, uint8_t* rcv, uint32_t cb){
+	return rtlTransfer((RtlDevice*)link, NULL, rcv, cb);
+}
+
+static void rtlCancel(void* link){
+	(void)link;//Transfers complete synchronously
+}
+
+static uint64_t rtlClockNs(void* link){
+	RtlDevice* rd = (RtlDevice*)link;
+	uint64_t ns;
+
+	osMutexLock(&rd->lock);
+	ns = rd->cycle * RTL_CLK_NS;
+	osMutexUnlock(&rd->lock);
+	return ns;
+}
+
+extern "C" const DspiTransport transportRtl = {
+	"rtl",
+	0,
+	rtlOpen,
+	rtlClose,
+	rtlPut,
+	rtlGet,
+	rtlCancel,
+	NULL,//Simulated transfers cannot stall
+	rtlClockNs
+};
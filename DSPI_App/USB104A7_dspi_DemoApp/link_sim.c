@@ -0,0 +1,1298 @@
+/************************************************************************/
+/*                                                                      */
+/*    link_sim.c  --  Simulated USB104A7 DSPI device                    */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    A model of the demo firmware that answers transfers in process:   */
+/*    the same frame pipelining, payload phases, register regions and   */
+/*    AXI bridge allow-list. The AXI bus holds the button/LED GPIO, the */
+/*    UART, a read-only interrupt controller and a DDR scratch window.  */
+/*                                                                      */
+/*    Register scripts and captures run lazily: every transfer first    */
+/*    runs the script and takes the capture samples due up to the       */
+/*    current time, so the host observes the same sequence as on the    */
+/*    device without a thread of its own.                               */
+/*                                                                      */
+/*    The device string is a comma separated list of options:           */
+/*        sck=<Hz>     model the SPI clock, 0 for instant transfers     */
+/*        usb=<us>     model a fixed USB round trip per transfer        */
+/*        btn=<value>  state of the buttons                             */
+/*        hang=<n>     every nth transfer hangs until it times out or   */
+/*                     is canceled, and the device never sees it        */
+/*        hangms=<ms>  a hung transfer fails after ms, before it times  */
+/*                     out, to keep tests short                         */
+/*        drop=<n>     every nth frame comes before the last response   */
+/*                     was staged and is dropped, like on the fabric    */
+/*        fabric=1     report the fabric register file in op_identify   */
+/*        legacy=1     firmware from before op_identify                 */
+/*        noop=<op>    firmware without that opcode                     */
+/*    e.g. "sck=125000,usb=250" models the real link closely.           */
+/*                                                                      */
+/************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "host_os.h"
+#include "dspi_link.h"
+#include "dspi_protocol.h"
+#include "dspi_codec.h"
+#include "regmap.h"
+
+#define SIM_GPIO_BASE 0x40000000
+#define SIM_UART_BASE 0x40600000
+#define SIM_INTC_BASE 0x41200000
+#define SIM_WINDOW_SIZE 0x10000
+#define SIM_DDR_BASE 0x80100000	//first DDR address above the firmware image
+#define SIM_DDR_WORDS 0x10000
+#define SIM_FIRMWARE_VERSION 16	//the firmware revision modeled
+#define SIM_FIFO_SIZE 512	//reply payload FIFO of dspi_regfile
+
+typedef enum {
+	PHASE_FRAME,
+	PHASE_RECV,
+	PHASE_SEND
+} SimPhase;
+
+typedef struct {
+	OsMutex lock;
+	uint32_t sckHz;
+	uint32_t usbUs;
+
+	//Fault model
+	uint32_t hangEvery;
+	uint32_t hangMs;	//hung transfers fail after this long, 0 to wait for the timeout
+	uint32_t dropEvery;
+	uint32_t cFrames;
+	uint32_t cTransfers;
+	uint32_t timeoutMs;
+	int fCancel;	//set by simCancel() for the transfer in flight
+	OsCond cancelCond;
+
+	//Firmware model
+	uint32_t features;	//FEATURE_*
+	int fLegacy;	//answers op_identify with STATUS_BAD_OP
+	int missingOp;	//opcode answered with STATUS_BAD_OP, -1 for none
+
+	//Link state, mirrors the firmware main loop
+	SimPhase phase;
+	uint32_t payloadLen;
+	uint8_t cmd;
+	uint8_t width;
+	uint16_t addr;
+	uint32_t value;
+	uint32_t operand;	//latched by op_operand
+	uint8_t status;
+	uint8_t rsp[FRAME_SIZE];
+	uint8_t payloadIn[PAYLOAD_SIZE];
+	uint8_t payloadOut[PAYLOAD_SIZE];
+	const uint8_t* payloadTx;	//reply payload, payloadOut or the capture trace
+	uint32_t bulkWords[BULK_MAX_WORDS];	//unpacked op_bulk_write payload
+	uint8_t deltaBuf[DELTA_MAX_SIZE(DELTA_MAX_REGS)];	//staged by op_delta_scan
+	uint32_t deltaLen;
+
+	//Event trace, see trace.c in the firmware
+	int fTraceOn;
+	uint64_t traceEpochNs;	//trace clock 0
+	uint64_t traceNowNs;	//device time of the transfer being clocked, once it is in
+	uint32_t traceCount;
+	uint8_t traceMem[TRACE_DEPTH * TRACE_EVENT_SIZE];
+	uint8_t traceOut[TRACE_DEPTH * TRACE_EVENT_SIZE];
+
+	//Script engine, see script.c in the firmware
+	uint8_t script[SCRIPT_SIZE];
+	int fScriptRunning;
+	uint16_t scriptPc;
+	uint8_t scriptStatus;
+	uint32_t scriptAcc;
+	uint64_t scriptNs;	//time the script has advanced to
+	int fScriptWaiting;	//blocked in sc_wait until waitNs
+	uint64_t waitNs;
+
+	//Capture engine, see capture.c in the firmware
+	uint8_t capState;
+	uint16_t capSrc[CAPTURE_MAX_CHANNELS];
+	uint8_t capChans;
+	uint32_t capTrigMask;
+	uint32_t capTrigValue;
+	uint32_t capPre;
+	uint32_t capDepth;
+	uint64_t capPeriodNs;
+	uint64_t capNextNs;	//time of the next sample
+	uint32_t capHead;
+	uint32_t capFilled;
+	uint32_t capRemaining;
+	uint32_t capTrigIdx;
+	uint32_t capPreTaken;
+	int fCapMatched;
+	uint32_t capLen;
+	uint32_t capTrigAt;
+	uint32_t capZLen;
+	uint32_t capMem[CAPTURE_SIZE / 4];
+	uint8_t capPacked[DZV_MAX_SIZE(CAPTURE_SIZE / 4)];
+
+	//Register file, reg<id> for every region of regmap.def
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	REGMAP_TYPE(width) reg##id[count];
+#include "regmap.def"
+
+	//Write generations, gen<id> for every region, see registers.c
+	uint32_t generation;
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	uint32_t gen##id[count];
+#include "regmap.def"
+
+	//AXI peripherals
+	uint32_t gpio[4];	//btn data, btn tri, led data, led tri
+	uint32_t uart[4];
+	uint32_t ddr[SIM_DDR_WORDS];
+} SimDevice;
+
+typedef struct {
+	uint16_t base;
+	uint16_t count;
+	uint8_t width;
+	size_t offset;	//of the backing array in SimDevice
+	size_t genOffset;	//of the generations
+} SimRegion;
+
+static uint8_t simScriptStart(SimDevice* sd, uint16_t pc);
+static uint8_t simCaptureControl(SimDevice* sd, uint32_t ctl);
+
+static const SimRegion simRegions[] = {
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	{base, count, width, offsetof(SimDevice, reg##id), offsetof(SimDevice, gen##id)},
+#include "regmap.def"
+};
+
+/**
+* Reads or writes the register at store, see reghooks.c in the firmware for
+* the peripheral-backed ones.
+*/
+static uint8_t simRegStore(SimDevice* sd, const SimRegion* r, uint16_t addr, uint8_t* store, uint32_t* value, int fWrite){
+	if(addr == REG_BTN){
+		if(fWrite) return STATUS_DENIED;
+		*store = (uint8_t)sd->gpio[0];
+	}
+	else if(addr == REG_LED){
+		if(fWrite) sd->gpio[2] = (uint8_t)*value;
+		*store = (uint8_t)sd->gpio[2];
+	}
+	else if(addr == REG_CAP_CTL || addr == REG_CAP_LEN || addr == REG_CAP_TRIG_AT || addr == REG_CAP_ZLEN){
+		uint8_t status = STATUS_OK;
+
+		if(fWrite){
+			if(addr != REG_CAP_CTL){
+				return STATUS_DENIED;
+			}
+			status = simCaptureControl(sd, *value);
+		}
+		if(addr == REG_CAP_CTL){
+			*value = sd->capState;
+		}else if(addr == REG_CAP_ZLEN){
+			*value = sd->capZLen;
+		}else{
+			*value = addr == REG_CAP_LEN ? sd->capLen : sd->capTrigAt;
+		}
+		*(uint32_t*)store = *value;
+		return status;
+	}
+	else if(addr == REG_SCRIPT){
+		uint8_t status = STATUS_OK;
+
+		if(fWrite){
+			if(*value & SCRIPT_CTL_STOP){
+				sd->fScriptRunning = 0;
+			}else{
+				status = simScriptStart(sd, (uint16_t)*value);
+			}
+		}
+		*value = (sd->fScriptRunning ? SCRIPT_STATE_RUNNING : 0) | ((uint32_t)sd->scriptStatus << 16) | sd->scriptPc;
+		*(uint32_t*)store = *value;
+		return status;
+	}
+	switch(r->width){
+		case 1:
+			if(fWrite) *store = (uint8_t)*value;
+			*value = *store;
+			break;
+		case 2:
+			if(fWrite) *(uint16_t*)store = (uint16_t)*value;
+			*value = *(uint16_t*)store;
+			break;
+		default:
+			if(fWrite) *(uint32_t*)store = *value;
+			*value = *(uint32_t*)store;
+			break;
+	}
+	return STATUS_OK;
+}
+
+/**
+* Reads or writes a register, see registers.c in the firmware. A write, or
+* a sample that differs from the value kept, gives the register a new
+* generation.
+*
+* @return STATUS_OK, STATUS_BAD_ADDR or STATUS_BAD_WIDTH
+*
+*/
+static uint8_t simRegAccess(SimDevice* sd, uint16_t addr, uint8_t width, uint32_t* value, int fWrite){
+	const SimRegion* r;
+	uint8_t* store;
+	uint32_t before = 0, after = 0;
+	uint8_t status;
+	int i;
+
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		r = &simRegions[i];
+		if(addr < r->base || addr - r->base >= r->count){
+			continue;
+		}
+		if(width != 0 && width != r->width){
+			return STATUS_BAD_WIDTH;
+		}
+		store = (uint8_t*)sd + r->offset + (size_t)(addr - r->base) * r->width;
+		memcpy(&before, store, r->width);
+		status = simRegStore(sd, r, addr, store, value, fWrite);
+		memcpy(&after, store, r->width);
+		if((fWrite && status == STATUS_OK) || after != before){
+			((uint32_t*)((uint8_t*)sd + r->genOffset))[addr - r->base] = ++sd->generation;
+		}
+		return status;
+	}
+	*value = 0;
+	return STATUS_BAD_ADDR;
+}
+
+/**
+* Performs one 32-bit access on the modeled AXI bus, with the firmware's
+* allow-list.
+*
+* @return STATUS_OK, STATUS_BAD_ADDR or STATUS_DENIED
+*
+*/
+static uint8_t simAxiAccess(SimDevice* sd, uint32_t addr, uint32_t* value, int fWrite){
+	uint32_t* reg = NULL;
+
+	if(addr & 3){
+		return STATUS_BAD_ADDR;
+	}
+	if(addr - SIM_GPIO_BASE < SIM_WINDOW_SIZE){
+		if(addr - SIM_GPIO_BASE < sizeof(sd->gpio)){
+			reg = &sd->gpio[(addr - SIM_GPIO_BASE) / 4];
+		}
+	}
+	else if(addr - SIM_UART_BASE < SIM_WINDOW_SIZE){
+		if(addr - SIM_UART_BASE < sizeof(sd->uart)){
+			reg = &sd->uart[(addr - SIM_UART_BASE) / 4];
+		}
+	}
+	else if(addr - SIM_INTC_BASE < SIM_WINDOW_SIZE){
+		if(fWrite){
+			return STATUS_DENIED;
+		}
+	}
+	else if(addr - SIM_DDR_BASE < SIM_DDR_WORDS * 4){
+		reg = &sd->ddr[(addr - SIM_DDR_BASE) / 4];
+	}
+	else{
+		return STATUS_DENIED;
+	}
+
+	if(fWrite){
+		if(reg != NULL){
+			*reg = *value;
+		}
+	}else{
+		*value = (reg != NULL) ? *reg : 0;
+	}
+	return STATUS_OK;
+}
+
+/**
+* Modifies bits of a register in one step, see RegUpdate() in the firmware.
+*
+* @return STATUS_OK, STATUS_BAD_ADDR, STATUS_BAD_WIDTH or STATUS_DENIED
+*
+*/
+static uint8_t simRegUpdate(SimDevice* sd, uint16_t addr, uint8_t width, uint32_t clear, uint32_t set, uint32_t toggle, uint32_t* value){
+	uint32_t old;
+	uint8_t status;
+
+	if((status = simRegAccess(sd, addr, width, &old, 0)) != STATUS_OK){
+		*value = 0;
+		return status;
+	}
+	*value = ((old & ~clear) | set) ^ toggle;
+	if((status = simRegAccess(sd, addr, width, value, 1)) != STATUS_OK){
+		*value = old;
+	}
+	return status;
+}
+
+/**
+* Writes a run of registers of one region, see RegWriteBlock() in the
+* firmware.
+*
+* @return STATUS_OK, STATUS_BAD_ADDR or STATUS_DENIED
+*
+*/
+static uint8_t simRegWriteBlock(SimDevice* sd, uint16_t addr, const uint32_t* values, uint32_t count){
+	const SimRegion* r;
+	uint32_t value;
+	uint32_t i;
+	uint8_t status;
+
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		r = &simRegions[i];
+		if(addr >= r->base && addr - r->base < r->count){
+			break;
+		}
+	}
+	if(i == REGMAP_N_REGIONS || count > (uint32_t)(r->count - (addr - r->base))){
+		return STATUS_BAD_ADDR;
+	}
+	for(i = 0; i < count; i++){
+		value = values[i];
+		if((status = simRegAccess(sd, addr + i, 0, &value, 1)) != STATUS_OK){
+			return status;
+		}
+	}
+	return STATUS_OK;
+}
+
+/**
+* Stages the delta of a run of registers of one region, see RegDeltaScan()
+* in the firmware. Every register is read first, so the sampled ones count
+* as changed when their sample does.
+*
+* @return STATUS_OK, STATUS_BAD_LENGTH or STATUS_BAD_ADDR
+*
+*/
+static uint8_t simDeltaScan(SimDevice* sd, uint16_t addr, uint32_t count, uint32_t since){
+	const SimRegion* r;
+	const uint32_t* gen;
+	uint8_t* out;
+	uint32_t value;
+	uint32_t i;
+	uint8_t status;
+
+	sd->deltaLen = 0;
+	if(count == 0 || count > DELTA_MAX_REGS){
+		return STATUS_BAD_LENGTH;
+	}
+	for(i = 0; i < REGMAP_N_REGIONS; i++){
+		r = &simRegions[i];
+		if(addr >= r->base && addr - r->base < r->count){
+			break;
+		}
+	}
+	if(i == REGMAP_N_REGIONS || count > (uint32_t)(r->count - (addr - r->base))){
+		return STATUS_BAD_ADDR;
+	}
+	gen = (const uint32_t*)((const uint8_t*)sd + r->genOffset) + (addr - r->base);
+	out = sd->deltaBuf + 4 + (count + 7) / 8;
+	memset(sd->deltaBuf + 4, 0, (count + 7) / 8);
+	for(i = 0; i < count; i++){
+		if((status = simRegAccess(sd, addr + i, 0, &value, 0)) != STATUS_OK){
+			return status;
+		}
+		if(since != 0 && gen[i] <= since){
+			continue;
+		}
+		sd->deltaBuf[4 + i / 8] |= 1 << (i % 8);
+		putBE32(out, value);
+		out += 4;
+	}
+	putBE32(sd->deltaBuf, sd->generation);
+	sd->deltaLen = (uint32_t)(out - sd->deltaBuf);
+	return STATUS_OK;
+}
+
+/**
+* Executes a batch of bridge requests, see bridge.c in the firmware.
+*
+* @return size of the reply payload
+*
+*/
+static uint32_t simBridgeExecute(SimDevice* sd, uint32_t count){
+	const uint8_t* req = sd->payloadIn;
+	uint8_t* rsp = sd->payloadOut;
+	uint32_t i;
+	uint8_t st;
+	uint32_t value;
+
+	sd->status = STATUS_OK;
+	for(i = 0; i < count; i++, req += BRIDGE_REQ_SIZE, rsp += BRIDGE_RSP_SIZE){
+		value = getBE32(req + 5);
+		if(req[0] != BRIDGE_READ && req[0] != BRIDGE_WRITE){
+			st = STATUS_BAD_OP;
+		}else{
+			st = simAxiAccess(sd, getBE32(req + 1), &value, req[0] == BRIDGE_WRITE);
+		}
+		if(st != STATUS_OK){
+			value = 0;
+			if(sd->status == STATUS_OK){
+				sd->status = st;
+			}
+		}
+		rsp[0] = st;
+		putBE32(rsp + 1, value);
+	}
+	return count * BRIDGE_RSP_SIZE;
+}
+
+static void simCaptureTrigger(SimDevice* sd){
+	sd->capTrigIdx = sd->capHead;
+	sd->capPreTaken = sd->capFilled < sd->capPre ? sd->capFilled : sd->capPre;
+	sd->capState = CAPTURE_TRIGGERED;
+}
+
+/**
+* Arms, stops or triggers the capture, see CaptureControl() in the firmware.
+*
+* @return STATUS_OK, STATUS_BAD_LENGTH, STATUS_BUSY or STATUS_BAD_ADDR
+*
+*/
+static uint8_t simCaptureControl(SimDevice* sd, uint32_t ctl){
+	uint32_t period, post, value;
+	uint32_t max;
+	int i;
+
+	switch(ctl){
+		case CAPTURE_CTL_STOP:
+			sd->capState = CAPTURE_IDLE;
+			return STATUS_OK;
+		case CAPTURE_CTL_TRIGGER:
+			if(sd->capState != CAPTURE_ARMED){
+				return STATUS_BUSY;
+			}
+			simCaptureTrigger(sd);
+			return STATUS_OK;
+		case CAPTURE_CTL_ARM:
+			break;
+		default:
+			return STATUS_BAD_ADDR;
+	}
+
+	sd->capState = CAPTURE_IDLE;
+	simRegAccess(sd, REG_CAP_PERIOD, 0, &period, 0);
+	simRegAccess(sd, REG_CAP_CHANS, 0, &value, 0);
+	simRegAccess(sd, REG_CAP_PRE, 0, &sd->capPre, 0);
+	simRegAccess(sd, REG_CAP_POST, 0, &post, 0);
+	simRegAccess(sd, REG_CAP_TRIG_MASK, 0, &sd->capTrigMask, 0);
+	simRegAccess(sd, REG_CAP_TRIG_VALUE, 0, &sd->capTrigValue, 0);
+	if(value > CAPTURE_MAX_CHANNELS || period < CAPTURE_MIN_PERIOD_US || post == 0){
+		return STATUS_BAD_LENGTH;
+	}
+	sd->capChans = value == 0 ? 1 : (uint8_t)value;
+	max = CAPTURE_SIZE / 4 / sd->capChans;
+	if(sd->capPre > max || post > max - sd->capPre){
+		return STATUS_BAD_LENGTH;
+	}
+	for(i = 0; i < sd->capChans; i++){
+		simRegAccess(sd, REG_CAP_SRC0 + i, 0, &value, 0);
+		sd->capSrc[i] = (uint16_t)value;
+	}
+
+	sd->capDepth = sd->capPre + post;
+	sd->capHead = 0;
+	sd->capFilled = 0;
+	sd->capRemaining = post;
+	sd->fCapMatched = 0;
+	sd->capLen = 0;
+	sd->capTrigAt = 0;
+	sd->capZLen = 0;
+	sd->capPeriodNs = (uint64_t)period * 1000;
+	sd->capNextNs = osNowNs() + sd->capPeriodNs;
+	sd->capState = CAPTURE_ARMED;
+	if(sd->capTrigMask == 0){
+		simCaptureTrigger(sd);
+	}
+	return STATUS_OK;
+}
+
+static void simReverse(uint32_t* p, uint32_t n){
+	uint32_t t;
+	uint32_t i;
+
+	for(i = 0; i < n / 2; i++){
+		t = p[i];
+		p[i] = p[n - 1 - i];
+		p[n - 1 - i] = t;
+	}
+}
+
+/**
+* Takes the capture samples due up to now, like the firmware's timer
+* interrupt, and linearizes and packs the trace once the capture stops.
+*/
+static void simCaptureRun(SimDevice* sd, uint64_t now){
+	uint8_t* sample;
+	uint32_t* words;
+	uint32_t value, first = 0;
+	uint32_t n, k;
+	int fMatch;
+	int i;
+
+	while(sd->capNextNs <= now && (sd->capState == CAPTURE_ARMED || sd->capState == CAPTURE_TRIGGERED)){
+		sd->capNextNs += sd->capPeriodNs;
+		sample = (uint8_t*)(sd->capMem + sd->capHead * sd->capChans);
+		for(i = 0; i < sd->capChans; i++){
+			if(simRegAccess(sd, sd->capSrc[i], 0, &value, 0) != STATUS_OK){
+				value = 0;
+			}
+			if(i == 0){
+				first = value;
+			}
+			putBE32(sample + 4 * i, value);
+		}
+		if(sd->capState == CAPTURE_ARMED){
+			fMatch = (first & sd->capTrigMask) == (sd->capTrigValue & sd->capTrigMask);
+			if(fMatch && !sd->fCapMatched){
+				simCaptureTrigger(sd);
+			}
+			sd->fCapMatched = fMatch;
+		}
+		if(sd->capState == CAPTURE_TRIGGERED && --sd->capRemaining == 0){
+			sd->capState = CAPTURE_DONE;
+		}
+		if(++sd->capHead == sd->capDepth){
+			sd->capHead = 0;
+		}
+		if(sd->capFilled < sd->capDepth){
+			sd->capFilled++;
+		}
+	}
+	if(sd->capState == CAPTURE_DONE && sd->capLen == 0){
+		n = sd->capDepth * sd->capChans;
+		k = (sd->capTrigIdx + sd->capDepth - sd->capPreTaken) % sd->capDepth * sd->capChans;
+		simReverse(sd->capMem, k);
+		simReverse(sd->capMem + k, n - k);
+		simReverse(sd->capMem, n);
+		sd->capLen = sd->capPreTaken + sd->capDepth - sd->capPre;
+		sd->capTrigAt = sd->capPreTaken;
+
+		//The firmware packs the big endian trace in place, the host codec wants words
+		n = sd->capLen * sd->capChans;
+		sd->capZLen = 0;
+		if((words = malloc(n * sizeof(uint32_t))) != NULL){
+			for(k = 0; k < n; k++){
+				words[k] = getBE32((const uint8_t*)(sd->capMem + k));
+			}
+			dzvEncode(words, n, sd->capChans, sd->capPacked, sizeof(sd->capPacked), &sd->capZLen);
+			free(words);
+		}
+	}
+}
+
+/**
+* Starts the script at pc, see ScriptStart() in the firmware.
+*
+* @return STATUS_OK, STATUS_BUSY or STATUS_BAD_ADDR
+*
+*/
+static uint8_t simScriptStart(SimDevice* sd, uint16_t pc){
+	if(sd->fScriptRunning){
+		return STATUS_BUSY;
+	}
+	if(pc >= SCRIPT_SIZE){
+		return STATUS_BAD_ADDR;
+	}
+	sd->fScriptRunning = 1;
+	sd->fScriptWaiting = 0;
+	sd->scriptPc = pc;
+	sd->scriptStatus = STATUS_OK;
+	sd->scriptAcc = 0;
+	sd->scriptNs = osNowNs();
+	return STATUS_OK;
+}
+
+/**
+* Runs the script up to now. Delays advance the script clock, a wait that
+* does not match blocks until the next transfer could have changed the
+* register or its timeout passes.
+*/
+static void simScriptRun(SimDevice* sd, uint64_t now){
+	static const uint8_t size[] = {1, 7, 7, 7, 7, 5, 15, 3, 11, 11, 3};
+	const uint8_t* p;
+	uint32_t value, mask;
+	uint8_t status;
+	int steps;
+
+	//Bounded so that a script spinning without delays cannot stall the link
+	for(steps = 0; sd->fScriptRunning && steps < 10000; steps++){
+		if(sd->scriptNs > now){
+			return;
+		}
+		p = sd->script + sd->scriptPc;
+		if(p[0] >= sizeof(size) || sd->scriptPc + size[p[0]] > SCRIPT_SIZE){
+			sd->scriptStatus = STATUS_BAD_OP;
+			sd->fScriptRunning = 0;
+			return;
+		}
+		status = STATUS_OK;
+		switch(p[0]){
+			case SC_END:
+				sd->fScriptRunning = 0;
+				return;
+			case SC_WRITE:
+				value = getBE32(p + 3);
+				status = simRegAccess(sd, getBE16(p + 1), 0, &value, 1);
+				break;
+			case SC_SET:
+				status = simRegUpdate(sd, getBE16(p + 1), 0, 0, getBE32(p + 3), 0, &value);
+				break;
+			case SC_CLEAR:
+				status = simRegUpdate(sd, getBE16(p + 1), 0, getBE32(p + 3), 0, 0, &value);
+				break;
+			case SC_TOGGLE:
+				status = simRegUpdate(sd, getBE16(p + 1), 0, 0, 0, getBE32(p + 3), &value);
+				break;
+			case SC_DELAY:
+				sd->scriptNs += (uint64_t)getBE32(p + 1) * 1000;
+				break;
+			case SC_WAIT:
+				mask = getBE32(p + 3);
+				if((status = simRegAccess(sd, getBE16(p + 1), 0, &value, 0)) != STATUS_OK){
+					break;
+				}
+				if((value & mask) != (getBE32(p + 7) & mask)){
+					if(!sd->fScriptWaiting){
+						sd->fScriptWaiting = 1;
+						sd->waitNs = sd->scriptNs + (uint64_t)getBE32(p + 11) * 1000;
+					}
+					if(sd->waitNs > now){
+						return;
+					}
+					status = STATUS_TIMEOUT;
+					break;
+				}
+				if(sd->fScriptWaiting){
+					sd->fScriptWaiting = 0;
+					sd->scriptNs = now;
+				}
+				break;
+			case SC_LOAD:
+				status = simRegAccess(sd, getBE16(p + 1), 0, &sd->scriptAcc, 0);
+				break;
+			case SC_BEQ:
+			case SC_BNE:
+				if(((sd->scriptAcc & getBE32(p + 1)) == getBE32(p + 5)) == (p[0] == SC_BEQ)){
+					sd->scriptPc = getBE16(p + 9);
+					continue;
+				}
+				break;
+			case SC_JUMP:
+				sd->scriptPc = getBE16(p + 1);
+				continue;
+		}
+		if(status != STATUS_OK){
+			sd->fScriptWaiting = 0;
+			sd->scriptStatus = status;
+			sd->fScriptRunning = 0;
+			return;
+		}
+		sd->scriptPc += size[p[0]];
+	}
+}
+
+/**
+* Tells whether the modeled firmware serves an opcode.
+*/
+static int simServes(SimDevice* sd, int op){
+	static const uint8_t ops[] = {
+		op_nop, op_write, op_read, op_axi_batch, op_operand, op_set_bits,
+		op_clear_bits, op_toggle_bits, op_mask_write, op_cas, op_wait,
+		op_script_load, op_capture_read, op_bulk_write, op_identify,
+		op_delta_scan, op_delta_read, op_trace, op_trace_read
+	};
+	size_t i;
+
+	if(op == sd->missingOp || (op == op_identify && sd->fLegacy)){
+		return 0;
+	}
+	for(i = 0; i < sizeof(ops); i++){
+		if(ops[i] == op){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+* Answers op_identify, see Identify() in the firmware.
+*/
+static uint8_t simIdentify(SimDevice* sd, uint16_t word, uint32_t* value){
+	int op;
+
+	*value = 0;
+	switch(word){
+		case ID_VERSION:
+			*value = (PROTOCOL_VERSION << 16) | SIM_FIRMWARE_VERSION;
+			break;
+		case ID_REGISTERS:
+			*value = REGMAP_N_REGS;
+			break;
+		case ID_PAYLOAD:
+			*value = PAYLOAD_SIZE;
+			break;
+		case ID_BURST:
+			*value = (BULK_MAX_WORDS << 16) | BRIDGE_MAX_OPS;
+			break;
+		case ID_FIFO:
+			*value = SIM_FIFO_SIZE;
+			break;
+		case ID_FEATURES:
+			*value = sd->features;
+			break;
+		default:
+			if(word >= ID_COUNT){
+				return STATUS_BAD_ADDR;
+			}
+			for(op = 0; op < 32; op++){
+				if(word >= ID_OPS && simServes(sd, 32 * (word - ID_OPS) + op)){
+					*value |= 1u << op;
+				}
+			}
+			break;
+	}
+	return STATUS_OK;
+}
+
+/**
+* Reads the trace clock as the firmware sees it for the transfer being
+* clocked: the bytes are in, half the USB round trip is still to go.
+*/
+static uint32_t simTraceTicks(SimDevice* sd){
+	return (uint32_t)((sd->traceNowNs - sd->traceEpochNs) / (1000000000 / TRACE_TICK_HZ));
+}
+
+/**
+* Appends an event for the current command, see TraceRecord() in the
+* firmware.
+*/
+static void simTraceRecord(SimDevice* sd, uint8_t event){
+	uint8_t* p = sd->traceMem + (sd->traceCount % TRACE_DEPTH) * TRACE_EVENT_SIZE;
+
+	if(!sd->fTraceOn){
+		return;
+	}
+	putBE32(p, simTraceTicks(sd));
+	p[4] = event;
+	p[5] = sd->cmd;
+	putBE16(p + 6, sd->addr);
+	sd->traceCount++;
+}
+
+/**
+* Answers op_trace, see TraceControl() in the firmware.
+*/
+static uint8_t simTraceControl(SimDevice* sd, uint16_t word, uint32_t* value){
+	switch(word){
+		case TRACE_CLOCK:
+			*value = simTraceTicks(sd);
+			break;
+		case TRACE_COUNT:
+			*value = sd->traceCount;
+			break;
+		case TRACE_START:
+			if(*value != 0){
+				sd->traceCount = 0;
+			}
+			sd->fTraceOn = *value != 0;
+			*value = sd->traceCount;
+			break;
+		default:
+			*value = 0;
+			return STATUS_BAD_ADDR;
+	}
+	return STATUS_OK;
+}
+
+/**
+* Stages events for op_trace_read, see TraceCopy() in the firmware.
+*/
+static uint8_t simTraceCopy(SimDevice* sd, uint32_t first, uint32_t len){
+	uint32_t n = len / TRACE_EVENT_SIZE;
+	uint32_t i;
+
+	sd->payloadTx = sd->traceOut;
+	if(len % TRACE_EVENT_SIZE != 0){
+		return STATUS_BAD_LENGTH;
+	}
+	if(first > sd->traceCount || n > sd->traceCount - first || sd->traceCount - first > TRACE_DEPTH){
+		return STATUS_BAD_ADDR;
+	}
+	for(i = 0; i < n; i++){
+		memcpy(sd->traceOut + i * TRACE_EVENT_SIZE, sd->traceMem + ((first + i) % TRACE_DEPTH) * TRACE_EVENT_SIZE, TRACE_EVENT_SIZE);
+	}
+	return STATUS_OK;
+}
+
+/**
+* Decodes a command frame like the firmware's PHASE_FRAME handling.
+*/
+static void simFrame(SimDevice* sd, const uint8_t* frame){
+	uint32_t match;
+
+	sd->cmd = frame[FRAME_OP];
+	sd->width = frame[FRAME_WIDTH];
+	sd->addr = getBE16(frame + FRAME_ADDR);
+	sd->value = getBE32(frame + FRAME_DATA);
+
+	switch(simServes(sd, sd->cmd) ? sd->cmd : -1){
+		case op_nop:
+			sd->value = 0;
+			sd->status = STATUS_OK;
+			break;
+		case op_write:
+			sd->status = simRegAccess(sd, sd->addr, sd->width, &sd->value, 1);
+			break;
+		case op_read:
+			sd->status = simRegAccess(sd, sd->addr, sd->width, &sd->value, 0);
+			break;
+		case op_identify:
+			sd->status = simIdentify(sd, sd->addr, &sd->value);
+			break;
+		case op_operand:
+			sd->operand = sd->value;
+			sd->status = STATUS_OK;
+			break;
+		case op_set_bits:
+			sd->status = simRegUpdate(sd, sd->addr, sd->width, 0, sd->value, 0, &sd->value);
+			break;
+		case op_clear_bits:
+			sd->status = simRegUpdate(sd, sd->addr, sd->width, sd->value, 0, 0, &sd->value);
+			break;
+		case op_toggle_bits:
+			sd->status = simRegUpdate(sd, sd->addr, sd->width, 0, 0, sd->value, &sd->value);
+			break;
+		case op_mask_write:
+			sd->status = simRegUpdate(sd, sd->addr, sd->width, sd->operand, sd->value & sd->operand, 0, &sd->value);
+			break;
+		case op_cas:
+			match = sd->value;
+			if((sd->status = simRegAccess(sd, sd->addr, sd->width, &sd->value, 0)) == STATUS_OK){
+				if(sd->value != sd->operand){
+					sd->status = STATUS_MISMATCH;
+				}else{
+					sd->value = match;
+					sd->status = simRegAccess(sd, sd->addr, sd->width, &sd->value, 1);
+				}
+			}
+			break;
+		case op_wait:
+			//Nothing else runs while the device waits, a mismatch lasts the whole slice
+			match = sd->value;
+			if((sd->status = simRegAccess(sd, sd->addr, sd->width, &sd->value, 0)) == STATUS_OK
+				&& (sd->value & sd->operand) != (match & sd->operand)){
+				osSleepUs(WAIT_SLICE_US);
+				sd->status = STATUS_TIMEOUT;
+			}
+			break;
+		case op_axi_batch:
+			if(sd->value == 0 || sd->value > BRIDGE_MAX_OPS){
+				sd->status = STATUS_BAD_LENGTH;
+				break;
+			}
+			sd->payloadLen = sd->value * BRIDGE_REQ_SIZE;
+			sd->phase = PHASE_RECV;
+			break;
+		case op_script_load:
+			if(sd->value == 0 || sd->value > PAYLOAD_SIZE){
+				sd->status = STATUS_BAD_LENGTH;
+				break;
+			}
+			sd->payloadLen = sd->value;
+			sd->phase = PHASE_RECV;
+			break;
+		case op_capture_read:
+			if(sd->value == 0 || sd->value > (sd->width == ENC_DZV ? sizeof(sd->capPacked) : CAPTURE_SIZE)){
+				sd->status = STATUS_BAD_LENGTH;
+				break;
+			}
+			sd->payloadTx = sd->width == ENC_DZV ? sd->capPacked : (const uint8_t*)sd->capMem;
+			match = sd->width == ENC_DZV ? sd->capZLen : sd->capLen * sd->capChans * 4;
+			if(sd->width > ENC_DZV){
+				sd->status = STATUS_BAD_WIDTH;
+			}else if(sd->capState != CAPTURE_DONE){
+				sd->status = STATUS_BUSY;
+			}else if(sd->operand > match || sd->value > match - sd->operand){
+				sd->status = STATUS_BAD_ADDR;
+			}else{
+				sd->payloadTx += sd->operand;
+				sd->status = STATUS_OK;
+			}
+			sd->payloadLen = sd->value;
+			sd->phase = PHASE_SEND;
+			break;
+		case op_bulk_write:
+			if(sd->value == 0 || sd->value > PAYLOAD_SIZE || sd->operand == 0 || sd->operand > BULK_MAX_WORDS){
+				sd->status = STATUS_BAD_LENGTH;
+				break;
+			}
+			sd->payloadLen = sd->value;
+			sd->phase = PHASE_RECV;
+			break;
+		case op_delta_scan:
+			sd->status = simDeltaScan(sd, sd->addr, sd->operand, sd->value);
+			sd->value = sd->deltaLen;
+			break;
+		case op_delta_read:
+			if(sd->value == 0 || sd->value > sizeof(sd->deltaBuf)){
+				sd->status = STATUS_BAD_LENGTH;
+				break;
+			}
+			sd->status = sd->value == sd->deltaLen ? STATUS_OK : STATUS_BAD_LENGTH;
+			sd->payloadTx = sd->deltaBuf;
+			sd->payloadLen = sd->value;
+			sd->phase = PHASE_SEND;
+			break;
+		case op_trace:
+			sd->status = simTraceControl(sd, sd->addr, &sd->value);
+			break;
+		case op_trace_read:
+			if(sd->value == 0 || sd->value > TRACE_DEPTH * TRACE_EVENT_SIZE){
+				sd->status = STATUS_BAD_LENGTH;
+				break;
+			}
+			sd->status = simTraceCopy(sd, sd->operand, sd->value);
+			sd->payloadLen = sd->value;
+			sd->phase = PHASE_SEND;
+			break;
+		default:
+			sd->value = 0;
+			sd->status = STATUS_BAD_OP;
+			break;
+	}
+}
+
+/**
+* Stages the response that goes out with the next frame.
+*/
+static void simStageResponse(SimDevice* sd){
+	sd->rsp[FRAME_OP] = sd->cmd;
+	sd->rsp[FRAME_STATUS] = sd->status;
+	putBE16(sd->rsp + FRAME_ADDR, sd->addr);
+	putBE32(sd->rsp + FRAME_DATA, sd->value);
+}
+
+/**
+* Clocks one transfer through the device.
+*
+* @param snd bytes from the host, NULL for fill bytes
+* @param rcv receives the bytes from the device, may be NULL
+* @param cb transfer length
+*
+* @return 0 if passed, LINK_ERR_LENGTH if the device expected another length.
+*         That ends a payload phase like on the device, a frame is dropped.
+*
+*/
+static int simTransfer(SimDevice* sd, const uint8_t* snd, uint8_t* rcv, uint32_t cb){
+	static const uint8_t zeros[PAYLOAD_SIZE];
+	uint64_t now, deadline;
+	uint32_t us;
+	uint32_t i;
+	int status;
+
+	if(snd == NULL){
+		snd = zeros;
+	}
+	osMutexLock(&sd->lock);
+	if(sd->phase == PHASE_FRAME ? cb != FRAME_SIZE : cb != sd->payloadLen){
+		if(sd->phase != PHASE_FRAME){
+			sd->phase = PHASE_FRAME;
+			sd->status = STATUS_BAD_LENGTH;
+			sd->value = 0;
+			simStageResponse(sd);
+		}
+		osMutexUnlock(&sd->lock);
+		return LINK_ERR_LENGTH;
+	}
+
+	//Timing model: the bus is held for the whole transfer
+	us = sd->usbUs;
+	if(sd->sckHz != 0){
+		us += (uint32_t)((uint64_t)cb * 8 * 1000000 / sd->sckHz);
+	}
+
+	//A hung or too slow transfer is lost, the device state stays as it was
+	sd->fCancel = 0;
+	sd->cTransfers++;
+	if((sd->hangEvery != 0 && sd->cTransfers % sd->hangEvery == 0) || us > (uint64_t)sd->timeoutMs * 1000){
+		deadline = osNowNs() + (uint64_t)(sd->hangMs != 0 && sd->hangMs < sd->timeoutMs ? sd->hangMs : sd->timeoutMs) * 1000000;
+		while(!sd->fCancel && (now = osNowNs()) < deadline){
+			osCondWaitUs(&sd->cancelCond, &sd->lock, (uint32_t)((deadline - now + 999) / 1000));
+		}
+		status = sd->fCancel ? LINK_ERR_CANCELED : LINK_ERR_TIMEOUT;
+		osMutexUnlock(&sd->lock);
+		return status;
+	}
+	if(sd->fScriptRunning){
+		simScriptRun(sd, osNowNs());
+	}
+	if(sd->capState == CAPTURE_ARMED || sd->capState == CAPTURE_TRIGGERED){
+		simCaptureRun(sd, osNowNs());
+	}
+	sd->traceNowNs = osNowNs() + (uint64_t)(us - sd->usbUs / 2) * 1000;
+
+	switch(sd->phase){
+	case PHASE_FRAME:
+		if(sd->dropEvery != 0 && ++sd->cFrames % sd->dropEvery == 0){
+			//The fabric answers for the firmware, which has not staged the
+			//response yet, and drops the frame
+			if(rcv != NULL){
+				memset(rcv, 0, FRAME_SIZE);
+				rcv[FRAME_STATUS] = STATUS_DROPPED;
+			}
+			break;
+		}
+		if(rcv != NULL){
+			memcpy(rcv, sd->rsp, FRAME_SIZE);
+		}
+		simFrame(sd, snd);
+		simTraceRecord(sd, TRACE_EV_IRQ);
+		simTraceRecord(sd, TRACE_EV_FRAME | TRACE_EV_BEGIN);
+		simTraceRecord(sd, TRACE_EV_FRAME | TRACE_EV_END);
+		break;
+	case PHASE_RECV:
+		simTraceRecord(sd, TRACE_EV_IRQ);
+		simTraceRecord(sd, TRACE_EV_PAYLOAD | TRACE_EV_BEGIN);
+		memcpy(sd->payloadIn, snd, cb);
+		if(rcv != NULL){
+			memcpy(rcv, sd->payloadOut, cb);
+		}
+		switch(sd->cmd){
+			case op_axi_batch:
+				sd->payloadLen = simBridgeExecute(sd, sd->value);
+				sd->payloadTx = sd->payloadOut;
+				break;
+			case op_script_load:
+				if(sd->fScriptRunning){
+					sd->status = STATUS_BUSY;
+				}else if(sd->addr >= SCRIPT_SIZE || cb > SCRIPT_SIZE - (uint32_t)sd->addr){
+					sd->status = STATUS_BAD_ADDR;
+				}else{
+					memcpy(sd->script + sd->addr, sd->payloadIn, cb);
+					sd->status = STATUS_OK;
+				}
+				sd->payloadLen = 0;
+				break;
+			case op_bulk_write:
+				if(sd->width == ENC_RAW){
+					sd->status = cb == 4 * sd->operand ? STATUS_OK : STATUS_BAD_LENGTH;
+					for(i = 0; sd->status == STATUS_OK && i < sd->operand; i++){
+						sd->bulkWords[i] = getBE32(sd->payloadIn + 4 * i);
+					}
+				}else if(sd->width == ENC_DZV){
+					sd->status = dzvDecode(sd->payloadIn, cb, sd->bulkWords, sd->operand, 1) == 0 ? STATUS_OK : STATUS_BAD_LENGTH;
+				}else{
+					sd->status = STATUS_BAD_WIDTH;
+				}
+				if(sd->status == STATUS_OK){
+					sd->status = simRegWriteBlock(sd, sd->addr, sd->bulkWords, sd->operand);
+				}
+				sd->value = sd->operand;
+				sd->payloadLen = 0;
+				break;
+		}
+		simTraceRecord(sd, TRACE_EV_PAYLOAD | TRACE_EV_END);
+		sd->phase = sd->payloadLen ? PHASE_SEND : PHASE_FRAME;
+		break;
+	case PHASE_SEND:
+		if(rcv != NULL){
+			memcpy(rcv, sd->payloadTx, cb);
+		}
+		sd->phase = PHASE_FRAME;
+		break;
+	}
+	if(sd->phase == PHASE_FRAME){
+		simStageResponse(sd);
+	}
+
+	if(us != 0){
+		osSleepUs(us);
+	}
+	osMutexUnlock(&sd->lock);
+	return 0;
+}
+
+/**
+* Creates a simulated device.
+*
+* @param link receives the device
+* @param device option string, see the file description. May be NULL.
+*
+* @return 0 if passed, LINK_ERR_OPEN if an option is not recognized
+*
+*/
+static int simOpen(void** link, const char* device){
+	SimDevice* sd;
+	const char* p = device;
+	char key[16];
+	long val;
+	int n;
+
+	if((sd = calloc(1, sizeof(SimDevice))) == NULL){
+		return LINK_ERR_OPEN;
+	}
+	sd->features = FEATURE_DZV;
+	sd->missingOp = -1;
+	sd->generation = 1;	//never reported as 0, which selects every register
+	sd->traceEpochNs = osNowNs();
+	sd->traceNowNs = sd->traceEpochNs;
+	while(p != NULL && *p != '\0'){
+		if(sscanf(p, "%15[^=]=%li%n", key, &val, &n) != 2){
+			printf("Unrecognized simulator option %s\n", p);
+			free(sd);
+			return LINK_ERR_OPEN;
+		}
+		if(strcmp(key, "sck") == 0){
+			sd->sckHz = val;
+		}else if(strcmp(key, "usb") == 0){
+			sd->usbUs = val;
+		}else if(strcmp(key, "btn") == 0){
+			sd->gpio[0] = val;
+		}else if(strcmp(key, "hang") == 0){
+			sd->hangEvery = val;
+		}else if(strcmp(key, "hangms") == 0){
+			sd->hangMs = val;
+		}else if(strcmp(key, "drop") == 0){
+			sd->dropEvery = val;
+		}else if(strcmp(key, "fabric") == 0){
+			sd->features = val != 0 ? sd->features | FEATURE_FABRIC : sd->features & ~FEATURE_FABRIC;
+		}else if(strcmp(key, "legacy") == 0){
+			sd->fLegacy = val != 0;
+		}else if(strcmp(key, "noop") == 0){
+			sd->missingOp = val;
+		}else{
+			printf("Unrecognized simulator option %s\n", key);
+			free(sd);
+			return LINK_ERR_OPEN;
+		}
+		p += n;
+		if(*p == ','){
+			p++;
+		}
+	}
+	sd->gpio[1] = 0xFFFF;	//Buttons are inputs
+	sd->uart[2] = 0x04;	//TX FIFO empty
+	sd->timeoutMs = 3000;	//as the Adept transport
+	osMutexInit(&sd->lock);
+	osCondInit(&sd->cancelCond);
+	simStageResponse(sd);
+	*link = sd;
+	return 0;
+}
+
+static void simClose(void* link){
+	SimDevice* sd = link;
+
+	osCondDestroy(&sd->cancelCond);
+	osMutexDestroy(&sd->lock);
+	free(sd);
+}
+
+static int simPut(void* link, const uint8_t* snd, uint8_t* rcv, uint32_t cb){
+	return simTransfer(link, snd, rcv, cb);
+}
+
+static int simGet(void* link, uint8_t* rcv, uint32_t cb){
+	return simTransfer(link, NULL, rcv, cb);
+}
+
+/**
+* Cancels a hung transfer. A transfer that is being modeled completes first,
+* the cancel then applies to nothing.
+*/
+static void simCancel(void* link){
+	SimDevice* sd = link;
+
+	osMutexLock(&sd->lock);
+	sd->fCancel = 1;
+	osCondBroadcast(&sd->cancelCond);
+	osMutexUnlock(&sd->lock);
+}
+
+static void simSetTimeout(void* link, uint32_t ms){
+	SimDevice* sd = link;
+
+	osMutexLock(&sd->lock);
+	sd->timeoutMs = ms;
+	osMutexUnlock(&sd->lock);
+}
+
+/**
+* Tells what the model expects next, for link_rtl.cpp, which runs the model
+* as the firmware behind the RTL of the SPI slave.
+*
+* @param link model opened through transportSim
+* @param rsp receives the response the model has decoded so far
+* @param tx receives the reply payload of SIM_NEXT_SEND
+* @param cb receives the payload length of SIM_NEXT_RECV and SIM_NEXT_SEND
+*
+* @return SIM_NEXT_FRAME, SIM_NEXT_RECV or SIM_NEXT_SEND
+*
+*/
+int simNext(void* link, uint8_t* rsp, const uint8_t** tx, uint32_t* cb){
+	SimDevice* sd = link;
+	int next;
+
+	osMutexLock(&sd->lock);
+	rsp[FRAME_OP] = sd->cmd;
+	rsp[FRAME_STATUS] = sd->status;
+	putBE16(rsp + FRAME_ADDR, sd->addr);
+	putBE32(rsp + FRAME_DATA, sd->value);
+	*tx = sd->payloadTx;
+	*cb = sd->payloadLen;
+	next = sd->phase == PHASE_RECV ? SIM_NEXT_RECV : sd->phase == PHASE_SEND ? SIM_NEXT_SEND : SIM_NEXT_FRAME;
+	osMutexUnlock(&sd->lock);
+	return next;
+}
+
+/**
+* Gives the backing array of a register region of the model, so that
+* link_rtl.cpp can keep it in step with the RTL register RAM.
+*
+* @param link model opened through transportSim
+* @param index region, REGMAP_INDEX_<id>
+*
+* @return the array, count * width bytes
+*
+*/
+void* simRegionStore(void* link, int index){
+	return (uint8_t*)link + simRegions[index].offset;
+}
+
+/**
+* Gives a register of the model a new generation, for writes link_rtl.cpp
+* sees the RTL serve without the model.
+*
+* @param link model opened through transportSim
+* @param index region, REGMAP_INDEX_<id>
+* @param reg register offset in the region
+*
+*/
+void simRegionTouch(void* link, int index, uint32_t reg){
+	SimDevice* sd = link;
+
+	((uint32_t*)((uint8_t*)sd + simRegions[index].genOffset))[reg] = ++sd->generation;
+}
+
+const DspiTransport transportSim = {
+	"sim",
+	0,
+	simOpen,
+	simClose,
+	simPut,
+	simGet,
+	simCancel,
+	simSetTimeout,
+	NULL
+};
@@ -0,0 +1,90 @@
+/************************************************************************/
+/*                                                                      */
+/*    test.h  --  Checks for the headless tests of the host library     */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Every test is a program that runs its checks against the          */
+/*    simulated device and exits with 1 if any check failed, so ctest   */
+/*    runs it as is. A failed check prints where it failed and the      */
+/*    test goes on. A test takes the transport from its arguments:      */
+/*    none for -sim, "-sim options" or "-rtl options" for the RTL       */
+/*    co-simulation where it is built.                                  */
+/*                                                                      */
+/************************************************************************/
+
+#if !defined(DSPI_TEST_INCLUDED)
+#define      DSPI_TEST_INCLUDED
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dspi_dev.h"
+#include "dspi_link.h"
+
+static int cTestFailed;
+
+#define CHECK(cond) testCheck((cond) != 0, #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) testCheckEq((uint64_t)(a), (uint64_t)(b), #a, #b, __FILE__, __LINE__)
+
+static void testCheck(int fPassed, const char* what, const char* file, int line){
+	if(!fPassed){
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+		cTestFailed++;
+	}
+}
+
+static void testCheckEq(uint64_t a, uint64_t b, const char* what, const char* expect, const char* file, int line){
+	if(a != b){
+		fprintf(stderr, "%s:%d: check failed: %s == %s, got 0x%llX, expected 0x%llX\n", file, line,
+			what, expect, (unsigned long long)a, (unsigned long long)b);
+		cTestFailed++;
+	}
+}
+
+/**
+* Opens the device the arguments select, with extra simulator options.
+*
+* @param options appended to the device string, may be NULL
+*
+* @return 0 if passed, transport error code if failed
+*
+*/
+static int testOpen(DspiDev* dev, int argc, char* argv[], const char* options){
+	const DspiTransport* transport = &transportSim;
+	char device[256] = "";
+
+	if(argc > 1 && strcmp(argv[1], "-rtl") == 0){
+#if defined(DSPI_WITH_RTL)
+		transport = &transportRtl;
+#else
+		fprintf(stderr, "Built without the RTL co-simulation\n");
+		return -1;
+#endif
+	}
+	if(argc > 2){
+		snprintf(device, sizeof(device), "%s", argv[2]);
+	}
+	if(options != NULL){
+		snprintf(device + strlen(device), sizeof(device) - strlen(device), "%s%s", device[0] != '\0' ? "," : "", options);
+	}
+	return devOpen(dev, transport, device);
+}
+
+/**
+* Reports the result.
+*
+* @return exit status of the test
+*/
+static int testEnd(const char* name){
+	if(cTestFailed != 0){
+		fprintf(stderr, "%s: %d checks failed\n", name, cTestFailed);
+	}else{
+		printf("%s: passed\n", name);
+	}
+	return cTestFailed != 0;
+}
+
+#endif
@@ -0,0 +1,126 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_batch.c  --  Register batches and coalescing across threads  */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    devRegBatch() must send consecutive writes as one bulk write and  */
+/*    give every write its own status, a rejected one among them too.   */
+/*    Then threads write and read registers of their own through a      */
+/*    DspiBatch over a link with a 200 us round trip: each must get its */
+/*    own results, a rejected write must fail only its caller, and the  */
+/*    requests must have shared batches.                                */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "host_os.h"
+#include "dspi_batch.h"
+#include "dspi_metrics.h"
+
+#define TEST_THREADS 8
+#define TEST_ROUNDS 50
+#define TEST_RUN 8
+
+static DspiBatch batch;
+
+typedef struct {
+	uint16_t addr;
+	int cBad;
+} TestWorker;
+
+static void* testWorker(void* arg){
+	TestWorker* w = (TestWorker*)arg;
+	uint32_t val;
+	int i;
+
+	for(i = 0; i < TEST_ROUNDS; i++){
+		if(batchWrite(&batch, w->addr, (uint32_t)(w->addr << 16 | i)) != 0){
+			w->cBad++;
+		}
+		if(batchRead(&batch, w->addr, &val) != 0 || val != (uint32_t)(w->addr << 16 | i)){
+			w->cBad++;
+		}
+		//The read-only register fails this write and no one else's
+		if(w->addr == 0x0240 && batchWrite(&batch, 0x0000, 1) != -1){
+			w->cBad++;
+		}
+	}
+	return 0;
+}
+
+/**
+* Runs a bulk write run, a rejected write and single accesses as one batch.
+*/
+static void testRegBatch(DspiDev* dev, MetricsShard* shard){
+	RegOp ops[TEST_RUN + 4];
+	uint64_t bulk = shard->frames[op_bulk_write];
+	uint64_t writes = shard->frames[op_write];
+	int i;
+
+	memset(ops, 0, sizeof(ops));
+	for(i = 0; i < TEST_RUN; i++){
+		ops[i].op = op_write;
+		ops[i].addr = (uint16_t)(0x0220 + i);
+		ops[i].value = 0x100 + i;
+	}
+	ops[i].op = op_write;
+	ops[i++].addr = 0x0000;
+	ops[i].op = op_write;
+	ops[i].addr = 0x0230;
+	ops[i++].value = 0xABCD;
+	ops[i].op = op_read;
+	ops[i++].addr = 0x0223;
+	ops[i].op = op_read;
+	ops[i++].addr = 0x0230;
+
+	CHECK_EQ(devRegBatch(dev, ops, i), -1);
+	CHECK_EQ(shard->frames[op_bulk_write] - bulk, 1);
+	CHECK_EQ(shard->frames[op_write] - writes, 2);
+	for(i = 0; i < TEST_RUN; i++){
+		CHECK_EQ(ops[i].status, STATUS_OK);
+		CHECK_EQ(ops[i].value, 0x100 + i);
+	}
+	CHECK(ops[TEST_RUN].status != STATUS_OK && ops[TEST_RUN].status != STATUS_NO_REPLY);
+	CHECK_EQ(ops[TEST_RUN + 1].status, STATUS_OK);
+	CHECK_EQ(ops[TEST_RUN + 2].status, STATUS_OK);
+	CHECK_EQ(ops[TEST_RUN + 2].value, 0x103);
+	CHECK_EQ(ops[TEST_RUN + 3].status, STATUS_OK);
+	CHECK_EQ(ops[TEST_RUN + 3].value, 0xABCD);
+	CHECK_EQ(devRegBatch(dev, ops, 0), -1);
+}
+
+int main(int argc, char* argv[]){
+	static TestWorker workers[TEST_THREADS];
+	OsThread threads[TEST_THREADS];
+	MetricsShard* shard;
+	DspiDev dev;
+	int i;
+
+	metricsEnabled = 1;
+	if(testOpen(&dev, argc, argv, "usb=200") != 0 || (shard = metricsClaim()) == NULL){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testRegBatch(&dev, shard);
+
+	batchInit(&batch, &dev, BATCH_BUDGET_US, BATCH_MAX_OPS);
+	for(i = 0; i < TEST_THREADS; i++){
+		workers[i].addr = (uint16_t)(0x0240 + i);
+		if(osThreadStart(&threads[i], testWorker, &workers[i]) != 0){
+			fprintf(stderr, "Cannot start a worker thread\n");
+			return 1;
+		}
+	}
+	for(i = 0; i < TEST_THREADS; i++){
+		osThreadJoin(threads[i]);
+		CHECK_EQ(workers[i].cBad, 0);
+	}
+	CHECK_EQ(batch.ops, TEST_THREADS * TEST_ROUNDS * 2 + TEST_ROUNDS);
+	CHECK_EQ(batch.expired, 0);
+	CHECK(batch.batches < batch.ops / 2);
+	batchDestroy(&batch);
+	devClose(&dev);
+	return testEnd("batch");
+}
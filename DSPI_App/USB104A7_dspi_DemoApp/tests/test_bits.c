@@ -0,0 +1,92 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_bits.c  --  Set, clear, toggle and masked writes             */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Runs the bit commands on registers of every width, first with     */
+/*    firmware that serves them, then with firmware that lacks one at   */
+/*    a time. That command must fall back to a read and a write with    */
+/*    the same result, and never be sent.                               */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "dspi_metrics.h"
+
+static const uint16_t cAddrs[] = {0x0005, 0x0105, 0x0210};
+
+/**
+* Reads a register, 0 if the read failed.
+*/
+static uint32_t testRead(DspiDev* dev, uint16_t addr){
+	uint32_t val = 0;
+
+	CHECK_EQ(devRead(dev, &addr, &val, 1), 0);
+	return val;
+}
+
+/**
+* Checks every bit command on every width.
+*/
+static void testBits(DspiDev* dev){
+	uint8_t op = 0, status = 0;
+	uint16_t addr = 0;
+	int i;
+
+	for(i = 0; i < (int)(sizeof(cAddrs) / sizeof(cAddrs[0])); i++){
+		CHECK_EQ(devWrite(dev, cAddrs[i], 0x41), 0);
+		CHECK_EQ(devSetBits(dev, cAddrs[i], 0x12), 0);
+		CHECK_EQ(testRead(dev, cAddrs[i]), 0x53);
+		CHECK_EQ(devClearBits(dev, cAddrs[i], 0x03), 0);
+		CHECK_EQ(testRead(dev, cAddrs[i]), 0x50);
+		CHECK_EQ(devToggleBits(dev, cAddrs[i], 0x21), 0);
+		CHECK_EQ(testRead(dev, cAddrs[i]), 0x71);
+		CHECK_EQ(devMaskWrite(dev, cAddrs[i], 0x0F, 0xA6), 0);
+		CHECK_EQ(testRead(dev, cAddrs[i]), 0x76);
+	}
+	CHECK_EQ(devMaskWrite(dev, 0x0210, 0xFFFF0000, 0xCAFE1234), 0);
+	CHECK_EQ(testRead(dev, 0x0210), 0xCAFE0076);
+	CHECK(!devTakeRejected(dev, &op, &addr, &status));
+
+	//A bit command on a read-only register is rejected later, like a write
+	CHECK_EQ(devSetBits(dev, 0x0000, 0x1), 0);
+	testRead(dev, 0x0005);
+	CHECK(devTakeRejected(dev, &op, &addr, &status));
+	CHECK_EQ(addr, 0x0000);
+	CHECK(status != STATUS_OK);
+}
+
+int main(int argc, char* argv[]){
+	static const uint8_t missing[] = {op_set_bits, op_clear_bits, op_toggle_bits, op_mask_write};
+	MetricsShard* shard;
+	char options[16];
+	DspiDev dev;
+	int i;
+
+	metricsEnabled = 1;
+	if(testOpen(&dev, argc, argv, NULL) != 0 || (shard = metricsClaim()) == NULL){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testBits(&dev);
+	for(i = 0; i < (int)sizeof(missing); i++){
+		CHECK(shard->frames[missing[i]] != 0);
+	}
+	devClose(&dev);
+
+	for(i = 0; i < (int)sizeof(missing); i++){
+		snprintf(options, sizeof(options), "noop=0x%02X", missing[i]);
+		if(testOpen(&dev, argc, argv, options) != 0){
+			fprintf(stderr, "Cannot open the device with %s\n", options);
+			return 1;
+		}
+		CHECK(!devServes(&dev, missing[i]));
+		shard->frames[missing[i]] = 0;
+		testBits(&dev);
+		CHECK_EQ(shard->frames[missing[i]], 0);
+		devClose(&dev);
+	}
+	return testEnd("bits");
+}
@@ -0,0 +1,96 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_capture.c  --  Capture traces read by threads at once        */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Takes a capture of two registers, then two threads read the       */
+/*    finished trace over and over, one packed and one raw. Both must   */
+/*    get the samples the registers held every time.                    */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "host_os.h"
+#include "regmap.h"
+
+#define TEST_SAMPLES 2000
+#define TEST_CHANS 2
+#define TEST_ROUNDS 10000
+
+static DspiDev dev;
+static volatile uint32_t cStarted;
+
+typedef struct {
+	uint32_t cbPacked;	//0 reads the trace raw
+	uint32_t words[TEST_SAMPLES * TEST_CHANS];
+	int cBad;
+} TestReader;
+
+static void* testReader(void* arg){
+	TestReader* r = (TestReader*)arg;
+	uint8_t status;
+	int i, j;
+
+	//Start together, so the reads overlap from the first round on
+	osAtomicAdd(&cStarted, 1);
+	while(osAtomicLoad(&cStarted) < 2){
+		osSleepUs(1);
+	}
+	for(i = 0; i < TEST_ROUNDS; i++){
+		memset(r->words, 0, sizeof(r->words));
+		if(devCaptureTrace(&dev, r->words, TEST_SAMPLES * TEST_CHANS, TEST_CHANS, r->cbPacked, &status) != 0){
+			r->cBad++;
+			continue;
+		}
+		for(j = 0; j < TEST_SAMPLES; j++){
+			if(r->words[TEST_CHANS * j] != 0x11223344 || r->words[TEST_CHANS * j + 1] != 0xCAFE){
+				r->cBad++;
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]){
+	static TestReader packed, raw;
+	static const uint16_t regs[] = {REG_CAP_PERIOD, REG_CAP_CHANS, REG_CAP_SRC0, REG_CAP_SRC1,
+		REG_CAP_TRIG_MASK, REG_CAP_PRE, REG_CAP_POST};
+	static const uint32_t config[] = {CAPTURE_MIN_PERIOD_US, TEST_CHANS, 0x0210, 0x0105, 0, 0, TEST_SAMPLES};
+	uint16_t info[3] = {REG_CAP_LEN, REG_CAP_TRIG_AT, REG_CAP_ZLEN};
+	uint32_t vals[3];
+	uint32_t state = 0;
+	uint8_t status = STATUS_NO_REPLY;
+	OsThread thread;
+	int i;
+
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	CHECK_EQ(devWrite(&dev, 0x0210, 0x11223344), 0);
+	CHECK_EQ(devWrite(&dev, 0x0105, 0xCAFE), 0);
+	for(i = 0; i < (int)(sizeof(regs) / sizeof(regs[0])); i++){
+		CHECK_EQ(devWrite(&dev, regs[i], config[i]), 0);
+	}
+	CHECK_EQ(devWrite(&dev, REG_CAP_CTL, CAPTURE_CTL_ARM), 0);
+	CHECK_EQ(devWait(&dev, REG_CAP_CTL, 0x3, CAPTURE_DONE, 1000000, &state, &status), 0);
+	CHECK_EQ(devRead(&dev, info, vals, 3), 0);
+	CHECK_EQ(vals[0], TEST_SAMPLES);
+	CHECK(vals[2] != 0 && vals[2] < 4 * TEST_SAMPLES * TEST_CHANS);
+
+	packed.cbPacked = vals[2];
+	if(osThreadStart(&thread, testReader, &packed) != 0){
+		fprintf(stderr, "Cannot start the reader thread\n");
+		return 1;
+	}
+	testReader(&raw);
+	osThreadJoin(thread);
+	CHECK_EQ(packed.cBad, 0);
+	CHECK_EQ(raw.cBad, 0);
+
+	devClose(&dev);
+	return testEnd("capture");
+}
@@ -0,0 +1,70 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_cas.c  --  Compare-and-swap and device-side waits            */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    A swap must only write when the register holds the expected       */
+/*    value, and otherwise answer STATUS_MISMATCH with what it holds.   */
+/*    A wait must return at once when the masked bits already match,    */
+/*    and answer STATUS_TIMEOUT with the last sample, not before its    */
+/*    timeout, when they never do.                                      */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "host_os.h"
+
+#define TEST_TIMEOUT_US 3000
+
+int main(int argc, char* argv[]){
+	uint16_t addr = 0x0210;
+	uint32_t current = 0, val = 0;
+	uint8_t status = 0;
+	uint64_t startNs;
+	DspiDev dev;
+
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+
+	//Swap when the register holds expect
+	CHECK_EQ(devWrite(&dev, addr, 0x1234), 0);
+	CHECK_EQ(devCompareSwap(&dev, addr, 0x1234, 0x5678, &current, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	CHECK_EQ(devRead(&dev, &addr, &val, 1), 0);
+	CHECK_EQ(val, 0x5678);
+
+	//Leave it and report what it holds when it does not
+	CHECK_EQ(devCompareSwap(&dev, addr, 0x1234, 0x9ABC, &current, &status), -1);
+	CHECK_EQ(status, STATUS_MISMATCH);
+	CHECK_EQ(current, 0x5678);
+	CHECK_EQ(devRead(&dev, &addr, &val, 1), 0);
+	CHECK_EQ(val, 0x5678);
+	CHECK_EQ(devCompareSwap(&dev, 0x0FFF, 0, 1, &current, &status), -1);
+	CHECK(status != STATUS_OK && status != STATUS_MISMATCH);
+
+	//A wait on bits that already match costs no slice
+	startNs = osNowNs();
+	CHECK_EQ(devWait(&dev, addr, 0x00FF, 0xFF78, TEST_TIMEOUT_US, &current, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	CHECK_EQ(current, 0x5678);
+	CHECK(osNowNs() - startNs < (uint64_t)TEST_TIMEOUT_US * 1000);
+
+	//Bits that never match time out with the last sample
+	startNs = osNowNs();
+	CHECK_EQ(devWait(&dev, addr, 0x00FF, 0x0079, TEST_TIMEOUT_US, &current, &status), -1);
+	CHECK_EQ(status, STATUS_TIMEOUT);
+	CHECK_EQ(current, 0x5678);
+	CHECK(osNowNs() - startNs >= (uint64_t)TEST_TIMEOUT_US * 1000);
+
+	//The link is in sequence after both
+	CHECK_EQ(devWrite(&dev, addr, 0x79), 0);
+	CHECK_EQ(devWait(&dev, addr, 0x00FF, 0x0079, TEST_TIMEOUT_US, &current, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	CHECK_EQ(current, 0x79);
+	devClose(&dev);
+	return testEnd("cas");
+}
@@ -0,0 +1,180 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_cmd.c  --  Console command tokenizer and operand parsers     */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Splits lines into tokens, then parses values, registers and       */
+/*    register lists. Bad numbers, ranges and lists, unmapped           */
+/*    registers, lists longer than the array and values wider than a    */
+/*    register must be refused with the error dspi_cmd.h names. A list  */
+/*    that parsed is then written and read back on the simulated       */
+/*    device.                                                           */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "dspi_cmd.h"
+#include "regmap.h"
+
+static void testSplit(){
+	char line[CMD_MAX_TOKENS * 2 + 8];
+	CmdLine cl;
+	int i;
+
+	strcpy(line, "  write\tLED,4..5   0x3 \n");
+	CHECK_EQ(cmdSplit(line, &cl), 3);
+	CHECK(strcmp(cmdNext(&cl), "write") == 0);
+	CHECK(strcmp(cmdNext(&cl), "LED,4..5") == 0);
+	CHECK(strcmp(cmdNext(&cl), "0x3") == 0);
+	CHECK(cmdNext(&cl) == NULL);
+
+	strcpy(line, " \t ");
+	CHECK_EQ(cmdSplit(line, &cl), 0);
+	CHECK(cmdNext(&cl) == NULL);
+
+	for(i = 0; i < CMD_MAX_TOKENS; i++){
+		memcpy(line + 2 * i, "x ", 2);
+	}
+	line[2 * i] = '\0';
+	CHECK_EQ(cmdSplit(line, &cl), CMD_MAX_TOKENS);
+	for(i = 0; i < CMD_MAX_TOKENS; i++){
+		memcpy(line + 2 * i, "x ", 2);
+	}
+	strcpy(line + 2 * i, "y");
+	CHECK_EQ(cmdSplit(line, &cl), -1);
+
+	CHECK(cmdIs("ReAd", "read"));
+	CHECK(!cmdIs("reads", "read"));
+	CHECK(!cmdIs("rea", "read"));
+	CHECK(!cmdIs(NULL, "read"));
+}
+
+static void testValue(){
+	uint32_t val = 0;
+
+	CHECK_EQ(cmdValue("42", &val), 0);
+	CHECK_EQ(val, 42);
+	CHECK_EQ(cmdValue("0xFFFFFFFF", &val), 0);
+	CHECK_EQ(val, 0xFFFFFFFF);
+	CHECK_EQ(cmdValue("010", &val), 0);
+	CHECK_EQ(val, 8);
+	CHECK_EQ(cmdValue("0x100000000", &val), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdValue("-1", &val), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdValue("+1", &val), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdValue("12z", &val), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdValue("", &val), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdValue(NULL, &val), CMD_ERR_SYNTAX);
+	CHECK_EQ(val, 8);
+}
+
+static void testRegisters(){
+	uint16_t addrs[8];
+	uint16_t addr = 0;
+	uint32_t bad = 0;
+	int count = 0;
+
+	CHECK_EQ(cmdRegister("led", &addr, &bad), 0);
+	CHECK_EQ(addr, REG_LED);
+	CHECK_EQ(cmdRegister("0x0105", &addr, &bad), 0);
+	CHECK_EQ(addr, 0x0105);
+	CHECK_EQ(cmdRegister("0x0040", &addr, &bad), CMD_ERR_UNMAPPED);
+	CHECK_EQ(bad, 0x0040);
+	CHECK_EQ(cmdRegister("0x10000", &addr, &bad), CMD_ERR_UNMAPPED);
+	CHECK_EQ(bad, 0x10000);
+	CHECK_EQ(cmdRegister("nosuch", &addr, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegister(NULL, &addr, &bad), CMD_ERR_SYNTAX);
+
+	CHECK_EQ(cmdRegisters("btn,4..6,0x200", addrs, 8, &count, &bad), 0);
+	CHECK_EQ(count, 5);
+	CHECK(addrs[0] == REG_BTN && addrs[1] == 4 && addrs[2] == 5 && addrs[3] == 6 && addrs[4] == 0x0200);
+	CHECK_EQ(cmdRegisters("7..7", addrs, 8, &count, &bad), 0);
+	CHECK_EQ(count, 1);
+	CHECK_EQ(addrs[0], 7);
+	CHECK_EQ(cmdRegisters("led..3", addrs, 8, &count, &bad), 0);
+	CHECK_EQ(count, 3);
+
+	//Bad ranges and lists
+	CHECK_EQ(cmdRegisters("6..4", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("4..", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("..4", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("4...6", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("4,,5", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("4,", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters(",4", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("4..x", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("", addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters(NULL, addrs, 8, &count, &bad), CMD_ERR_SYNTAX);
+	CHECK_EQ(cmdRegisters("0x3E..0x41", addrs, 8, &count, &bad), CMD_ERR_UNMAPPED);
+	CHECK_EQ(bad, 0x40);
+	CHECK_EQ(cmdRegisters("1,2..9", addrs, 8, &count, &bad), CMD_ERR_TOO_MANY);
+	CHECK_EQ(count, 8);
+
+	CHECK(cmdIsBlock(addrs, 8));
+	addrs[0] = 0x003F;
+	addrs[1] = 0x0040;
+	CHECK(!cmdIsBlock(addrs, 2));
+	addrs[0] = 4;
+	addrs[1] = 6;
+	CHECK(!cmdIsBlock(addrs, 2));
+}
+
+static void testWidth(){
+	static const uint16_t addrs[] = {0x0210, 0x0105, 0x0005};
+
+	CHECK_EQ(cmdTooWide(addrs, 3, 0xFF), -1);
+	CHECK_EQ(cmdTooWide(addrs, 3, 0x100), 2);
+	CHECK_EQ(cmdTooWide(addrs, 2, 0x100), -1);
+	CHECK_EQ(cmdTooWide(addrs, 3, 0x10000), 1);
+	CHECK_EQ(cmdTooWide(addrs, 1, 0xFFFFFFFF), -1);
+}
+
+/**
+* Writes a value to every register of a list, as one bulk write if they are
+* a block, and reads them back.
+*/
+static void testDevice(DspiDev* dev, const char* list, uint32_t value){
+	uint16_t addrs[16];
+	uint32_t vals[16];
+	uint32_t bad = 0;
+	uint8_t status = 0;
+	int count = 0;
+	int i;
+
+	CHECK_EQ(cmdRegisters(list, addrs, 16, &count, &bad), 0);
+	CHECK_EQ(cmdTooWide(addrs, count, value), -1);
+	for(i = 0; i < count; i++){
+		vals[i] = value;
+	}
+	if(cmdIsBlock(addrs, count)){
+		CHECK_EQ(devBulkWrite(dev, addrs[0], vals, count, ENC_RAW, &status), 0);
+		CHECK_EQ(status, STATUS_OK);
+	}else{
+		for(i = 0; i < count; i++){
+			CHECK_EQ(devWrite(dev, addrs[i], value), 0);
+		}
+	}
+	memset(vals, 0, sizeof(vals));
+	CHECK_EQ(devRead(dev, addrs, vals, count), 0);
+	for(i = 0; i < count; i++){
+		CHECK_EQ(vals[i], value);
+	}
+}
+
+int main(int argc, char* argv[]){
+	DspiDev dev;
+
+	testSplit();
+	testValue();
+	testRegisters();
+	testWidth();
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testDevice(&dev, "0x1000..0x100F", 0x12345678);
+	testDevice(&dev, "led,4..6,0x0105", 0x3C);
+	devClose(&dev);
+	return testEnd("cmd");
+}
@@ -0,0 +1,106 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_codec.c  --  ENC_DZV round trips                             */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "dspi_codec.h"
+
+#define TEST_WORDS 300
+
+/**
+* Fills words with one of the test patterns.
+*/
+static void testPattern(int pattern, uint32_t* words, uint32_t count){
+	uint32_t seed = 12345;
+	uint32_t i;
+
+	for(i = 0; i < count; i++){
+		seed = seed * 1103515245 + 12345;
+		switch(pattern){
+		case 0: words[i] = 0; break;
+		case 1: words[i] = 0xDEADBEEF; break;
+		case 2: words[i] = i * 3; break;	//ramp
+		case 3: words[i] = (i & 1) ? 0x80000000 : 0x7FFFFFFF; break;	//largest deltas
+		case 4: words[i] = seed % 7 == 0 ? seed : 0; break;	//sparse
+		default: words[i] = seed; break;
+		}
+	}
+}
+
+/**
+* Encodes words and decodes them again, whole and split by a small buffer.
+*/
+static void testRoundTrip(int pattern, uint32_t stride){
+	uint32_t words[TEST_WORDS];
+	uint32_t back[TEST_WORDS];
+	uint8_t buf[DZV_MAX_SIZE(TEST_WORDS)];
+	uint32_t n, cb, done;
+
+	testPattern(pattern, words, TEST_WORDS);
+	n = dzvEncode(words, TEST_WORDS, stride, buf, sizeof(buf), &cb);
+	CHECK_EQ(n, TEST_WORDS);
+	CHECK(cb <= DZV_MAX_SIZE(TEST_WORDS));
+	memset(back, 0xA5, sizeof(back));
+	CHECK_EQ(dzvDecode(buf, cb, back, TEST_WORDS, stride), 0);
+	CHECK(memcmp(back, words, sizeof(words)) == 0);
+
+	//A decoder that expects another count rejects the data
+	if(cb > 0){
+		CHECK_EQ(dzvDecode(buf, cb, back, TEST_WORDS + 1, stride), -1);
+		CHECK_EQ(dzvDecode(buf, cb - 1, back, TEST_WORDS, stride), -1);
+	}
+
+	//Payloads of 64 bytes, each decodes on its own
+	for(done = 0; done < TEST_WORDS; done += n){
+		n = dzvEncode(words + done, TEST_WORDS - done, stride, buf, 64, &cb);
+		CHECK(n != 0);
+		CHECK(cb <= 64);
+		if(n == 0){
+			break;
+		}
+		CHECK_EQ(dzvDecode(buf, cb, back + done, n, stride), 0);
+	}
+	CHECK(memcmp(back, words, sizeof(words)) == 0);
+}
+
+int main(int argc, char* argv[]){
+	uint32_t words[TEST_WORDS];
+	uint32_t back[TEST_WORDS];
+	uint16_t addrs[TEST_WORDS];
+	uint8_t buf[DZV_MAX_SIZE(TEST_WORDS)];
+	uint8_t status = STATUS_NO_REPLY;
+	uint32_t cbZero, cb, i;
+	DspiDev dev;
+	int pattern;
+
+	for(pattern = 0; pattern < 6; pattern++){
+		testRoundTrip(pattern, 1);
+		testRoundTrip(pattern, 3);
+	}
+
+	//Runs of zeros pack well below ENC_RAW
+	testPattern(0, words, TEST_WORDS);
+	dzvEncode(words, TEST_WORDS, 1, buf, sizeof(buf), &cbZero);
+	CHECK(cbZero < TEST_WORDS);
+	testPattern(5, words, TEST_WORDS);
+	dzvEncode(words, TEST_WORDS, 1, buf, sizeof(buf), &cb);
+	CHECK(cb > cbZero);
+
+	//Through the device: op_bulk_write decodes on the firmware side
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testPattern(4, words, TEST_WORDS);
+	for(i = 0; i < TEST_WORDS; i++){
+		addrs[i] = (uint16_t)(0x1000 + i);
+	}
+	CHECK_EQ(devBulkWrite(&dev, 0x1000, words, TEST_WORDS, ENC_DZV, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	CHECK_EQ(devRead(&dev, addrs, back, TEST_WORDS), 0);
+	CHECK(memcmp(back, words, sizeof(words)) == 0);
+	devClose(&dev);
+	return testEnd("codec");
+}
@@ -0,0 +1,89 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_delta.c  --  Delta readout of the registers written          */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+
+#define TEST_BASE 0x0200
+#define TEST_REGS 64
+
+/**
+* Reads the run the plain way and compares it with the copy.
+*/
+static void testSame(DspiDev* dev, const uint32_t* copy){
+	uint16_t addrs[TEST_REGS];
+	uint32_t vals[TEST_REGS];
+	int i;
+
+	for(i = 0; i < TEST_REGS; i++){
+		addrs[i] = (uint16_t)(TEST_BASE + i);
+	}
+	CHECK_EQ(devRead(dev, addrs, vals, TEST_REGS), 0);
+	CHECK(memcmp(vals, copy, sizeof(vals)) == 0);
+}
+
+/**
+* Writes a few registers, one of them twice, and one bulk run, checking
+* after each that a delta read brings the copy up to date with only the
+* registers written.
+*/
+static void testSync(DspiDev* dev, int fGenerations){
+	uint32_t copy[TEST_REGS];
+	uint32_t bulk[10];
+	uint32_t gen = 0, last;
+	uint32_t cChanged = 0;
+	uint8_t status = STATUS_NO_REPLY;
+	int i;
+
+	memset(copy, 0, sizeof(copy));
+	CHECK_EQ(devDeltaRead(dev, TEST_BASE, TEST_REGS, &gen, copy, &cChanged, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	testSame(dev, copy);
+	CHECK_EQ(gen != 0, fGenerations);
+
+	last = gen;
+	CHECK_EQ(devWrite(dev, TEST_BASE + 1, copy[1] + 1), 0);
+	CHECK_EQ(devWrite(dev, TEST_BASE + 7, copy[7] + 7), 0);
+	CHECK_EQ(devWrite(dev, TEST_BASE + 7, copy[7] + 8), 0);
+	CHECK_EQ(devWrite(dev, TEST_BASE + 63, copy[63] + 63), 0);
+	CHECK_EQ(devDeltaRead(dev, TEST_BASE, TEST_REGS, &gen, copy, &cChanged, &status), 0);
+	CHECK_EQ(cChanged, 3);
+	testSame(dev, copy);
+	if(fGenerations){
+		CHECK(gen > last);
+	}
+
+	CHECK_EQ(devDeltaRead(dev, TEST_BASE, TEST_REGS, &gen, copy, &cChanged, &status), 0);
+	CHECK_EQ(cChanged, 0);
+
+	for(i = 0; i < 10; i++){
+		bulk[i] = copy[20 + i] ^ 0xFFFF0000;
+	}
+	CHECK_EQ(devBulkWrite(dev, TEST_BASE + 20, bulk, 10, ENC_RAW, &status), 0);
+	CHECK_EQ(devDeltaRead(dev, TEST_BASE, TEST_REGS, &gen, copy, &cChanged, &status), 0);
+	CHECK_EQ(cChanged, 10);
+	testSame(dev, copy);
+
+	//A run that leaves its region is rejected
+	CHECK_EQ(devDeltaRead(dev, 0x02F8, 16, &gen, copy, &cChanged, &status), -1);
+	CHECK_EQ(status, STATUS_BAD_ADDR);
+}
+
+int main(int argc, char* argv[]){
+	DspiDev dev;
+
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testSync(&dev, 1);
+	devClose(&dev);
+
+	//Firmware without op_delta_scan: the run is read and compared
+	CHECK_EQ(testOpen(&dev, argc, argv, "legacy=1"), 0);
+	testSync(&dev, 0);
+	devClose(&dev);
+	return testEnd("delta");
+}
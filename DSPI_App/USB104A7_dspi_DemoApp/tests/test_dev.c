@@ -0,0 +1,70 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_dev.c  --  Open, identify and register round trips           */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "regmap.h"
+
+/**
+* Checks what op_identify reported.
+*/
+static void testIdentify(DspiDev* dev){
+	CHECK_EQ(dev->caps.protocol, PROTOCOL_VERSION);
+	CHECK(dev->caps.firmware != 0);
+	CHECK_EQ(dev->caps.registers, REGMAP_N_REGS);
+	CHECK_EQ(dev->caps.payloadSize, PAYLOAD_SIZE);
+	CHECK(dev->caps.features & FEATURE_DZV);
+	CHECK(devServes(dev, op_identify));
+	CHECK(devServes(dev, op_axi_batch));
+	CHECK(!devServes(dev, 0xFE));
+}
+
+/**
+* Writes registers of every width and reads them back.
+*/
+static void testRoundTrip(DspiDev* dev){
+	static const uint16_t addrs[] = {0x0005, 0x0105, 0x0205, 0x1005};
+	static const uint32_t vals[] = {0xA5, 0xBEEF, 0xDEADBEEF, 0x12345678};
+	uint32_t got[4];
+	uint8_t op = 0;
+	uint16_t addr = 0;
+	uint8_t status = 0;
+	int i;
+
+	for(i = 0; i < 4; i++){
+		CHECK_EQ(devWrite(dev, addrs[i], vals[i]), 0);
+	}
+	CHECK_EQ(devRead(dev, addrs, got, 4), 0);
+	for(i = 0; i < 4; i++){
+		CHECK_EQ(got[i], vals[i]);
+	}
+	CHECK(!devTakeRejected(dev, &op, &addr, &status));
+
+	//A write to a read-only register is posted, its rejection comes later
+	CHECK_EQ(devWrite(dev, 0x0000, 1), 0);
+	CHECK_EQ(devRead(dev, addrs, got, 1), 0);
+	CHECK(devTakeRejected(dev, &op, &addr, &status));
+	CHECK_EQ(op, op_write);
+	CHECK_EQ(addr, 0x0000);
+	CHECK(status != STATUS_OK);
+
+	//Unmapped registers are rejected
+	addr = 0x0FFF;
+	CHECK_EQ(devRead(dev, &addr, got, 1), -1);
+	CHECK_EQ(got[0], 0);
+}
+
+int main(int argc, char* argv[]){
+	DspiDev dev;
+
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testIdentify(&dev);
+	testRoundTrip(&dev);
+	devClose(&dev);
+	return testEnd("dev");
+}
@@ -0,0 +1,82 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_drop.c  --  Frames the fabric drops as too early             */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    The simulated device drops every third frame with STATUS_DROPPED, */
+/*    the RTL co-simulation every frame that comes before the slow      */
+/*    firmware staged its response. Posted writes, bit commands, bulk   */
+/*    writes and batches must all arrive, with every response in        */
+/*    sequence, and a device that drops every frame must fail the call  */
+/*    instead of hanging.                                               */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "regmap.h"
+#include "dspi_metrics.h"
+
+#define TEST_REGS 16
+
+int main(int argc, char* argv[]){
+	int fRtl = argc > 1 && strcmp(argv[1], "-rtl") == 0;
+	uint16_t addrs[TEST_REGS];
+	uint32_t vals[TEST_REGS], got[TEST_REGS];
+	RegOp ops[4];
+	MetricsShard* shard;
+	DspiDev dev;
+	uint8_t op = 0, status = 0;
+	uint16_t addr = 0;
+	int i;
+
+	metricsEnabled = 1;
+	if(testOpen(&dev, argc, argv, fRtl ? "strict=1,fw=50000" : "drop=3") != 0 || (shard = metricsClaim()) == NULL){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	for(i = 0; i < TEST_REGS; i++){
+		addrs[i] = (uint16_t)(0x0220 + i);
+		vals[i] = 0x7000 + i;
+		CHECK_EQ(devWrite(&dev, addrs[i], vals[i]), 0);
+	}
+	CHECK_EQ(devWrite(&dev, REG_LED, 0x5), 0);
+	CHECK_EQ(devSetBits(&dev, 0x0230, 0x11), 0);
+	CHECK_EQ(devToggleBits(&dev, 0x0230, 0x01), 0);
+	CHECK_EQ(devBulkWrite(&dev, 0x1100, vals, TEST_REGS, ENC_DZV, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+
+	CHECK_EQ(devRead(&dev, addrs, got, TEST_REGS), 0);
+	CHECK(memcmp(got, vals, sizeof(vals)) == 0);
+	for(i = 0; i < TEST_REGS; i++){
+		addrs[i] = (uint16_t)(0x1100 + i);
+	}
+	CHECK_EQ(devRead(&dev, addrs, got, TEST_REGS), 0);
+	CHECK(memcmp(got, vals, sizeof(vals)) == 0);
+
+	ops[0].op = op_read;
+	ops[0].addr = REG_LED;
+	ops[1].op = op_read;
+	ops[1].addr = 0x0230;
+	ops[2].op = op_write;
+	ops[2].addr = 0x0231;
+	ops[2].value = 0x42;
+	ops[3].op = op_read;
+	ops[3].addr = 0x0231;
+	CHECK_EQ(devRegBatch(&dev, ops, 4), 0);
+	CHECK_EQ(ops[0].value, 0x5);
+	CHECK_EQ(ops[1].value, 0x10);
+	CHECK_EQ(ops[3].value, 0x42);
+
+	//Nothing rejected, nothing out of sequence, and there were drops
+	CHECK(!devTakeRejected(&dev, &op, &addr, &status));
+	CHECK_EQ(shard->sequence, 0);
+	CHECK(shard->statuses[STATUS_DROPPED] != 0);
+	devClose(&dev);
+
+	if(!fRtl){
+		CHECK(testOpen(&dev, argc, argv, "drop=1") != 0);
+	}
+	return testEnd("drop");
+}
@@ -0,0 +1,147 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_identify.c  --  Capability discovery and its fallbacks       */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Firmware from before op_identify must get the PROTOCOL_LEGACY     */
+/*    set with the link still in sequence, and firmware without an      */
+/*    opcode must never be sent it: operations with a frame fallback    */
+/*    take it, those without one fail with STATUS_BAD_OP. Runs on the   */
+/*    simulated device only, its options model the older firmware.     */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "dspi_metrics.h"
+
+#define TEST_REGS 8
+
+/**
+* Writes registers, reads them back and checks nothing was out of sequence.
+*/
+static void testInSequence(DspiDev* dev, MetricsShard* shard){
+	uint16_t addrs[TEST_REGS];
+	uint32_t vals[TEST_REGS];
+	uint8_t status = 0;
+	int i;
+
+	for(i = 0; i < TEST_REGS; i++){
+		addrs[i] = (uint16_t)(0x0200 + i);
+		vals[i] = 0x3000 + i;
+	}
+	CHECK_EQ(devBulkWrite(dev, addrs[0], vals, TEST_REGS, ENC_DZV, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	memset(vals, 0, sizeof(vals));
+	CHECK_EQ(devRead(dev, addrs, vals, TEST_REGS), 0);
+	for(i = 0; i < TEST_REGS; i++){
+		CHECK_EQ(vals[i], 0x3000 + i);
+	}
+	CHECK_EQ(shard->sequence, 0);
+}
+
+static int testLegacy(DspiDev* dev, MetricsShard* shard, int argc, char* argv[]){
+	uint32_t vals[TEST_REGS];
+	uint32_t gen = 5, cChanged = 0;
+	uint8_t status = 0;
+
+	if(testOpen(dev, argc, argv, "legacy=1") != 0){
+		fprintf(stderr, "Cannot open the device with legacy=1\n");
+		return -1;
+	}
+	CHECK_EQ(dev->caps.protocol, PROTOCOL_LEGACY);
+	CHECK_EQ(dev->caps.firmware, 0);
+	CHECK_EQ(dev->caps.registers, REGMAP_N_REGS);
+	CHECK_EQ(dev->caps.payloadSize, PAYLOAD_SIZE);
+	CHECK_EQ(dev->caps.bulkWords, BULK_MAX_WORDS);
+	CHECK_EQ(dev->caps.bridgeOps, BRIDGE_MAX_OPS);
+	CHECK_EQ(dev->caps.features, FEATURE_DZV);
+	CHECK_EQ(dev->fabric, 0);
+	CHECK(devServes(dev, op_bulk_write));
+	CHECK(devServes(dev, op_cas));
+	CHECK(!devServes(dev, op_identify));
+	CHECK(!devServes(dev, op_delta_scan));
+	CHECK(!devServes(dev, op_trace));
+
+	//The answer to the rejected op_identify was collected, the link is in sequence
+	testInSequence(dev, shard);
+
+	//Delta reads fall back to reading every register
+	shard->frames[op_delta_scan] = 0;
+	CHECK_EQ(devDeltaRead(dev, 0x0200, TEST_REGS, &gen, vals, &cChanged, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	CHECK_EQ(gen, 0);
+	CHECK_EQ(vals[TEST_REGS - 1], 0x3000 + TEST_REGS - 1);
+	CHECK_EQ(shard->frames[op_delta_scan], 0);
+	devClose(dev);
+	return 0;
+}
+
+static int testMissing(DspiDev* dev, MetricsShard* shard, int argc, char* argv[]){
+	static const uint8_t code[4] = {0};
+	AxiOp axi;
+	uint8_t status = 0;
+
+	//Bulk writes fall back to a frame per register
+	if(testOpen(dev, argc, argv, "noop=0xC3") != 0){
+		fprintf(stderr, "Cannot open the device with noop=0xC3\n");
+		return -1;
+	}
+	CHECK_EQ(dev->caps.protocol, PROTOCOL_VERSION);
+	CHECK(!devServes(dev, op_bulk_write));
+	CHECK(devServes(dev, op_script_load));
+	shard->frames[op_bulk_write] = 0;
+	testInSequence(dev, shard);
+	CHECK_EQ(shard->frames[op_bulk_write], 0);
+	devClose(dev);
+
+	//Payload commands without a fallback are refused on the host
+	if(testOpen(dev, argc, argv, "noop=0xC1") != 0){
+		fprintf(stderr, "Cannot open the device with noop=0xC1\n");
+		return -1;
+	}
+	shard->frames[op_script_load] = 0;
+	CHECK_EQ(devScriptLoad(dev, 0, code, sizeof(code), &status), -1);
+	CHECK_EQ(status, STATUS_BAD_OP);
+	CHECK_EQ(shard->frames[op_script_load], 0);
+	testInSequence(dev, shard);
+	devClose(dev);
+
+	if(testOpen(dev, argc, argv, "noop=0xC0") != 0){
+		fprintf(stderr, "Cannot open the device with noop=0xC0\n");
+		return -1;
+	}
+	axi.kind = BRIDGE_READ;
+	axi.addr = 0;
+	axi.value = 0;
+	shard->frames[op_axi_batch] = 0;
+	CHECK_EQ(devAxiBatch(dev, &axi, 1), -1);
+	CHECK_EQ(axi.status, STATUS_BAD_OP);
+	CHECK_EQ(shard->frames[op_axi_batch], 0);
+	devClose(dev);
+	return 0;
+}
+
+int main(int argc, char* argv[]){
+	MetricsShard* shard;
+	DspiDev dev;
+
+	metricsEnabled = 1;
+	if((shard = metricsClaim()) == NULL){
+		fprintf(stderr, "Cannot count frames\n");
+		return 1;
+	}
+	if(testOpen(&dev, argc, argv, "fabric=1") != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	CHECK(dev.caps.features & FEATURE_FABRIC);
+	CHECK_EQ(dev.fabric, 1);
+	devClose(&dev);
+
+	if(testLegacy(&dev, shard, argc, argv) != 0 || testMissing(&dev, shard, argc, argv) != 0){
+		return 1;
+	}
+	return testEnd("identify");
+}
@@ -0,0 +1,214 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_log.c  --  JSON-lines and binary operation logs              */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Writes the same records in both formats to a temporary file and   */
+/*    checks every line and byte against the layouts of dspi_log.h,     */
+/*    and that nothing is written before the buffer is flushed or full. */
+/*    Then logs a read and a late rejection from the simulated device   */
+/*    the way the console application does.                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "host_os.h"
+#include "dspi_log.h"
+
+#define TEST_RECORDS 3
+
+static LogWriter writer;
+static char text[LOG_BUFFER_SIZE];
+
+static const LogRecord cRecords[TEST_RECORDS] = {
+	{0, 120000, 0x0005, 5, 0, op_read, STATUS_OK},
+	{0, 1500, 0x0210, 0xDEADBEEF, 0, op_write, STATUS_NO_REPLY},
+	{0, 0, 0x0000, op_set_bits, -1, LOG_OP_REJECTED, STATUS_DENIED}
+};
+
+static uint32_t getLE32(const uint8_t* p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+* Reads what was written to fp so far.
+*
+* @return bytes read
+*/
+static size_t testReadBack(FILE* fp){
+	size_t cb;
+
+	rewind(fp);
+	cb = fread(text, 1, sizeof(text) - 1, fp);
+	text[cb] = '\0';
+	fseek(fp, 0, SEEK_END);
+	return cb;
+}
+
+/**
+* Logs cRecords, 10.5 us apart from the start of the log.
+*/
+static void testLogRecords(){
+	LogRecord rec;
+	int i;
+
+	for(i = 0; i < TEST_RECORDS; i++){
+		rec = cRecords[i];
+		rec.tNs = writer.startNs + 10500 * (uint64_t)(i + 1);
+		logRecord(&writer, &rec);
+	}
+}
+
+static void testJson(){
+	FILE* fp = tmpfile();
+	char* line;
+	int i;
+
+	CHECK(fp != NULL);
+	if(fp == NULL){
+		return;
+	}
+	CHECK_EQ(logOpen(&writer, LOG_JSON, fp), 0);
+	testLogRecords();
+	CHECK_EQ(testReadBack(fp), 0);
+	logFlush(&writer);
+	testReadBack(fp);
+
+	line = strtok(text, "\n");
+	CHECK(line != NULL && strncmp(line, "{\"log\": \"dspi\", \"version\": 1, \"start_unix_s\": ", 46) == 0);
+	for(i = 0; i < TEST_RECORDS; i++){
+		line = strtok(NULL, "\n");
+		CHECK(line != NULL);
+		if(line == NULL){
+			break;
+		}
+		switch(i){
+			case 0:
+				CHECK(strcmp(line, "{\"t_us\": 10.5, \"op\": \"read\", \"addr\": 5, \"value\": 5, \"status\": 0, \"result\": 0, \"latency_us\": 120.0}") == 0);
+				break;
+			case 1:
+				CHECK(strcmp(line, "{\"t_us\": 21.0, \"op\": \"write\", \"addr\": 528, \"value\": 3735928559, \"status\": 255, \"result\": 0, \"latency_us\": 1.5}") == 0);
+				break;
+			default:
+				CHECK(strcmp(line, "{\"t_us\": 31.5, \"op\": \"rejected\", \"addr\": 0, \"value\": 161, \"status\": 4, \"result\": -1, \"latency_us\": 0.0}") == 0);
+		}
+	}
+	CHECK(strtok(NULL, "\n") == NULL);
+	fclose(fp);
+}
+
+static void testBinary(){
+	FILE* fp = tmpfile();
+	const uint8_t* p = (const uint8_t*)text;
+	size_t cb;
+	int i;
+
+	CHECK(fp != NULL);
+	if(fp == NULL){
+		return;
+	}
+	CHECK_EQ(logOpen(&writer, LOG_BINARY, fp), 0);
+	testLogRecords();
+	logFlush(&writer);
+	cb = testReadBack(fp);
+	CHECK_EQ(cb, 16 + TEST_RECORDS * LOG_BINARY_SIZE);
+	CHECK(memcmp(p, "DSPILOG\x01", 8) == 0);
+	CHECK(getLE32(p + 8) != 0);
+	for(i = 0; i < TEST_RECORDS && cb == 16 + TEST_RECORDS * LOG_BINARY_SIZE; i++){
+		p = (const uint8_t*)text + 16 + i * LOG_BINARY_SIZE;
+		CHECK_EQ(getLE32(p), 10500 * (i + 1));
+		CHECK_EQ(getLE32(p + 4), 0);
+		CHECK_EQ(getLE32(p + 8), cRecords[i].latencyNs);
+		CHECK_EQ(getLE32(p + 12), cRecords[i].addr);
+		CHECK_EQ(getLE32(p + 16), cRecords[i].value);
+		CHECK_EQ(getLE32(p + 20), (uint32_t)cRecords[i].result);
+		CHECK_EQ(p[24], cRecords[i].op);
+		CHECK_EQ(p[25], cRecords[i].status);
+		CHECK_EQ(p[26] | p[27], 0);
+	}
+	fclose(fp);
+}
+
+/**
+* A full buffer is written out before the record that might not fit.
+*/
+static void testFull(){
+	FILE* fp = tmpfile();
+	int count = (LOG_BUFFER_SIZE - 16 - LOG_RECORD_MAX) / LOG_BINARY_SIZE + 1;
+	LogRecord rec = {0};
+	int i;
+
+	CHECK(fp != NULL);
+	if(fp == NULL){
+		return;
+	}
+	CHECK_EQ(logOpen(&writer, LOG_BINARY, fp), 0);
+	rec.tNs = writer.startNs;
+	for(i = 0; i < count; i++){
+		logRecord(&writer, &rec);
+	}
+	CHECK_EQ(testReadBack(fp), 0);
+	logRecord(&writer, &rec);
+	CHECK_EQ(testReadBack(fp), 16 + count * LOG_BINARY_SIZE);
+	CHECK_EQ(writer.cb, LOG_BINARY_SIZE);
+	fclose(fp);
+}
+
+/**
+* Logs device operations with their results, latency and late rejections.
+*/
+static void testDevice(DspiDev* dev){
+	FILE* fp = tmpfile();
+	LogRecord rec;
+	uint16_t addr = 0x0005;
+	uint32_t val = 0;
+	uint8_t op = 0, status = 0;
+
+	CHECK(fp != NULL);
+	if(fp == NULL){
+		return;
+	}
+	CHECK_EQ(logOpen(&writer, LOG_JSON, fp), 0);
+	CHECK_EQ(devWrite(dev, addr, 0xA5), 0);
+	CHECK_EQ(devWrite(dev, 0x0000, 1), 0);
+	rec.tNs = osNowNs();
+	rec.result = devRead(dev, &addr, &val, 1);
+	rec.latencyNs = (uint32_t)(osNowNs() - rec.tNs);
+	rec.op = op_read;
+	rec.addr = addr;
+	rec.value = val;
+	rec.status = rec.result == 0 ? STATUS_OK : STATUS_NO_REPLY;
+	logRecord(&writer, &rec);
+	CHECK(devTakeRejected(dev, &op, &addr, &status));
+	rec.tNs = osNowNs();
+	rec.latencyNs = 0;
+	rec.op = LOG_OP_REJECTED;
+	rec.addr = addr;
+	rec.value = op;
+	rec.status = status;
+	rec.result = -1;
+	logRecord(&writer, &rec);
+	logFlush(&writer);
+	testReadBack(fp);
+	CHECK(strstr(text, "\"op\": \"read\", \"addr\": 5, \"value\": 165, \"status\": 0, \"result\": 0, \"latency_us\": ") != NULL);
+	CHECK(strstr(text, "\"op\": \"rejected\", \"addr\": 0, \"value\": 170, \"status\": ") != NULL);
+	fclose(fp);
+}
+
+int main(int argc, char* argv[]){
+	DspiDev dev;
+
+	CHECK_EQ(logOpen(&writer, LOG_OFF, stdout), -1);
+	testJson();
+	testBinary();
+	testFull();
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testDevice(&dev);
+	devClose(&dev);
+	return testEnd("log");
+}
@@ -0,0 +1,146 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_metrics.c  --  Scrape of the Prometheus endpoint             */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Two threads count into shards of their own, then GET /metrics     */
+/*    must return their sums over a socket like a scraper sees them.    */
+/*                                                                      */
+/************************************************************************/
+
+#if defined(WIN32)
+	#include <winsock2.h>
+	typedef SOCKET TestSocket;
+	#define testCloseSocket closesocket
+	#define TEST_NO_SOCKET INVALID_SOCKET
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <unistd.h>
+	typedef int TestSocket;
+	#define testCloseSocket close
+	#define TEST_NO_SOCKET (-1)
+#endif
+
+#include "test.h"
+#include "dspi_metrics.h"
+
+#define TEST_WRITES 100
+
+static DspiDev dev;
+static MetricsServer server;
+static char text[METRICS_TEXT_SIZE];
+
+static void* testWriter(void* arg){
+	int i;
+
+	(void)arg;
+	for(i = 0; i < TEST_WRITES; i++){
+		devWrite(&dev, 0x0210, i);
+	}
+	return 0;
+}
+
+/**
+* Sends a request to the server and reads the answer until it hangs up.
+*
+* @return bytes read, 0 if the server could not be reached
+*/
+static size_t testGet(const char* path){
+	struct sockaddr_in sa;
+	TestSocket s;
+	size_t n = 0;
+	int r;
+
+	text[0] = '\0';
+	if((s = socket(AF_INET, SOCK_STREAM, 0)) == TEST_NO_SOCKET){
+		return 0;
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(server.port);
+	sa.sin_addr.s_addr = inet_addr("127.0.0.1");
+	if(connect(s, (struct sockaddr*)&sa, sizeof(sa)) != 0){
+		testCloseSocket(s);
+		return 0;
+	}
+	snprintf(text, sizeof(text), "GET %s HTTP/1.0\r\nHost: localhost\r\n\r\n", path);
+	send(s, text, (int)strlen(text), 0);
+	while(n < sizeof(text) - 1 && (r = recv(s, text + n, (int)(sizeof(text) - 1 - n), 0)) > 0){
+		n += r;
+	}
+	text[n] = '\0';
+	testCloseSocket(s);
+	return n;
+}
+
+/**
+* @return the value of a sample in the scrape, -1 if it is missing
+*/
+static double testSample(const char* sample){
+	const char* p = text;
+	size_t cb = strlen(sample);
+	double v;
+
+	while((p = strstr(p, sample)) != NULL){
+		if((p == text || p[-1] == '\n') && p[cb] == ' ' && sscanf(p + cb, "%lf", &v) == 1){
+			return v;
+		}
+		p += cb;
+	}
+	return -1;
+}
+
+int main(int argc, char* argv[]){
+	OsThread thread;
+	uint16_t addr = 0x0210;
+	uint32_t val;
+	int i;
+
+	//Shards of two threads never share a cache line
+	CHECK_EQ(sizeof(MetricsShard) % METRICS_CACHE_LINE, 0);
+	CHECK_EQ((uintptr_t)metricsClaim() % METRICS_CACHE_LINE, 0);
+
+	metricsEnabled = 1;
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	if(osThreadStart(&thread, testWriter, NULL) != 0){
+		fprintf(stderr, "Cannot start the writer thread\n");
+		return 1;
+	}
+	for(i = 0; i < TEST_WRITES; i++){
+		devWrite(&dev, 0x0211, i);
+	}
+	osThreadJoin(thread);
+	CHECK_EQ(devWrite(&dev, 0x0000, 1), 0);	//read only, rejected
+	CHECK_EQ(devRead(&dev, &addr, &val, 1), 0);
+
+	CHECK_EQ(metricsServe(&server, NULL, 0), 0);
+	CHECK(server.port != 0);
+	CHECK(testGet("/metrics") > 0);
+	CHECK(strncmp(text, "HTTP/1.0 200 OK\r\n", 17) == 0);
+	CHECK(strstr(text, "Content-Type: text/plain; version=0.0.4\r\n") != NULL);
+	CHECK(strstr(text, "# TYPE dspi_transaction_duration_seconds histogram\n") != NULL);
+	CHECK_EQ(testSample("dspi_frames_total{op=\"write\"}"), 2 * TEST_WRITES + 1);
+	CHECK_EQ(testSample("dspi_device_status_total{status=\"4\"}"), 1);
+	CHECK_EQ(testSample("dspi_device_opens_total"), 1);
+	CHECK_EQ(testSample("dspi_device_up"), 1);
+	CHECK_EQ(testSample("dspi_lock_queue_depth"), 0);
+	CHECK(testSample("dspi_transactions_total") >= 2 * TEST_WRITES + 2);
+	CHECK_EQ(testSample("dspi_transaction_duration_seconds_bucket{le=\"+Inf\"}"), testSample("dspi_transactions_total"));
+
+	CHECK(testGet("/other") > 0);
+	CHECK(strncmp(text, "HTTP/1.0 404", 12) == 0);
+
+	devClose(&dev);
+	CHECK(testGet("/metrics") > 0);
+	CHECK_EQ(testSample("dspi_device_up"), 0);
+	metricsStop(&server);
+	return testEnd("metrics");
+}
@@ -0,0 +1,70 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_regmap.c  --  Register map lookups and cacheable reads       */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Checks the tables built from regmap.def, then that a batch reads  */
+/*    a cacheable register once until it is written, and registers      */
+/*    that are not cacheable every time.                                */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "regmap.h"
+#include "dspi_metrics.h"
+
+#define TEST_OPS 9
+
+static const uint16_t cAddrs[TEST_OPS] = {0x0005, 0x0005, 0x0005, 0x0005, 0x0005, REG_BTN, REG_BTN, 0x0210, 0x0210};
+static const uint8_t cOps[TEST_OPS] = {op_read, op_read, op_read, op_write, op_read, op_read, op_read, op_read, op_read};
+
+int main(int argc, char* argv[]){
+	RegOp ops[TEST_OPS];
+	MetricsShard* shard;
+	uint64_t reads;
+	DspiDev dev;
+	int i;
+
+	for(i = 0; i < TEST_OPS; i++){
+		ops[i].op = cOps[i];
+		ops[i].addr = cAddrs[i];
+		ops[i].value = 0x34;//Written by the write
+	}
+
+	CHECK_EQ(regWidth(0x0005), 1);
+	CHECK_EQ(regWidth(0x0105), 2);
+	CHECK_EQ(regWidth(0x1000), 4);
+	CHECK_EQ(regWidth(0x0400), 0);
+	CHECK_EQ(regAttrs(0x0400), -1);
+	CHECK_EQ(regAttrs(0x0005), REG_ATTR_CACHEABLE);
+	CHECK_EQ(regAttrs(0x0210), 0);
+	CHECK_EQ(regAttrs(REG_LED), REG_ATTR_READ_EFFECT | REG_ATTR_WRITE_EFFECT);
+	CHECK(regFind("LED") != NULL && regFind("LED")->addr == REG_LED);
+	CHECK(regFind("cap_ctl") != NULL && regFind("cap_ctl")->addr == REG_CAP_CTL);
+	CHECK(regFind("nosuch") == NULL);
+
+	metricsEnabled = 1;
+	if(testOpen(&dev, argc, argv, NULL) != 0 || (shard = metricsClaim()) == NULL){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	CHECK_EQ(devWrite(&dev, 0x0005, 0x12), 0);
+	CHECK_EQ(devWrite(&dev, 0x0210, 0x5678), 0);
+	reads = shard->frames[op_read];
+	CHECK_EQ(devRegBatch(&dev, ops, TEST_OPS), 0);
+	//0x0005 before and after the write, btn and 0x0210 every time
+	CHECK_EQ(shard->frames[op_read] - reads, 6);
+	for(i = 0; i < TEST_OPS; i++){
+		CHECK_EQ(ops[i].status, STATUS_OK);
+	}
+	CHECK_EQ(ops[0].value, 0x12);
+	CHECK_EQ(ops[1].value, 0x12);
+	CHECK_EQ(ops[2].value, 0x12);
+	CHECK_EQ(ops[4].value, 0x34);
+	CHECK_EQ(ops[7].value, 0x5678);
+	CHECK_EQ(ops[8].value, 0x5678);
+	devClose(&dev);
+	return testEnd("regmap");
+}
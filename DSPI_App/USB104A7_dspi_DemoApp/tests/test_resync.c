@@ -0,0 +1,72 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_resync.c  --  Recovery from transfers that hang              */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Every 20th transfer hangs. A round of the loop is a bulk write,   */
+/*    a read back and a delta read, so over the rounds frames, request  */
+/*    payloads and reply payloads all hang. A failed operation must     */
+/*    leave the device in step for the next one.                        */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "host_os.h"
+
+#define TEST_ROUNDS 40
+#define TEST_WORDS 4
+
+int main(int argc, char* argv[]){
+	DspiDev dev;
+	uint16_t addrs[TEST_WORDS];
+	uint32_t values[TEST_WORDS];
+	uint32_t vals[TEST_WORDS];
+	uint32_t gen = 0;
+	uint32_t cChanged;
+	uint8_t status;
+	int cTimeouts = 0;
+	int cPassed = 0;
+	int result;
+	int round, i;
+
+	if(testOpen(&dev, argc, argv, "hang=20,hangms=1") != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	for(i = 0; i < TEST_WORDS; i++){
+		addrs[i] = 0x1000 + i;
+	}
+	for(round = 0; round < TEST_ROUNDS; round++){
+		for(i = 0; i < TEST_WORDS; i++){
+			values[i] = (uint32_t)(round << 8 | i);
+		}
+		result = devBulkWrite(&dev, addrs[0], values, TEST_WORDS, ENC_RAW, &status);
+		CHECK(result == 0 || result == LINK_ERR_TIMEOUT);
+		if(result == 0){
+			CHECK_EQ(status, STATUS_OK);
+			if((result = devRead(&dev, addrs, vals, TEST_WORDS)) == 0){
+				for(i = 0; i < TEST_WORDS; i++){
+					CHECK_EQ(vals[i], values[i]);
+				}
+				cPassed++;
+			}
+			CHECK(result == 0 || result == LINK_ERR_TIMEOUT);
+		}
+		cTimeouts += result == LINK_ERR_TIMEOUT;
+
+		result = devDeltaRead(&dev, addrs[0], TEST_WORDS, &gen, vals, &cChanged, &status);
+		CHECK(result == 0 || result == LINK_ERR_TIMEOUT);
+		cTimeouts += result == LINK_ERR_TIMEOUT;
+	}
+	CHECK(cTimeouts != 0);
+	CHECK(cPassed != 0);
+
+	//A passed deadline fails the frame before it is sent
+	devSetDeadline(osNowNs() - 1);
+	CHECK_EQ(devRead(&dev, addrs, vals, 1), LINK_ERR_TIMEOUT);
+	devSetDeadline(0);
+	devClose(&dev);
+	return testEnd("resync");
+}
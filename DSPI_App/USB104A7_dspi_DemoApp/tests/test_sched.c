@@ -0,0 +1,92 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_sched.c  --  Priority classes preempting a bulk write        */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    A thread streams a bulk write of 16 segments over a link with a   */
+/*    200 us round trip while the main thread writes a register as      */
+/*    SCHED_CONTROL. The write must get in between two segments, long   */
+/*    before the bulk write is done, and both must arrive intact.       */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "host_os.h"
+#include "dspi_sched.h"
+
+#define TEST_WORDS (16 * SCHED_SEG_WORDS)
+
+static DspiSched sched;
+static uint32_t values[TEST_WORDS];
+static volatile int fBulkDone;
+static int bulkResult;
+static uint8_t bulkStatus;
+
+static void* testStreamer(void* arg){
+	(void)arg;
+	bulkResult = schedBulkWrite(&sched, SCHED_BULK, 0x1000, values, TEST_WORDS, ENC_RAW, &bulkStatus);
+	fBulkDone = 1;
+	return 0;
+}
+
+int main(int argc, char* argv[]){
+	SchedStats stats[SCHED_N_CLASSES];
+	uint16_t addrs[] = {0x0200, 0x1000, 0x1000 + TEST_WORDS - 1};
+	uint32_t vals[3];
+	DspiDev dev;
+	OsThread thread;
+	int i;
+
+	if(testOpen(&dev, argc, argv, "usb=200") != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	schedInit(&sched, &dev);
+	for(i = 0; i < TEST_WORDS; i++){
+		values[i] = 0x5000 + i;
+	}
+	if(osThreadStart(&thread, testStreamer, NULL) != 0){
+		fprintf(stderr, "Cannot start the bulk thread\n");
+		return 1;
+	}
+
+	//Wait for the bulk write to hold the device, then preempt it
+	for(i = 0; i < 1000; i++){
+		schedStats(&sched, stats);
+		if(stats[SCHED_BULK].grants != 0){
+			break;
+		}
+		osSleepUs(100);
+	}
+	osSleepUs(1000);
+	CHECK_EQ(schedWrite(&sched, SCHED_CONTROL, 0x0200, 0x1234), 0);
+	CHECK(!fBulkDone);
+	osThreadJoin(thread);
+	CHECK_EQ(bulkResult, 0);
+	CHECK_EQ(bulkStatus, STATUS_OK);
+
+	schedStats(&sched, stats);
+	CHECK(stats[SCHED_BULK].yields >= 1);
+	CHECK_EQ(stats[SCHED_CONTROL].grants, 1);
+	CHECK_EQ(stats[SCHED_CONTROL].yields, 0);
+
+	CHECK_EQ(schedRead(&sched, SCHED_NORMAL, addrs, vals, 3), 0);
+	CHECK_EQ(vals[0], 0x1234);
+	CHECK_EQ(vals[1], values[0]);
+	CHECK_EQ(vals[2], values[TEST_WORDS - 1]);
+
+	//A request still waiting at its deadline is dropped
+	CHECK_EQ(schedAcquire(&sched, SCHED_NORMAL), 0);
+	devSetDeadline(osNowNs() + 2000000);
+	CHECK_EQ(schedAcquire(&sched, SCHED_CONTROL), LINK_ERR_TIMEOUT);
+	devSetDeadline(0);
+	schedRelease(&sched);
+	schedStats(&sched, stats);
+	CHECK_EQ(stats[SCHED_CONTROL].expired, 1);
+
+	schedDestroy(&sched);
+	devClose(&dev);
+	return testEnd("sched");
+}
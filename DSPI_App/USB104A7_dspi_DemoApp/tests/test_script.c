@@ -0,0 +1,81 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_script.c  --  Script assembly and runs on the device         */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "regmap.h"
+#include "dspi_script.h"
+
+static const char cScript[] =
+	"; bit commands on a 32-bit register, a wait and a branch on its value\n"
+	"        write led 0x5\n"
+	"        write 0x0205 0x1\n"
+	"        set 0x0205 0xF0\n"
+	"        toggle 0x0205 0x3\n"
+	"        clear 0x0205 0x100\n"
+	"        wait 0x0205 0xFF 0xF2 1000\n"
+	"        load 0x0205\n"
+	"        bne 0xFF 0xF2 fail\n"
+	"        write 0x0206 0xAA\n"
+	"        end\n"
+	"fail:   write 0x0206 0xBAD\n";
+
+/**
+* Assembles script text.
+*
+* @return what scriptAssemble() returned
+*/
+static int testAssemble(const char* text, uint8_t* code, uint32_t* cb){
+	FILE* fp = tmpfile();
+	int status;
+
+	if(fp == NULL){
+		return -1;
+	}
+	fputs(text, fp);
+	rewind(fp);
+	status = scriptAssemble(fp, "test", code, SCRIPT_SIZE, cb);
+	fclose(fp);
+	return status;
+}
+
+int main(int argc, char* argv[]){
+	static uint8_t code[SCRIPT_SIZE];
+	DspiDev dev;
+	uint16_t addrs[] = {0x0205, 0x0206, REG_LED};
+	uint32_t vals[3];
+	uint32_t state = 0;
+	uint32_t cb = 0;
+	uint8_t status = STATUS_NO_REPLY;
+
+	//Errors are reported, not assembled
+	CHECK_EQ(testAssemble("frob 0x0205\n", code, &cb), -1);
+	CHECK_EQ(testAssemble("jump nowhere\n", code, &cb), -1);
+	CHECK_EQ(testAssemble("write no_such_reg 1\n", code, &cb), -1);
+	CHECK_EQ(testAssemble("write 0x0205\n", code, &cb), -1);
+	CHECK_EQ(testAssemble("a:\na:\nend\n", code, &cb), -1);
+
+	if(testAssemble(cScript, code, &cb) != 0){
+		fprintf(stderr, "Cannot assemble the script\n");
+		return 1;
+	}
+	CHECK(cb > 0);
+
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	CHECK_EQ(devScriptLoad(&dev, 0, code, cb, &status), 0);
+	CHECK_EQ(status, STATUS_OK);
+	CHECK_EQ(devWrite(&dev, REG_SCRIPT, 0), 0);
+	CHECK_EQ(devWait(&dev, REG_SCRIPT, SCRIPT_STATE_RUNNING, 0, 1000000, &state, &status), 0);
+	CHECK_EQ(SCRIPT_STATE_STATUS(state), STATUS_OK);
+	CHECK_EQ(devRead(&dev, addrs, vals, 3), 0);
+	CHECK_EQ(vals[0], 0xF2);
+	CHECK_EQ(vals[1], 0xAA);
+	CHECK_EQ(vals[2], 0x5);
+	devClose(&dev);
+	return testEnd("script");
+}
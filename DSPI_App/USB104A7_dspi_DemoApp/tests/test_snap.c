@@ -0,0 +1,74 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_snap.c  --  Snapshot of one device restored on another       */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "regmap.h"
+#include "dspi_snap.h"
+
+#define TEST_FILE "test_snap.snap"
+#define TEST_REGS 5
+
+static const uint16_t cAddrs[TEST_REGS] = {0x0005, 0x0105, 0x0205, 0x1005, REG_LED};
+static const uint32_t cVals[TEST_REGS] = {0x5A, 0xBEEF, 0xCAFE0001, 0x11223344, 0x3};
+
+int main(int argc, char* argv[]){
+	static DspiSnap snap, loaded;
+	uint32_t vals[TEST_REGS];
+	uint32_t cWritten = 0, cMismatch = 0;
+	uint16_t firstBad = 0;
+	uint8_t status = STATUS_NO_REPLY;
+	DspiDev dev;
+	FILE* fp;
+	int i;
+
+	//Commands and read only registers are never written back
+	CHECK(snapWritable(REG_LED));
+	CHECK(!snapWritable(REG_CAP_CTL));
+	CHECK(!snapWritable(REG_SCRIPT));
+	CHECK(!snapWritable(REG_BTN));
+
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	for(i = 0; i < TEST_REGS; i++){
+		CHECK_EQ(devWrite(&dev, cAddrs[i], cVals[i]), 0);
+	}
+	CHECK_EQ(snapTake(&dev, &snap, SNAP_DDR, &status), 0);
+	CHECK(snapRegisters(&snap) > 0);
+	devClose(&dev);
+
+	//The file holds the same snapshot, and is refused once damaged
+	CHECK_EQ(snapSave(&snap, TEST_FILE), 0);
+	CHECK_EQ(snapLoad(&loaded, TEST_FILE), 0);
+	CHECK(memcmp(&loaded, &snap, sizeof(snap)) == 0);
+	if((fp = fopen(TEST_FILE, "r+b")) != NULL){
+		fseek(fp, 32, SEEK_SET);
+		fputc(fgetc(fp) ^ 0x01, fp);
+		fclose(fp);
+	}
+	CHECK_EQ(snapLoad(&snap, TEST_FILE), -1);
+	remove(TEST_FILE);
+
+	//A fresh device gets everything back, the led through its hook
+	CHECK_EQ(testOpen(&dev, argc, argv, NULL), 0);
+	CHECK_EQ(snapRestore(&dev, &loaded, &cWritten, &cMismatch, &firstBad, &status), 0);
+	CHECK(cWritten >= TEST_REGS);
+	CHECK_EQ(cMismatch, 0);
+	CHECK_EQ(devRead(&dev, cAddrs, vals, TEST_REGS), 0);
+	for(i = 0; i < TEST_REGS; i++){
+		CHECK_EQ(vals[i], cVals[i]);
+	}
+
+	//And again over a register changed since
+	CHECK_EQ(devWrite(&dev, 0x0205, 0), 0);
+	CHECK_EQ(snapRestore(&dev, &loaded, &cWritten, &cMismatch, &firstBad, &status), 0);
+	CHECK_EQ(cMismatch, 0);
+	CHECK_EQ(devRead(&dev, cAddrs + 2, vals, 1), 0);
+	CHECK_EQ(vals[0], cVals[2]);
+	devClose(&dev);
+	return testEnd("snap");
+}
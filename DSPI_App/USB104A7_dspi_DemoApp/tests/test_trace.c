@@ -0,0 +1,159 @@
+/************************************************************************/
+/*                                                                      */
+/*    test_trace.c  --  Chrome trace of the host and the device         */
+/*                                                                      */
+/************************************************************************/
+/*  File Description:                                                   */
+/*                                                                      */
+/*    Traces a few register accesses on the simulated device: the file  */
+/*    must be well formed and hold the host frames and the device       */
+/*    spans of the same accesses. Then a thread overflows its ring and  */
+/*    the device overwrites events before they are read: the trace must */
+/*    report exactly the events dropped on the host and lost on the     */
+/*    device.                                                           */
+/*                                                                      */
+/************************************************************************/
+
+#include "test.h"
+#include "host_os.h"
+#include "dspi_trace.h"
+
+#define TEST_FLOOD 10	//host events past a full ring
+#define TEST_READS 400	//device frames, 3 events each
+
+static char text[4 << 20];
+
+/**
+* Reads the whole trace file back.
+*/
+static void testReadBack(FILE* fp){
+	size_t cb;
+
+	rewind(fp);
+	cb = fread(text, 1, sizeof(text) - 1, fp);
+	text[cb] = '\0';
+}
+
+/**
+* Checks that brackets and braces outside strings balance.
+*/
+static int testBalanced(const char* s){
+	int depth = 0;
+	int fString = 0;
+
+	for(; *s != '\0'; s++){
+		if(fString){
+			if(*s == '\\' && s[1] != '\0'){
+				s++;
+			}else if(*s == '"'){
+				fString = 0;
+			}
+		}else if(*s == '"'){
+			fString = 1;
+		}else if(*s == '{' || *s == '['){
+			depth++;
+		}else if((*s == '}' || *s == ']') && --depth < 0){
+			return 0;
+		}
+	}
+	return depth == 0 && !fString;
+}
+
+static void* testFlood(void* arg){
+	int i;
+
+	(void)arg;
+	traceThreadName("flood");
+	for(i = 0; i < TRACE_RING_EVENTS + TEST_FLOOD; i++){
+		traceInstant("flood", "i", i);
+	}
+	return 0;
+}
+
+static void testEvents(DspiDev* dev){
+	TraceWriter tw;
+	uint16_t addr = 0x0210;
+	uint32_t val = 0;
+	FILE* fp = tmpfile();
+
+	if(fp == NULL){
+		CHECK(fp != NULL);
+		return;
+	}
+	CHECK_EQ(traceOpen(&tw, fp, dev), 0);
+	CHECK(tw.dev == dev);
+	traceThreadName("main");
+	CHECK_EQ(devWrite(dev, addr, 0x1234), 0);
+	CHECK_EQ(devRead(dev, &addr, &val, 1), 0);
+	tracePoll(&tw);
+	traceClose(&tw);
+	CHECK_EQ(tw.lost, 0);
+	testReadBack(fp);
+	fclose(fp);
+
+	CHECK(strncmp(text, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n{", 41) == 0);
+	CHECK(strlen(text) > 4 && strcmp(text + strlen(text) - 4, "\n]}\n") == 0);
+	CHECK(testBalanced(text));
+	CHECK(strstr(text, ",\n]") == NULL);
+	CHECK(strstr(text, "\"args\":{\"name\":\"host\"}") != NULL);
+	CHECK(strstr(text, "\"args\":{\"name\":\"device\"}") != NULL);
+	CHECK(strstr(text, "\"args\":{\"name\":\"main\"}") != NULL);
+	CHECK(strstr(text, "\"name\":\"clock_sync\"") != NULL);
+	CHECK(strstr(text, "\"name\":\"frame\"") != NULL);
+	CHECK(strstr(text, "\"args\":{\"op\":\"write\"}") != NULL);
+	CHECK(strstr(text, "\"name\":\"frame\",\"ph\":\"B\",\"pid\":2,\"tid\":1,") != NULL);
+	CHECK(strstr(text, "\"args\":{\"op\":\"write\",\"addr\":528}") != NULL);
+	CHECK(strstr(text, "\"args\":{\"op\":\"read\",\"addr\":528}") != NULL);
+	CHECK(strstr(text, "\"name\":\"lost\"") == NULL);
+	CHECK(strstr(text, "\"name\":\"dropped\"") == NULL);
+}
+
+static void testLost(DspiDev* dev){
+	static uint16_t addrs[TEST_READS];
+	static uint32_t vals[TEST_READS];
+	char expect[64];
+	TraceWriter tw;
+	OsThread thread;
+	FILE* fp = tmpfile();
+	int i;
+
+	if(fp == NULL){
+		CHECK(fp != NULL);
+		return;
+	}
+	for(i = 0; i < TEST_READS; i++){
+		addrs[i] = (uint16_t)(0x1000 + i);
+	}
+	CHECK_EQ(traceOpen(&tw, fp, dev), 0);
+	CHECK_EQ(devRead(dev, addrs, vals, TEST_READS), 0);
+	if(osThreadStart(&thread, testFlood, NULL) != 0){
+		fprintf(stderr, "Cannot start the flood thread\n");
+		cTestFailed++;
+		return;
+	}
+	osThreadJoin(thread);
+	traceClose(&tw);
+	testReadBack(fp);
+	fclose(fp);
+
+	CHECK(testBalanced(text));
+	CHECK(tw.lost != 0);
+	snprintf(expect, sizeof(expect), "\"args\":{\"events\":%lu}", (unsigned long)tw.lost);
+	CHECK(strstr(text, "\"name\":\"lost\"") != NULL && strstr(strstr(text, "\"name\":\"lost\""), expect) != NULL);
+	snprintf(expect, sizeof(expect), "\"args\":{\"events\":%d}", TEST_FLOOD);
+	CHECK(strstr(text, "\"name\":\"dropped\"") != NULL && strstr(strstr(text, "\"name\":\"dropped\""), expect) != NULL);
+	CHECK(strstr(text, "\"args\":{\"name\":\"flood\"}") != NULL);
+}
+
+int main(int argc, char* argv[]){
+	DspiDev dev;
+
+	if(testOpen(&dev, argc, argv, NULL) != 0){
+		fprintf(stderr, "Cannot open the device\n");
+		return 1;
+	}
+	testEvents(&dev);
+	testLost(&dev);
+	devClose(&dev);
+	return testEnd("trace");
+}
@@ -0,0 +1,649 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// dspi_regfile.v -- DSPI slave that serves the register file in fabric
+//
+//////////////////////////////////////////////////////////////////////////////
+// Module Description:
+//
+// SPI slave on the DSPI pins (mode 0, MSB first, slave select frames every
+// transfer) that speaks the frame protocol of dspi_protocol.h. The register
+// regions the firmware maps into the fabric live in a dual-port RAM: the
+// engine answers OP_NOP, OP_READ and OP_WRITE on registers without side
+// effects by itself, at the SPI clock rate and without an interrupt. Every
+// other frame is forwarded to the MicroBlaze, which stages the response and
+// the payload phases through the AXI-Lite window below. The MicroBlaze sees
+// the same RAM, so the firmware register accessors are unchanged.
+//
+// SCK, MOSI and slave select are oversampled on s_axi_aclk; SCK must stay
+// below an eighth of that clock.
+//
+// AXI-Lite window (byte offsets):
+//     0x0000 - 0x07FF  REGS      register RAM, byte writable
+//     0x0800 - 0x09FF  RXBUF     request payload, read only
+//     0x1000  CTRL      [0] serve plain frames in fabric
+//     0x1004  ISR       [0] frame forwarded, [1] payload received (W1C)
+//                       [2] TX FIFO low (level), [3] late (W1C)
+//                       [4] payload aborted (W1C)
+//     0x1008  IER       interrupt enables, same bits as ISR
+//     0x100C  REQ_HDR   forwarded frame [op, width, addrHi, addrLo]
+//     0x1010  REQ_DATA  forwarded frame data
+//     0x1014  RSP_HDR   response [op, status, addrHi, addrLo]
+//     0x1018  RSP_DATA  response value
+//     0x101C  PHASE     [25:24] 0 frame, 1 receive, 2 send, [23:0] length.
+//                       A write stages the response, or for receive arms
+//                       the request payload; a read returns the mode and
+//                       the bytes left.
+//     0x1020  TXFIFO    pushes a word of reply payload, byte 0 first
+//     0x1024  TXFREE    free bytes in the TX FIFO
+//     0x1028  FLAGS     [17] forward writes, [16] forward reads of the
+//                       register at REGS byte offset [10:0]
+//     0x102C  FASTCNT   frames answered in fabric
+//     0x1040 + 8n       WINn  [31:16] count, [15:0] first register
+//     0x1044 + 8n       WINn  [31] enable, [18:16] width, [10:0] REGS offset
+//     0x1080 + 4n       DIRTYn  bit m set if the engine served a write to
+//                       REGS word 32n + m; a read returns and clears it
+//
+// A frame that arrives before the response to the previous one is staged is
+// answered with STATUS_DROPPED and dropped, and sets ISR[3]; the response
+// still goes out with the next frame, so the master sends the dropped one
+// again. A reply payload byte the firmware has not pushed in time sets
+// ISR[3] too. A transfer of another
+// length is dropped in frame mode. In a payload phase it aborts the phase:
+// the command is answered with STATUS_BAD_LENGTH, the TX FIFO is emptied
+// and ISR[4] is set, so one short payload cannot shift the later frames.
+//
+//////////////////////////////////////////////////////////////////////////////
+// Revision History:
+//
+//    10/19/2026:           Created
+//    10/19/2026:           Dirty bitmap of served writes
+//    10/19/2026:           Transfers of another length abort payloads
+//    10/19/2026:           Dropped frames answer STATUS_DROPPED, not BUSY
+//
+//////////////////////////////////////////////////////////////////////////////
+
+`timescale 1ns / 1ps
+`default_nettype none
+
+module dspi_regfile (
+    (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF s_axi, ASSOCIATED_RESET s_axi_aresetn" *)
+    input  wire        s_axi_aclk,
+    input  wire        s_axi_aresetn,
+    input  wire [12:0] s_axi_awaddr,
+    input  wire [2:0]  s_axi_awprot,
+    input  wire        s_axi_awvalid,
+    output wire        s_axi_awready,
+    input  wire [31:0] s_axi_wdata,
+    input  wire [3:0]  s_axi_wstrb,
+    input  wire        s_axi_wvalid,
+    output wire        s_axi_wready,
+    output wire [1:0]  s_axi_bresp,
+    output reg         s_axi_bvalid,
+    input  wire        s_axi_bready,
+    input  wire [12:0] s_axi_araddr,
+    input  wire [2:0]  s_axi_arprot,
+    input  wire        s_axi_arvalid,
+    output wire        s_axi_arready,
+    output reg  [31:0] s_axi_rdata,
+    output wire [1:0]  s_axi_rresp,
+    output reg         s_axi_rvalid,
+    input  wire        s_axi_rready,
+
+    (* X_INTERFACE_INFO = "xilinx.com:signal:interrupt:1.0 irq INTERRUPT" *)
+    (* X_INTERFACE_PARAMETER = "SENSITIVITY LEVEL_HIGH" *)
+    output wire        irq,
+
+    input  wire        dspi_sck_io,
+    input  wire        dspi_io0_io,     // MOSI
+    output wire        dspi_io1_io,     // MISO
+    input  wire        dspi_spisel      // slave select, active low
+);
+
+    localparam [7:0] OP_NOP      = 8'h00;
+    localparam [7:0] OP_WRITE    = 8'hAA;
+    localparam [7:0] OP_READ     = 8'hBB;
+    localparam [7:0] STATUS_OK   = 8'h00;
+    localparam [7:0] STATUS_BAD_LENGTH = 8'h05;
+    localparam [7:0] STATUS_DROPPED = 8'h09;
+
+    localparam [1:0] MODE_FRAME = 2'd0;
+    localparam [1:0] MODE_RECV  = 2'd1;
+    localparam [1:0] MODE_SEND  = 2'd2;
+
+    localparam [1:0] DEC_IDLE = 2'd0;
+    localparam [1:0] DEC_LOOK = 2'd1;
+    localparam [1:0] DEC_WAIT = 2'd2;
+    localparam [1:0] DEC_EXEC = 2'd3;
+
+    localparam [5:0] A_CTRL     = 6'h00;
+    localparam [5:0] A_ISR      = 6'h01;
+    localparam [5:0] A_IER      = 6'h02;
+    localparam [5:0] A_REQ_HDR  = 6'h03;
+    localparam [5:0] A_REQ_DATA = 6'h04;
+    localparam [5:0] A_RSP_HDR  = 6'h05;
+    localparam [5:0] A_RSP_DATA = 6'h06;
+    localparam [5:0] A_PHASE    = 6'h07;
+    localparam [5:0] A_TXFIFO   = 6'h08;
+    localparam [5:0] A_TXFREE   = 6'h09;
+    localparam [5:0] A_FLAGS    = 6'h0A;
+    localparam [5:0] A_FASTCNT  = 6'h0B;
+
+    wire clk = s_axi_aclk;
+    wire rst = ~s_axi_aresetn;
+
+    integer ia;
+    integer ib;
+    integer id;
+
+    //////////////////////////////////////////////////////////////////////////
+    // Storage
+    //////////////////////////////////////////////////////////////////////////
+
+    reg  [31:0] regs [0:511];       // register RAM, port A AXI, port B engine
+    reg  [31:0] rxbuf [0:127];      // request payload
+    reg  [31:0] txbuf [0:127];      // reply payload FIFO
+    reg  [1:0]  flags [0:2047];     // {forward write, forward read} per REGS byte
+    reg  [31:0] dirty [0:15];       // a bit per REGS word written by the engine
+
+    reg  [8:0]  a_addr;
+    reg  [3:0]  a_we;
+    reg  [31:0] a_q;
+    reg  [8:0]  b_addr;
+    reg  [3:0]  b_we;
+    reg  [31:0] b_din;
+    reg  [31:0] b_q;
+
+    always @(posedge clk) begin
+        for (ia = 0; ia < 4; ia = ia + 1)
+            if (a_we[ia])
+                regs[a_addr][8*ia +: 8] <= s_axi_wdata[8*ia +: 8];
+        a_q <= regs[a_addr];
+    end
+
+    always @(posedge clk) begin
+        for (ib = 0; ib < 4; ib = ib + 1)
+            if (b_we[ib])
+                regs[b_addr][8*ib +: 8] <= b_din[8*ib +: 8];
+        b_q <= regs[b_addr];
+    end
+
+    //////////////////////////////////////////////////////////////////////////
+    // AXI-Lite handshakes. Ready may follow valid, one access at a time.
+    //////////////////////////////////////////////////////////////////////////
+
+    wire wr_fire = s_axi_awvalid && s_axi_wvalid && !s_axi_bvalid;
+    reg  rd_busy;
+    reg  [12:0] rd_addr;
+    wire rd_fire = s_axi_arvalid && !s_axi_rvalid && !rd_busy && !wr_fire;
+
+    assign s_axi_awready = wr_fire;
+    assign s_axi_wready  = wr_fire;
+    assign s_axi_arready = rd_fire;
+    assign s_axi_bresp   = 2'b00;
+    assign s_axi_rresp   = 2'b00;
+
+    wire       wr_regs = wr_fire && s_axi_awaddr[12:11] == 2'b00;
+    wire       wr_ctl  = wr_fire && s_axi_awaddr[12];
+    wire [5:0] wr_reg  = s_axi_awaddr[7:2];
+
+    always @* begin
+        a_addr = wr_fire ? s_axi_awaddr[10:2] : s_axi_araddr[10:2];
+        a_we   = wr_regs ? s_axi_wstrb : 4'b0000;
+    end
+
+    //////////////////////////////////////////////////////////////////////////
+    // SPI pins
+    //////////////////////////////////////////////////////////////////////////
+
+    reg [2:0] sck_s;
+    reg [2:0] ss_s;
+    reg [1:0] mosi_s;
+
+    always @(posedge clk) begin
+        sck_s  <= {sck_s[1:0], dspi_sck_io};
+        ss_s   <= {ss_s[1:0], dspi_spisel};
+        mosi_s <= {mosi_s[0], dspi_io0_io};
+    end
+
+    wire selected = ~ss_s[1];
+    wire ss_start = ss_s[2:1] == 2'b10;
+    wire ss_end   = ss_s[2:1] == 2'b01;
+    wire sck_rise = selected && sck_s[2:1] == 2'b01;
+    wire sck_fall = selected && sck_s[2:1] == 2'b10;
+    wire [7:0] rx_byte;
+
+    reg [7:0] tx_shift;
+    assign dspi_io1_io = tx_shift[7];
+
+    reg  [2:0]  bit_cnt;
+    reg  [7:0]  rx_shift;
+    reg  [3:0]  byte_cnt;           // bytes of the current frame transfer
+    reg  [63:0] tx_frame;
+    reg         drop;               // transfer started before the response was staged
+
+    //////////////////////////////////////////////////////////////////////////
+    // Control state
+    //////////////////////////////////////////////////////////////////////////
+
+    reg         fast_en;
+    reg  [4:0]  ier;
+    reg         isr_frame;
+    reg         isr_recv;
+    reg         isr_late;
+    reg         isr_abort;
+    reg  [63:0] req;
+    reg  [63:0] rsp;
+    reg         rsp_ready;
+    reg  [1:0]  mode;
+    reg  [23:0] xfer_len;
+    reg  [23:0] pay_cnt;
+    reg  [31:0] fast_cnt;
+
+    reg  [15:0] win_base  [0:3];
+    reg  [15:0] win_count [0:3];
+    reg  [2:0]  win_width [0:3];
+    reg  [10:0] win_off   [0:3];
+    reg  [3:0]  win_en;
+
+    // TX FIFO: words in, bytes out
+    reg  [7:0]  tx_wr;              // words, one wrap bit
+    reg  [9:0]  tx_rd;              // bytes, one wrap bit
+    reg  [23:0] tx_pushed;
+    wire [9:0]  tx_level = {tx_wr, 2'b00} - tx_rd;
+    wire [9:0]  tx_free  = 10'd512 - tx_level;
+    wire [31:0] tx_word  = txbuf[tx_rd[8:2]];
+    wire [7:0]  tx_byte  = tx_word[8*tx_rd[1:0] +: 8];
+    wire        tx_empty = tx_level == 10'd0;
+    wire        tx_low   = mode == MODE_SEND && tx_pushed < xfer_len && tx_free >= 10'd256;
+
+    wire [4:0]  isr = {isr_abort, isr_late, tx_low, isr_recv, isr_frame};
+    assign irq = |(isr & ier);
+
+    always @(posedge clk) begin
+        if (wr_fire && wr_ctl && wr_reg == A_TXFIFO && tx_free >= 10'd4)
+            txbuf[tx_wr[6:0]] <= s_axi_wdata;
+    end
+
+    wire rx_we = sck_rise && bit_cnt == 3'd7 && mode == MODE_RECV && pay_cnt < 24'd512;
+
+    always @(posedge clk) begin
+        if (rx_we)
+            rxbuf[pay_cnt[8:2]][8*pay_cnt[1:0] +: 8] <= rx_byte;
+    end
+
+    always @(posedge clk) begin
+        if (wr_fire && wr_ctl && wr_reg == A_FLAGS)
+            flags[s_axi_wdata[10:0]] <= s_axi_wdata[17:16];
+    end
+
+    //////////////////////////////////////////////////////////////////////////
+    // Frame decoder
+    //////////////////////////////////////////////////////////////////////////
+
+    reg  [1:0]  dec;
+    reg  [63:0] rx_frame;
+    reg  [63:0] frame;              // frame being decoded
+    reg  [1:0]  dec_flags;
+    reg         dec_hit;
+    reg  [10:0] dec_off;
+    reg  [2:0]  dec_width;
+
+    wire [7:0]  f_op    = frame[63:56];
+    wire [7:0]  f_width = frame[55:48];
+    wire [15:0] f_addr  = frame[47:32];
+    wire [31:0] f_data  = frame[31:0];
+
+    // Window of the frame address, the lowest numbered hit wins
+    reg         look_hit;
+    reg  [15:0] look_off;
+    reg  [2:0]  look_width;
+    reg  [15:0] look_idx;
+    integer n;
+
+    always @* begin
+        look_hit = 1'b0;
+        look_off = 16'd0;
+        look_width = 3'd0;
+        look_idx = 16'd0;
+        for (n = 3; n >= 0; n = n - 1) begin
+            look_idx = f_addr - win_base[n];
+            if (win_en[n] && f_addr >= win_base[n] && look_idx < win_count[n]) begin
+                look_hit = 1'b1;
+                look_width = win_width[n];
+                case (win_width[n])
+                    3'd1:    look_off = win_off[n] + look_idx;
+                    3'd2:    look_off = win_off[n] + {look_idx[14:0], 1'b0};
+                    default: look_off = win_off[n] + {look_idx[13:0], 2'b00};
+                endcase
+            end
+        end
+        if (look_off > 16'h07FF)
+            look_hit = 1'b0;
+    end
+
+    // Register value in the RAM word, zero extended
+    reg [31:0] reg_value;
+    reg [31:0] wr_value;
+    reg [3:0]  wr_lanes;
+
+    always @* begin
+        case (dec_width)
+            3'd1: begin
+                reg_value = {24'd0, b_q[8*dec_off[1:0] +: 8]};
+                wr_value  = {24'd0, f_data[7:0]};
+                wr_lanes  = 4'b0001 << dec_off[1:0];
+            end
+            3'd2: begin
+                reg_value = {16'd0, b_q[16*dec_off[1] +: 16]};
+                wr_value  = {16'd0, f_data[15:0]};
+                wr_lanes  = dec_off[1] ? 4'b1100 : 4'b0011;
+            end
+            default: begin
+                reg_value = b_q;
+                wr_value  = f_data;
+                wr_lanes  = 4'b1111;
+            end
+        endcase
+    end
+
+    wire width_ok = f_width == 8'd0 || f_width == {5'd0, dec_width};
+    wire serve = fast_en && (f_op == OP_NOP
+                 || (dec_hit && width_ok && f_op == OP_READ && !dec_flags[0])
+                 || (dec_hit && width_ok && f_op == OP_WRITE && !dec_flags[1]));
+
+    always @(posedge clk) begin
+        dec_flags <= flags[dec_off];
+    end
+
+    //////////////////////////////////////////////////////////////////////////
+    // Engine
+    //////////////////////////////////////////////////////////////////////////
+
+    assign rx_byte = {rx_shift[6:0], mosi_s[1]};
+
+    // Answers a frame that comes too early. It echoes no command, the
+    // response still due goes out with the next frame.
+    wire [63:0] drop_frame = {OP_NOP, STATUS_DROPPED, 16'd0, 32'd0};
+    wire        rsp_now = rsp_ready && dec == DEC_IDLE;
+
+    always @(posedge clk) begin
+        b_we <= 4'b0000;
+        if (rst) begin
+            fast_en   <= 1'b0;
+            ier       <= 5'b00000;
+            isr_frame <= 1'b0;
+            isr_recv  <= 1'b0;
+            isr_late  <= 1'b0;
+            isr_abort <= 1'b0;
+            req       <= 64'd0;
+            rsp       <= 64'd0;
+            rsp_ready <= 1'b1;
+            mode      <= MODE_FRAME;
+            xfer_len  <= 24'd0;
+            pay_cnt   <= 24'd0;
+            fast_cnt  <= 32'd0;
+            win_en    <= 4'b0000;
+            tx_wr     <= 8'd0;
+            tx_rd     <= 10'd0;
+            tx_pushed <= 24'd0;
+            dec       <= DEC_IDLE;
+            for (id = 0; id < 16; id = id + 1)
+                dirty[id] <= 32'd0;
+            bit_cnt   <= 3'd0;
+            byte_cnt  <= 4'd0;
+            tx_shift  <= 8'd0;
+            drop      <= 1'b0;
+        end else begin
+
+            //////////////////////////////////////////////////////////////////
+            // AXI writes of the control registers
+            //////////////////////////////////////////////////////////////////
+            if (wr_fire && wr_ctl) begin
+                case (wr_reg)
+                    A_CTRL:     fast_en <= s_axi_wdata[0];
+                    A_ISR: begin
+                        if (s_axi_wdata[0]) isr_frame <= 1'b0;
+                        if (s_axi_wdata[1]) isr_recv  <= 1'b0;
+                        if (s_axi_wdata[3]) isr_late  <= 1'b0;
+                        if (s_axi_wdata[4]) isr_abort <= 1'b0;
+                    end
+                    A_IER:      ier <= s_axi_wdata[4:0];
+                    A_RSP_HDR:  rsp[63:32] <= s_axi_wdata;
+                    A_RSP_DATA: rsp[31:0]  <= s_axi_wdata;
+                    A_PHASE: begin
+                        mode     <= s_axi_wdata[25:24];
+                        xfer_len <= s_axi_wdata[23:0];
+                        pay_cnt  <= 24'd0;
+                        // Receive waits for a new response after the payload,
+                        // send puts the staged one out after it.
+                        rsp_ready <= s_axi_wdata[25:24] == MODE_FRAME;
+                    end
+                    A_TXFIFO: begin
+                        if (tx_free >= 10'd4) begin
+                            tx_wr     <= tx_wr + 8'd1;
+                            tx_pushed <= tx_pushed + 24'd4;
+                        end
+                    end
+                    default: begin
+                        if (wr_reg[5:4] == 2'b01 && !wr_reg[0]) begin
+                            win_base[wr_reg[2:1]]  <= s_axi_wdata[15:0];
+                            win_count[wr_reg[2:1]] <= s_axi_wdata[31:16];
+                        end else if (wr_reg[5:4] == 2'b01) begin
+                            win_en[wr_reg[2:1]]    <= s_axi_wdata[31];
+                            win_width[wr_reg[2:1]] <= s_axi_wdata[18:16];
+                            win_off[wr_reg[2:1]]   <= s_axi_wdata[10:0];
+                        end
+                    end
+                endcase
+            end
+
+            // The AXI read of a dirty word clears it; a write served in
+            // the same cycle sets its bit again below.
+            if (rd_busy && rd_addr[12] && rd_addr[7:6] == 2'b10)
+                dirty[rd_addr[5:2]] <= 32'd0;
+
+            //////////////////////////////////////////////////////////////////
+            // Bits and bytes
+            //////////////////////////////////////////////////////////////////
+            if (ss_start) begin
+                bit_cnt  <= 3'd0;
+                byte_cnt <= 4'd0;
+                drop     <= 1'b0;
+                case (mode)
+                    MODE_FRAME: begin
+                        tx_frame <= rsp_now ? rsp : drop_frame;
+                        tx_shift <= rsp_now ? rsp[63:56] : drop_frame[63:56];
+                        drop     <= !rsp_now;
+                    end
+                    MODE_SEND: begin
+                        tx_shift <= tx_empty ? 8'd0 : tx_byte;
+                        if (tx_empty)
+                            isr_late <= 1'b1;
+                        else
+                            tx_rd <= tx_rd + 10'd1;
+                    end
+                    default:
+                        tx_shift <= 8'd0;
+                endcase
+            end
+
+            if (sck_fall && bit_cnt != 3'd0)
+                tx_shift <= {tx_shift[6:0], 1'b0};
+
+            if (sck_rise) begin
+                rx_shift <= rx_byte;
+                bit_cnt  <= bit_cnt + 3'd1;
+                if (bit_cnt == 3'd7) begin
+                    case (mode)
+                        MODE_FRAME: begin
+                            rx_frame <= {rx_frame[55:0], rx_byte};
+                            if (byte_cnt != 4'd15)
+                                byte_cnt <= byte_cnt + 4'd1;
+                            tx_shift <= byte_cnt < 4'd7 ? tx_frame[55 - 8*byte_cnt -: 8] : 8'd0;
+                        end
+                        MODE_RECV: begin
+                            pay_cnt <= pay_cnt + 24'd1;
+                            tx_shift <= 8'd0;
+                        end
+                        MODE_SEND: begin
+                            pay_cnt <= pay_cnt + 24'd1;
+                            if (pay_cnt + 24'd1 >= xfer_len) begin
+                                tx_shift <= 8'd0;
+                            end else if (tx_empty) begin
+                                tx_shift <= 8'd0;
+                                isr_late <= 1'b1;
+                            end else begin
+                                tx_shift <= tx_byte;
+                                tx_rd    <= tx_rd + 10'd1;
+                            end
+                        end
+                        default: ;
+                    endcase
+                end
+            end
+
+            //////////////////////////////////////////////////////////////////
+            // End of a transfer
+            //////////////////////////////////////////////////////////////////
+            if (ss_end) begin
+                case (mode)
+                    MODE_FRAME: begin
+                        if (byte_cnt == 4'd8 && bit_cnt == 3'd0) begin
+                            if (drop) begin
+                                isr_late <= 1'b1;
+                            end else begin
+                                frame     <= rx_frame;
+                                rsp_ready <= 1'b0;
+                                dec       <= DEC_LOOK;
+                            end
+                        end
+                    end
+                    MODE_RECV: begin
+                        mode <= MODE_FRAME;
+                        if (pay_cnt == xfer_len && bit_cnt == 3'd0) begin
+                            isr_recv <= 1'b1;
+                        end else begin
+                            rsp       <= {req[63:56], STATUS_BAD_LENGTH, req[47:32], 32'd0};
+                            rsp_ready <= 1'b1;
+                            isr_abort <= 1'b1;
+                        end
+                    end
+                    MODE_SEND: begin
+                        mode      <= MODE_FRAME;
+                        rsp_ready <= 1'b1;
+                        tx_wr     <= 8'd0;
+                        tx_rd     <= 10'd0;
+                        tx_pushed <= 24'd0;
+                        if (pay_cnt != xfer_len || bit_cnt != 3'd0) begin
+                            rsp       <= {rsp[63:56], STATUS_BAD_LENGTH, rsp[47:32], 32'd0};
+                            isr_abort <= 1'b1;
+                        end
+                    end
+                    default: ;
+                endcase
+            end
+
+            //////////////////////////////////////////////////////////////////
+            // Decode: plain frames are served here, the rest is forwarded
+            //////////////////////////////////////////////////////////////////
+            case (dec)
+                DEC_LOOK: begin
+                    dec_hit   <= look_hit;
+                    dec_off   <= look_off[10:0];
+                    dec_width <= look_width;
+                    b_addr    <= look_off[10:2];
+                    dec       <= DEC_WAIT;
+                end
+                DEC_WAIT: begin
+                    dec <= DEC_EXEC;    // b_q and dec_flags settle
+                end
+                DEC_EXEC: begin
+                    dec <= DEC_IDLE;
+                    if (serve) begin
+                        rsp[63:32] <= {f_op, STATUS_OK, f_addr};
+                        if (f_op == OP_READ) begin
+                            rsp[31:0] <= reg_value;
+                        end else if (f_op == OP_WRITE) begin
+                            rsp[31:0] <= wr_value;
+                            b_din     <= wr_value << (8 * dec_off[1:0]);
+                            b_we      <= wr_lanes;
+                            dirty[b_addr[8:5]][b_addr[4:0]] <= 1'b1;
+                        end else begin
+                            rsp[31:0] <= 32'd0;
+                        end
+                        rsp_ready <= 1'b1;
+                        fast_cnt  <= fast_cnt + 32'd1;
+                    end else begin
+                        req       <= frame;
+                        isr_frame <= 1'b1;
+                    end
+                end
+                default: ;
+            endcase
+        end
+    end
+
+    //////////////////////////////////////////////////////////////////////////
+    // AXI responses
+    //////////////////////////////////////////////////////////////////////////
+
+    reg [31:0] rx_q;
+
+    always @(posedge clk) begin
+        rx_q <= rxbuf[s_axi_araddr[8:2]];
+    end
+
+    always @(posedge clk) begin
+        if (rst) begin
+            s_axi_bvalid <= 1'b0;
+            s_axi_rvalid <= 1'b0;
+            rd_busy      <= 1'b0;
+        end else begin
+            if (wr_fire)
+                s_axi_bvalid <= 1'b1;
+            else if (s_axi_bready)
+                s_axi_bvalid <= 1'b0;
+
+            if (rd_fire) begin
+                rd_addr <= s_axi_araddr;
+                rd_busy <= 1'b1;
+            end else if (rd_busy) begin
+                rd_busy      <= 1'b0;
+                s_axi_rvalid <= 1'b1;
+                if (rd_addr[12:11] == 2'b00) begin
+                    s_axi_rdata <= a_q;
+                end else if (rd_addr[12:11] == 2'b01) begin
+                    s_axi_rdata <= rx_q;
+                end else begin
+                    case (rd_addr[7:2])
+                        A_CTRL:     s_axi_rdata <= {31'd0, fast_en};
+                        A_ISR:      s_axi_rdata <= {27'd0, isr};
+                        A_IER:      s_axi_rdata <= {27'd0, ier};
+                        A_REQ_HDR:  s_axi_rdata <= req[63:32];
+                        A_REQ_DATA: s_axi_rdata <= req[31:0];
+                        A_RSP_HDR:  s_axi_rdata <= rsp[63:32];
+                        A_RSP_DATA: s_axi_rdata <= rsp[31:0];
+                        A_PHASE:    s_axi_rdata <= {6'd0, mode, xfer_len - pay_cnt};
+                        A_TXFREE:   s_axi_rdata <= {22'd0, tx_free};
+                        A_FASTCNT:  s_axi_rdata <= fast_cnt;
+                        default: begin
+                            if (rd_addr[7:6] == 2'b01 && !rd_addr[2])
+                                s_axi_rdata <= {win_count[rd_addr[4:3]], win_base[rd_addr[4:3]]};
+                            else if (rd_addr[7:6] == 2'b01)
+                                s_axi_rdata <= {win_en[rd_addr[4:3]], 12'd0, win_width[rd_addr[4:3]], 5'd0, win_off[rd_addr[4:3]]};
+                            else if (rd_addr[7:6] == 2'b10)
+                                s_axi_rdata <= dirty[rd_addr[5:2]];
+                            else
+                                s_axi_rdata <= 32'd0;
+                        end
+                    endcase
+                end
+            end else if (s_axi_rready) begin
+                s_axi_rvalid <= 1'b0;
+            end
+        end
+    end
+
+endmodule
+
+`default_nettype wire
@@ -0,0 +1,435 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// dspi_regfile_tb.v -- Testbench of the fabric DSPI slave
+//
+//////////////////////////////////////////////////////////////////////////////
+// Module Description:
+//
+// Plays the host on the SPI pins and the firmware on the AXI-Lite window of
+// dspi_regfile: frames served in fabric, frames forwarded to the CPU, both
+// payload phases, STATUS_DROPPED for a frame that comes before the response
+// is staged and the abort of a short payload. Prints PASS or FAIL at the
+// end.
+//
+//     iverilog -g2005 -o tb dspi_regfile_tb.v ../hdl/dspi_regfile.v
+//     vvp tb +sck_div=9
+//
+// +sck_div sets the SCK period in s_axi_aclk cycles. The module requires
+// SCK below an eighth of its clock, so 9 is the fastest SCK it must serve.
+//
+//////////////////////////////////////////////////////////////////////////////
+// Revision History:
+//
+//    10/19/2026:           Created
+//    10/19/2026:           Early frames answer STATUS_DROPPED
+//
+//////////////////////////////////////////////////////////////////////////////
+
+`timescale 1ns / 1ps
+`default_nettype none
+
+module dspi_regfile_tb;
+
+    localparam [7:0] OP_NOP    = 8'h00;
+    localparam [7:0] OP_WRITE  = 8'hAA;
+    localparam [7:0] OP_READ   = 8'hBB;
+    localparam [7:0] OP_OTHER  = 8'hC0;     // any op the engine forwards
+    localparam [7:0] ST_OK     = 8'h00;
+    localparam [7:0] ST_BADLEN = 8'h05;
+    localparam [7:0] ST_DROP   = 8'h09;
+
+    localparam [12:0] REGS     = 13'h0000;
+    localparam [12:0] RXBUF    = 13'h0800;
+    localparam [12:0] CTRL     = 13'h1000;
+    localparam [12:0] ISR      = 13'h1004;
+    localparam [12:0] IER      = 13'h1008;
+    localparam [12:0] REQ_HDR  = 13'h100C;
+    localparam [12:0] REQ_DATA = 13'h1010;
+    localparam [12:0] RSP_HDR  = 13'h1014;
+    localparam [12:0] RSP_DATA = 13'h1018;
+    localparam [12:0] PHASE    = 13'h101C;
+    localparam [12:0] TXFIFO   = 13'h1020;
+    localparam [12:0] TXFREE   = 13'h1024;
+    localparam [12:0] FLAGS    = 13'h1028;
+    localparam [12:0] FASTCNT  = 13'h102C;
+    localparam [12:0] WIN0     = 13'h1040;
+    localparam [12:0] DIRTY0   = 13'h1080;
+
+    localparam [31:0] PHASE_RECV = 32'h01000000;
+    localparam [31:0] PHASE_SEND = 32'h02000000;
+
+    localparam CLK_HALF = 5;
+
+    reg         clk = 1'b0;
+    reg         aresetn = 1'b0;
+    reg  [12:0] awaddr = 13'd0;
+    reg         awvalid = 1'b0;
+    wire        awready;
+    reg  [31:0] wdata = 32'd0;
+    reg  [3:0]  wstrb = 4'hF;
+    reg         wvalid = 1'b0;
+    wire        wready;
+    wire [1:0]  bresp;
+    wire        bvalid;
+    reg  [12:0] araddr = 13'd0;
+    reg         arvalid = 1'b0;
+    wire        arready;
+    wire [31:0] rdata;
+    wire [1:0]  rresp;
+    wire        rvalid;
+    wire        irq;
+    reg         sck = 1'b0;
+    reg         mosi = 1'b0;
+    wire        miso;
+    reg         ss_n = 1'b1;
+
+    dspi_regfile dut (
+        .s_axi_aclk(clk),
+        .s_axi_aresetn(aresetn),
+        .s_axi_awaddr(awaddr),
+        .s_axi_awprot(3'd0),
+        .s_axi_awvalid(awvalid),
+        .s_axi_awready(awready),
+        .s_axi_wdata(wdata),
+        .s_axi_wstrb(wstrb),
+        .s_axi_wvalid(wvalid),
+        .s_axi_wready(wready),
+        .s_axi_bresp(bresp),
+        .s_axi_bvalid(bvalid),
+        .s_axi_bready(1'b1),
+        .s_axi_araddr(araddr),
+        .s_axi_arprot(3'd0),
+        .s_axi_arvalid(arvalid),
+        .s_axi_arready(arready),
+        .s_axi_rdata(rdata),
+        .s_axi_rresp(rresp),
+        .s_axi_rvalid(rvalid),
+        .s_axi_rready(1'b1),
+        .irq(irq),
+        .dspi_sck_io(sck),
+        .dspi_io0_io(mosi),
+        .dspi_io1_io(miso),
+        .dspi_spisel(ss_n)
+    );
+
+    always #CLK_HALF clk = ~clk;
+
+    integer errors = 0;
+    integer sck_div = 9;
+    integer sck_half;
+    integer i;
+
+    //////////////////////////////////////////////////////////////////////////
+    // Checks
+    //////////////////////////////////////////////////////////////////////////
+
+    task check;
+        input [63:0]  got;
+        input [63:0]  expect;
+        input [383:0] what;
+        begin
+            if (got !== expect) begin
+                $display("FAIL %0s: got %h, expected %h", what, got, expect);
+                errors = errors + 1;
+            end
+        end
+    endtask
+
+    //////////////////////////////////////////////////////////////////////////
+    // Firmware side, one AXI-Lite access at a time. Inputs change one time
+    // unit after a rising edge and are sampled on the falling one.
+    //////////////////////////////////////////////////////////////////////////
+
+    task axi_write;
+        input [12:0] addr;
+        input [31:0] data;
+        begin
+            @(posedge clk) #1;
+            awaddr  = addr;
+            wdata   = data;
+            awvalid = 1'b1;
+            wvalid  = 1'b1;
+            @(negedge clk);
+            while (!awready)
+                @(negedge clk);
+            @(posedge clk) #1;
+            awvalid = 1'b0;
+            wvalid  = 1'b0;
+        end
+    endtask
+
+    task axi_read;
+        input  [12:0] addr;
+        output [31:0] data;
+        begin
+            @(posedge clk) #1;
+            araddr  = addr;
+            arvalid = 1'b1;
+            @(negedge clk);
+            while (!arready)
+                @(negedge clk);
+            @(posedge clk) #1;
+            arvalid = 1'b0;
+            @(negedge clk);
+            while (!rvalid)
+                @(negedge clk);
+            data = rdata;
+        end
+    endtask
+
+    task wait_irq;
+        integer n;
+        begin
+            n = 0;
+            while (!irq && n < 1000) begin
+                @(negedge clk);
+                n = n + 1;
+            end
+            if (!irq) begin
+                $display("FAIL no interrupt");
+                errors = errors + 1;
+            end
+        end
+    endtask
+
+    //////////////////////////////////////////////////////////////////////////
+    // Host side: mode 0, MSB first. The edges sit one time unit after a
+    // falling clock edge so they never race the synchronizers.
+    //////////////////////////////////////////////////////////////////////////
+
+    reg [7:0] tx [0:63];
+    reg [7:0] rx [0:63];
+
+    task spi_xfer;
+        input integer len;
+        integer n;
+        integer b;
+        begin
+            @(negedge clk) #1;
+            ss_n = 1'b0;
+            for (n = 0; n < len; n = n + 1) begin
+                for (b = 7; b >= 0; b = b - 1) begin
+                    mosi = tx[n][b];
+                    #(sck_half);
+                    sck = 1'b1;
+                    rx[n][b] = miso;
+                    #(sck_half);
+                    sck = 1'b0;
+                end
+            end
+            #(sck_half);
+            ss_n = 1'b1;
+            // Leave the engine time to decode before the next transfer
+            repeat (12) @(negedge clk);
+        end
+    endtask
+
+    // Sends a frame and returns the response to the previous one
+    task frame;
+        input  [7:0]  op;
+        input  [7:0]  width;
+        input  [15:0] addr;
+        input  [31:0] data;
+        output [63:0] rsp;
+        begin
+            {tx[0], tx[1], tx[2], tx[3], tx[4], tx[5], tx[6], tx[7]} = {op, width, addr, data};
+            spi_xfer(8);
+            rsp = {rx[0], rx[1], rx[2], rx[3], rx[4], rx[5], rx[6], rx[7]};
+        end
+    endtask
+
+    //////////////////////////////////////////////////////////////////////////
+    // Tests
+    //////////////////////////////////////////////////////////////////////////
+
+    reg [63:0] rsp;
+    reg [31:0] r;
+
+    initial begin
+        if (!$value$plusargs("sck_div=%d", sck_div))
+            sck_div = 9;
+        sck_half = sck_div * CLK_HALF;
+        $display("SCK = clk / %0d", sck_div);
+
+        repeat (4) @(posedge clk);
+        aresetn = 1'b1;
+
+        // Firmware init. The flag RAM powers up clear on the FPGA.
+        for (i = 0; i < 2048; i = i + 1)
+            axi_write(FLAGS, i);
+        axi_write(REGS + 13'h10, 32'hBEEF1234);
+        axi_write(WIN0, {16'd4, 16'h0100});         // 0x0100 - 0x0103
+        axi_write(WIN0 + 4, 32'h80020010);          // 16-bit at REGS 0x10
+        axi_write(ISR, 32'h1F);
+        axi_write(IER, 32'h1F);
+        axi_write(CTRL, 32'h1);
+
+        // Reads and writes the fabric serves, without an interrupt
+        frame(OP_READ, 8'd2, 16'h0100, 32'd0, rsp);
+        frame(OP_READ, 8'd2, 16'h0101, 32'd0, rsp);
+        check(rsp, {OP_READ, ST_OK, 16'h0100, 32'h00001234}, "fast read");
+        frame(OP_WRITE, 8'd2, 16'h0101, 32'h00005555, rsp);
+        check(rsp, {OP_READ, ST_OK, 16'h0101, 32'h0000BEEF}, "fast read high half");
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_WRITE, ST_OK, 16'h0101, 32'h00005555}, "fast write");
+        axi_read(REGS + 13'h10, r);
+        check(r, 32'h55551234, "fast write lands in the RAM");
+        axi_read(DIRTY0, r);
+        check(r, 32'h00000010, "dirty bit of the write");
+        axi_read(DIRTY0, r);
+        check(r, 32'h00000000, "dirty read clears");
+        axi_read(FASTCNT, r);
+        check(r, 32'd4, "frames served in fabric");
+        check(irq, 1'b0, "no interrupt for served frames");
+
+        // A frame of another length is dropped, the response stays pending
+        tx[0] = OP_READ;
+        tx[1] = 8'd2;
+        tx[2] = 8'h01;
+        spi_xfer(3);
+        axi_read(FASTCNT, r);
+        check(r, 32'd4, "short frame dropped");
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_NOP, ST_OK, 16'h0000, 32'd0}, "response after short frame");
+
+        // Forwarded ops, a forwarded register and a width mismatch
+        frame(OP_OTHER, 8'd4, 16'h1234, 32'hCAFEF00D, rsp);
+        wait_irq;
+        axi_read(ISR, r);
+        check(r, 32'h01, "ISR of a forwarded frame");
+        axi_read(REQ_HDR, r);
+        check(r, {OP_OTHER, 8'd4, 16'h1234}, "forwarded header");
+        axi_read(REQ_DATA, r);
+        check(r, 32'hCAFEF00D, "forwarded data");
+        axi_write(ISR, 32'h01);
+        axi_write(RSP_HDR, {OP_OTHER, ST_OK, 16'h1234});
+        axi_write(RSP_DATA, 32'h00000042);
+        axi_write(PHASE, 32'd0);
+        check(irq, 1'b0, "interrupt cleared");
+        frame(OP_READ, 8'd4, 16'h0100, 32'd0, rsp);
+        check(rsp, {OP_OTHER, ST_OK, 16'h1234, 32'h00000042}, "staged response");
+        wait_irq;
+        axi_read(REQ_HDR, r);
+        check(r, {OP_READ, 8'd4, 16'h0100}, "width mismatch forwarded");
+        axi_write(ISR, 32'h01);
+        axi_write(RSP_HDR, {OP_READ, ST_OK, 16'h0100});
+        axi_write(RSP_DATA, 32'h00001234);
+        axi_write(PHASE, 32'd0);
+        axi_write(FLAGS, 32'h00010010);
+        frame(OP_READ, 8'd2, 16'h0100, 32'd0, rsp);
+        wait_irq;
+        axi_read(REQ_HDR, r);
+        check(r, {OP_READ, 8'd2, 16'h0100}, "flagged read forwarded");
+        axi_write(FLAGS, 32'h00000010);
+        axi_write(ISR, 32'h01);
+        axi_write(RSP_HDR, {OP_READ, ST_OK, 16'h0100});
+        axi_write(RSP_DATA, 32'h00001234);
+        axi_write(PHASE, 32'd0);
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_READ, ST_OK, 16'h0100, 32'h00001234}, "flagged read response");
+
+        // A frame before the response is staged gets STATUS_DROPPED and is
+        // dropped, the staged response goes out with the next one
+        frame(OP_OTHER, 8'd0, 16'h0042, 32'd0, rsp);
+        wait_irq;
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_NOP, ST_DROP, 16'h0000, 32'd0}, "early frame dropped");
+        axi_read(ISR, r);
+        check(r, 32'h09, "ISR late");
+        axi_write(ISR, 32'h09);
+        axi_write(RSP_HDR, {OP_OTHER, ST_OK, 16'h0042});
+        axi_write(RSP_DATA, 32'd7);
+        axi_write(PHASE, 32'd0);
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_OTHER, ST_OK, 16'h0042, 32'd7}, "response after drop");
+
+        // Request payload
+        frame(OP_OTHER, 8'd0, 16'h0200, 32'd6, rsp);
+        wait_irq;
+        axi_write(ISR, 32'h01);
+        axi_write(PHASE, PHASE_RECV | 32'd6);
+        for (i = 0; i < 6; i = i + 1)
+            tx[i] = 8'h11 * (i + 1);
+        spi_xfer(6);
+        wait_irq;
+        axi_read(ISR, r);
+        check(r, 32'h02, "ISR payload received");
+        axi_read(RXBUF, r);
+        check(r, 32'h44332211, "request payload word 0");
+        axi_read(RXBUF + 4, r);
+        check(r[15:0], 16'h6655, "request payload word 1");
+        axi_write(ISR, 32'h02);
+        axi_write(RSP_HDR, {OP_OTHER, ST_OK, 16'h0200});
+        axi_write(RSP_DATA, 32'd6);
+        axi_write(PHASE, 32'd0);
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_OTHER, ST_OK, 16'h0200, 32'd6}, "response after request payload");
+
+        // Reply payload, the response goes out after it
+        frame(OP_OTHER, 8'd0, 16'h0300, 32'd6, rsp);
+        wait_irq;
+        axi_write(ISR, 32'h01);
+        axi_write(RSP_HDR, {OP_OTHER, ST_OK, 16'h0300});
+        axi_write(RSP_DATA, 32'd6);
+        axi_write(TXFIFO, 32'hD4C3B2A1);
+        axi_write(TXFIFO, 32'h0000F6E5);
+        axi_write(PHASE, PHASE_SEND | 32'd6);
+        for (i = 0; i < 6; i = i + 1)
+            tx[i] = 8'h00;
+        spi_xfer(6);
+        check({rx[0], rx[1], rx[2], rx[3], rx[4], rx[5]}, 48'hA1B2C3D4E5F6, "reply payload");
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_OTHER, ST_OK, 16'h0300, 32'd6}, "response after reply payload");
+        axi_read(ISR, r);
+        check(r, 32'h00, "ISR after reply payload");
+
+        // A short request payload aborts the phase
+        frame(OP_OTHER, 8'd0, 16'h0400, 32'd8, rsp);
+        wait_irq;
+        axi_write(ISR, 32'h01);
+        axi_write(PHASE, PHASE_RECV | 32'd8);
+        spi_xfer(4);
+        wait_irq;
+        axi_read(ISR, r);
+        check(r, 32'h10, "ISR short request payload");
+        axi_read(PHASE, r);
+        check(r[25:24], 2'd0, "frame mode after short request payload");
+        axi_write(ISR, 32'h10);
+        frame(OP_READ, 8'd2, 16'h0100, 32'd0, rsp);
+        check(rsp, {OP_OTHER, ST_BADLEN, 16'h0400, 32'd0}, "short request payload");
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_READ, ST_OK, 16'h0100, 32'h00001234}, "frame after short request payload");
+
+        // A short reply payload aborts the phase and empties the TX FIFO
+        frame(OP_OTHER, 8'd0, 16'h0500, 32'd8, rsp);
+        wait_irq;
+        axi_write(ISR, 32'h01);
+        axi_write(RSP_HDR, {OP_OTHER, ST_OK, 16'h0500});
+        axi_write(RSP_DATA, 32'd8);
+        axi_write(TXFIFO, 32'h04030201);
+        axi_write(TXFIFO, 32'h08070605);
+        axi_write(PHASE, PHASE_SEND | 32'd8);
+        spi_xfer(4);
+        check({rx[0], rx[1], rx[2], rx[3]}, 32'h01020304, "short reply payload bytes");
+        wait_irq;
+        axi_read(ISR, r);
+        check(r, 32'h10, "ISR short reply payload");
+        axi_read(TXFREE, r);
+        check(r, 32'd512, "TX FIFO emptied");
+        axi_write(ISR, 32'h10);
+        frame(OP_READ, 8'd2, 16'h0101, 32'd0, rsp);
+        check(rsp, {OP_OTHER, ST_BADLEN, 16'h0500, 32'd0}, "short reply payload");
+        frame(OP_NOP, 8'd0, 16'h0000, 32'd0, rsp);
+        check(rsp, {OP_READ, ST_OK, 16'h0101, 32'h00005555}, "frame after short reply payload");
+        check(irq, 1'b0, "no interrupt left");
+
+        if (errors == 0)
+            $display("PASS");
+        else
+            $display("FAIL %0d checks", errors);
+        $finish;
+    end
+
+endmodule
+
+`default_nettype wire
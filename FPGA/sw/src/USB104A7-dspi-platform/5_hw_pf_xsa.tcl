@@ -10,6 +10,21 @@ set hw_src [lindex [glob -nocomplain $script_dir/*.xsa] 0]
 
 puts "INFO: Found $hw_src"
 
+# The firmware drives the capture timer and the fabric register file. An XSA
+# exported before they were added to the block design still makes a platform,
+# so refuse it here rather than at the first run on the board.
+set hw_design [hsi::open_hw_design $hw_src]
+set missing {}
+foreach cell {axi_timer_0 dspi_regfile_0} {
+	if {[llength [hsi::get_cells -hierarchical $cell]] == 0} {
+		lappend missing $cell
+	}
+}
+hsi::close_hw_design $hw_design
+if {[llength $missing] != 0} {
+	return -code error "ERROR: $hw_src has no $missing, re-export design_1_wrapper.xsa from Vivado"
+}
+
 set hw_name [file tail $script_dir]
 
 platform create -name "$hw_name" -hw "$hw_src"
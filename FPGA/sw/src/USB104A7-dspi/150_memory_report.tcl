@@ -0,0 +1,60 @@
+# This script will report the memory placement of the application named after the script directory
+# It lists the size of every section, the LMB budget, and the symbols pinned in LMB,
+# and fails if the interrupt path has been linked outside LMB.
+# Run after the build script. Workspace should be set externally
+
+set script [info script] 
+set script_dir [file normalize [file dirname $script]]
+
+puts "INFO: Running $script"
+
+set app_name [file tail $script_dir]
+
+# Must match the LMB region of src/lscript.ld
+set lmb_origin 0x50
+set lmb_length 0x1FB0
+
+# Symbols whose latency must not depend on DDR or the caches
+set hot_symbols {FabricInterruptHandler FabricFeed XIntc_DeviceInterruptHandler XTmrCtr_InterruptHandler CaptureTick main RegRead RegWrite TraceRecord}
+
+set build_config [app config -name $app_name build-config]
+set elf [file join [getws] $app_name $build_config $app_name.elf]
+if {![file exists $elf]} {
+	return -code error "ERROR: $elf not found, build $app_name first"
+}
+
+puts "INFO: Section sizes of $elf"
+puts [exec mb-size -A -x $elf]
+
+# Sum the LMB sections
+set lmb_used 0
+foreach line [split [exec mb-objdump -h $elf] "\n"] {
+	if {[regexp {^\s*\d+\s+(\S+)\s+([0-9a-f]+)\s+([0-9a-f]+)} $line -> name size vma]} {
+		set size [expr 0x$size]
+		set vma [expr 0x$vma]
+		if {$vma >= $lmb_origin && $vma < $lmb_origin + $lmb_length} {
+			incr lmb_used $size
+			puts [format "INFO: LMB  %-14s 0x%08X %6d bytes" $name $vma $size]
+		}
+	}
+}
+puts [format "INFO: LMB usage %d of %d bytes (%d%%)" $lmb_used $lmb_length [expr {100 * $lmb_used / $lmb_length}]]
+
+# Check the hot path placement
+set errors 0
+foreach line [split [exec mb-nm -S $elf] "\n"] {
+	if {[regexp {^([0-9a-f]+)\s+([0-9a-f]+)\s+[tT]\s+(\S+)$} $line -> addr size name]} {
+		if {[lsearch -exact $hot_symbols $name] >= 0} {
+			set addr [expr 0x$addr]
+			if {$addr >= $lmb_origin && $addr < $lmb_origin + $lmb_length} {
+				puts [format "INFO: %-30s 0x%08X LMB" $name $addr]
+			} else {
+				puts [format "ERROR: %-29s 0x%08X DDR" $name $addr]
+				incr errors
+			}
+		}
+	}
+}
+if {$errors != 0} {
+	return -code error "ERROR: $errors hot path symbols are not in LMB"
+}
@@ -3,7 +3,8 @@
 # It imports all source files from the src subdirectory as LINKS.
 # BUG 2020.1: linker script imported as link won't build, import by setting
 # linker-script app config as a workaround.
-# It also sets some C/C++ build settings
+# It also sets some C/C++ build settings, including the include path of the
+# register map shared with the host application (<repo>/regmap)
 # Workspace should be set externally
 
 set script [info script] 
@@ -42,10 +43,14 @@ app config -set -name $app_name assembler-flags {}
 app config -set -name $app_name compiler-misc {-c -fmessage-length=0 -MT"$@"}
 app config -set -name $app_name compiler-optimization {Optimize more (-O2)}
 app config -add -name $app_name include-path $script_dir/src
+app config -add -name $app_name include-path [file normalize $script_dir/../../../../regmap]
 app config -set -name $app_name linker-script $script_dir/src/lscript.ld
+app config -add -name $app_name linker-misc "-Wl,--print-memory-usage -Wl,-Map=$app_name.map"
 app config -set -name $app_name build-config Debug
 app config -set -name $app_name assembler-flags {}
 app config -set -name $app_name compiler-misc {-c -fmessage-length=0 -MT"$@"}
 app config -set -name $app_name compiler-optimization {None (-O0)}
 app config -add -name $app_name include-path $script_dir/src
+app config -add -name $app_name include-path [file normalize $script_dir/../../../../regmap]
 app config -set -name $app_name linker-script $script_dir/src/lscript.ld
+app config -add -name $app_name linker-misc "-Wl,--print-memory-usage -Wl,-Map=$app_name.map"
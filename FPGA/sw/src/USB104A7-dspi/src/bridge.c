@@ -0,0 +1,116 @@
+/******************************************************************************/
+/*                                                                            */
+/* bridge.c -- Batched AXI peek/poke through the DSPI link                    */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Executes batches of 32-bit AXI reads and writes for the host. Addresses    */
+/* are checked against an allow-list of peripheral windows. The DSPI core     */
+/* itself is left out so the host cannot break its own link, and only the    */
+/* part of DDR above the firmware image is open.                              */
+/*                                                                            */
+/******************************************************************************/
+
+#include "xparameters.h"
+#include "xil_io.h"
+#include "bridge.h"
+#include "dspi_protocol.h"
+
+typedef struct {
+	u32 base;
+	u32 size;
+	u8 access;
+} BridgeWindow;
+
+/*
+ * End of the firmware image, stack and heap included. Provided by lscript.ld.
+ */
+extern char _end[];
+
+static BridgeWindow windows[] = {
+	{XPAR_AXI_GPIO_BTNS_LEDS_BASEADDR, 0x10000, BRIDGE_RW},
+	{XPAR_AXI_UARTLITE_0_BASEADDR, 0x10000, BRIDGE_RW},
+	{XPAR_AXI_INTC_0_BASEADDR, 0x10000, BRIDGE_READ},
+	{0, 0, BRIDGE_RW},	// DDR above the firmware image, set by BridgeInit()
+};
+#define N_WINDOWS (sizeof(windows)/sizeof(windows[0]))
+
+/**
+* Opens the unused part of DDR to the bridge.
+*/
+void BridgeInit(){
+	u32 base = ((UINTPTR)_end + 3) & ~3;
+
+	windows[N_WINDOWS-1].base = base;
+	windows[N_WINDOWS-1].size = XPAR_MIG7SERIES_0_HIGHADDR - base + 1;
+}
+
+/**
+* Checks an access against the allow-list.
+*
+* @param addr address of the access
+* @param kind BRIDGE_READ or BRIDGE_WRITE
+*
+* @return STATUS_OK, STATUS_BAD_ADDR if misaligned, STATUS_DENIED if not allowed
+*
+*/
+static u8 BridgeCheck(u32 addr, u8 kind){
+	u32 i;
+
+	if(addr & 3){
+		return STATUS_BAD_ADDR;
+	}
+	for(i = 0; i < N_WINDOWS; i++){
+		if(addr - windows[i].base < windows[i].size){
+			return (windows[i].access & kind) ? STATUS_OK : STATUS_DENIED;
+		}
+	}
+	return STATUS_DENIED;
+}
+
+/**
+* Executes a batch of AXI requests. A failed request does not stop the batch.
+*
+* @param req request records
+* @param count number of requests
+* @param rsp receives one reply record per request
+* @param status receives STATUS_OK, or the status of the first failed request
+*
+* @return size of the reply payload in bytes
+*
+*/
+u16 BridgeExecute(const u8 *req, u16 count, u8 *rsp, u8 *status){
+	u16 i;
+	u8 kind;
+	u8 st;
+	u32 addr;
+	u32 value;
+
+	*status = STATUS_OK;
+	for(i = 0; i < count; i++, req += BRIDGE_REQ_SIZE, rsp += BRIDGE_RSP_SIZE){
+		kind = req[0];
+		addr = GetBE32(req + 1);
+		value = GetBE32(req + 5);
+		if(kind != BRIDGE_READ && kind != BRIDGE_WRITE){
+			st = STATUS_BAD_OP;
+		}
+		else if((st = BridgeCheck(addr, kind)) == STATUS_OK){
+			if(kind == BRIDGE_WRITE){
+				Xil_Out32(addr, value);
+			}
+			else{
+				value = Xil_In32(addr);
+			}
+		}
+		if(st != STATUS_OK){
+			value = 0;
+			if(*status == STATUS_OK){
+				*status = st;
+			}
+		}
+		rsp[0] = st;
+		PutBE32(rsp + 1, value);
+	}
+	return count * BRIDGE_RSP_SIZE;
+}
@@ -0,0 +1,35 @@
+/******************************************************************************/
+/*                                                                            */
+/* bridge.h -- Batched AXI peek/poke through the DSPI link                    */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* OP_AXI_BATCH carries the number of requests in its data field and is       */
+/* followed by a request payload of BRIDGE_REQ_SIZE byte records:             */
+/*     [kind, a3, a2, a1, a0, v3, v2, v1, v0]                                 */
+/* The reply payload holds one BRIDGE_RSP_SIZE record per request:            */
+/*     [status, v3, v2, v1, v0]                                               */
+/* with the value read, or the value written for writes. Only 32-bit aligned  */
+/* addresses inside the allow-list are accessed.                              */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef BRIDGE_H_
+#define BRIDGE_H_
+
+#include "xil_types.h"
+#include "placement.h"
+
+#define BRIDGE_READ 0x01
+#define BRIDGE_WRITE 0x02
+#define BRIDGE_RW (BRIDGE_READ | BRIDGE_WRITE)
+
+#define BRIDGE_REQ_SIZE 9
+#define BRIDGE_RSP_SIZE 5
+#define BRIDGE_MAX_OPS 48
+
+void BridgeInit() DDR_TEXT;
+u16 BridgeExecute(const u8 *req, u16 count, u8 *rsp, u8 *status);
+
+#endif
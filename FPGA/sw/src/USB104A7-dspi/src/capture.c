@@ -0,0 +1,270 @@
+/******************************************************************************/
+/*                                                                            */
+/* capture.c -- Timer-driven capture of register traces into DDR              */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Samples are taken in the timer interrupt, which is pinned in LMB next to  */
+/* the DSPI interrupt path. The ring holds cap_pre + cap_post samples, so     */
+/* samples after the trigger only overwrite samples older than the pre-       */
+/* trigger window. Samples are stored big endian, like every other word on    */
+/* the link, so the trace is streamed without conversion. Finishing also      */
+/* packs the trace with ENC_DZV, channel by channel, for hosts that prefer    */
+/* fewer bytes on the wire.                                                   */
+/*                                                                            */
+/******************************************************************************/
+
+#include "xparameters.h"
+#include "xtmrctr.h"
+#include "capture.h"
+#include "registers.h"
+#include "codec.h"
+#include "dspi_protocol.h"
+#include "trace.h"
+
+
+static u32 CaptureMem[CAPTURE_SIZE / 4] DDR_BSS;
+static u8 CapturePacked[DZV_MAX_SIZE(CAPTURE_SIZE / 4)] DDR_BSS;
+static XTmrCtr Timer LMB_BSS;
+
+volatile u8 captureState LMB_BSS;
+u32 captureLen LMB_BSS;		// samples in the finished trace
+u32 captureTrigAt LMB_BSS;	// trigger sample in the finished trace
+u32 captureZLen LMB_BSS;	// bytes of the packed trace
+
+// Arm time copy of the configuration
+static u16 src[CAPTURE_MAX_CHANNELS] LMB_BSS;
+static u8 chans LMB_BSS;
+static u32 trigMask LMB_BSS;
+static u32 trigValue LMB_BSS;
+static u32 pre LMB_BSS;
+static u32 depth LMB_BSS;	// ring size in samples
+
+// Ring state, owned by the timer interrupt while it runs
+static u32 head LMB_BSS;	// next sample index
+static u32 filled LMB_BSS;	// samples in the ring, up to depth
+static u32 remaining LMB_BSS;	// samples still to take after the trigger
+static u32 trigIdx LMB_BSS;
+static u32 preTaken LMB_BSS;
+static u8 fMatched LMB_BSS;
+
+static void CaptureTick(void *CallBackRef, u8 TmrCtrNumber) LMB_TEXT;
+static void CaptureTrigger() LMB_TEXT;
+
+static void CaptureTrigger(){
+	trigIdx = head;
+	preTaken = filled < pre ? filled : pre;
+	captureState = CAPTURE_TRIGGERED;
+}
+
+/**
+* Timer interrupt, takes one sample.
+*/
+static void CaptureTick(void *CallBackRef, u8 TmrCtrNumber){
+	u8 *sample = (u8 *)(CaptureMem + head * chans);
+	u32 value, first = 0;
+	u8 i;
+	u8 fMatch;
+
+	for(i = 0; i < chans; i++){
+		if(RegRead(src[i], 0, &value) != STATUS_OK){
+			value = 0;
+		}
+		if(i == 0){
+			first = value;
+		}
+		PutBE32(sample + 4 * i, value);
+	}
+
+	if(captureState == CAPTURE_ARMED){
+		fMatch = (first & trigMask) == (trigValue & trigMask);
+		if(fMatch && !fMatched){
+			CaptureTrigger();
+		}
+		fMatched = fMatch;
+	}
+	if(captureState == CAPTURE_TRIGGERED && --remaining == 0){
+		XTmrCtr_Stop(&Timer, 0);
+		captureState = CAPTURE_FINISHING;
+	}
+
+	if(++head == depth){
+		head = 0;
+	}
+	if(filled < depth){
+		filled++;
+	}
+}
+
+/**
+* Sets up the sample timer.
+*
+* @param intc started interrupt controller
+*
+* @return XST_SUCCESS or XST_FAILURE
+*
+*/
+int CaptureInit(XIntc *intc){
+	int Status;
+
+	Status = XTmrCtr_Initialize(&Timer, XPAR_AXI_TIMER_0_DEVICE_ID);
+	if(Status != XST_SUCCESS){
+		return XST_FAILURE;
+	}
+	XTmrCtr_SetHandler(&Timer, CaptureTick, NULL);
+	XTmrCtr_SetOptions(&Timer, 0, XTC_INT_MODE_OPTION | XTC_AUTO_RELOAD_OPTION | XTC_DOWN_COUNT_OPTION);
+	Status = XIntc_Connect(intc, XPAR_INTC_0_TMRCTR_0_VEC_ID,
+				(XInterruptHandler) XTmrCtr_InterruptHandler,
+				(void *)&Timer);
+	if(Status != XST_SUCCESS){
+		return XST_FAILURE;
+	}
+	XIntc_Enable(intc, XPAR_INTC_0_TMRCTR_0_VEC_ID);
+
+	// The other counter runs free as the trace clock
+	XTmrCtr_SetOptions(&Timer, TRACE_TIMER, XTC_AUTO_RELOAD_OPTION);
+	XTmrCtr_SetResetValue(&Timer, TRACE_TIMER, 0);
+	XTmrCtr_Start(&Timer, TRACE_TIMER);
+	return XST_SUCCESS;
+}
+
+/**
+* Arms the capture from the cap_* registers, stops it or triggers it now.
+*
+* @param ctl CAPTURE_CTL_ARM, CAPTURE_CTL_STOP or CAPTURE_CTL_TRIGGER
+*
+* @return STATUS_OK, STATUS_BAD_LENGTH if the configuration does not fit,
+* STATUS_BUSY to trigger a capture that is not armed
+*
+*/
+u8 CaptureControl(u32 ctl){
+	u32 period, post, value;
+	u8 i;
+
+	switch(ctl){
+		case CAPTURE_CTL_STOP:
+			XTmrCtr_Stop(&Timer, 0);
+			captureState = CAPTURE_IDLE;
+			return STATUS_OK;
+		case CAPTURE_CTL_TRIGGER:
+			if(captureState != CAPTURE_ARMED){
+				return STATUS_BUSY;
+			}
+			XTmrCtr_Stop(&Timer, 0);
+			CaptureTrigger();
+			XTmrCtr_Start(&Timer, 0);
+			return STATUS_OK;
+		case CAPTURE_CTL_ARM:
+			break;
+		default:
+			return STATUS_BAD_ADDR;
+	}
+
+	XTmrCtr_Stop(&Timer, 0);
+	captureState = CAPTURE_IDLE;
+	RegRead(REG_CAP_PERIOD, 0, &period);
+	RegRead(REG_CAP_CHANS, 0, &value);
+	RegRead(REG_CAP_PRE, 0, &pre);
+	RegRead(REG_CAP_POST, 0, &post);
+	RegRead(REG_CAP_TRIG_MASK, 0, &trigMask);
+	RegRead(REG_CAP_TRIG_VALUE, 0, &trigValue);
+	chans = value == 0 ? 1 : value;
+	if(value > CAPTURE_MAX_CHANNELS || period < CAPTURE_MIN_PERIOD_US || post == 0
+		|| pre > CAPTURE_SIZE / 4 / chans || post > CAPTURE_SIZE / 4 / chans - pre){
+		return STATUS_BAD_LENGTH;
+	}
+	for(i = 0; i < chans; i++){
+		RegRead(REG_CAP_SRC0 + i, 0, &value);
+		src[i] = value;
+	}
+
+	depth = pre + post;
+	head = 0;
+	filled = 0;
+	remaining = post;
+	fMatched = 0;
+	captureLen = 0;
+	captureTrigAt = 0;
+	captureZLen = 0;
+	captureState = CAPTURE_ARMED;
+	if(trigMask == 0){
+		CaptureTrigger();
+	}
+	XTmrCtr_SetResetValue(&Timer, 0, period * (XPAR_AXI_TIMER_0_CLOCK_FREQ_HZ / 1000000));
+	XTmrCtr_Start(&Timer, 0);
+	return STATUS_OK;
+}
+
+/**
+* @return CAPTURE_IDLE, CAPTURE_ARMED, CAPTURE_TRIGGERED or CAPTURE_DONE
+*/
+u8 CaptureState(){
+	return captureState == CAPTURE_FINISHING ? CAPTURE_TRIGGERED : captureState;
+}
+
+static void Reverse(u32 *p, u32 n){
+	u32 t;
+	u32 i;
+
+	for(i = 0; i < n / 2; i++){
+		t = p[i];
+		p[i] = p[n - 1 - i];
+		p[n - 1 - i] = t;
+	}
+}
+
+/**
+* Turns the ring of a stopped capture into a linear trace, oldest sample
+* first, and packs it. Called from the main loop, not time critical.
+*/
+void CaptureFinish(){
+	u32 start = (trigIdx + depth - preTaken) % depth;
+	u32 n = depth * chans;
+	u32 k = start * chans;
+
+	// Rotate left by k words: three reversals, in place
+	Reverse(CaptureMem, k);
+	Reverse(CaptureMem + k, n - k);
+	Reverse(CaptureMem, n);
+
+	captureLen = preTaken + (depth - pre);
+	captureTrigAt = preTaken;
+	captureZLen = DzvEncode((const u8 *)CaptureMem, captureLen * chans, chans, CapturePacked);
+	captureState = CAPTURE_DONE;
+}
+
+/**
+* Locates a part of the finished trace for OP_CAPTURE_READ.
+*
+* @param encoding ENC_RAW for the trace, ENC_DZV for the packed trace
+* @param offset byte offset in the trace
+* @param len number of bytes, at most CAPTURE_SIZE
+* @param data receives the bytes to send. Also set for a rejected read, so the
+* payload phase can go ahead.
+*
+* @return STATUS_OK, STATUS_BUSY while no trace is finished, STATUS_BAD_ADDR
+* if the bytes are not all in the trace, STATUS_BAD_WIDTH for an unknown
+* encoding
+*
+*/
+u8 CaptureTrace(u8 encoding, u32 offset, u32 len, const u8 **data){
+	u32 size = captureLen * chans * 4;
+
+	*data = (const u8 *)CaptureMem;
+	if(encoding == ENC_DZV){
+		*data = CapturePacked;
+		size = captureZLen;
+	}
+	else if(encoding != ENC_RAW){
+		return STATUS_BAD_WIDTH;
+	}
+	if(captureState != CAPTURE_DONE){
+		return STATUS_BUSY;
+	}
+	if(offset > size || len > size - offset){
+		return STATUS_BAD_ADDR;
+	}
+	*data += offset;
+	return STATUS_OK;
+}
@@ -0,0 +1,36 @@
+/******************************************************************************/
+/*                                                                            */
+/* capture.h -- Timer-driven capture of register traces into DDR              */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* The AXI timer interrupts every cap_period us and samples the cap_src       */
+/* registers into a ring in DDR. Once armed, the ring keeps the last cap_pre  */
+/* samples until channel 0 starts to match the trigger, then cap_post more    */
+/* samples are taken and the timer stops. The main loop then turns the ring   */
+/* into a linear trace that OP_CAPTURE_READ streams out.                      */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include "xil_types.h"
+#include "xintc.h"
+#include "placement.h"
+
+#define CAPTURE_FINISHING 0x80	// captureState once stopped, ring not yet linear
+
+int CaptureInit(XIntc *intc) DDR_TEXT;
+u8 CaptureControl(u32 ctl);
+u8 CaptureState();
+void CaptureFinish();
+u8 CaptureTrace(u8 encoding, u32 offset, u32 len, const u8 **data);
+
+extern u32 captureLen;
+extern u32 captureTrigAt;
+extern u32 captureZLen;
+extern volatile u8 captureState;
+
+#endif
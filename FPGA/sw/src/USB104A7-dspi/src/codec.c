@@ -0,0 +1,161 @@
+/******************************************************************************/
+/*                                                                            */
+/* codec.c -- Payload encodings of the DSPI link                              */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* The encoder only runs once per finished capture, from the main loop. The   */
+/* decoder runs for every bulk write payload and sits in LMB.                 */
+/*                                                                            */
+/******************************************************************************/
+
+#include "codec.h"
+#include "dspi_protocol.h"
+
+static u8 *PutVarint(u8 *p, u32 v){
+	while(v >= 0x80){
+		*p++ = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+/**
+* Reads an LEB128 varint of at most 5 bytes.
+*
+* @return 0 if the varint runs past end or is too long
+*
+*/
+static inline int GetVarint(const u8 **p, const u8 *end, u32 *v){
+	const u8 *q = *p;
+	u32 shift;
+	u8 b;
+
+	*v = 0;
+	for(shift = 0; shift < 35; shift += 7){
+		if(q == end){
+			return 0;
+		}
+		b = *q++;
+		*v |= (u32)(b & 0x7F) << shift;
+		if(!(b & 0x80)){
+			*p = q;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+* Packs big endian words with ENC_DZV.
+*
+* @param words count big endian 32-bit words
+* @param count number of words
+* @param stride distance of the word each word is diffed against
+* @param out receives up to DZV_MAX_SIZE(count) bytes
+*
+* @return number of bytes written
+*
+*/
+u32 DzvEncode(const u8 *words, u32 count, u32 stride, u8 *out){
+	u8 *p = out;
+	u32 i, d, z;
+	u32 run = 0;
+
+	for(i = 0; i < count; i++){
+		d = GetBE32(words + 4 * i);
+		if(i >= stride){
+			d -= GetBE32(words + 4 * (i - stride));
+		}
+		z = (d << 1) ^ (u32)((s32)d >> 31);
+		if(z == 0){
+			run++;
+			continue;
+		}
+		if(run != 0){
+			*p++ = 0;
+			p = PutVarint(p, run);
+			run = 0;
+		}
+		p = PutVarint(p, z);
+	}
+	if(run != 0){
+		*p++ = 0;
+		p = PutVarint(p, run);
+	}
+	return p - out;
+}
+
+/**
+* Unpacks ENC_DZV data into exactly count words.
+*
+* @param in encoded bytes
+* @param len number of encoded bytes
+* @param out receives count words
+* @param count number of words expected
+* @param stride distance of the word each word is diffed against
+*
+* @return STATUS_OK, STATUS_BAD_LENGTH if the data is malformed or does not
+* hold exactly count words
+*
+*/
+u8 DzvDecode(const u8 *in, u32 len, u32 *out, u32 count, u32 stride){
+	const u8 *end = in + len;
+	u32 i = 0;
+	u32 z, run;
+
+	while(in != end){
+		if(!GetVarint(&in, end, &z)){
+			return STATUS_BAD_LENGTH;
+		}
+		if(z == 0){
+			if(!GetVarint(&in, end, &run) || run == 0 || run > count - i){
+				return STATUS_BAD_LENGTH;
+			}
+			for(; run != 0; run--, i++){
+				out[i] = i < stride ? 0 : out[i - stride];
+			}
+			continue;
+		}
+		if(i == count){
+			return STATUS_BAD_LENGTH;
+		}
+		out[i] = (i < stride ? 0 : out[i - stride]) + ((z >> 1) ^ -(z & 1));
+		i++;
+	}
+	return i == count ? STATUS_OK : STATUS_BAD_LENGTH;
+}
+
+/**
+* Unpacks a request payload of 32-bit words.
+*
+* @param encoding ENC_RAW or ENC_DZV, with a stride of 1
+* @param in payload
+* @param len payload length
+* @param out receives count words
+* @param count number of words the payload must hold
+*
+* @return STATUS_OK, STATUS_BAD_WIDTH for an unknown encoding,
+* STATUS_BAD_LENGTH if the payload does not hold count words
+*
+*/
+u8 CodecUnpack(u8 encoding, const u8 *in, u32 len, u32 *out, u32 count){
+	u32 i;
+
+	switch(encoding){
+		case ENC_RAW:
+			if(len != 4 * count){
+				return STATUS_BAD_LENGTH;
+			}
+			for(i = 0; i < count; i++){
+				out[i] = GetBE32(in + 4 * i);
+			}
+			return STATUS_OK;
+		case ENC_DZV:
+			return DzvDecode(in, len, out, count, 1);
+		default:
+			return STATUS_BAD_WIDTH;
+	}
+}
@@ -0,0 +1,28 @@
+/******************************************************************************/
+/*                                                                            */
+/* codec.h -- Payload encodings of the DSPI link                              */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* ENC_DZV (dspi_protocol.h) is a delta, zero-run and varint code of 32-bit   */
+/* words. Register tables and traces change slowly, so most differences fit   */
+/* in one or two bytes and idle stretches collapse into a single run. The     */
+/* decoder is a short byte loop without tables or lookback windows, small     */
+/* enough for LMB and no load on the 8 KB caches.                             */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef CODEC_H_
+#define CODEC_H_
+
+#include "xil_types.h"
+#include "placement.h"
+
+#define DZV_MAX_SIZE(count) (5 * (count))	// worst case encoded bytes
+
+u32 DzvEncode(const u8 *words, u32 count, u32 stride, u8 *out);
+u8 DzvDecode(const u8 *in, u32 len, u32 *out, u32 count, u32 stride) LMB_TEXT;
+u8 CodecUnpack(u8 encoding, const u8 *in, u32 len, u32 *out, u32 count) LMB_TEXT;
+
+#endif
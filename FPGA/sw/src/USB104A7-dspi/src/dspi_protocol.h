@@ -0,0 +1,237 @@
+/******************************************************************************/
+/*                                                                            */
+/* dspi_protocol.h -- DSPI frame layout shared by the firmware modules        */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Every command is a fixed FRAME_SIZE frame:                                 */
+/*     [op, width, addrHi, addrLo, d3, d2, d1, d0]                            */
+/* and is answered while the next frame is clocked in with:                   */
+/*     [op, status, addrHi, addrLo, v3, v2, v1, v0]                           */
+/* where op and address echo the command being answered. Multi-byte fields    */
+/* are big endian. A width of 0 selects the register's native width.         */
+/*                                                                            */
+/* Commands that move more than a frame continue with payload phases right   */
+/* after their frame: the master first sends the request payload, then reads  */
+/* the reply payload. The frame response is staged once both phases are done. */
+/* A payload transfer of another length ends the payload phases: the command  */
+/* is answered with STATUS_BAD_LENGTH and the next transfer is a frame again. */
+/* A frame of another length is dropped. With the fabric slave, a frame that  */
+/* comes before the last response is staged is dropped too and answered with */
+/* STATUS_DROPPED; the master sends it again and the response is still due.   */
+/*                                                                            */
+/* The bit commands modify a register atomically and answer with its new      */
+/* value. OP_OPERAND latches its data as the second operand of the commands   */
+/* that need two, e.g. OP_MASK_WRITE writes (reg & ~operand) | (d & operand). */
+/*                                                                            */
+/* OP_CAS writes d if the register holds operand. OP_WAIT polls the register  */
+/* on the device until (reg & operand) == (d & operand) or WAIT_SLICE_US      */
+/* pass, and only then stages its response and re-arms. The master must leave */
+/* at least WAIT_SLICE_US + WAIT_MARGIN_US before the next transfer; longer   */
+/* waits are a run of OP_WAIT frames.                                         */
+/*                                                                            */
+/* OP_SCRIPT_LOAD copies a request payload of d bytes into script memory at   */
+/* offset addr; it has no reply payload. Scripts are started, stopped and     */
+/* watched through the script register (regmap.def), see script.h.            */
+/*                                                                            */
+/* OP_CAPTURE_READ streams d bytes of the finished capture trace from byte    */
+/* offset operand as its reply payload, straight out of the trace memory.     */
+/* The payload length only depends on the frame: a read the device rejects   */
+/* still sends d bytes and reports the status with the next frame.            */
+/*                                                                            */
+/* On payload commands the width byte selects the payload encoding, ENC_RAW   */
+/* or ENC_DZV. OP_BULK_WRITE writes operand consecutive registers from addr   */
+/* out of a request payload of d bytes and answers with the count; with       */
+/* ENC_DZV on OP_CAPTURE_READ, d and operand address the packed trace of      */
+/* cap_zlen bytes.                                                            */
+/*                                                                            */
+/* OP_IDENTIFY answers identify word addr (ID_*): versions, limits and a      */
+/* bitmap of the opcodes served, so the host can pick its paths. Firmware     */
+/* from before it answers STATUS_BAD_OP and speaks PROTOCOL_LEGACY.           */
+/*                                                                            */
+/* OP_DELTA_SCAN stages the operand registers from addr, at most              */
+/* DELTA_MAX_REGS of one region, written after generation d and answers with  */
+/* the length of that delta; OP_DELTA_READ streams d bytes of it as its reply */
+/* payload, sent even if rejected. A delta is the current generation, a       */
+/* bitmap of (operand + 7) / 8 bytes with bit i % 8 of byte i / 8 set for     */
+/* every changed register i, and the value of each changed register, see      */
+/* registers.h. Generation 0 selects every register.                          */
+/*                                                                            */
+/* OP_TRACE controls the event trace of trace.h: addr selects TRACE_CLOCK,    */
+/* TRACE_COUNT or TRACE_START. OP_TRACE_READ streams d bytes of events from   */
+/* event operand as its reply payload, sent even if rejected. An event is the */
+/* trace clock, the event, and the opcode and address of its frame.           */
+/*                                                                            */
+/* This file must be kept in step with the host application.                  */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef DSPI_PROTOCOL_H_
+#define DSPI_PROTOCOL_H_
+
+#include "xil_types.h"
+
+#define FRAME_SIZE 8
+#define FRAME_OP 0
+#define FRAME_WIDTH 1
+#define FRAME_STATUS 1
+#define FRAME_ADDR 2
+#define FRAME_DATA 4
+
+#define OP_NOP 0x00
+#define OP_WRITE 0xAA
+#define OP_READ 0xBB
+#define OP_AXI_BATCH 0xC0
+#define OP_OPERAND 0xA0
+#define OP_SET_BITS 0xA1
+#define OP_CLEAR_BITS 0xA2
+#define OP_TOGGLE_BITS 0xA3
+#define OP_MASK_WRITE 0xA4
+#define OP_CAS 0xA5
+#define OP_WAIT 0xA6
+#define OP_SCRIPT_LOAD 0xC1
+#define OP_CAPTURE_READ 0xC2
+#define OP_BULK_WRITE 0xC3
+#define OP_IDENTIFY 0xA7
+#define OP_DELTA_SCAN 0xA8
+#define OP_DELTA_READ 0xC4
+#define OP_TRACE 0xA9
+#define OP_TRACE_READ 0xC5
+
+#define PROTOCOL_VERSION 2
+#define PROTOCOL_LEGACY 1	// OP_NOP to OP_BULK_WRITE, no OP_IDENTIFY
+
+#define ID_VERSION 0	// PROTOCOL_VERSION << 16 | FIRMWARE_VERSION
+#define ID_REGISTERS 1	// registers in the register map
+#define ID_PAYLOAD 2	// PAYLOAD_SIZE
+#define ID_BURST 3	// BULK_MAX_WORDS << 16 | BRIDGE_MAX_OPS
+#define ID_FIFO 4	// reply payload FIFO of the SPI slave, bytes
+#define ID_FEATURES 5	// FEATURE_*
+#define ID_OPS 8	// 8 words, bit op % 32 of word ID_OPS + op / 32 per opcode served
+#define ID_COUNT 16
+
+#define FEATURE_FABRIC 0x01	// the fabric answers plain frames
+#define FEATURE_DZV 0x02	// ENC_DZV payloads
+
+#define WAIT_SLICE_US 500
+#define WAIT_MARGIN_US 250
+
+/*
+ * Largest payload phase. Sized for a full batch of bridge requests.
+ */
+#define PAYLOAD_SIZE 512
+
+#define STATUS_OK 0x00
+#define STATUS_BAD_OP 0x01
+#define STATUS_BAD_ADDR 0x02
+#define STATUS_BAD_WIDTH 0x03
+#define STATUS_DENIED 0x04
+#define STATUS_BAD_LENGTH 0x05
+#define STATUS_MISMATCH 0x06
+#define STATUS_TIMEOUT 0x07
+#define STATUS_BUSY 0x08
+#define STATUS_DROPPED 0x09
+
+/*
+ * Script bytecode. Every instruction is an opcode byte followed by big endian
+ * operands: a = 16-bit register address, m/v = 32-bit mask/value, us =
+ * 32-bit microseconds, t = 16-bit script offset. acc is the value of the last
+ * SC_LOAD.
+ */
+#define SC_END 0x00	// stop, success
+#define SC_WRITE 0x01	// a v
+#define SC_SET 0x02	// a m
+#define SC_CLEAR 0x03	// a m
+#define SC_TOGGLE 0x04	// a m
+#define SC_DELAY 0x05	// us
+#define SC_WAIT 0x06	// a m v us, fails with STATUS_TIMEOUT
+#define SC_LOAD 0x07	// a
+#define SC_BEQ 0x08	// m v t, branch if (acc & m) == v
+#define SC_BNE 0x09	// m v t, branch if (acc & m) != v
+#define SC_JUMP 0x0A	// t
+
+#define SCRIPT_SIZE 4096
+
+/*
+ * Script register: write an offset to start there, SCRIPT_CTL_STOP to stop.
+ * Reads return the state: pc, last status and SCRIPT_STATE_RUNNING.
+ */
+#define SCRIPT_CTL_STOP 0x80000000
+#define SCRIPT_STATE_RUNNING 0x01000000
+#define SCRIPT_STATE_STATUS(s) (((s) >> 16) & 0xFF)
+#define SCRIPT_STATE_PC(s) ((s) & 0xFFFF)
+
+/*
+ * Capture engine. A trace holds samples of cap_chans 32-bit words each,
+ * oldest first: cap_trig_at samples before the trigger, then the trigger
+ * sample and the rest of cap_post.
+ */
+#define CAPTURE_SIZE 0x40000	// bytes of trace memory
+#define CAPTURE_MAX_CHANNELS 4
+#define CAPTURE_MIN_PERIOD_US 5
+
+#define CAPTURE_CTL_STOP 0	// writes to cap_ctl
+#define CAPTURE_CTL_ARM 1
+#define CAPTURE_CTL_TRIGGER 2	// trigger now
+
+#define CAPTURE_IDLE 0		// reads of cap_ctl
+#define CAPTURE_ARMED 1
+#define CAPTURE_TRIGGERED 2
+#define CAPTURE_DONE 3
+
+/*
+ * Payload encodings. ENC_DZV packs 32-bit words: each word is replaced by
+ * its difference to the word stride places back (0 for the first stride
+ * words), zigzag mapped and written as an LEB128 varint. A varint 0 is
+ * followed by a varint count of zero differences. The stride is 1 for bulk
+ * writes and cap_chans for traces, so every channel is diffed with itself.
+ */
+#define ENC_RAW 0
+#define ENC_DZV 1
+
+#define BULK_MAX_WORDS 4096	// registers per OP_BULK_WRITE
+
+#define DELTA_MAX_REGS 1024	// registers per OP_DELTA_SCAN
+#define DELTA_MAX_SIZE(n) (4 + ((n) + 7) / 8 + 4 * (n))	// delta of n registers, all changed
+
+#define TRACE_CLOCK 0	// OP_TRACE answers the trace clock
+#define TRACE_COUNT 1	// OP_TRACE answers the events recorded since the start
+#define TRACE_START 2	// OP_TRACE starts a new trace if d is 1, stops it if 0
+#define TRACE_TICK_HZ 100000000	// 32-bit trace clock, the AXI clock
+#define TRACE_DEPTH 1024	// events kept, a power of 2
+#define TRACE_EVENT_SIZE 8	// BE32 clock, event, opcode, BE16 address
+
+/*
+ * Trace events, with TRACE_EV_BEGIN or TRACE_EV_END for spans.
+ */
+#define TRACE_EV_IRQ 0x01	// link interrupt, the frame is the one it raised
+#define TRACE_EV_FRAME 0x02	// a forwarded frame, from decode to response
+#define TRACE_EV_PAYLOAD 0x03	// a request payload, from arrival to response
+#define TRACE_EV_PRINT 0x04	// UART output after a frame
+#define TRACE_EV_CAPTURE 0x05	// finishing a capture
+#define TRACE_EV_BEGIN 0x40
+#define TRACE_EV_END 0x80
+#define TRACE_EV_KIND(e) ((e) & 0x3F)
+
+static inline u16 GetBE16(const u8 *p){
+	return ((u16)p[0] << 8) | p[1];
+}
+
+static inline u32 GetBE32(const u8 *p){
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+static inline void PutBE16(u8 *p, u16 v){
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static inline void PutBE32(u8 *p, u32 v){
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+#endif
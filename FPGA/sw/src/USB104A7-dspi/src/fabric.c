@@ -0,0 +1,256 @@
+/******************************************************************************/
+/*                                                                            */
+/* fabric.c -- DSPI link through the dspi_regfile block in the fabric         */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Driver of the forwarding side of dspi_regfile, see the module header for   */
+/* the register layout. The interrupt only latches events for the main loop,  */
+/* except for reply payloads: those are fed into the TX FIFO from the         */
+/* interrupt, so a long capture read streams while scripts run.               */
+/*                                                                            */
+/******************************************************************************/
+
+#include "xil_io.h"
+#include "fabric.h"
+#include "dspi_protocol.h"
+#include "trace.h"
+
+#define FABRIC_RXBUF (FABRIC_BASEADDR + 0x0800)
+#define FABRIC_CTRL (FABRIC_BASEADDR + 0x1000)
+#define FABRIC_ISR (FABRIC_BASEADDR + 0x1004)
+#define FABRIC_IER (FABRIC_BASEADDR + 0x1008)
+#define FABRIC_REQ_HDR (FABRIC_BASEADDR + 0x100C)
+#define FABRIC_REQ_DATA (FABRIC_BASEADDR + 0x1010)
+#define FABRIC_RSP_HDR (FABRIC_BASEADDR + 0x1014)
+#define FABRIC_RSP_DATA (FABRIC_BASEADDR + 0x1018)
+#define FABRIC_PHASE (FABRIC_BASEADDR + 0x101C)
+#define FABRIC_TXFIFO (FABRIC_BASEADDR + 0x1020)
+#define FABRIC_TXFREE (FABRIC_BASEADDR + 0x1024)
+#define FABRIC_FLAGS (FABRIC_BASEADDR + 0x1028)
+#define FABRIC_WIN(n) (FABRIC_BASEADDR + 0x1040 + 8 * (n))
+#define FABRIC_DIRTY(n) (FABRIC_BASEADDR + 0x1080 + 4 * (n))
+
+#define CTRL_SERVE 0x01
+
+#define INT_FRAME 0x01
+#define INT_RECV 0x02
+#define INT_TX_LOW 0x04
+#define INT_LATE 0x08
+#define INT_ABORT 0x10
+
+#define PHASE_FRAME (0 << 24)
+#define PHASE_RECV (1 << 24)
+#define PHASE_SEND (2 << 24)
+
+#define FLAG_FWD_READ (1 << 16)
+#define FLAG_FWD_WRITE (1 << 17)
+
+volatile u8 fabricEvents LMB_BSS;
+volatile u8 fabricAbort LMB_BSS;	// a payload phase ended early, see fabric.h
+volatile u32 fabricLate LMB_BSS;	// frames answered STATUS_DROPPED, payload underruns
+volatile u32 fabricTicks LMB_BSS;	// trace clock of the last event, while tracing
+
+// Reply payload still to push
+static const u8 *txData LMB_BSS;
+static u32 txLeft LMB_BSS;
+
+static void FabricFeed() LMB_TEXT;
+
+/**
+* Pushes reply payload while the TX FIFO has room, byte 0 of each word first.
+*/
+static void FabricFeed(){
+	u32 room = Xil_In32(FABRIC_TXFREE);
+	u32 word;
+
+	while(txLeft != 0 && room >= 4){
+		word = txData[0];
+		if(txLeft > 1) word |= (u32)txData[1] << 8;
+		if(txLeft > 2) word |= (u32)txData[2] << 16;
+		if(txLeft > 3) word |= (u32)txData[3] << 24;
+		Xil_Out32(FABRIC_TXFIFO, word);
+		if(txLeft <= 4){
+			txLeft = 0;
+			break;
+		}
+		txData += 4;
+		txLeft -= 4;
+		room -= 4;
+	}
+}
+
+void FabricInterruptHandler(void *CallBackRef){
+	u32 isr = Xil_In32(FABRIC_ISR);
+
+	if(isr & INT_ABORT){
+		txLeft = 0;	// the fabric emptied the TX FIFO
+		fabricAbort = 1;
+	}else if(isr & INT_TX_LOW){
+		FabricFeed();
+	}
+	if(isr & INT_LATE){
+		fabricLate++;
+	}
+	if(traceOn && (isr & (INT_FRAME | INT_RECV))){
+		fabricTicks = TraceTicks();
+	}
+	fabricEvents |= isr & (FABRIC_EV_FRAME | FABRIC_EV_RECV);
+	Xil_Out32(FABRIC_ISR, isr & (INT_FRAME | INT_RECV | INT_LATE | INT_ABORT));
+}
+
+/**
+* Connects the link interrupt and lets the fabric answer plain frames. The
+* regions must be mapped first, see RegFabricInit().
+*
+* @param intc interrupt controller, started afterwards
+*
+* @return XST_SUCCESS or XST_FAILURE
+*
+*/
+int FabricInit(XIntc *intc){
+	int Status;
+
+	Status = XIntc_Connect(intc, FABRIC_INTR_ID, (XInterruptHandler) FabricInterruptHandler, NULL);
+	if(Status != XST_SUCCESS){
+		return XST_FAILURE;
+	}
+	XIntc_Enable(intc, FABRIC_INTR_ID);
+	Xil_Out32(FABRIC_ISR, INT_FRAME | INT_RECV | INT_LATE | INT_ABORT);
+	Xil_Out32(FABRIC_IER, INT_FRAME | INT_RECV | INT_TX_LOW | INT_LATE | INT_ABORT);
+	Xil_Out32(FABRIC_CTRL, CTRL_SERVE);
+	return XST_SUCCESS;
+}
+
+/**
+* Maps a register region held in the register RAM into the frame decoder.
+*
+* @param window 0 to FABRIC_WINDOWS - 1
+* @param base first register
+* @param count number of registers
+* @param width register width in bytes
+* @param store backing array, inside the register RAM
+*
+*/
+void FabricMapRegion(u8 window, u16 base, u16 count, u8 width, volatile void *store){
+	Xil_Out32(FABRIC_WIN(window), ((u32)count << 16) | base);
+	Xil_Out32(FABRIC_WIN(window) + 4, 0x80000000 | ((u32)width << 16) | ((UINTPTR)store - FABRIC_BASEADDR));
+}
+
+/**
+* Sets whether the fabric forwards reads and writes of a register to the
+* firmware instead of answering them itself.
+*
+* @param reg the register in the register RAM
+* @param reads nonzero to forward reads
+* @param writes nonzero to forward writes
+*
+*/
+void FabricForward(volatile void *reg, u8 reads, u8 writes){
+	Xil_Out32(FABRIC_FLAGS, ((UINTPTR)reg - FABRIC_BASEADDR)
+		| (reads ? FLAG_FWD_READ : 0) | (writes ? FLAG_FWD_WRITE : 0));
+}
+
+/**
+* Forwards all frames until FabricRelease(), so a read-modify-write of the
+* register RAM cannot interleave with a frame. The read back waits for the
+* write to land.
+*/
+void FabricHold(){
+	Xil_Out32(FABRIC_CTRL, 0);
+	(void)Xil_In32(FABRIC_CTRL);
+}
+
+void FabricRelease(){
+	Xil_Out32(FABRIC_CTRL, CTRL_SERVE);
+}
+
+/**
+* Copies the forwarded frame.
+*
+* @param frame receives FRAME_SIZE bytes
+*
+*/
+void FabricFrame(u8 *frame){
+	PutBE32(frame, Xil_In32(FABRIC_REQ_HDR));
+	PutBE32(frame + FRAME_DATA, Xil_In32(FABRIC_REQ_DATA));
+}
+
+/**
+* Stages the response to the forwarded frame. It goes out while the master
+* clocks in the next frame.
+*
+* @param response FRAME_SIZE bytes
+*
+*/
+void FabricRespond(const u8 *response){
+	Xil_Out32(FABRIC_RSP_HDR, GetBE32(response));
+	Xil_Out32(FABRIC_RSP_DATA, GetBE32(response + FRAME_DATA));
+	Xil_Out32(FABRIC_PHASE, PHASE_FRAME);
+}
+
+/**
+* Arms the request payload of the forwarded frame. FABRIC_EV_RECV follows
+* once len bytes have arrived.
+*
+* @param len payload length, at most PAYLOAD_SIZE
+*
+*/
+void FabricRecv(u32 len){
+	Xil_Out32(FABRIC_PHASE, PHASE_RECV | len);
+}
+
+/**
+* Copies the request payload.
+*
+* @param buf receives len bytes
+* @param len payload length, at most PAYLOAD_SIZE
+*
+*/
+void FabricPayload(u8 *buf, u32 len){
+	u32 word = 0;
+	u32 i;
+
+	for(i = 0; i < len; i++){
+		if((i & 3) == 0){
+			word = Xil_In32(FABRIC_RXBUF + i);
+		}
+		buf[i] = word >> (8 * (i & 3));
+	}
+}
+
+/**
+* Stages the response to the forwarded frame behind a reply payload. The
+* payload is streamed from data as the TX FIFO drains, data must stay valid
+* until the master has read it.
+*
+* @param response FRAME_SIZE bytes
+* @param data reply payload
+* @param len payload length
+*
+*/
+void FabricSend(const u8 *response, const u8 *data, u32 len){
+	Xil_Out32(FABRIC_RSP_HDR, GetBE32(response));
+	Xil_Out32(FABRIC_RSP_DATA, GetBE32(response + FRAME_DATA));
+	txData = data;
+	txLeft = len;
+	FabricFeed();
+	Xil_Out32(FABRIC_PHASE, PHASE_SEND | len);
+}
+
+/**
+* Takes the dirty bitmap of the register RAM: bit n % 32 of word n / 32 is
+* set if the fabric served a write to word n since the last call. Reading a
+* word clears it.
+*
+* @param words receives FABRIC_DIRTY_WORDS words
+*
+*/
+void FabricDirty(u32 *words){
+	u32 i;
+
+	for(i = 0; i < FABRIC_DIRTY_WORDS; i++){
+		words[i] = Xil_In32(FABRIC_DIRTY(i));
+	}
+}
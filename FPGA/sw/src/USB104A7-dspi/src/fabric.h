@@ -0,0 +1,65 @@
+/******************************************************************************/
+/*                                                                            */
+/* fabric.h -- DSPI link through the dspi_regfile block in the fabric         */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* dspi_regfile (FPGA/hw/src/hdl) is the SPI slave on the DSPI pins. It holds */
+/* the FAB_BSS register regions in a RAM it shares with the MicroBlaze and    */
+/* answers reads and writes of registers without hooks by itself. Every other */
+/* frame raises FABRIC_EV_FRAME; the main loop decodes it as before and then  */
+/* stages its response, or arms a payload phase, with the calls below. A      */
+/* payload transfer of another length than armed ends the phase in the        */
+/* fabric, which answers the command with STATUS_BAD_LENGTH and sets          */
+/* fabricAbort; the next event then starts at a frame again.                  */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef FABRIC_H_
+#define FABRIC_H_
+
+#include "xil_types.h"
+#include "xintc.h"
+#include "placement.h"
+
+/*
+ * dspi_regfile_0 in design_1.tcl: AXI window and intr_bus input. Module
+ * references get no xparameters entries.
+ */
+#define FABRIC_BASEADDR 0x44A00000
+#define FABRIC_INTR_ID 0
+#define FABRIC_REGS_SIZE 0x800	// bytes of register RAM
+#define FABRIC_WINDOWS 4
+#define FABRIC_TXFIFO_SIZE 512	// bytes of reply payload the fabric buffers
+#define FABRIC_DIRTY_WORDS 16	// dirty bitmap, a bit per word of register RAM
+
+#define FABRIC_EV_FRAME 0x01	// a forwarded frame is waiting
+#define FABRIC_EV_RECV 0x02	// the request payload has arrived
+
+int FabricInit(XIntc *intc) DDR_TEXT;
+void FabricInterruptHandler(void *CallBackRef) LMB_TEXT;
+void FabricMapRegion(u8 window, u16 base, u16 count, u8 width, volatile void *store) DDR_TEXT;
+void FabricForward(volatile void *reg, u8 reads, u8 writes) DDR_TEXT;
+void FabricHold() LMB_TEXT;
+void FabricRelease() LMB_TEXT;
+void FabricFrame(u8 *frame) LMB_TEXT;
+void FabricRespond(const u8 *response) LMB_TEXT;
+void FabricRecv(u32 len) LMB_TEXT;
+void FabricPayload(u8 *buf, u32 len) LMB_TEXT;
+void FabricSend(const u8 *response, const u8 *data, u32 len) LMB_TEXT;
+void FabricDirty(u32 *words) DDR_TEXT;
+
+/*
+ * The register RAM as seen by the MicroBlaze.
+ */
+static inline u8 FabricOwns(volatile void *p){
+	return (UINTPTR)p - FABRIC_BASEADDR < FABRIC_REGS_SIZE;
+}
+
+extern volatile u8 fabricEvents;
+extern volatile u8 fabricAbort;
+extern volatile u32 fabricLate;
+extern volatile u32 fabricTicks;
+
+#endif
@@ -12,14 +12,33 @@
 /* the USB104A7                                                               */
 /*                                                                            */
 /* Adept DSPI commands are sent from the USB104A7_DSPI_DemoApp application.   */
-/* When a write operation is received, then print out the bytes that were     */
-/* received. When a read operation is received, then send [length] bytes      */
-/* back over DSPI as a counter.                                               */
+/* Every command is a fixed BUFFER_SIZE frame. Frames are pipelined: while    */
+/* frame N is clocked in, the response to frame N-1 is clocked out, so a      */
+/* register read or write costs a single SPI transaction.                     */
+/*                                                                            */
+/* The SPI slave is dspi_regfile in the fabric. It answers NOP and plain      */
+/* reads and writes of the register sets by itself and forwards every other   */
+/* frame here; see fabric.h.                                                  */
 /*                                                                            */
 /******************************************************************************/
 /* Revision History:                                                          */
 /*                                                                            */
 /*    08/13/2020(TommyK):   Created                                           */
+/*    10/19/2026:           Pipelined fixed-size frames                       */
+/*    10/19/2026:           16-bit address space with 8/16/32-bit registers   */
+/*    10/19/2026:           Payload phases and batched AXI bridge             */
+/*    10/19/2026:           Pin the interrupt and dispatch path in LMB        */
+/*    10/19/2026:           Register hooks, GPIO sampled only when accessed   */
+/*    10/19/2026:           Atomic bit set/clear/toggle and masked write      */
+/*    10/19/2026:           Compare-and-swap and device-side wait             */
+/*    10/19/2026:           Register scripts run between frames               */
+/*    10/19/2026:           Timer-driven capture streamed from DDR            */
+/*    10/19/2026:           Delta/varint packed bulk writes and traces        */
+/*    10/19/2026:           Fabric register file answers plain frames         */
+/*    10/19/2026:           Identify opcode for capability discovery          */
+/*    10/19/2026:           Write generations and delta readout               */
+/*    10/19/2026:           Event trace with a free-running clock             */
+/*    10/19/2026:           Payloads of another length abort the phase        */
 /*                                                                            */
 /******************************************************************************/
 /* Baud Rate :                                                                */
@@ -31,96 +50,282 @@
 #include <stdio.h>
 #include "platform.h"
 #include "xil_printf.h"
-#include "xspi.h"
 #include "xparameters.h"
 #include "xil_testmem.h"
 #include "xintc.h"
+#include "dspi_protocol.h"
+#include "registers.h"
+#include "bridge.h"
+#include "script.h"
+#include "capture.h"
+#include "codec.h"
+#include "placement.h"
+#include "fabric.h"
+#include "trace.h"
+
+/*
+ * Reported by OP_IDENTIFY, one step per revision above.
+ */
+#define FIRMWARE_VERSION 16
+
+XIntc INTERRUPTC LMB_BSS;
+
+/*
+ * The forwarded frame and its response. The fabric holds the response until
+ * the master clocks in the next frame.
+ */
+u8 Frame[FRAME_SIZE] LMB_BSS;
+u8 Response[FRAME_SIZE] LMB_BSS;
+
+/*
+ * What follows a forwarded frame: another frame, or a payload phase of a
+ * command that moves more than a frame. The fabric runs the phases, the
+ * main loop only sees their ends.
+ */
+typedef enum {
+	PHASE_FRAME,	// the response goes out with the next frame
+	PHASE_RECV,	// a request payload comes in first
+	PHASE_SEND	// a reply payload goes out after the response
+} LinkPhase;
+
+u8 PayloadIn[PAYLOAD_SIZE] DDR_BSS;
+u8 PayloadOut[PAYLOAD_SIZE] DDR_BSS;
+LinkPhase phase LMB_BSS;
+u32 payloadLen LMB_BSS;
+const u8 *payloadTx LMB_BSS;	// reply payload, PayloadOut unless streamed from elsewhere
+u32 BulkWords[BULK_MAX_WORDS] DDR_BSS;	// unpacked OP_BULK_WRITE payload
+u8 DeltaBuf[DELTA_MAX_SIZE(DELTA_MAX_REGS)] DDR_BSS;	// staged by OP_DELTA_SCAN
+u32 deltaLen LMB_BSS;
 
-#define BUFFER_SIZE 4
-XIntc INTERRUPTC;
-XSpi DSPI;
-u8 WriteBuffer[4];
-u8 ReadBuffer[4];
-
-#define N_REGISTERS 64
-#define BTNREG 0
-#define LEDREG 1
-volatile u8 RegisterSet[N_REGISTERS];
 u8 cmd=0;
-u8 reg=0;
-
-volatile u8 transferDone=0;
-volatile u8 slaveSelected=0;
-
-int init();
+u16 reg=0;
+u32 operand LMB_BSS;	// latched by OP_OPERAND
 
-void DSPI_Interrupt_Handler(void *CallBackRef, u32 StatusEvent, u32 ByteCount){
-	if(StatusEvent == XST_SPI_SLAVE_MODE){//Slave select low
-		//Load registers with current system state when SS goes low.
-		RegisterSet[BTNREG] = Xil_In32(XPAR_AXI_GPIO_BTNS_LEDS_BASEADDR);
-		RegisterSet[LEDREG] = Xil_In32(XPAR_AXI_GPIO_BTNS_LEDS_BASEADDR+8);
-
-	}
-	if(StatusEvent == XST_SPI_TRANSFER_DONE){
-		/*
-		 * Tell main loop that a command has been received.
-		 */
-		transferDone=1;
-	}
-}
+int init() DDR_TEXT;
+int main() LMB_TEXT;
+u8 Identify(u16 word, u32 *value) DDR_TEXT;
 
 int main()
 {
 	int Status;
+	u8 width;
+	u8 status;
+	u8 span = TRACE_EV_FRAME;
+	u32 value;
+
 	if((Status=init())!=XST_SUCCESS){
 		xil_printf("Error %d during initialization. Exiting.\r\n", Status);
 	}
 
-	/*
-	 * Prepare the data buffers for transmission and to receive data
-	 * when the SPI device is selected by a master.
-	 */
-	XSpi_Transfer(&DSPI, WriteBuffer, ReadBuffer, 2);
-
 	while(1){
 
-		if(transferDone==1){
-			transferDone=0;
-			cmd = ReadBuffer[0];
-			reg = ReadBuffer[1];
-			xil_printf("Recv %02X %X\r\n", cmd, reg);
-			switch(cmd){
-				case 0xAA://Write op
-					Status = XSpi_Transfer(&DSPI, WriteBuffer, ReadBuffer, 1);//Read data
-					if(Status!=XST_SUCCESS){
-						xil_printf("spi: %d\r\n", Status);
-					}
-					xil_printf("Write op received\r\n");
-					while(transferDone==0);
-					transferDone=0;
-					RegisterSet[reg] = ReadBuffer[0];
-					xil_printf("Register %d set to: 0x%02X\r\n", reg, RegisterSet[reg]);
-					if(reg == LEDREG){
-						Xil_Out32(XPAR_AXI_GPIO_BTNS_LEDS_BASEADDR+8, RegisterSet[LEDREG]);
-					}
-					break;
-				case 0xBB://Read op
-					WriteBuffer[0] = RegisterSet[reg];
-					Status= XSpi_Transfer(&DSPI, WriteBuffer, ReadBuffer, 1);
-					if(Status!=XST_SUCCESS){
-						xil_printf("spi: %d\r\n", Status);
-					}
-					xil_printf("Read op received\r\n");
-					while(transferDone==0);
-					transferDone=0;
-					break;
-				default:
-					xil_printf("Invalid command received: 0x%02X", ReadBuffer[0]);
-					break;
+		/*
+		 * No new event can be raised until the current one is answered,
+		 * so clearing it here cannot lose one.
+		 */
+		if(fabricEvents != 0){
+			fabricEvents = 0;
+			if(fabricAbort){
+				/*
+				 * The fabric ended the payload phase early and answered
+				 * the command itself; the event is the next frame.
+				 */
+				fabricAbort = 0;
+				phase = PHASE_FRAME;
 			}
 
-			XSpi_Transfer(&DSPI, WriteBuffer, ReadBuffer, 2);
+			switch(phase){
+			case PHASE_FRAME:
+				FabricFrame(Frame);
+				cmd = Frame[FRAME_OP];
+				width = Frame[FRAME_WIDTH];
+				reg = GetBE16(Frame + FRAME_ADDR);
+				value = GetBE32(Frame + FRAME_DATA);
+				Response[FRAME_OP] = cmd;
+				Response[FRAME_ADDR] = Frame[FRAME_ADDR];
+				Response[FRAME_ADDR+1] = Frame[FRAME_ADDR+1];
+				TraceMarkAt(fabricTicks, TRACE_EV_IRQ, cmd, reg);
+				span = TRACE_EV_FRAME;
+				TraceMark(span | TRACE_EV_BEGIN, cmd, reg);
+
+				switch(cmd){
+					case OP_NOP://Flush, only collects the previous response
+						value = 0;
+						status = STATUS_OK;
+						break;
+					case OP_WRITE://Write op
+						if((status = RegWrite(reg, width, value)) == STATUS_OK){
+							status = RegRead(reg, width, &value);
+						}
+						break;
+					case OP_READ://Read op
+						status = RegRead(reg, width, &value);
+						break;
+					case OP_IDENTIFY://reg = identify word
+						status = Identify(reg, &value);
+						break;
+					case OP_OPERAND://Second operand of the next command
+						operand = value;
+						status = STATUS_OK;
+						break;
+					case OP_SET_BITS:
+						status = RegUpdate(reg, width, 0, value, 0, &value);
+						break;
+					case OP_CLEAR_BITS:
+						status = RegUpdate(reg, width, value, 0, 0, &value);
+						break;
+					case OP_TOGGLE_BITS:
+						status = RegUpdate(reg, width, 0, 0, value, &value);
+						break;
+					case OP_MASK_WRITE://operand = mask
+						status = RegUpdate(reg, width, operand, value & operand, 0, &value);
+						break;
+					case OP_CAS://operand = expected value
+						status = RegCompareSwap(reg, width, operand, value, &value);
+						break;
+					case OP_WAIT://operand = mask, polls before re-arming
+						status = RegWait(reg, width, operand, value, WAIT_SLICE_US, &value);
+						break;
+					case OP_AXI_BATCH://value = number of requests
+						if(value == 0 || value > BRIDGE_MAX_OPS){
+							status = STATUS_BAD_LENGTH;
+							break;
+						}
+						payloadLen = value * BRIDGE_REQ_SIZE;
+						phase = PHASE_RECV;
+						break;
+					case OP_SCRIPT_LOAD://value = payload length, reg = script offset
+						if(value == 0 || value > PAYLOAD_SIZE){
+							status = STATUS_BAD_LENGTH;
+							break;
+						}
+						payloadLen = value;
+						phase = PHASE_RECV;
+						break;
+					case OP_CAPTURE_READ://value = length, operand = trace offset, width = encoding
+						if(value == 0 || value > (width == ENC_DZV ? DZV_MAX_SIZE(CAPTURE_SIZE / 4) : CAPTURE_SIZE)){
+							status = STATUS_BAD_LENGTH;
+							break;
+						}
+						status = CaptureTrace(width, operand, value, &payloadTx);
+						payloadLen = value;
+						phase = PHASE_SEND;
+						break;
+					case OP_BULK_WRITE://value = payload length, operand = count, width = encoding
+						if(value == 0 || value > PAYLOAD_SIZE
+							|| operand == 0 || operand > BULK_MAX_WORDS){
+							status = STATUS_BAD_LENGTH;
+							break;
+						}
+						payloadLen = value;
+						phase = PHASE_RECV;
+						break;
+					case OP_DELTA_SCAN://value = since generation, operand = count
+						status = RegDeltaScan(reg, operand, value, DeltaBuf, &deltaLen);
+						value = deltaLen;
+						break;
+					case OP_DELTA_READ://value = length of the staged delta
+						if(value == 0 || value > sizeof(DeltaBuf)){
+							status = STATUS_BAD_LENGTH;
+							break;
+						}
+						status = value == deltaLen ? STATUS_OK : STATUS_BAD_LENGTH;
+						payloadTx = DeltaBuf;
+						payloadLen = value;
+						phase = PHASE_SEND;
+						break;
+					case OP_TRACE://reg = TRACE_CLOCK, TRACE_COUNT or TRACE_START
+						status = TraceControl(reg, value, &value);
+						break;
+					case OP_TRACE_READ://value = length, operand = first event
+						if(value == 0 || value > TRACE_DEPTH * TRACE_EVENT_SIZE){
+							status = STATUS_BAD_LENGTH;
+							break;
+						}
+						status = TraceCopy(operand, value, &payloadTx);
+						payloadLen = value;
+						phase = PHASE_SEND;
+						break;
+					default:
+						value = 0;
+						status = STATUS_BAD_OP;
+						break;
+				}
+				break;
+
+			case PHASE_RECV:
+				TraceMarkAt(fabricTicks, TRACE_EV_IRQ, cmd, reg);
+				span = TRACE_EV_PAYLOAD;
+				TraceMark(span | TRACE_EV_BEGIN, cmd, reg);
+				FabricPayload(PayloadIn, payloadLen);
+				switch(cmd){
+					case OP_AXI_BATCH:
+						payloadLen = BridgeExecute(PayloadIn, value, PayloadOut, &status);
+						payloadTx = PayloadOut;
+						break;
+					case OP_SCRIPT_LOAD://no reply payload
+						status = ScriptLoad(reg, PayloadIn, value);
+						payloadLen = 0;
+						break;
+					case OP_BULK_WRITE://no reply payload, answers with the count
+						if((status = CodecUnpack(width, PayloadIn, value, BulkWords, operand)) == STATUS_OK){
+							status = RegWriteBlock(reg, BulkWords, operand);
+						}
+						value = operand;
+						payloadLen = 0;
+						break;
+				}
+				phase = payloadLen ? PHASE_SEND : PHASE_FRAME;
+				break;
+
+			case PHASE_SEND://ends in the fabric, never pending here
+				break;
+			}
 
+			/*
+			 * Answer before anything slow. The fabric clocks the payload
+			 * phases and puts the response out; a reply payload follows
+			 * the response without another event.
+			 */
+			TraceMark(span | TRACE_EV_END, cmd, reg);
+			if(phase == PHASE_RECV){
+				FabricRecv(payloadLen);
+				continue;
+			}
+			Response[FRAME_STATUS] = status;
+			PutBE32(Response + FRAME_DATA, value);
+			if(phase == PHASE_SEND){
+				FabricSend(Response, payloadTx, payloadLen);
+				phase = PHASE_FRAME;
+				continue;
+			}
+			FabricRespond(Response);
+
+			if(status != STATUS_OK || cmd == OP_WRITE){
+				TraceMark(TRACE_EV_PRINT | TRACE_EV_BEGIN, cmd, reg);
+				if(status == STATUS_BAD_OP){
+					xil_printf("Invalid command received: 0x%02X\r\n", cmd);
+				}
+				else if(status != STATUS_OK){
+					xil_printf("Rejected 0x%02X at 0x%04X: %d\r\n", cmd, reg, status);
+				}
+				else{
+					xil_printf("Register 0x%04X set to: 0x%X\r\n", reg, value);
+				}
+				TraceMark(TRACE_EV_PRINT | TRACE_EV_END, cmd, reg);
+			}
+		}
+		else if(captureState == CAPTURE_FINISHING){
+			TraceMark(TRACE_EV_CAPTURE | TRACE_EV_BEGIN, 0, 0);
+			CaptureFinish();
+			TraceMark(TRACE_EV_CAPTURE | TRACE_EV_END, 0, 0);
+		}
+		else if(scriptRunning){
+			/*
+			 * Scripts only run while no transfer is pending, one
+			 * instruction or delay tick at a time.
+			 */
+			ScriptStep();
 		}
 
 	}
@@ -130,57 +335,107 @@ int main()
 }
 
 
+/*
+ * Opcodes served, for the ID_OPS bitmap.
+ */
+static const u8 SupportedOps[] = {
+	OP_NOP, OP_WRITE, OP_READ, OP_AXI_BATCH, OP_OPERAND, OP_SET_BITS,
+	OP_CLEAR_BITS, OP_TOGGLE_BITS, OP_MASK_WRITE, OP_CAS, OP_WAIT,
+	OP_SCRIPT_LOAD, OP_CAPTURE_READ, OP_BULK_WRITE, OP_IDENTIFY,
+	OP_DELTA_SCAN, OP_DELTA_READ, OP_TRACE, OP_TRACE_READ
+};
+
+/**
+* Answers OP_IDENTIFY. Runs once per connection, so it stays in DDR.
+*
+* @param word identify word, ID_*
+* @param value receives the word
+*
+* @return STATUS_OK, STATUS_BAD_ADDR past ID_COUNT
+*/
+u8 Identify(u16 word, u32 *value){
+	u32 i;
+
+	*value = 0;
+	switch(word){
+		case ID_VERSION:
+			*value = (PROTOCOL_VERSION << 16) | FIRMWARE_VERSION;
+			break;
+		case ID_REGISTERS:
+			*value = REGMAP_N_REGS;
+			break;
+		case ID_PAYLOAD:
+			*value = PAYLOAD_SIZE;
+			break;
+		case ID_BURST:
+			*value = (BULK_MAX_WORDS << 16) | BRIDGE_MAX_OPS;
+			break;
+		case ID_FIFO:
+			*value = FABRIC_TXFIFO_SIZE;
+			break;
+		case ID_FEATURES:
+			*value = FEATURE_FABRIC | FEATURE_DZV;
+			break;
+		default:
+			if(word >= ID_COUNT){
+				return STATUS_BAD_ADDR;
+			}
+			for(i = 0; i < sizeof(SupportedOps); i++){
+				if(SupportedOps[i] / 32 == word - ID_OPS){
+					*value |= 1u << (SupportedOps[i] % 32);
+				}
+			}
+			break;
+	}
+	return STATUS_OK;
+}
+
 int init(){
 	int Status;
-	XSpi_Config *config;
+
+	/*
+	 * LMB data and the register RAM are NOLOAD, clear them before any
+	 * driver instance or register is used.
+	 */
+	PlacementInit();
 
 	/*
 	 * Initialize the base platform by enabling caches & uart controller.
 	 */
 	init_platform();
-
+	BridgeInit();
 
 	/*
-	 * Initialize the SPI driver so that it is  ready to use.
+	 * Tell the fabric where the register sets are and which registers
+	 * have hooks. It does not answer any frame before FabricInit().
 	 */
-	config = XSpi_LookupConfig(XPAR_AXI_QUAD_SPI_0_DEVICE_ID);
-	if (config == NULL) {
-		return XST_FAILURE;
-	}
-	Status = XSpi_CfgInitialize(&DSPI, config,
-				config->BaseAddress);
-	if (Status != XST_SUCCESS) {
-		return XST_FAILURE;
-	}
+	RegFabricInit();
 
 	/*
-	 * The SPI device is a slave by default and the clock phase and polarity
-	 * have to be set according to its master. SPI Mode 0
+	 * Initialize the interrupt controller driver so that it is ready to
+	 * use.
 	 */
-	Status = XSpi_SetOptions(&DSPI, 0);
+	Status = XIntc_Initialize(&INTERRUPTC, XPAR_AXI_INTC_0_DEVICE_ID);
 	if (Status != XST_SUCCESS) {
+		xil_printf("Error initializing INTC\r\n");
 		return XST_FAILURE;
 	}
 
 	/*
-	 * Initialize the interrupt controller driver so that it is ready to
-	 * use.
+	 * Connect the link interrupt and let the fabric serve frames. SPI
+	 * mode 0 is fixed in the fabric.
 	 */
-	Status = XIntc_Initialize(&INTERRUPTC, XPAR_AXI_INTC_0_DEVICE_ID);
+	Status = FabricInit(&INTERRUPTC);
 	if (Status != XST_SUCCESS) {
-		xil_printf("Error initializing INTC\r\n");
 		return XST_FAILURE;
 	}
 
 	/*
-	 * Connect a device driver handler that will be called when an interrupt
-	 * for the device occurs, the device driver handler performs the
-	 * specific interrupt processing for the device.
+	 * The capture timer shares the interrupt controller.
 	 */
-	Status = XIntc_Connect(&INTERRUPTC, XPAR_INTC_0_SPI_0_VEC_ID,
-				(XInterruptHandler) XSpi_InterruptHandler,
-				(void *)&DSPI);
+	Status = CaptureInit(&INTERRUPTC);
 	if (Status != XST_SUCCESS) {
+		xil_printf("Error initializing the capture timer\r\n");
 		return XST_FAILURE;
 	}
 
@@ -194,11 +449,6 @@ int init(){
 	   return XST_FAILURE;
 	}
 
-	/*
-	 * Enable the interrupt for the SPI device.
-	 */
-	XIntc_Enable(&INTERRUPTC, XPAR_INTC_0_SPI_0_VEC_ID);
-
 	/* Enable interrupts from the hardware */
 	Xil_ExceptionInit();
 	// Register the interrupt controller handler with the exception table.
@@ -208,21 +458,6 @@ int init(){
 				&INTERRUPTC);
 	Xil_ExceptionEnable();
 
-
-	/*
-	 * Setup the handler for the SPI that will be called from the interrupt
-	 * context when an SPI status occurs, specify a pointer to the SPI
-	 * driver instance as the callback reference so the handler is able to
-	 * access the instance data.
-	 */
-	XSpi_SetStatusHandler(&DSPI, &DSPI,
-				(XSpi_StatusHandler) DSPI_Interrupt_Handler);
-
-	/*
-	 * Start the SPI driver so that the device is enabled.
-	 */
-	XSpi_Start(&DSPI);
-
 	/*
 	 * Set Buttons as inputs
 	 */
@@ -0,0 +1,52 @@
+/******************************************************************************/
+/*                                                                            */
+/* placement.h -- Memory placement of firmware code and data                  */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Section attributes matching the named sections in lscript.ld. LMB BRAM is  */
+/* single cycle and never misses, so code and data on the interrupt and       */
+/* frame dispatch path go there. Large buffers and cold code go to DDR, which */
+/* is reached through the caches.                                             */
+/*                                                                            */
+/* .fab_bss is the register RAM of dspi_regfile, which the fabric reads and   */
+/* writes on its own; only register arrays go there.                          */
+/*                                                                            */
+/* .lmb_bss and .fab_bss are NOLOAD and are cleared by PlacementInit().       */
+/* .ddr_bss is part of .bss and is cleared by the startup code.               */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef PLACEMENT_H_
+#define PLACEMENT_H_
+
+#define LMB_TEXT __attribute__((section(".lmb_text")))
+#define LMB_DATA __attribute__((section(".lmb_data")))
+#define LMB_BSS __attribute__((section(".lmb_bss")))
+#define DDR_TEXT __attribute__((section(".ddr_text")))
+#define DDR_BSS __attribute__((section(".ddr_bss")))
+#define FAB_BSS __attribute__((section(".fab_bss")))
+
+extern char __lmb_bss_start[];
+extern char __lmb_bss_end[];
+extern volatile char __fab_bss_start[];
+extern volatile char __fab_bss_end[];
+
+/**
+* Clears .lmb_bss and .fab_bss. Must run before any LMB_BSS or FAB_BSS
+* object is used.
+*/
+static inline void PlacementInit(){
+	char *p;
+	volatile char *f;
+
+	for(p = __lmb_bss_start; p < __lmb_bss_end; p++){
+		*p = 0;
+	}
+	for(f = __fab_bss_start; f < __fab_bss_end; f++){
+		*f = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,118 @@
+/******************************************************************************/
+/*                                                                            */
+/* reghooks.c -- Peripheral-backed registers                                  */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Read and write hooks of the registers that mirror hardware. A register    */
+/* gets hooks by filling its slot in the hook table of its region, all other */
+/* slots stay zero and their registers are plain memory.                      */
+/*                                                                            */
+/*     btn   read samples the button GPIO, writes are denied                  */
+/*     led   read samples the LED GPIO, write drives it                       */
+/*     script  read returns the script state, write starts or stops it        */
+/*     cap_ctl  read returns the capture state, write arms, stops or triggers */
+/*     cap_len, cap_trig_at, cap_zlen  read the finished trace, writes denied */
+/*                                                                            */
+/******************************************************************************/
+
+#include "xparameters.h"
+#include "xil_io.h"
+#include "registers.h"
+#include "dspi_protocol.h"
+#include "script.h"
+#include "capture.h"
+
+#define GPIO_BTN_DATA (XPAR_AXI_GPIO_BTNS_LEDS_BASEADDR)
+#define GPIO_LED_DATA (XPAR_AXI_GPIO_BTNS_LEDS_BASEADDR+8)
+
+static u8 RegDenyWrite(u16 addr, u32 value) LMB_TEXT;
+static u8 BtnRead(u16 addr, u32 *value) LMB_TEXT;
+static u8 LedRead(u16 addr, u32 *value) LMB_TEXT;
+static u8 LedWrite(u16 addr, u32 value) LMB_TEXT;
+static u8 ScriptRead(u16 addr, u32 *value);
+static u8 ScriptWrite(u16 addr, u32 value);
+static u8 CaptureCtlRead(u16 addr, u32 *value);
+static u8 CaptureCtlWrite(u16 addr, u32 value);
+static u8 CaptureLenRead(u16 addr, u32 *value);
+static u8 CaptureTrigAtRead(u16 addr, u32 *value);
+static u8 CaptureZLenRead(u16 addr, u32 *value);
+
+static u8 RegDenyWrite(u16 addr, u32 value){
+	return STATUS_DENIED;
+}
+
+static u8 BtnRead(u16 addr, u32 *value){
+	*value = Xil_In32(GPIO_BTN_DATA);
+	return STATUS_OK;
+}
+
+static u8 LedRead(u16 addr, u32 *value){
+	*value = Xil_In32(GPIO_LED_DATA);
+	return STATUS_OK;
+}
+
+static u8 LedWrite(u16 addr, u32 value){
+	Xil_Out32(GPIO_LED_DATA, value);
+	return STATUS_OK;
+}
+
+static u8 ScriptRead(u16 addr, u32 *value){
+	*value = ScriptState();
+	return STATUS_OK;
+}
+
+static u8 ScriptWrite(u16 addr, u32 value){
+	if(value & SCRIPT_CTL_STOP){
+		ScriptStop();
+		return STATUS_OK;
+	}
+	return ScriptStart(value & 0xFFFF);
+}
+
+static u8 CaptureCtlRead(u16 addr, u32 *value){
+	*value = CaptureState();
+	return STATUS_OK;
+}
+
+static u8 CaptureCtlWrite(u16 addr, u32 value){
+	return CaptureControl(value);
+}
+
+static u8 CaptureLenRead(u16 addr, u32 *value){
+	*value = captureLen;
+	return STATUS_OK;
+}
+
+static u8 CaptureTrigAtRead(u16 addr, u32 *value){
+	*value = captureTrigAt;
+	return STATUS_OK;
+}
+
+static u8 CaptureZLenRead(u16 addr, u32 *value){
+	*value = captureZLen;
+	return STATUS_OK;
+}
+
+static const RegHook SetHooks[REGION_Set_COUNT] LMB_DATA = {
+	[REG_BTN - REGION_Set_BASE] = {BtnRead, RegDenyWrite},
+	[REG_LED - REGION_Set_BASE] = {LedRead, LedWrite},
+};
+
+/*
+ * Set32 is large and its hooks are not on the fast path, keep the table out
+ * of LMB.
+ */
+static const RegHook Set32Hooks[REGION_Set32_COUNT] = {
+	[REG_CAP_CTL - REGION_Set32_BASE] = {CaptureCtlRead, CaptureCtlWrite},
+	[REG_CAP_LEN - REGION_Set32_BASE] = {CaptureLenRead, RegDenyWrite},
+	[REG_CAP_TRIG_AT - REGION_Set32_BASE] = {CaptureTrigAtRead, RegDenyWrite},
+	[REG_CAP_ZLEN - REGION_Set32_BASE] = {CaptureZLenRead, RegDenyWrite},
+	[REG_SCRIPT - REGION_Set32_BASE] = {ScriptRead, ScriptWrite},
+};
+
+const RegHook *const RegionHooks[REGMAP_N_REGIONS] LMB_DATA = {
+	[REGMAP_INDEX_Set] = SetHooks,
+	[REGMAP_INDEX_Set32] = Set32Hooks,
+};
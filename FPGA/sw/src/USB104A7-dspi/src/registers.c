@@ -0,0 +1,434 @@
+/******************************************************************************/
+/*                                                                            */
+/* registers.c -- 16-bit register address space                               */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Address map, see regmap.def:                                               */
+/*     0x0000 - 0x003F   64 x 8-bit    FAB   0 buttons, 1 LEDs, rest general  */
+/*     0x0100 - 0x013F   64 x 16-bit   FAB   general purpose                  */
+/*     0x0200 - 0x02FF  256 x 32-bit   FAB   application state                */
+/*     0x1000 - 0x4FFF  16K x 32-bit   DDR   bulk tables                      */
+/*                                                                            */
+/* FAB regions are also read and written by dspi_regfile, which serves plain  */
+/* frames for registers without hooks from the same RAM.                      */
+/*                                                                            */
+/* Generations live in DDR for every region, next to nothing on the frame     */
+/* path: one store per write.                                                 */
+/*                                                                            */
+/******************************************************************************/
+
+#include "sleep.h"
+#include "registers.h"
+#include "dspi_protocol.h"
+#include "fabric.h"
+
+#define WAIT_POLL_US 2
+
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	volatile REGMAP_TYPE(width) Register##id[count] backing##_BSS;
+#include "regmap.def"
+
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	static u32 Generation##id[count] DDR_BSS;
+#include "regmap.def"
+
+static const RegRegion regions[] LMB_DATA = {
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	{base, count, width, attrs, Register##id, Generation##id},
+#include "regmap.def"
+};
+#define N_REGIONS REGMAP_N_REGIONS
+
+u32 RegGeneration LMB_DATA = 1;	// bumped on every change, never 0 so no scan selects all
+
+/**
+* Finds the region holding an address and checks the access width.
+*
+* @param addr register address
+* @param width access width in bytes, 0 for the native width
+* @param status receives STATUS_BAD_ADDR or STATUS_BAD_WIDTH on failure
+*
+* @return region, or NULL if the access is not allowed
+*
+*/
+static LMB_TEXT const RegRegion* RegLookup(u16 addr, u8 width, u8 *status){
+	const RegRegion *r;
+	u32 i;
+
+	for(i = 0; i < N_REGIONS; i++){
+		r = &regions[i];
+		if(addr >= r->base && addr - r->base < r->count){
+			if(width != 0 && width != r->width){
+				*status = STATUS_BAD_WIDTH;
+				return NULL;
+			}
+			return r;
+		}
+	}
+	*status = STATUS_BAD_ADDR;
+	return NULL;
+}
+
+/**
+* Finds the hooks of a register.
+*
+* @return hooks, or NULL for a plain memory register
+*
+*/
+static inline const RegHook* RegHookOf(const RegRegion *r, u16 idx){
+	const RegHook *h = RegionHooks[r - regions];
+
+	if(h == NULL || (h[idx].OnRead == NULL && h[idx].OnWrite == NULL)){
+		return NULL;
+	}
+	return &h[idx];
+}
+
+static inline void RegStore(const RegRegion *r, u16 idx, u32 value){
+	switch(r->width){
+		case 1: ((volatile u8*)r->store)[idx] = value; break;
+		case 2: ((volatile u16*)r->store)[idx] = value; break;
+		default: ((volatile u32*)r->store)[idx] = value; break;
+	}
+}
+
+static inline u32 RegLoad(const RegRegion *r, u16 idx){
+	switch(r->width){
+		case 1: return ((volatile u8*)r->store)[idx];
+		case 2: return ((volatile u16*)r->store)[idx];
+		default: return ((volatile u32*)r->store)[idx];
+	}
+}
+
+static inline void RegTouch(const RegRegion *r, u16 idx){
+	r->gen[idx] = ++RegGeneration;
+}
+
+/**
+* Reads a register. A peripheral-backed register is sampled by its read hook
+* and the sample is kept in the register, as a change if it differs.
+*
+* @param addr register address
+* @param width access width in bytes, 0 for the native width
+* @param value receives the register value, zero extended
+*
+* @return STATUS_OK, STATUS_BAD_ADDR, STATUS_BAD_WIDTH or a hook status
+*
+*/
+u8 RegRead(u16 addr, u8 width, u32 *value){
+	const RegRegion *r;
+	const RegHook *h;
+	u16 idx;
+	u8 status;
+
+	if((r = RegLookup(addr, width, &status)) == NULL){
+		*value = 0;
+		return status;
+	}
+	idx = addr - r->base;
+	if((h = RegHookOf(r, idx)) != NULL && h->OnRead != NULL){
+		if((status = h->OnRead(addr, value)) != STATUS_OK){
+			*value = 0;
+			return status;
+		}
+		if(*value != RegLoad(r, idx)){
+			RegStore(r, idx, *value);
+			RegTouch(r, idx);
+		}
+	}
+	*value = RegLoad(r, idx);
+	return STATUS_OK;
+}
+
+/**
+* Writes a register. Values wider than the register are truncated. The write
+* hook of a peripheral-backed register sees the truncated value and may
+* reject it, in which case the register keeps its value.
+*
+* @param addr register address
+* @param width access width in bytes, 0 for the native width
+* @param value value to write
+*
+* @return STATUS_OK, STATUS_BAD_ADDR, STATUS_BAD_WIDTH or a hook status
+*
+*/
+u8 RegWrite(u16 addr, u8 width, u32 value){
+	const RegRegion *r;
+	const RegHook *h;
+	u16 idx;
+	u8 status;
+
+	if((r = RegLookup(addr, width, &status)) == NULL){
+		return status;
+	}
+	idx = addr - r->base;
+	if(r->width < 4){
+		value &= (1u << (8 * r->width)) - 1;
+	}
+	if((h = RegHookOf(r, idx)) != NULL && h->OnWrite != NULL){
+		if((status = h->OnWrite(addr, value)) != STATUS_OK){
+			return status;
+		}
+	}
+	RegStore(r, idx, value);
+	RegTouch(r, idx);
+	return STATUS_OK;
+}
+
+/**
+* Writes a run of consecutive registers of one region, as RegWrite would one
+* by one. Plain memory registers are stored directly; the run stops at the
+* first register a hook rejects.
+*
+* @param addr first register address
+* @param values values to write
+* @param count number of registers
+*
+* @return STATUS_OK, STATUS_BAD_ADDR if the run leaves its region, or a hook
+* status
+*
+*/
+u8 RegWriteBlock(u16 addr, const u32 *values, u32 count){
+	const RegRegion *r;
+	const RegHook *h;
+	u16 idx;
+	u32 i;
+	u8 status;
+
+	if((r = RegLookup(addr, 0, &status)) == NULL){
+		return status;
+	}
+	idx = addr - r->base;
+	if(count > (u32)(r->count - idx)){
+		return STATUS_BAD_ADDR;
+	}
+	for(i = 0; i < count; i++, idx++){
+		if((h = RegHookOf(r, idx)) != NULL){
+			if((status = RegWrite(addr + i, 0, values[i])) != STATUS_OK){
+				return status;
+			}
+			continue;
+		}
+		RegStore(r, idx, values[i]);
+		RegTouch(r, idx);
+	}
+	return STATUS_OK;
+}
+
+/**
+* Modifies bits of a register in one step: ((reg & ~clear) | set) ^ toggle.
+* The fabric is held off meanwhile, so the update cannot interleave with a
+* frame it serves.
+*
+* @param addr register address
+* @param width access width in bytes, 0 for the native width
+* @param clear bits to clear
+* @param set bits to set
+* @param toggle bits to invert
+* @param value receives the new register value
+*
+* @return STATUS_OK, STATUS_BAD_ADDR, STATUS_BAD_WIDTH or a hook status
+*
+*/
+u8 RegUpdate(u16 addr, u8 width, u32 clear, u32 set, u32 toggle, u32 *value){
+	u32 old;
+	u8 status;
+
+	FabricHold();
+	if((status = RegRead(addr, width, &old)) != STATUS_OK){
+		*value = 0;
+	}
+	else if((status = RegWrite(addr, width, ((old & ~clear) | set) ^ toggle)) != STATUS_OK){
+		*value = old;
+	}
+	else{
+		status = RegRead(addr, width, value);
+	}
+	FabricRelease();
+	return status;
+}
+
+/**
+* Writes a register only if it holds an expected value.
+*
+* @param addr register address
+* @param width access width in bytes, 0 for the native width
+* @param expect value the register must hold
+* @param next value to write
+* @param value receives the register value after the call
+*
+* @return STATUS_OK if swapped, STATUS_MISMATCH if not, or a lookup or hook status
+*
+*/
+u8 RegCompareSwap(u16 addr, u8 width, u32 expect, u32 next, u32 *value){
+	u8 status;
+
+	FabricHold();
+	if((status = RegRead(addr, width, value)) == STATUS_OK){
+		if(*value != expect){
+			status = STATUS_MISMATCH;
+		}
+		else if((status = RegWrite(addr, width, next)) == STATUS_OK){
+			status = RegRead(addr, width, value);
+		}
+	}
+	FabricRelease();
+	return status;
+}
+
+/**
+* Polls a register until (reg & mask) == (match & mask). The time spent
+* sampling is not counted, so the wait may run a little over timeoutUs.
+*
+* @param addr register address
+* @param width access width in bytes, 0 for the native width
+* @param mask bits to compare
+* @param match value of those bits to wait for
+* @param timeoutUs time to poll for
+* @param value receives the last sample
+*
+* @return STATUS_OK once the bits match, STATUS_TIMEOUT, or a lookup or hook status
+*
+*/
+u8 RegWait(u16 addr, u8 width, u32 mask, u32 match, u32 timeoutUs, u32 *value){
+	u32 elapsed;
+	u8 status;
+
+	for(elapsed = 0; ; elapsed += WAIT_POLL_US){
+		if((status = RegRead(addr, width, value)) != STATUS_OK){
+			return status;
+		}
+		if((*value & mask) == (match & mask)){
+			return STATUS_OK;
+		}
+		if(elapsed >= timeoutUs){
+			return STATUS_TIMEOUT;
+		}
+		usleep(WAIT_POLL_US);
+	}
+}
+
+/**
+* Gives the registers the fabric wrote since the last call a new generation.
+* A dirty word changes every register in it.
+*/
+static void RegFabricDirty(){
+	u32 dirty[FABRIC_DIRTY_WORDS];
+	const RegRegion *r;
+	u32 any = 0;
+	u32 i, word;
+	u16 idx;
+
+	FabricDirty(dirty);
+	for(i = 0; i < FABRIC_DIRTY_WORDS; i++){
+		any |= dirty[i];
+	}
+	if(any == 0){
+		return;
+	}
+	for(i = 0; i < N_REGIONS; i++){
+		r = &regions[i];
+		if(!FabricOwns(r->store)){
+			continue;
+		}
+		for(idx = 0; idx < r->count; idx++){
+			word = ((UINTPTR)r->store - FABRIC_BASEADDR + idx * r->width) / 4;
+			if(dirty[word / 32] & (1u << (word % 32))){
+				RegTouch(r, idx);
+			}
+		}
+	}
+}
+
+/**
+* Stages the delta of a run of registers of one region: the current
+* generation, a bitmap of the registers changed after since, and their
+* values, see OP_DELTA_SCAN. Sampled registers are read to find out whether
+* they changed.
+*
+* @param addr first register address
+* @param count number of registers, at most DELTA_MAX_REGS
+* @param since generation the caller is up to date with, 0 for none
+* @param buf receives the delta, DELTA_MAX_SIZE(count) bytes at most
+* @param len receives the length of the delta, 0 on failure
+*
+* @return STATUS_OK, STATUS_BAD_LENGTH, STATUS_BAD_ADDR if the run leaves its
+* region, or a hook status
+*
+*/
+u8 RegDeltaScan(u16 addr, u32 count, u32 since, u8 *buf, u32 *len){
+	const RegRegion *r;
+	const RegHook *h;
+	u8 *bitmap;
+	u8 *out;
+	u32 value;
+	u32 i;
+	u16 idx;
+	u8 status;
+
+	*len = 0;
+	if(count == 0 || count > DELTA_MAX_REGS){
+		return STATUS_BAD_LENGTH;
+	}
+	if((r = RegLookup(addr, 0, &status)) == NULL){
+		return status;
+	}
+	idx = addr - r->base;
+	if(count > (u32)(r->count - idx)){
+		return STATUS_BAD_ADDR;
+	}
+	RegFabricDirty();
+	bitmap = buf + 4;
+	out = bitmap + (count + 7) / 8;
+	for(i = 0; i < (count + 7) / 8; i++){
+		bitmap[i] = 0;
+	}
+	for(i = 0; i < count; i++, idx++){
+		if((h = RegHookOf(r, idx)) != NULL && h->OnRead != NULL){
+			if((status = RegRead(addr + i, 0, &value)) != STATUS_OK){
+				return status;
+			}
+		}
+		if(since != 0 && r->gen[idx] <= since){
+			continue;
+		}
+		bitmap[i / 8] |= 1 << (i % 8);
+		PutBE32(out, RegLoad(r, idx));
+		out += 4;
+	}
+	PutBE32(buf, RegGeneration);
+	*len = out - buf;
+	return STATUS_OK;
+}
+
+/**
+* Maps the regions held in the register RAM into dspi_regfile and has it
+* forward every access to a register with a read or write hook, so hooks
+* run as before. Must run before FabricInit().
+*/
+void RegFabricInit(){
+	const RegRegion *r;
+	const RegHook *h;
+	u32 i;
+	u16 idx;
+	u8 window = 0;
+
+	for(i = 0; i < N_REGIONS; i++){
+		r = &regions[i];
+		if(!FabricOwns(r->store) || window == FABRIC_WINDOWS){
+			continue;
+		}
+		FabricMapRegion(window++, r->base, r->count, r->width, r->store);
+		if((h = RegionHooks[i]) == NULL){
+			continue;
+		}
+		for(idx = 0; idx < r->count; idx++){
+			if(h[idx].OnRead != NULL || h[idx].OnWrite != NULL){
+				FabricForward((volatile u8*)r->store + idx * r->width,
+					h[idx].OnRead != NULL, h[idx].OnWrite != NULL);
+			}
+		}
+	}
+}
@@ -0,0 +1,79 @@
+/******************************************************************************/
+/*                                                                            */
+/* registers.h -- 16-bit register address space                               */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* The register space is split into regions of same-width registers. Each     */
+/* region is backed by its own array, placed in the register RAM of the       */
+/* fabric (FAB) for small hot sets or in DDR for large tables. All accesses   */
+/* are bounds checked against the region table. Regions and named registers   */
+/* come from regmap.def, shared with the host.                                */
+/*                                                                            */
+/* Registers backed by peripherals have read and write hooks, looked up by    */
+/* register index in a per-region hook table (reghooks.c). The peripheral is  */
+/* only touched when such a register is accessed; all other registers are     */
+/* plain memory.                                                              */
+/*                                                                            */
+/* Every register keeps the generation of its last change: RegGeneration is   */
+/* bumped on each write and copied to the register. A sampled register counts */
+/* as changed when the sample differs from the value kept. Writes the fabric  */
+/* serves on its own are only seen through its dirty bitmap, one bit per word */
+/* of register RAM, so they change every register sharing the word. Scanning  */
+/* for registers newer than a generation lets the host read only what changed */
+/* since its last scan.                                                       */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef REGISTERS_H_
+#define REGISTERS_H_
+
+#include "xil_types.h"
+#include "placement.h"
+#include "regmap.h"
+
+typedef struct {
+	u16 base;		// first address of the region
+	u16 count;		// number of registers
+	u8 width;		// native register width in bytes: 1, 2 or 4
+	u8 attrs;		// REG_ATTR_* of the region
+	volatile void *store;	// backing array
+	u32 *gen;		// generation of the last change, per register
+} RegRegion;
+
+/*
+ * Hooks of a peripheral-backed register. OnRead replaces the stored value with
+ * a fresh sample, OnWrite runs before the value is stored and can reject it.
+ * Either may be NULL.
+ */
+typedef struct {
+	u8 (*OnRead)(u16 addr, u32 *value);
+	u8 (*OnWrite)(u16 addr, u32 value);
+} RegHook;
+
+/*
+ * Hook tables indexed by region (REGMAP_INDEX_<id>), then by register offset
+ * in the region. NULL for regions without hooks.
+ */
+extern const RegHook *const RegionHooks[REGMAP_N_REGIONS];
+
+/*
+ * Backing arrays, Register<id> for every region of regmap.def.
+ */
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	extern volatile REGMAP_TYPE(width) Register##id[count];
+#include "regmap.def"
+
+extern u32 RegGeneration;
+
+u8 RegRead(u16 addr, u8 width, u32 *value) LMB_TEXT;
+u8 RegWrite(u16 addr, u8 width, u32 value) LMB_TEXT;
+u8 RegWriteBlock(u16 addr, const u32 *values, u32 count) LMB_TEXT;
+u8 RegUpdate(u16 addr, u8 width, u32 clear, u32 set, u32 toggle, u32 *value) LMB_TEXT;
+u8 RegCompareSwap(u16 addr, u8 width, u32 expect, u32 next, u32 *value) LMB_TEXT;
+u8 RegWait(u16 addr, u8 width, u32 mask, u32 match, u32 timeoutUs, u32 *value) LMB_TEXT;
+u8 RegDeltaScan(u16 addr, u32 count, u32 since, u8 *buf, u32 *len) DDR_TEXT;
+void RegFabricInit() DDR_TEXT;
+
+#endif
@@ -0,0 +1,174 @@
+/******************************************************************************/
+/*                                                                            */
+/* script.c -- Register scripts interpreted on the MicroBlaze                 */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Interpreter of the SC_* bytecode. A failing instruction stops the script   */
+/* and leaves its status and pc in the script state.                          */
+/*                                                                            */
+/******************************************************************************/
+
+#include <string.h>
+#include "sleep.h"
+#include "script.h"
+#include "registers.h"
+#include "dspi_protocol.h"
+
+static u8 ScriptMem[SCRIPT_SIZE] DDR_BSS;
+
+u8 scriptRunning LMB_BSS;	// polled by the main loop
+static u16 pc;
+static u8 lastStatus;
+static u32 acc;
+static u32 remainingUs;		// of the current SC_DELAY or SC_WAIT
+static u8 fTiming;		// remainingUs is loaded
+
+/**
+* Copies bytecode into script memory. Not allowed while a script runs.
+*
+* @param offset destination in script memory
+* @param code bytecode
+* @param len number of bytes
+*
+* @return STATUS_OK, STATUS_BUSY or STATUS_BAD_ADDR
+*
+*/
+u8 ScriptLoad(u16 offset, const u8 *code, u16 len){
+	if(scriptRunning){
+		return STATUS_BUSY;
+	}
+	if(offset >= SCRIPT_SIZE || len > SCRIPT_SIZE - offset){
+		return STATUS_BAD_ADDR;
+	}
+	memcpy(ScriptMem + offset, code, len);
+	return STATUS_OK;
+}
+
+/**
+* Starts the script at pc.
+*
+* @return STATUS_OK, STATUS_BUSY or STATUS_BAD_ADDR
+*
+*/
+u8 ScriptStart(u16 start){
+	if(scriptRunning){
+		return STATUS_BUSY;
+	}
+	if(start >= SCRIPT_SIZE){
+		return STATUS_BAD_ADDR;
+	}
+	pc = start;
+	lastStatus = STATUS_OK;
+	acc = 0;
+	fTiming = 0;
+	scriptRunning = 1;
+	return STATUS_OK;
+}
+
+void ScriptStop(){
+	scriptRunning = 0;
+}
+
+/**
+* @return the script state, see SCRIPT_STATE_* in dspi_protocol.h
+*/
+u32 ScriptState(){
+	return (scriptRunning ? SCRIPT_STATE_RUNNING : 0) | ((u32)lastStatus << 16) | pc;
+}
+
+static void ScriptFail(u8 status){
+	lastStatus = status;
+	scriptRunning = 0;
+}
+
+/**
+* Runs one instruction, or one tick of a delay or wait.
+*/
+void ScriptStep(){
+	static const u8 size[] = {1, 7, 7, 7, 7, 5, 15, 3, 11, 11, 3};
+	const u8 *p = ScriptMem + pc;
+	u8 op = p[0];
+	u16 addr = 0;
+	u32 value;
+	u8 status = STATUS_OK;
+
+	if(op >= sizeof(size) || pc + size[op] > SCRIPT_SIZE){
+		ScriptFail(STATUS_BAD_OP);
+		return;
+	}
+	if(size[op] >= 3 && op < SC_BEQ){
+		addr = GetBE16(p + 1);
+	}
+
+	switch(op){
+		case SC_END:
+			scriptRunning = 0;
+			return;
+		case SC_WRITE:
+			status = RegWrite(addr, 0, GetBE32(p + 3));
+			break;
+		case SC_SET:
+			status = RegUpdate(addr, 0, 0, GetBE32(p + 3), 0, &value);
+			break;
+		case SC_CLEAR:
+			status = RegUpdate(addr, 0, GetBE32(p + 3), 0, 0, &value);
+			break;
+		case SC_TOGGLE:
+			status = RegUpdate(addr, 0, 0, 0, GetBE32(p + 3), &value);
+			break;
+		case SC_DELAY:
+			if(!fTiming){
+				remainingUs = GetBE32(p + 1);
+				fTiming = 1;
+			}
+			if(remainingUs != 0){
+				value = remainingUs < SCRIPT_TICK_US ? remainingUs : SCRIPT_TICK_US;
+				usleep(value);
+				remainingUs -= value;
+				return;
+			}
+			fTiming = 0;
+			break;
+		case SC_WAIT:
+			if(!fTiming){
+				remainingUs = GetBE32(p + 11);
+				fTiming = 1;
+			}
+			if((status = RegRead(addr, 0, &value)) != STATUS_OK){
+				break;
+			}
+			if((value & GetBE32(p + 3)) != (GetBE32(p + 7) & GetBE32(p + 3))){
+				if(remainingUs == 0){
+					status = STATUS_TIMEOUT;
+					break;
+				}
+				value = remainingUs < SCRIPT_TICK_US ? remainingUs : SCRIPT_TICK_US;
+				usleep(value);
+				remainingUs -= value;
+				return;
+			}
+			fTiming = 0;
+			break;
+		case SC_LOAD:
+			status = RegRead(addr, 0, &acc);
+			break;
+		case SC_BEQ:
+		case SC_BNE:
+			if(((acc & GetBE32(p + 1)) == GetBE32(p + 5)) == (op == SC_BEQ)){
+				pc = GetBE16(p + 9);
+				return;
+			}
+			break;
+		case SC_JUMP:
+			pc = GetBE16(p + 1);
+			return;
+	}
+	if(status != STATUS_OK){
+		fTiming = 0;
+		ScriptFail(status);
+		return;
+	}
+	pc += size[op];
+}
@@ -0,0 +1,33 @@
+/******************************************************************************/
+/*                                                                            */
+/* script.h -- Register scripts interpreted on the MicroBlaze                 */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* A script is SC_* bytecode (dspi_protocol.h) uploaded into script memory    */
+/* with OP_SCRIPT_LOAD and started by writing its offset to the script        */
+/* register. The main loop runs it one step at a time while no frame is       */
+/* waiting, so the DSPI link stays responsive during long scripts. Delays and */
+/* waits advance in SCRIPT_TICK_US steps; time spent serving frames is not    */
+/* counted, so they may run long but never short.                             */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef SCRIPT_H_
+#define SCRIPT_H_
+
+#include "xil_types.h"
+#include "placement.h"
+
+#define SCRIPT_TICK_US 10
+
+u8 ScriptLoad(u16 offset, const u8 *code, u16 len);
+u8 ScriptStart(u16 pc);
+void ScriptStop();
+u32 ScriptState();
+void ScriptStep();
+
+extern u8 scriptRunning;
+
+#endif
@@ -0,0 +1,103 @@
+/******************************************************************************/
+/*                                                                            */
+/* trace.c -- Timestamped event trace of the frame path                       */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Events are stored big endian as OP_TRACE_READ sends them. Event i of the   */
+/* trace lives at i % TRACE_DEPTH, so once the ring wrapped only the last     */
+/* TRACE_DEPTH events can be read. A read is staged linearly in TraceOut      */
+/* before it goes out, the ring keeps filling while it streams.               */
+/*                                                                            */
+/******************************************************************************/
+
+#include <string.h>
+#include "trace.h"
+
+static u8 TraceMem[TRACE_DEPTH * TRACE_EVENT_SIZE] DDR_BSS;
+static u8 TraceOut[TRACE_DEPTH * TRACE_EVENT_SIZE] DDR_BSS;
+
+volatile u8 traceOn LMB_BSS;
+static u32 traceCount LMB_BSS;	// events since the start
+
+/**
+* Appends an event to the ring.
+*
+* @param ticks trace clock of the event
+* @param event TRACE_EV_*, with TRACE_EV_BEGIN or TRACE_EV_END
+* @param op opcode of the frame
+* @param addr address of the frame
+*
+*/
+void TraceRecord(u32 ticks, u8 event, u8 op, u16 addr){
+	u8 *p = TraceMem + (traceCount & (TRACE_DEPTH - 1)) * TRACE_EVENT_SIZE;
+
+	PutBE32(p, ticks);
+	p[4] = event;
+	p[5] = op;
+	PutBE16(p + 6, addr);
+	traceCount++;
+}
+
+/**
+* Answers OP_TRACE.
+*
+* @param word TRACE_CLOCK, TRACE_COUNT or TRACE_START
+* @param value 1 to start a new trace, 0 to stop it, for TRACE_START
+* @param result receives the clock, or the events recorded
+*
+* @return STATUS_OK, STATUS_BAD_ADDR for an unknown word
+*
+*/
+u8 TraceControl(u16 word, u32 value, u32 *result){
+	switch(word){
+		case TRACE_CLOCK:
+			*result = TraceTicks();
+			break;
+		case TRACE_COUNT:
+			*result = traceCount;
+			break;
+		case TRACE_START:
+			if(value != 0){
+				traceCount = 0;
+			}
+			traceOn = value != 0;
+			*result = traceCount;
+			break;
+		default:
+			*result = 0;
+			return STATUS_BAD_ADDR;
+	}
+	return STATUS_OK;
+}
+
+/**
+* Stages events for OP_TRACE_READ.
+*
+* @param first index of the first event since the start
+* @param len bytes to send, whole events
+* @param data receives the bytes to stream, also when rejected
+*
+* @return STATUS_OK, STATUS_BAD_LENGTH for a partial event,
+* STATUS_BAD_ADDR for events not recorded yet or already overwritten
+*
+*/
+u8 TraceCopy(u32 first, u32 len, const u8 **data){
+	u32 count = traceCount;
+	u32 n = len / TRACE_EVENT_SIZE;
+	u32 at, run;
+
+	*data = TraceOut;
+	if(len % TRACE_EVENT_SIZE != 0){
+		return STATUS_BAD_LENGTH;
+	}
+	if(first > count || n > count - first || count - first > TRACE_DEPTH){
+		return STATUS_BAD_ADDR;
+	}
+	at = first & (TRACE_DEPTH - 1);
+	run = TRACE_DEPTH - at < n ? TRACE_DEPTH - at : n;
+	memcpy(TraceOut, TraceMem + at * TRACE_EVENT_SIZE, run * TRACE_EVENT_SIZE);
+	memcpy(TraceOut + run * TRACE_EVENT_SIZE, TraceMem, (n - run) * TRACE_EVENT_SIZE);
+	return STATUS_OK;
+}
@@ -0,0 +1,60 @@
+/******************************************************************************/
+/*                                                                            */
+/* trace.h -- Timestamped event trace of the frame path                       */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Counter 1 of the capture timer runs free at the AXI clock and timestamps   */
+/* events of the frame path into a ring of the last TRACE_DEPTH events in     */
+/* DDR. The host reads the clock with OP_TRACE to align it with its own and   */
+/* streams the ring with OP_TRACE_READ, see dspi_protocol.h.                  */
+/*                                                                            */
+/* Events are only recorded from the main loop, so the ring needs no lock.    */
+/* The link interrupt just latches its time in fabricTicks. While the trace   */
+/* is stopped a mark costs one load and branch.                               */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "xil_types.h"
+#include "xil_io.h"
+#include "xparameters.h"
+#include "xtmrctr.h"
+#include "placement.h"
+#include "dspi_protocol.h"
+
+#if XPAR_AXI_TIMER_0_CLOCK_FREQ_HZ != TRACE_TICK_HZ
+#error "The trace clock must run at TRACE_TICK_HZ"
+#endif
+
+#define TRACE_TIMER 1	// counter of the capture timer, counter 0 samples
+
+void TraceRecord(u32 ticks, u8 event, u8 op, u16 addr) LMB_TEXT;
+u8 TraceControl(u16 word, u32 value, u32 *result) DDR_TEXT;
+u8 TraceCopy(u32 first, u32 len, const u8 **data) DDR_TEXT;
+
+extern volatile u8 traceOn;
+
+/*
+ * The free-running clock, read straight from the counter register.
+ */
+static inline u32 TraceTicks(){
+	return Xil_In32(XPAR_AXI_TIMER_0_BASEADDR + TRACE_TIMER * XTC_TIMER_COUNTER_OFFSET + XTC_TCR_OFFSET);
+}
+
+static inline void TraceMark(u8 event, u8 op, u16 addr){
+	if(traceOn){
+		TraceRecord(TraceTicks(), event, op, addr);
+	}
+}
+
+static inline void TraceMarkAt(u32 ticks, u8 event, u8 op, u16 addr){
+	if(traceOn){
+		TraceRecord(ticks, event, op, addr);
+	}
+}
+
+#endif
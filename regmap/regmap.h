@@ -0,0 +1,70 @@
+/******************************************************************************/
+/*                                                                            */
+/* regmap.h -- Compile time view of the register map                          */
+/*                                                                            */
+/******************************************************************************/
+/* File Description:                                                          */
+/*                                                                            */
+/* Constants generated from regmap.def:                                       */
+/*     REG_<id>, REG_ATTRS_<id>        address and attributes of named regs   */
+/*     REGION_<id>_BASE/_COUNT/_WIDTH  layout of each region                  */
+/*     REGION_<id>_ATTRS                                                      */
+/*     REGION_<id>_FABRIC              1 if dspi_regfile serves the region    */
+/*     REGMAP_N_REGS                   registers in all regions               */
+/* and the storage type of a width, REGMAP_TYPE(width). The firmware and the  */
+/* host build their own lookup tables from regmap.def with these.             */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef REGMAP_H_
+#define REGMAP_H_
+
+#include <stdint.h>
+
+#define REG_ATTR_CACHEABLE	0x01	// only changes when written over DSPI, see devRegBatch()
+#define REG_ATTR_READ_EFFECT	0x02	// a read samples hardware
+#define REG_ATTR_WRITE_EFFECT	0x04	// a write drives hardware, never drop or merge
+#define REG_ATTR_READONLY	0x08	// writes are rejected
+#define REG_ATTR_COMMAND	0x10	// a write starts an action, writing back what was read is no restore
+
+#define REGMAP_IN_FABRIC_LMB 0
+#define REGMAP_IN_FABRIC_DDR 0
+#define REGMAP_IN_FABRIC_FAB 1
+
+#define REGMAP_TYPE_1 uint8_t
+#define REGMAP_TYPE_2 uint16_t
+#define REGMAP_TYPE_4 uint32_t
+#define REGMAP_TYPE(width) REGMAP_TYPE_##width
+
+enum {
+#define REGMAP_REG(id, name, addr, attrs, help) \
+	REG_##id = (addr), \
+	REG_ATTRS_##id = (attrs),
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) \
+	REGION_##id##_BASE = (base), \
+	REGION_##id##_COUNT = (count), \
+	REGION_##id##_WIDTH = (width), \
+	REGION_##id##_ATTRS = (attrs), \
+	REGION_##id##_FABRIC = REGMAP_IN_FABRIC_##backing,
+#include "regmap.def"
+};
+
+enum {
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) REGMAP_INDEX_##id,
+#include "regmap.def"
+	REGMAP_N_REGIONS
+};
+
+enum {
+#define REGMAP_REG(id, name, addr, attrs, help) REGMAP_NAMED_##id,
+#include "regmap.def"
+	REGMAP_N_NAMED
+};
+
+enum {
+	REGMAP_N_REGS = 0
+#define REGMAP_REGION(id, base, count, width, backing, attrs, help) + (count)
+#include "regmap.def"
+};
+
+#endif